@@ -0,0 +1,223 @@
+##
+# Benchmarks.
+#
+# Measures fetch, bind, execute and LOB paths of hdbtcl against the stub DBCAPI library (see
+# stub/dbcapi_stub.c), which generates result sets without a server, thus the results mostly
+# reflect the time hdbtcl itself spends:
+#
+#   HDBCAPILIB=/path/to/libdbcapistub.so tclsh bench.tcl ?-rows N? ?-latency US? ?-json file?
+#
+# Where:
+#   -rows     - number of rows fetched by the fetch benchmarks (default 200000). Other benchmarks
+#               scale their number of operations from it.
+#   -latency  - simulated latency (us) of every DBCAPI call that would go to the server (default 0).
+#   -json     - file where the results are saved for comparing runs.
+##
+array set options { -rows 200000 -latency 0 -json "" }
+foreach { opt val } $::argv {
+    if { ![info exists options($opt)] } {
+        puts stderr "usage: tclsh bench.tcl ?-rows N? ?-latency US? ?-json file?"
+        exit 1
+    }
+    set options($opt) $val
+}
+set num_rows $options(-rows)
+set latency "latency=$options(-latency)"
+
+lappend ::auto_path [pwd]
+set version [package require hdbtcl]
+
+set results {}
+
+##
+# Runs the benchmark script and reports how long it took to process the specified number of rows.
+##
+proc bench { name rows script { bytes 0 } } {
+    set started [clock microseconds]
+    uplevel 1 $script
+    set elapsed [expr { max([clock microseconds] - $started, 1) }]
+    set rows_per_sec [expr { $rows * 1e6 / $elapsed }]
+    set ns_per_row [expr { $elapsed * 1e3 / $rows }]
+    set line [format "  %-36s %10d rows %14.0f rows/s %10.1f ns/row" $name $rows $rows_per_sec $ns_per_row]
+    if { $bytes > 0 } {
+        append line [format " %8.1f MB/s" [expr { $bytes / double($elapsed) }]]
+    }
+    puts $line
+    lappend ::results [dict create name $name rows $rows seconds [expr { $elapsed / 1e6 }] rows_per_sec $rows_per_sec ns_per_row $ns_per_row bytes $bytes]
+}
+
+proc drain { stmt } {
+    while { [$stmt fetch row] } {}
+}
+
+proc drain_many { stmt } {
+    while { [llength [$stmt fetchmany 1000]] > 0 } {}
+}
+
+proc read_lob { state chunk args } {
+    return [expr { $state + [string length $chunk] }]
+}
+
+puts "hdbtcl $version benchmarks: $num_rows rows, $options(-latency) us latency"
+
+set conn [hdb connect -serverNode stub]
+
+set cols "cols=int,bigint,double,decimal,varchar,nvarchar,timestamp"
+set stmt [$conn prepare "SELECT rows=$num_rows $cols $latency"]
+$stmt execute
+bench "fetch" $num_rows { drain $stmt }
+$stmt execute
+bench "fetchmany" $num_rows { drain_many $stmt }
+$stmt execute
+bench "fetchjson" $num_rows {
+    while { [$stmt fetchjson -maxrows 1000] != "\[\]" } {}
+}
+$stmt execute
+bench "channel csv" $num_rows {
+    set rows [$stmt channel]
+    fconfigure $rows -translation binary
+    while { [string length [read $rows 65536]] > 0 } {}
+    close $rows
+}
+$stmt close
+
+set stmt [$conn prepare "SELECT rows=$num_rows cols=int,bigint,double nulls=2 $latency"]
+$stmt execute
+bench "fetchmany numbers with NULLs" $num_rows { drain_many $stmt }
+$stmt execute
+bench "fetchcolumn double" $num_rows {
+    $stmt fetchcolumn 2 -as double -nulls nulls
+}
+$stmt close
+
+set stmt [$conn prepare "SELECT rows=$num_rows cols=int,varbinary width=200 $latency"]
+$stmt execute
+bench "fetchmany binaries + encode hex" $num_rows {
+    while { [llength [set rows [$stmt fetchmany 1000]]] > 0 } {
+        foreach row $rows {
+            binary encode hex [lindex $row 1]
+        }
+    }
+}
+$stmt execute
+bench "fetchmany binaries -binaryas hex" $num_rows {
+    while { [llength [$stmt fetchmany 1000 -binaryas hex]] > 0 } {}
+}
+$stmt close
+
+# 1536-dimension embeddings unpacked in Tcl and converted by hdbtcl
+set num_vectors [expr { max($num_rows / 100, 1) }]
+set stmt [$conn prepare "SELECT rows=$num_vectors cols=int,real_vector width=1536 $latency"]
+$stmt execute
+bench "fetchmany vectors + binary scan" $num_vectors {
+    while { [llength [set rows [$stmt fetchmany 100]]] > 0 } {
+        foreach row $rows {
+            binary scan [lindex $row 1] f* embedding
+        }
+    }
+}
+$stmt execute
+bench "fetchmany vectors -binaryas list" $num_vectors {
+    while { [llength [$stmt fetchmany 100 -binaryas list]] > 0 } {}
+}
+$stmt close
+
+set stmt [$conn prepare "INSERT INTO t VALUES (?, ?) params=int,real_vector $latency"]
+set embedding [binary format f* [lrepeat 1536 0.5]]
+set args {}
+for { set i 0 } { $i < $num_vectors } { incr i } {
+    lappend args [list $i $embedding]
+}
+bench "execute packed vectors" $num_vectors {
+    foreach arg $args {
+        $stmt execute {*}$arg
+    }
+}
+# executemany sends the argument lists in batches, one execution - and one round trip - per batch
+bench "executemany packed vectors" $num_vectors {
+    $stmt executemany $args
+}
+$stmt close
+
+# scaling curve of the conversion of large rowsets by the conversion threads
+set conversion_threads [dict get [hdb configure] conversionthreads]
+set stmt [$conn prepare "SELECT rows=$num_rows cols=int,decimal,varchar,nvarchar,varbinary,timestamp width=40 $latency"]
+foreach threads { 1 2 4 8 } {
+    hdb configure -conversionthreads $threads
+    $stmt execute
+    bench "fetchmany 50000 wide, $threads threads" $num_rows {
+        while { [llength [$stmt fetchmany 50000 -binaryas base64]] > 0 } {}
+    }
+}
+hdb configure -conversionthreads $conversion_threads
+$stmt close
+
+set num_executions [expr { max($num_rows / 10, 1) }]
+set stmt [$conn prepare "INSERT INTO t VALUES (?, ?, ?, ?) params=int,bigint,double,nvarchar $latency"]
+bench "bind and execute" $num_executions {
+    for { set i 0 } { $i < $num_executions } { incr i } {
+        $stmt execute $i [expr { $i * 1000000 }] [expr { $i / 3.0 }] "row $i"
+    }
+}
+$stmt close
+
+set stmt [$conn prepare "UPDATE t SET x = 1 $latency"]
+bench "execute" $num_executions {
+    for { set i 0 } { $i < $num_executions } { incr i } {
+        $stmt execute
+    }
+}
+$stmt close
+
+set lob_size 65536
+set num_lobs [expr { max($num_rows / 100, 1) }]
+set stmt [$conn prepare "SELECT rows=$num_lobs cols=int,clob lob=$lob_size $latency"]
+$stmt execute
+bench "LOB fetch" $num_lobs { drain $stmt } [expr { $num_lobs * $lob_size }]
+$stmt execute
+bench "LOB read command" $num_lobs {
+    while { [$stmt fetch row -lobreadcommand read_lob -lobreadinitialstate 0] } {}
+} [expr { $num_lobs * $lob_size }]
+$stmt close
+
+set lob_file [file join [pwd] bench_lob.bin]
+set chan [open $lob_file wb]
+puts -nonewline $chan [string repeat "\x55" $lob_size]
+close $chan
+set chan [open $lob_file rb]
+set stmt [$conn prepare "INSERT INTO t VALUES (?, ?) params=int,blob $latency"]
+bench "LOB send from channel" $num_lobs {
+    for { set i 0 } { $i < $num_lobs } { incr i } {
+        seek $chan 0
+        $stmt execute $i $chan
+    }
+} [expr { $num_lobs * $lob_size }]
+$stmt close
+close $chan
+file delete $lob_file
+
+$conn close
+
+if { $options(-json) != "" } {
+    set entries {}
+    foreach result $results {
+        set fields {}
+        dict for { key value } $result {
+            if { $key == "name" } {
+                lappend fields "\"$key\": \"$value\""
+            } else {
+                lappend fields "\"$key\": $value"
+            }
+        }
+        lappend entries "    {[join $fields {, }]}"
+    }
+    set chan [open $options(-json) w]
+    puts $chan "{"
+    puts $chan "  \"hdbtcl\": \"$version\", \"tcl\": \"[info patchlevel]\", \"rows\": $num_rows, \"latency_us\": $options(-latency),"
+    puts $chan "  \"results\": \["
+    puts $chan [join $entries ",\n"]
+    puts $chan "  \]"
+    puts $chan "}"
+    close $chan
+    puts "results are saved in $options(-json)"
+}
@@ -0,0 +1,275 @@
+/**
+ * Microbenchmarks of the hdbtcl conversion kernels.
+ *
+ * Drives the kernels that `fetch`, `execute` and LOB streaming are built on with synthetic DBCAPI
+ * buffers inside an embedded Tcl interpreter, thus the results include neither the Tcl command
+ * dispatch nor DBCAPI:
+ *  - column - `NewColumnValueObj`, conversion of a fetched value into a Tcl object (binary values
+ *             also into hex and base64 text)
+ *  - bind   - `SetBindBuffer` and `LoadBindValue`, conversion of an argument into a bound value
+ *  - lob    - `ReadLobChunk` loops of `FetchLobColumn` (each piece replaces the previous one) and
+ *             `SaveDataToObject` (pieces are appended), reading a 1 MiB LOB
+ *
+ *   kernels ?-iterations N? ?-json file?
+ *
+ * Reports cycles (where the time stamp counter is available) and nanoseconds per value.
+ */
+#include "../hdbtcl.c"
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#include <x86intrin.h>
+#define READ_CYCLES() ( (uint64_t) __rdtsc() )
+#else
+#define READ_CYCLES() ( (uint64_t) 0 )
+#endif
+
+#define MAX_RESULTS     64
+#define LOB_SIZE        ( 1024 * 1024 )
+
+typedef struct kernel_result {
+    const char *        group;
+    const char *        name;
+    long                values;
+    double              cycles;         /// per value
+    double              ns;             /// per value
+} Kernel_Result;
+
+static Kernel_Result results[MAX_RESULTS];
+static int num_results;
+
+typedef struct kernel_timer {
+    Tcl_WideInt         started_ns;
+    uint64_t            started_cycles;
+} Kernel_Timer;
+
+static void
+Timer_Start (Kernel_Timer * timer_ptr)
+{
+    timer_ptr->started_ns = GetMonotonicTime();
+    timer_ptr->started_cycles = READ_CYCLES();
+}
+
+/**
+ * Saves and prints the time it took to process the specified number of values since the timer was started.
+ */
+static void
+Timer_Report (Kernel_Timer * timer_ptr, const char * group, const char * name, long values)
+{
+    uint64_t cycles = READ_CYCLES() - timer_ptr->started_cycles;
+    Tcl_WideInt ns = GetMonotonicTime() - timer_ptr->started_ns;
+    Kernel_Result * result_ptr = &results[num_results++];
+    result_ptr->group = group;
+    result_ptr->name = name;
+    result_ptr->values = values;
+    result_ptr->cycles = (double) cycles / values;
+    result_ptr->ns = (double) ns / values;
+    printf("  %-6s %-28s %10ld values %12.1f cycles/value %12.1f ns/value\n", group, name, values, result_ptr->cycles, result_ptr->ns);
+}
+
+/**
+ * Converts the same fetched value into a Tcl object over and over.
+ */
+static void
+Bench_ColumnValue (const char * name, dbcapi_data_type type, dbcapi_native_type native_type, const void * data, size_t length, Binary_Format binary_format, long iterations)
+{
+    char buffer[256];
+    memcpy(buffer, data, length);
+    size_t value_length = length;
+    dbcapi_bool is_null = 0;
+    dbcapi_data_value value = { .buffer = buffer, .buffer_size = sizeof(buffer), .length = &value_length, .type = type, .is_null = &is_null };
+
+    Kernel_Timer timer;
+    Timer_Start(&timer);
+    for ( long i = 0; i < iterations; i++ ) {
+        Tcl_Obj * obj = NewColumnValueObj(&value, native_type, binary_format);
+        Tcl_IncrRefCount(obj);
+        Tcl_DecrRefCount(obj);
+    }
+    Timer_Report(&timer, "column", name, iterations);
+}
+
+/**
+ * Binds the argument over and over. When `text` is provided the argument gets it as its string
+ * representation before each iteration, so its internal representation has to be recreated.
+ */
+static void
+Bench_BindValue (Tcl_Interp * interp, const char * name, dbcapi_data_type type, dbcapi_native_type native_type, Tcl_Obj * arg, const char * text, long iterations)
+{
+    Tcl_IncrRefCount(arg);
+    dbcapi_bool is_null = 0;
+    PrimitiveSqlValue sql_arg;
+    Stmt_Arena arena = { NULL };
+
+    Kernel_Timer timer;
+    Timer_Start(&timer);
+    for ( long i = 0; i < iterations; i++ ) {
+        if ( text != NULL ) {
+            Tcl_SetStringObj(arg, text, -1);
+        }
+        Arena_Mark mark = Arena_GetMark(&arena);
+        dbcapi_data_value value = { .type = type, .buffer_size = 5000 };
+        SetBindBuffer(&value, &sql_arg);
+        if ( LoadBindValue(interp, arg, is_null, native_type, &value, &sql_arg, &arena) != TCL_OK ) {
+            fprintf(stderr, "%s: %s\n", name, Tcl_GetStringResult(interp));
+            exit(1);
+        }
+        Arena_Release(&arena, mark);
+    }
+    Timer_Report(&timer, "bind", name, iterations);
+    Arena_Free(&arena);
+    Tcl_DecrRefCount(arg);
+}
+
+static char lob_data[LOB_SIZE];
+
+/**
+ * Serves pieces of the synthetic LOB.
+ */
+static dbcapi_i32
+SyntheticLobRead (dbcapi_stmt * stmt, dbcapi_u32 index, size_t offset, void * buffer, size_t size)
+{
+    if ( offset >= LOB_SIZE ) {
+        return 0;
+    }
+    size_t len = LOB_SIZE - offset < size ? LOB_SIZE - offset : size;
+    memcpy(buffer, lob_data + offset, len);
+    return (dbcapi_i32) len;
+}
+
+/**
+ * Reads the synthetic LOB piece by piece over and over. Each value is a complete LOB.
+ */
+static void
+Bench_LobRead (const char * name, dbcapi_data_type data_type, bool append, long iterations)
+{
+    Kernel_Timer timer;
+    Timer_Start(&timer);
+    for ( long i = 0; i < iterations; i++ ) {
+        Tcl_Obj * buff = Tcl_NewObj();
+        Tcl_IncrRefCount(buff);
+        size_t offset = 0;
+        int read_len;
+        do {
+            int keep = 0;
+            if ( append ) {
+                if ( data_type == A_STRING ) {
+                    Tcl_GetStringFromObj(buff, &keep);
+                } else {
+                    Tcl_GetByteArrayFromObj(buff, &keep);
+                }
+            }
+            read_len = ReadLobChunk(SyntheticLobRead, NULL, 0, offset, data_type, buff, keep, LOB_CHUNK_SIZE);
+            offset += read_len;
+        } while ( read_len > 0 );
+        Tcl_DecrRefCount(buff);
+    }
+    Timer_Report(&timer, "lob", name, iterations);
+}
+
+static void
+SaveJson (const char * file_name, long iterations)
+{
+    FILE * out = fopen(file_name, "w");
+    if ( out == NULL ) {
+        perror(file_name);
+        exit(1);
+    }
+    fprintf(out, "{\n  \"tcl\": \"%s\", \"iterations\": %ld, \"cycles\": %s,\n  \"results\": [\n", TCL_PATCH_LEVEL, iterations, READ_CYCLES() != 0 ? "true" : "false");
+    for ( int i = 0; i < num_results; i++ ) {
+        fprintf(out, "    {\"group\": \"%s\", \"name\": \"%s\", \"values\": %ld, \"cycles_per_value\": %.2f, \"ns_per_value\": %.2f}%s\n",
+            results[i].group, results[i].name, results[i].values, results[i].cycles, results[i].ns, i + 1 < num_results ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    fclose(out);
+    printf("results are saved in %s\n", file_name);
+}
+
+int
+main (int argc, char * argv[])
+{
+    long iterations = 1000000;
+    const char * json_file = NULL;
+    for ( int i = 1; i < argc; i += 2 ) {
+        if ( i + 1 < argc && strcmp(argv[i], "-iterations") == 0 ) {
+            iterations = strtol(argv[i + 1], NULL, 10);
+        } else if ( i + 1 < argc && strcmp(argv[i], "-json") == 0 ) {
+            json_file = argv[i + 1];
+        } else {
+            fprintf(stderr, "usage: %s ?-iterations N? ?-json file?\n", argv[0]);
+            return 1;
+        }
+    }
+    if ( iterations <= 0 ) {
+        iterations = 1;
+    }
+
+    Tcl_FindExecutable(argv[0]);
+    Tcl_Interp * interp = Tcl_CreateInterp();
+
+    printf("hdbtcl conversion kernels: %ld iterations%s\n", iterations, READ_CYCLES() != 0 ? "" : " (cycles are not available)");
+
+    uint8_t u8 = 200;
+    int16_t i16 = -12345;
+    int32_t i32 = 123456789;
+    int64_t i64 = INT64_C(1234567890123456789);
+    float f32 = 3.14159f;
+    double f64 = 2.718281828459045;
+    uint8_t flag = 1;
+    const char * decimal = "1234567890.123";
+    const char * ascii = "The quick brown fox jumps over";
+    const char * utf8 = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xe4\xb8\x96\xe7\x95\x8c";
+    const char * emoji = "Smile \xf0\x9f\x98\x80, wink \xf0\x9f\x98\x89";
+    char long_ascii[201];
+    memset(long_ascii, 'a', 200);
+    long_ascii[200] = '\0';
+    const char * timestamp = "2024-02-29 12:34:56.789000000";
+    const unsigned char binary[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff };
+    unsigned char long_binary[200];
+    for ( int i = 0; i < (int) sizeof(long_binary); i++ ) {
+        long_binary[i] = (unsigned char) ( i * 37 );
+    }
+
+    Bench_ColumnValue("tinyint", A_UVAL8, DT_TINYINT, &u8, sizeof(u8), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("smallint", A_VAL16, DT_SMALLINT, &i16, sizeof(i16), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("int", A_VAL32, DT_INT, &i32, sizeof(i32), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("bigint", A_VAL64, DT_BIGINT, &i64, sizeof(i64), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("real", A_FLOAT, DT_REAL, &f32, sizeof(f32), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("double", A_DOUBLE, DT_DOUBLE, &f64, sizeof(f64), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("boolean", A_UVAL8, DT_BOOLEAN, &flag, sizeof(flag), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("decimal", A_STRING, DT_DECIMAL, decimal, strlen(decimal), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("varchar (ascii, 30)", A_STRING, DT_VARCHAR1, ascii, strlen(ascii), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("varchar (ascii, 200)", A_STRING, DT_VARCHAR1, long_ascii, strlen(long_ascii), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("nvarchar (utf-8, 20)", A_STRING, DT_NVARCHAR, utf8, strlen(utf8), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("nvarchar (supplementary, 20)", A_STRING, DT_NVARCHAR, emoji, strlen(emoji), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("timestamp", A_STRING, DT_TIMESTAMP, timestamp, strlen(timestamp), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("varbinary (16)", A_BINARY, DT_VARBINARY, binary, sizeof(binary), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("varbinary (200)", A_BINARY, DT_VARBINARY, long_binary, sizeof(long_binary), BINARY_AS_BYTES, iterations);
+    Bench_ColumnValue("varbinary (200) as hex", A_BINARY, DT_VARBINARY, long_binary, sizeof(long_binary), BINARY_AS_HEX, iterations);
+    Bench_ColumnValue("varbinary (200) as base64", A_BINARY, DT_VARBINARY, long_binary, sizeof(long_binary), BINARY_AS_BASE64, iterations);
+
+    Bench_BindValue(interp, "int", A_VAL32, DT_INT, Tcl_NewIntObj(i32), NULL, iterations);
+    Bench_BindValue(interp, "int from string", A_VAL32, DT_INT, Tcl_NewObj(), "123456789", iterations);
+    Bench_BindValue(interp, "bigint", A_VAL64, DT_BIGINT, Tcl_NewWideIntObj(i64), NULL, iterations);
+    Bench_BindValue(interp, "bigint from string", A_VAL64, DT_BIGINT, Tcl_NewObj(), "1234567890123456789", iterations);
+    Bench_BindValue(interp, "double", A_DOUBLE, DT_DOUBLE, Tcl_NewDoubleObj(f64), NULL, iterations);
+    Bench_BindValue(interp, "double from string", A_DOUBLE, DT_DOUBLE, Tcl_NewObj(), "2.718281828459045", iterations);
+    Bench_BindValue(interp, "boolean from string", A_VAL32, DT_BOOLEAN, Tcl_NewObj(), "true", iterations);
+    Bench_BindValue(interp, "nvarchar", A_STRING, DT_NVARCHAR, Tcl_NewStringObj(utf8, -1), NULL, iterations);
+    Tcl_Obj * emoji_obj = Tcl_NewObj();
+    SetStringObjFromUtf8(emoji_obj, emoji, strlen(emoji));
+    Bench_BindValue(interp, "nvarchar (supplementary)", A_STRING, DT_NVARCHAR, emoji_obj, NULL, iterations);
+    Bench_BindValue(interp, "varbinary", A_BINARY, DT_VARBINARY, Tcl_NewByteArrayObj(binary, sizeof(binary)), NULL, iterations);
+
+    memset(lob_data, 'x', sizeof(lob_data));
+    long lob_iterations = iterations / 1000 > 0 ? iterations / 1000 : 1;
+    Bench_LobRead("clob pieces (1 MiB)", A_STRING, false, lob_iterations);
+    Bench_LobRead("blob pieces (1 MiB)", A_BINARY, false, lob_iterations);
+    Bench_LobRead("clob into object (1 MiB)", A_STRING, true, lob_iterations);
+    Bench_LobRead("blob into object (1 MiB)", A_BINARY, true, lob_iterations);
+
+    if ( json_file != NULL ) {
+        SaveJson(json_file, iterations);
+    }
+    Tcl_DeleteInterp(interp);
+    return 0;
+}
@@ -1,3 +1,8 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+// clock_gettime is not declared in the strict C99 mode otherwise
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -5,11 +10,16 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <memory.h>
+#include <ctype.h>
+#include <math.h>
+#include <errno.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <limits.h>
+#include <time.h>
+#include <unistd.h>
 static char *
 itoa(int value, char * result, int base) {
     // constraints:
@@ -22,13 +32,51 @@ itoa(int value, char * result, int base) {
 		*--out = "0123456789" [value % base];
 		value /= base;
 	} while ( value != 0 && out > buf );
-	return memcpy(result, out, sizeof(buf) - (buf - out));
+	return memcpy(result, out, buf + sizeof(buf) - out);
 }
 #endif
 
 #include <tcl.h>
 #include <DBCAPI.h>
 
+/*
+ * Static tracepoints for perf, bpftrace and SystemTap. They are compiled in when the build finds
+ * sys/sdt.h (see unix/Makefile) and are single NOPs until a tracer attaches to them.
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define PROBE1( name, a1 )                  DTRACE_PROBE1( hdbtcl, name, a1 )
+#define PROBE2( name, a1, a2 )              DTRACE_PROBE2( hdbtcl, name, a1, a2 )
+#define PROBE3( name, a1, a2, a3 )          DTRACE_PROBE3( hdbtcl, name, a1, a2, a3 )
+#define PROBE4( name, a1, a2, a3, a4 )      DTRACE_PROBE4( hdbtcl, name, a1, a2, a3, a4 )
+#define PROBE5( name, a1, a2, a3, a4, a5 )  DTRACE_PROBE5( hdbtcl, name, a1, a2, a3, a4, a5 )
+#else
+// arguments are compiled, so they do not become unused variables, but never evaluated
+#define PROBE1( name, a1 )                  do { if ( 0 ) { (void) (a1); } } while ( 0 )
+#define PROBE2( name, a1, a2 )              do { if ( 0 ) { (void) (a1); (void) (a2); } } while ( 0 )
+#define PROBE3( name, a1, a2, a3 )          do { if ( 0 ) { (void) (a1); (void) (a2); (void) (a3); } } while ( 0 )
+#define PROBE4( name, a1, a2, a3, a4 )      do { if ( 0 ) { (void) (a1); (void) (a2); (void) (a3); (void) (a4); } } while ( 0 )
+#define PROBE5( name, a1, a2, a3, a4, a5 )  do { if ( 0 ) { (void) (a1); (void) (a2); (void) (a3); (void) (a4); (void) (a5); } } while ( 0 )
+#endif
+
+/*
+ * Vector instructions that scan text for ASCII runs, encode binaries and widen float vectors. AVX2 (and SSSE3) are
+ * used when the build targets them (for example, with -mavx2), SSE2 is available on all x86-64
+ * targets.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HAVE_SSE2
+#define HAVE_SSSE3
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#define HAVE_SSE2
+#define HAVE_SSSE3
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HAVE_SSE2
+#endif
+
 /**
  * Collection of DBCAPI functions used by this interface.
  */
@@ -69,6 +117,12 @@ static struct dbcapi {
     dbcapi_bool             ( * get_column_info )( dbcapi_stmt * dbcapi_stmt, dbcapi_u32 col_index, dbcapi_column_info * buffer );
     dbcapi_i32              ( * get_data )( dbcapi_stmt * dbcapi_stmt, dbcapi_u32 col_index, size_t offset, void * buffer, size_t size );
     dbcapi_retcode          ( * get_print_line )( dbcapi_stmt * dbcapi_stmt, const dbcapi_i32 host_type, void * buffer, size_t * length_indicator, size_t buffer_size, const dbcapi_bool terminate );
+    dbcapi_stmt *           ( * execute_direct )( dbcapi_connection * dbcapi_conn, const char * sql_str );
+    dbcapi_bool             ( * execute_immediate )( dbcapi_connection * dbcapi_conn, const char * sql_str );
+    dbcapi_bool             ( * cancel )( dbcapi_connection * dbcapi_conn );
+    // array binding is optional, these are NULL when the library does not provide it
+    dbcapi_bool             ( * set_batch_size )( dbcapi_stmt * dbcapi_stmt, dbcapi_u32 num_rows );
+    dbcapi_bool             ( * set_param_bind_type )( dbcapi_stmt * dbcapi_stmt, size_t row_size );
 } dbcapi;
 
 #ifdef _WIN32
@@ -122,6 +176,10 @@ find_sym ( void * lib_handle, const char * sym_name )
     }                                                   \
 } while (0)
 
+#define INIT_OPTIONAL_FN( handle, sym ) do {            \
+    dbcapi.sym = find_sym( handle, "dbcapi_" #sym );    \
+} while (0)
+
 static bool
 init_dbcapi ( const char * apilib_filename )
 {
@@ -165,6 +223,11 @@ init_dbcapi ( const char * apilib_filename )
     INIT_FN( lib, get_column_info );
     INIT_FN( lib, get_data );
     INIT_FN( lib, get_print_line );
+    INIT_FN( lib, execute_direct );
+    INIT_FN( lib, execute_immediate );
+    INIT_FN( lib, cancel );
+    INIT_OPTIONAL_FN( lib, set_batch_size );
+    INIT_OPTIONAL_FN( lib, set_param_bind_type );
 
     return true;
 }
@@ -176,7 +239,13 @@ init_dbcapi ( const char * apilib_filename )
 #define BYTES_PER_CODEPOINT 4
 #endif
 
-#define NUM_NATIVE_TYPES 0x50
+/**
+ * HANA Cloud REAL_VECTOR type. It is newer than the DBCAPI.h versions hdbtcl is built with, thus its code is
+ * defined here.
+ */
+#define NATIVE_TYPE_REAL_VECTOR ((dbcapi_native_type) 96)
+
+#define NUM_NATIVE_TYPES 0x61
 
 /**
  * The constant string used by the module to return literals.
@@ -272,6 +341,7 @@ Hdbtcl_InitLiterals (Hdbtcl_Literals * lit_ptr)
     lit_ptr->dt[DT_ABAP_ITAB]           = Tcl_NewStringObj("ABAP_ITAB",           -1);
     lit_ptr->dt[DT_RECORD_ROW_STORE]    = Tcl_NewStringObj("RECORD_ROW_STORE",    -1);
     lit_ptr->dt[DT_RECORD_COLUMN_STORE] = Tcl_NewStringObj("RECORD_COLUMN_STORE", -1);
+    lit_ptr->dt[NATIVE_TYPE_REAL_VECTOR] = Tcl_NewStringObj("REAL_VECTOR",         -1);
     for (int i = 0; i < NUM_NATIVE_TYPES; i++ ) {
         Tcl_IncrRefCount(lit_ptr->dt[i]);
     }
@@ -311,18 +381,376 @@ GetTypeName (Hdbtcl_Literals * lit_ptr, dbcapi_native_type type)
     return lit_ptr->dt_unknown;
 }
 
+/**
+ * Performance counters. Times are measured by the monotonic clock in nanoseconds.
+ *
+ * \note All members are counters of the same type, so counters can be processed as an array.
+ */
+typedef struct hdbtcl_stats {
+    Tcl_WideInt         connects;
+    Tcl_WideInt         connect_time;
+    Tcl_WideInt         prepares;
+    Tcl_WideInt         prepare_time;
+    Tcl_WideInt         executes;
+    Tcl_WideInt         execute_time;
+    Tcl_WideInt         fetches;        /// fetch requests
+    Tcl_WideInt         fetch_time;     /// time DBCAPI spent fetching rows
+    Tcl_WideInt         rows;           /// fetched rows
+    Tcl_WideInt         convert_time;   /// time spent creating TCL values of fetched columns
+    Tcl_WideInt         bytes;          /// size of the converted column values
+    Tcl_WideInt         lob_time;       /// time spent streaming LOBs in and out
+    Tcl_WideInt         lob_read;       /// bytes of LOB data read
+    Tcl_WideInt         lob_sent;       /// bytes of LOB data sent
+    Tcl_WideInt         commits;
+    Tcl_WideInt         commit_time;
+    Tcl_WideInt         rollbacks;
+    Tcl_WideInt         rollback_time;
+    Tcl_WideInt         calls;          /// DBCAPI calls that communicate with the server
+    Tcl_WideInt         errors;         /// failed DBCAPI calls
+} Hdbtcl_Stats;
+
+#define NUM_STATS_COUNTERS ( sizeof(Hdbtcl_Stats) / sizeof(Tcl_WideInt) )
+
+#define SLOWLOG_SIZE        256     /// number of the most recent slow statements `hdb slowlog` keeps
+#define SLOWLOG_SQL_LENGTH  1000    /// number of SQL characters a slow log entry keeps
+
+/**
+ * Names of the counters in the order of their declaration. Names that end with `_time` report time in microseconds.
+ */
+static const char * const stats_names[NUM_STATS_COUNTERS] = {
+    "connects", "connect_time", "prepares", "prepare_time", "executes", "execute_time", "fetches", "fetch_time",
+    "rows", "convert_time", "bytes", "lob_time", "lob_read", "lob_sent", "commits", "commit_time", "rollbacks",
+    "rollback_time", "calls", "errors"
+};
+
+/**
+ * Returns the current time (ns) of the monotonic clock. The returned time is only useful to measure intervals.
+ */
+static Tcl_WideInt
+GetMonotonicTime ()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    if ( frequency.QuadPart == 0 ) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (Tcl_WideInt) ( (double) counter.QuadPart * 1e9 / frequency.QuadPart );
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (Tcl_WideInt) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/**
+ * Adds counters to the totals.
+ */
+static void
+Stats_Add (Hdbtcl_Stats * total_ptr, const Hdbtcl_Stats * delta_ptr)
+{
+    Tcl_WideInt * total = (Tcl_WideInt *) total_ptr;
+    const Tcl_WideInt * delta = (const Tcl_WideInt *) delta_ptr;
+    for ( size_t i = 0; i < NUM_STATS_COUNTERS; i++ ) {
+        total[i] += delta[i];
+    }
+}
+
+/**
+ * Returns counters as a dictionary. Resets them if requested.
+ */
+static int
+Stats_Report (Hdbtcl_Stats * stats_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[], const char * usage)
+{
+    static const char * const options[] = { "-reset", NULL };
+    int option;
+    if ( objc > 1 ) {
+        Tcl_WrongNumArgs(interp, 0, NULL, usage);
+        return TCL_ERROR;
+    }
+    if ( objc == 1 && Tcl_GetIndexFromObj(interp, objv[0], options, "option", 0, &option) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    Tcl_Obj * result = Tcl_NewDictObj();
+    const Tcl_WideInt * counters = (const Tcl_WideInt *) stats_ptr;
+    for ( size_t i = 0; i < NUM_STATS_COUNTERS; i++ ) {
+        size_t name_len = strlen(stats_names[i]);
+        bool is_time = name_len > 5 && strcmp(stats_names[i] + name_len - 5, "_time") == 0;
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj(stats_names[i], name_len), Tcl_NewWideIntObj(is_time ? counters[i] / 1000 : counters[i]));
+    }
+    if ( objc == 1 ) {
+        memset(stats_ptr, 0, sizeof(Hdbtcl_Stats));
+    }
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
+/**
+ * Memory that is held on behalf of statements. Sizes (bytes) are estimates - they include the data
+ * and the TCL objects that hold it, but not the allocator overhead.
+ *
+ * \note All members are sizes of the same type, so they can be processed as an array.
+ */
+typedef struct hdbtcl_memory {
+    Tcl_WideInt         rows;           /// rows converted by the fetch in progress, rows of asynchronous fetches
+    Tcl_WideInt         lobs;           /// LOB values read into TCL objects
+    Tcl_WideInt         params;         /// argument buffers kept by asynchronous executions
+    Tcl_WideInt         metadata;       /// statement state and its SQL text
+    Tcl_WideInt         total;          /// all of the above
+} Hdbtcl_Memory;
+
+enum { MEMORY_ROWS, MEMORY_LOBS, MEMORY_PARAMS, MEMORY_METADATA, MEMORY_TOTAL, NUM_MEMORY_KINDS };
+
+static const char * const memory_names[NUM_MEMORY_KINDS] = { "rows", "lobs", "params", "metadata", "total" };
+
+/**
+ * Returns memory sizes as a dictionary.
+ */
+static Tcl_Obj *
+Memory_NewDictObj (const Hdbtcl_Memory * memory_ptr)
+{
+    Tcl_Obj * result = Tcl_NewDictObj();
+    const Tcl_WideInt * sizes = (const Tcl_WideInt *) memory_ptr;
+    for ( int i = 0; i < NUM_MEMORY_KINDS; i++ ) {
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj(memory_names[i], -1), Tcl_NewWideIntObj(sizes[i]));
+    }
+    return result;
+}
+
+#define HISTOGRAM_SUB_BITS      3       /// each power of 2 is split into 2^HISTOGRAM_SUB_BITS buckets
+#define HISTOGRAM_SUB_BUCKETS   ( 1 << HISTOGRAM_SUB_BITS )
+#define HISTOGRAM_BUCKETS       ( 48 * HISTOGRAM_SUB_BUCKETS )  /// covers latencies up to 2^49 ns
+
+/**
+ * Log-bucketed latency histogram. Bucket boundaries are within 1/8 (12.5%) of each other, thus
+ * percentiles are reported with at most ~6% error.
+ */
+typedef struct latency_histogram {
+    Tcl_WideInt         count;
+    Tcl_WideInt         sum;            /// total time (ns) of all recorded operations
+    Tcl_WideInt         max;
+    Tcl_WideInt         buckets[HISTOGRAM_BUCKETS];
+} Latency_Histogram;
+
+/**
+ * Operations which latencies are tracked.
+ */
+enum {
+    LATENCY_CONNECT, LATENCY_PREPARE, LATENCY_EXECUTE, LATENCY_FETCH, LATENCY_COMMIT, NUM_LATENCY_HISTOGRAMS
+};
+
+static const char * const latency_names[NUM_LATENCY_HISTOGRAMS] = {
+    "connect", "prepare", "execute", "fetch", "commit"
+};
+
+static const char * const latency_metric_names[NUM_LATENCY_HISTOGRAMS] = {
+    "hdbtcl_connect_seconds", "hdbtcl_prepare_seconds", "hdbtcl_execute_seconds", "hdbtcl_fetch_row_seconds", "hdbtcl_commit_seconds"
+};
+
+static const char * const latency_metric_help[NUM_LATENCY_HISTOGRAMS] = {
+    "Time it takes to connect to the database.",
+    "Time it takes to prepare a statement.",
+    "Time it takes to execute a statement.",
+    "Time it takes to fetch and convert a row (or a batch of rows fetched in one call).",
+    "Time it takes to commit a transaction."
+};
+
+typedef struct latency_metrics {
+    Latency_Histogram   histograms[NUM_LATENCY_HISTOGRAMS];
+} Latency_Metrics;
+
+/**
+ * Returns the index of the bucket that counts latencies that are close to the specified one.
+ * Small latencies (< HISTOGRAM_SUB_BUCKETS ns) have buckets of their own.
+ */
+static int
+Histogram_BucketIndex (Tcl_WideInt latency)
+{
+    if ( latency < HISTOGRAM_SUB_BUCKETS ) {
+        return latency < 0 ? 0 : (int) latency;
+    }
+    int msb = HISTOGRAM_SUB_BITS;
+    while ( msb < 62 && ( latency >> ( msb + 1 ) ) != 0 ) {
+        ++msb;
+    }
+    int index = ( msb - HISTOGRAM_SUB_BITS + 1 ) * HISTOGRAM_SUB_BUCKETS + (int) ( ( latency >> ( msb - HISTOGRAM_SUB_BITS ) ) & ( HISTOGRAM_SUB_BUCKETS - 1 ) );
+    return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+/**
+ * Returns the latency in the middle of the bucket.
+ */
+static Tcl_WideInt
+Histogram_BucketValue (int index)
+{
+    if ( index < HISTOGRAM_SUB_BUCKETS ) {
+        return index;
+    }
+    int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+    Tcl_WideInt lower = (Tcl_WideInt) ( HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS ) << shift;
+    return lower + ( ( (Tcl_WideInt) 1 << shift ) >> 1 );
+}
+
+/**
+ * Records an operation that took `latency` ns.
+ */
+static void
+Histogram_Add (Latency_Histogram * histogram_ptr, Tcl_WideInt latency)
+{
+    histogram_ptr->buckets[Histogram_BucketIndex(latency)] += 1;
+    histogram_ptr->count += 1;
+    histogram_ptr->sum += latency;
+    if ( latency > histogram_ptr->max ) {
+        histogram_ptr->max = latency;
+    }
+}
+
+/**
+ * Returns the latency (ns) below which the specified fraction of operations completed.
+ */
+static Tcl_WideInt
+Histogram_Percentile (const Latency_Histogram * histogram_ptr, double fraction)
+{
+    double exact_rank = histogram_ptr->count * fraction;
+    Tcl_WideInt rank = (Tcl_WideInt) exact_rank;
+    if ( rank < exact_rank ) {
+        ++rank;
+    }
+    if ( rank < 1 ) {
+        rank = 1;
+    }
+    Tcl_WideInt seen = 0;
+    for ( int i = 0; i < HISTOGRAM_BUCKETS; i++ ) {
+        seen += histogram_ptr->buckets[i];
+        if ( seen >= rank ) {
+            Tcl_WideInt value = Histogram_BucketValue(i);
+            return value < histogram_ptr->max ? value : histogram_ptr->max;
+        }
+    }
+    return histogram_ptr->max;
+}
+
+/**
+ * Records latencies of the operations that are accounted in the counters delta. The delta is one
+ * call, so its operations are recorded as a single sample even when it accounts several of them
+ * (a batch of rows, for instance). Fetch latency is skipped when the rows have been timed one by one.
+ */
+static void
+Metrics_Add (Latency_Metrics * metrics_ptr, const Hdbtcl_Stats * delta_ptr, bool rows_timed)
+{
+    Latency_Histogram * histograms = metrics_ptr->histograms;
+    if ( delta_ptr->connects > 0 ) {
+        Histogram_Add(&histograms[LATENCY_CONNECT], delta_ptr->connect_time);
+    }
+    if ( delta_ptr->prepares > 0 ) {
+        Histogram_Add(&histograms[LATENCY_PREPARE], delta_ptr->prepare_time);
+    }
+    if ( delta_ptr->executes > 0 ) {
+        Histogram_Add(&histograms[LATENCY_EXECUTE], delta_ptr->execute_time);
+    }
+    if ( delta_ptr->rows > 0 && !rows_timed ) {
+        Histogram_Add(&histograms[LATENCY_FETCH], delta_ptr->fetch_time + delta_ptr->convert_time);
+    }
+    if ( delta_ptr->commits > 0 ) {
+        Histogram_Add(&histograms[LATENCY_COMMIT], delta_ptr->commit_time);
+    }
+}
+
+static const double latency_quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+static const char * const latency_quantile_names[] = { "p50", "p90", "p99", "p999" };
+#define NUM_LATENCY_QUANTILES ( sizeof(latency_quantiles) / sizeof(latency_quantiles[0]) )
+
+/**
+ * Returns histogram summary as a dictionary. Latencies are reported in microseconds.
+ */
+static Tcl_Obj *
+Histogram_NewDictObj (const Latency_Histogram * histogram_ptr)
+{
+    Tcl_Obj * result = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("count", 5), Tcl_NewWideIntObj(histogram_ptr->count));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("sum", 3), Tcl_NewDoubleObj(histogram_ptr->sum / 1e3));
+    for ( size_t i = 0; i < NUM_LATENCY_QUANTILES; i++ ) {
+        double value = histogram_ptr->count > 0 ? Histogram_Percentile(histogram_ptr, latency_quantiles[i]) / 1e3 : 0.0;
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj(latency_quantile_names[i], -1), Tcl_NewDoubleObj(value));
+    }
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("max", 3), Tcl_NewDoubleObj(histogram_ptr->max / 1e3));
+    return result;
+}
+
+/**
+ * Appends histogram summary in the Prometheus text exposition format. Latencies are reported in seconds.
+ */
+static void
+Histogram_AppendPrometheus (Tcl_Obj * result, const char * metric, const char * label, const Latency_Histogram * histogram_ptr)
+{
+    Tcl_DString labels;
+    Tcl_DStringInit(&labels);
+    if ( label != NULL ) {
+        Tcl_DStringAppend(&labels, "label=\"", -1);
+        for ( const char * p = label; *p; p++ ) {
+            switch ( *p ) {
+                case '\\': Tcl_DStringAppend(&labels, "\\\\", 2); break;
+                case '"':  Tcl_DStringAppend(&labels, "\\\"", 2); break;
+                case '\n': Tcl_DStringAppend(&labels, "\\n", 2); break;
+                default:   Tcl_DStringAppend(&labels, p, 1);
+            }
+        }
+        Tcl_DStringAppend(&labels, "\"", 1);
+    }
+    const char * label_text = Tcl_DStringValue(&labels);
+    const char * separator = label != NULL ? "," : "";
+    char value[TCL_DOUBLE_SPACE];
+    for ( size_t i = 0; i < NUM_LATENCY_QUANTILES; i++ ) {
+        if ( histogram_ptr->count > 0 ) {
+            Tcl_PrintDouble(NULL, Histogram_Percentile(histogram_ptr, latency_quantiles[i]) / 1e9, value);
+        } else {
+            strcpy(value, "NaN");
+        }
+        Tcl_AppendPrintfToObj(result, "%s{%s%squantile=\"%g\"} %s\n", metric, label_text, separator, latency_quantiles[i], value);
+    }
+    Tcl_PrintDouble(NULL, histogram_ptr->sum / 1e9, value);
+    if ( label != NULL ) {
+        Tcl_AppendPrintfToObj(result, "%s_sum{%s} %s\n%s_count{%s} %lld\n", metric, label_text, value, metric, label_text, histogram_ptr->count);
+    } else {
+        Tcl_AppendPrintfToObj(result, "%s_sum %s\n%s_count %lld\n", metric, value, metric, histogram_ptr->count);
+    }
+    Tcl_DStringFree(&labels);
+}
+
 /**
  * Internal module state.
  */
 typedef struct hdbtcl_state {
+    Tcl_Interp *        interp;
     Tcl_HashTable *     open_connections;
-    Tcl_Command         hdb_cmd;
+    Tcl_HashTable *     open_pools;
+    Tcl_Command         hdb_cmd;        /// NULL while the module state is being deleted
+    bool                hdb_cmd_deleted;/// the `hdb` command has been deleted (by the interpreter or the script)
     Hdbtcl_Literals     literals;
     Tcl_ObjType const * list_type;
+    Hdbtcl_Stats        stats;          /// totals of all connections
+    Tcl_Obj *           slowlog[SLOWLOG_SIZE];  /// ring buffer of traced slow statements
+    int                 slowlog_next;   /// position of the next entry in the ring
+    int                 slowlog_count;  /// number of entries in the ring
+    Latency_Metrics     metrics;        /// latencies of all connections
+    Tcl_HashTable *     labels;         /// statement label -> Latency_Metrics of the labelled statements
+    Hdbtcl_Memory       memory;         /// memory held by all statements
+    Hdbtcl_Memory       memory_peak;
+    Tcl_WideInt         memory_limit;   /// bytes all statements may hold while calls are in progress, 0 - no limit
 } Hdbtcl_State;
 
 static int Hdb_Cmd (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[]);
 
+/**
+ * Notes that the `hdb` command has been deleted, so its token would not be used anymore.
+ */
+static void
+Hdb_CmdDeleted (ClientData client_data)
+{
+    ((Hdbtcl_State *) client_data)->hdb_cmd_deleted = true;
+}
+
 /**
  * Deletes the module state.
  *
@@ -333,7 +761,23 @@ Hdbtcl_DeleteState (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp)
 {
     if ( hdbtcl_state_ptr == NULL ) return;
 
+    Tcl_Command hdb_cmd = hdbtcl_state_ptr->hdb_cmd;
     hdbtcl_state_ptr->hdb_cmd = NULL;
+    // pools are closed first, so they would not keep connections that are being closed
+    if ( hdbtcl_state_ptr->open_pools != NULL ) {
+        Tcl_HashSearch iter;
+        for (
+            Tcl_HashEntry * entry = Tcl_FirstHashEntry(hdbtcl_state_ptr->open_pools, &iter);
+            entry != NULL;
+            entry = Tcl_NextHashEntry(&iter)
+        ) {
+            Tcl_Command pool_cmd = Tcl_GetHashValue(entry);
+            Tcl_DeleteHashEntry(entry);
+            Tcl_DeleteCommandFromToken(interp, pool_cmd);
+        }
+        Tcl_DeleteHashTable(hdbtcl_state_ptr->open_pools);
+        ckfree(hdbtcl_state_ptr->open_pools);
+    }
     if ( hdbtcl_state_ptr->open_connections != NULL ) {
         Tcl_HashSearch iter;
         for (
@@ -348,7 +792,29 @@ Hdbtcl_DeleteState (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp)
         Tcl_DeleteHashTable(hdbtcl_state_ptr->open_connections);
         ckfree(hdbtcl_state_ptr->open_connections);
     }
+    for ( int i = 0; i < SLOWLOG_SIZE; i++ ) {
+        if ( hdbtcl_state_ptr->slowlog[i] != NULL ) {
+            Tcl_DecrRefCount(hdbtcl_state_ptr->slowlog[i]);
+        }
+    }
+    if ( hdbtcl_state_ptr->labels != NULL ) {
+        Tcl_HashSearch iter;
+        for (
+            Tcl_HashEntry * entry = Tcl_FirstHashEntry(hdbtcl_state_ptr->labels, &iter);
+            entry != NULL;
+            entry = Tcl_NextHashEntry(&iter)
+        ) {
+            ckfree(Tcl_GetHashValue(entry));
+        }
+        Tcl_DeleteHashTable(hdbtcl_state_ptr->labels);
+        ckfree(hdbtcl_state_ptr->labels);
+    }
     Hdbtcl_DeleteLiterals(&hdbtcl_state_ptr->literals);
+    // the interpreter might outlive the state (when its thread exits first), so the command that refers
+    // to the state must go with it
+    if ( hdb_cmd != NULL && !hdbtcl_state_ptr->hdb_cmd_deleted ) {
+        Tcl_DeleteCommandFromToken(interp, hdb_cmd);
+    }
     ckfree((char *) hdbtcl_state_ptr);
 }
 
@@ -366,13 +832,18 @@ Hdbtcl_InitState (Tcl_Interp * interp)
         return NULL;
     }
     memset(hdbtcl_state_ptr, 0, sizeof(Hdbtcl_State));
+    hdbtcl_state_ptr->interp = interp;
     hdbtcl_state_ptr->open_connections = ckalloc(sizeof(Tcl_HashTable));
     Tcl_InitHashTable(hdbtcl_state_ptr->open_connections, TCL_ONE_WORD_KEYS);
+    hdbtcl_state_ptr->open_pools = ckalloc(sizeof(Tcl_HashTable));
+    Tcl_InitHashTable(hdbtcl_state_ptr->open_pools, TCL_ONE_WORD_KEYS);
+    hdbtcl_state_ptr->labels = ckalloc(sizeof(Tcl_HashTable));
+    Tcl_InitHashTable(hdbtcl_state_ptr->labels, TCL_STRING_KEYS);
     Hdbtcl_InitLiterals(&hdbtcl_state_ptr->literals);
 
     hdbtcl_state_ptr->list_type = Tcl_GetObjType("list");
 
-    hdbtcl_state_ptr->hdb_cmd = Tcl_CreateObjCommand(interp, "hdb", (Tcl_ObjCmdProc *) Hdb_Cmd, (ClientData) hdbtcl_state_ptr, (Tcl_CmdDeleteProc *) NULL);
+    hdbtcl_state_ptr->hdb_cmd = Tcl_CreateObjCommand(interp, "hdb", (Tcl_ObjCmdProc *) Hdb_Cmd, (ClientData) hdbtcl_state_ptr, Hdb_CmdDeleted);
     if ( hdbtcl_state_ptr->hdb_cmd == NULL ) {
         Tcl_SetResult(interp, "cannot create hdb command", TCL_STATIC);
         Hdbtcl_DeleteState(hdbtcl_state_ptr, interp);
@@ -390,8 +861,31 @@ typedef struct conn_state {
     Tcl_HashTable *     open_statements;
     Hdbtcl_State *      hdbtcl_state_ptr;
     bool                connected;
+    int                 timeout;        /// default statement execution timeout (ms), 0 - no timeout
+    struct conn_pool *  pool;           /// pool that owns the connection, NULL if the connection is not pooled
+    Tcl_Time            idle_since;     /// when the connection was returned to the pool
+    Tcl_Obj *           clientinfo;     /// names of the client info variables set while the connection was checked out
+    Tcl_ThreadId        worker;         /// thread that executes asynchronous requests
+    Tcl_Mutex           worker_lock;
+    Tcl_Condition       worker_cond;
+    struct async_job *  job;            /// asynchronous request that has not been completed yet
+    bool                worker_exit;
+    Hdbtcl_Stats        stats;          /// totals of the connection and all its statements
+    bool                tracing;        /// whether slow statements are traced
+    int                 trace_threshold;/// execution time (ms) that makes a statement slow
+    Tcl_Obj *           trace_command;  /// called with the slow log entry of each slow statement
+    Hdbtcl_Memory       memory;         /// memory held by the connection statements
+    Hdbtcl_Memory       memory_peak;
+    Tcl_WideInt         memory_limit;   /// bytes a single fetch or execution may build, 0 - no limit
+    int                 lob_chunk_size; /// size of the pieces LOB data are sent and read in
+    Tcl_Obj *           lob_buffers[4]; /// LOB chunk buffers that are kept for reuse
+    int                 num_lob_buffers;
 } Conn_State;
 
+static void Async_Abandon (Conn_State * conn_state_ptr);
+static void Async_Shutdown (Conn_State * conn_state_ptr);
+static bool Pool_Release (struct conn_pool * pool_ptr, Conn_State * conn_state_ptr);
+
 /**
  * Destroys and deletes a connection state.
  */
@@ -401,6 +895,7 @@ Conn_DeleteState (Conn_State * conn_state_ptr, Tcl_Interp * interp)
     if ( conn_state_ptr == NULL ) {
         return;
     }
+    Async_Abandon(conn_state_ptr);
     if ( conn_state_ptr->conn_cmd != NULL ) {
         // if connection is not being deleted because the module is being deleted (hdb_cmd is null when module is being deleted),
         // then remove the command from the module's set of open connections
@@ -425,6 +920,21 @@ Conn_DeleteState (Conn_State * conn_state_ptr, Tcl_Interp * interp)
         }
         Tcl_DeleteHashTable(conn_state_ptr->open_statements);
         ckfree(conn_state_ptr->open_statements);
+        conn_state_ptr->open_statements = NULL;
+    }
+    if ( conn_state_ptr->pool != NULL && Pool_Release(conn_state_ptr->pool, conn_state_ptr) ) {
+        // the pool keeps the connection - and its worker thread - for reuse
+        return;
+    }
+    Async_Shutdown(conn_state_ptr);
+    if ( conn_state_ptr->clientinfo != NULL ) {
+        Tcl_DecrRefCount(conn_state_ptr->clientinfo);
+    }
+    if ( conn_state_ptr->trace_command != NULL ) {
+        Tcl_DecrRefCount(conn_state_ptr->trace_command);
+    }
+    while ( conn_state_ptr->num_lob_buffers > 0 ) {
+        Tcl_DecrRefCount(conn_state_ptr->lob_buffers[--conn_state_ptr->num_lob_buffers]);
     }
     if ( conn_state_ptr->conn != NULL ) {
         if ( conn_state_ptr->connected ) {
@@ -435,6 +945,38 @@ Conn_DeleteState (Conn_State * conn_state_ptr, Tcl_Interp * interp)
     ckfree((char *) conn_state_ptr);
 }
 
+#define ARENA_BLOCK_SIZE    4096        /// the smallest block the statement arena allocates
+#define ARENA_MAX_SIZE      1048576     /// the largest block the statement arena keeps between requests
+#define ARENA_ALIGNMENT     sizeof(Tcl_WideInt)
+
+/**
+ * Block of the statement arena memory.
+ */
+typedef struct arena_block {
+    struct arena_block *    next;       /// previous (filled) block
+    size_t                  size;
+    size_t                  used;
+    Tcl_WideInt             data[];     /// aligned storage
+} Arena_Block;
+
+/**
+ * Scratch memory of the statement requests - bind buffers, NULL indicators and column descriptors.
+ * Memory is allocated by bumping the pointer within the current block and is released back to the
+ * mark that was taken when the request started. Requests can nest when a callback of one uses the
+ * same statement.
+ */
+typedef struct stmt_arena {
+    Arena_Block *       head;           /// block allocations are made from
+} Stmt_Arena;
+
+/**
+ * Arena position to which allocations are released.
+ */
+typedef struct arena_mark {
+    Arena_Block *       block;
+    size_t              used;
+} Arena_Mark;
+
 /**
  * Internal statement state.
  */
@@ -442,105 +984,1282 @@ typedef struct stmt_state {
     dbcapi_stmt *       stmt;
     Tcl_Command         stmt_cmd;
     Conn_State *        conn_state_ptr;
+    int                 timeout;        /// execution timeout (ms), 0 - no timeout, -1 - use connection timeout
+    Hdbtcl_Stats        stats;
+    Tcl_Obj *           sql;            /// SQL text of the statement
+    uint32_t            sql_hash;       /// hash of the SQL text that tracepoints report
+    bool                traced;         /// whether the current execution is traced
+    int                 trace_params;   /// number of arguments of the traced execution
+    Hdbtcl_Stats        trace_base;     /// counters at the start of the traced execution
+    Tcl_HashEntry *     label;          /// entry of the module labels table, NULL if the statement is not labelled
+    Hdbtcl_Memory       memory;         /// memory held by the statement
+    Hdbtcl_Memory       memory_peak;
+    Stmt_Arena          arena;
+    struct column_objs *column_objs;    /// objects LOB read commands get for columns of the current result set
+    int                 num_column_objs;
+    struct rowset_channel * channel;    /// channel that reads the result set, NULL if there is none
 } Stmt_State;
 
+static void Async_Detach (Stmt_State * stmt_state_ptr);
+static void RowsetChannel_Detach (Stmt_State * stmt_state_ptr);
+
 /**
- * Destroys and deletes a statement state.
+ * Returns the current position of the arena.
  */
-static void
-Stmt_DeleteState (Stmt_State * stmt_state_ptr, Tcl_Interp * interp)
+static Arena_Mark
+Arena_GetMark (Stmt_Arena * arena_ptr)
 {
-    if ( stmt_state_ptr == NULL ) {
-        return;
-    }
-    if ( stmt_state_ptr->conn_state_ptr != NULL && stmt_state_ptr->stmt_cmd != NULL ) {
-        // If the statement is being deleted explicitly and not because connection executes finalization clean up
-        // (it is being deleted and it deletes all its statements), then remove statement entry from the set of
-        // connection's open statements
-        if ( stmt_state_ptr->conn_state_ptr->conn_cmd != NULL ) {
-            Tcl_HashEntry * entry = Tcl_FindHashEntry(stmt_state_ptr->conn_state_ptr->open_statements, stmt_state_ptr->stmt_cmd);
-            if ( entry != NULL ) {
-                Tcl_DeleteHashEntry(entry);
-            }
+    Arena_Mark mark = { arena_ptr->head, arena_ptr->head != NULL ? arena_ptr->head->used : 0 };
+    return mark;
+}
+
+/**
+ * Allocates memory from the arena. The memory is valid until the arena is released to the mark
+ * that was taken before the allocation.
+ */
+static void *
+Arena_Alloc (Stmt_Arena * arena_ptr, size_t size)
+{
+    size = ( size + ARENA_ALIGNMENT - 1 ) & ~( ARENA_ALIGNMENT - 1 );
+    Arena_Block * block = arena_ptr->head;
+    if ( block == NULL || block->size - block->used < size ) {
+        size_t block_size = block != NULL ? block->size * 2 : ARENA_BLOCK_SIZE;
+        if ( block_size < size ) {
+            block_size = size;
         }
-        stmt_state_ptr->conn_state_ptr = NULL;
-    }
-    if ( stmt_state_ptr->stmt != NULL ) {
-        dbcapi.free_stmt(stmt_state_ptr->stmt);
-        stmt_state_ptr->stmt = NULL;
+        block = (Arena_Block *) ckalloc(sizeof(Arena_Block) + block_size);
+        block->next = arena_ptr->head;
+        block->size = block_size;
+        block->used = 0;
+        arena_ptr->head = block;
     }
-    ckfree((char *) stmt_state_ptr);
+    void * ptr = (char *) block->data + block->used;
+    block->used += size;
+    return ptr;
 }
 
 /**
- * Reports DBCAPI errors as TCL errors.
+ * Releases arena allocations that were made after the mark was taken. When the arena becomes empty
+ * blocks that were added to it are consolidated into one, so the next request of the same size is
+ * served without allocations.
  */
 static void
-SetErrorResult (Tcl_Interp * interp, dbcapi_connection * conn, const char * message, ...)
+Arena_Release (Stmt_Arena * arena_ptr, Arena_Mark mark)
 {
-    va_list args;
-    va_start(args, message);
-    Tcl_AppendResult(interp, message, NULL);
-    Tcl_AppendResultVA(interp, args);
-    va_end(args);
-
-    size_t msg_size = dbcapi.error_length(conn);
-    char reason[msg_size];
-    int code = dbcapi.error(conn, reason, msg_size);
-
-    char reason_prefix[32];
-    sprintf(reason_prefix, " - Code: %d Reason: ", code);
-
-    Tcl_AppendResult(interp, reason_prefix, reason, NULL);
+    size_t size = 0;
+    while ( arena_ptr->head != mark.block ) {
+        Arena_Block * block = arena_ptr->head;
+        arena_ptr->head = block->next;
+        size += block->size;
+        ckfree((char *) block);
+    }
+    if ( arena_ptr->head != NULL ) {
+        arena_ptr->head->used = mark.used;
+        if ( size == 0 || mark.used != 0 || arena_ptr->head->next != NULL ) {
+            return;
+        }
+        size += arena_ptr->head->size;
+        ckfree((char *) arena_ptr->head);
+        arena_ptr->head = NULL;
+    }
+    if ( size > 0 && size <= ARENA_MAX_SIZE ) {
+        Arena_Block * block = (Arena_Block *) ckalloc(sizeof(Arena_Block) + size);
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+        arena_ptr->head = block;
+    }
 }
 
 /**
- * Closes the statement.
- *
- * # Example
- * \code{.tcl}
- * $stmt close
- * \endcode
- *
- * \note After the stemenet is closed the stored command is not longer valid. Also, the explicit
- * `close` is not necessary. `hdbtcl` will close the statement automatically when all saved
- * references to it are gone.
+ * Frees the arena memory.
  */
-static int
-Stmt_Close (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+static void
+Arena_Free (Stmt_Arena * arena_ptr)
 {
-    if ( Tcl_DeleteCommandFromToken(interp, stmt_state_ptr->stmt_cmd) != TCL_OK ) {
-        Tcl_SetResult(interp, "Cannot delete statement handle", TCL_STATIC);
-        return TCL_ERROR;
+    while ( arena_ptr->head != NULL ) {
+        Arena_Block * block = arena_ptr->head;
+        arena_ptr->head = block->next;
+        ckfree((char *) block);
     }
-    return TCL_OK;
 }
 
 /**
- * Type to store bound primitives.
+ * Column metadata objects that are passed to LOB read commands. They are created when the first LOB
+ * of the column is read and are reused for all rows of the result set.
  */
-typedef union primitive_sql_value {
-    double      double_value;
-    int         int_value;
-    Tcl_WideInt wideint_value;
-    size_t      data_length;
-} PrimitiveSqlValue;
+typedef struct column_objs {
+    Tcl_Obj *           num;
+    Tcl_Obj *           name;
+    Tcl_Obj *           table;
+    Tcl_Obj *           owner;
+} Column_Objs;
 
 /**
- * Helper function to report "expected N but got M" type of errors.
+ * Returns FNV-1a hash of the SQL text. Tracepoints report it to group executions of the same statement.
  */
-static void
-SetNumDiffErrorResult (Tcl_Interp * interp, const char * txt_begin, int num1, const char * txt_mid, int num2, const char * txt_end)
+static uint32_t
+GetSqlHash (Tcl_Obj * sql)
 {
-    char txt1[12], txt2[12];
-    Tcl_AppendResult(interp, txt_begin, itoa(num1, txt1, 10), txt_mid, itoa(num2, txt2, 10), txt_end, NULL);
+    int len;
+    const unsigned char * text = (const unsigned char *) Tcl_GetStringFromObj(sql, &len);
+    uint32_t hash = 2166136261u;
+    for ( int i = 0; i < len; i++ ) {
+        hash = ( hash ^ text[i] ) * 16777619u;
+    }
+    return hash;
 }
 
 /**
- * Macro that help to avoid the multiline pattern of binding parameters.
+ * Adds counters to the statement (if there is one), its connection and the module totals and
+ * records latencies of the accounted operations. `rows_timed` tells that the fetched rows have
+ * already been recorded by Stats_RecordRow.
  */
-#define BIND_PARAM(stmt_state_ptr, interp, i, bind_ptr) do { \
-    if ( !dbcapi.bind_param((stmt_state_ptr)->stmt, (i), (bind_ptr)) ) { \
+static void
+Stats_RecordCall (Conn_State * conn_state_ptr, Stmt_State * stmt_state_ptr, const Hdbtcl_Stats * delta_ptr, bool rows_timed)
+{
+    if ( stmt_state_ptr != NULL ) {
+        Stats_Add(&stmt_state_ptr->stats, delta_ptr);
+        if ( stmt_state_ptr->label != NULL ) {
+            Metrics_Add((Latency_Metrics *) Tcl_GetHashValue(stmt_state_ptr->label), delta_ptr, rows_timed);
+        }
+    }
+    Stats_Add(&conn_state_ptr->stats, delta_ptr);
+    Stats_Add(&conn_state_ptr->hdbtcl_state_ptr->stats, delta_ptr);
+    Metrics_Add(&conn_state_ptr->hdbtcl_state_ptr->metrics, delta_ptr, rows_timed);
+}
+
+static void
+Stats_Record (Conn_State * conn_state_ptr, Stmt_State * stmt_state_ptr, const Hdbtcl_Stats * delta_ptr)
+{
+    Stats_RecordCall(conn_state_ptr, stmt_state_ptr, delta_ptr, false);
+}
+
+/**
+ * Records fetch latency of a single row. Counters of the row are accounted by the caller.
+ */
+static void
+Stats_RecordRow (Stmt_State * stmt_state_ptr, Tcl_WideInt latency)
+{
+    if ( stmt_state_ptr->label != NULL ) {
+        Latency_Metrics * metrics_ptr = (Latency_Metrics *) Tcl_GetHashValue(stmt_state_ptr->label);
+        Histogram_Add(&metrics_ptr->histograms[LATENCY_FETCH], latency);
+    }
+    Histogram_Add(&stmt_state_ptr->conn_state_ptr->hdbtcl_state_ptr->metrics.histograms[LATENCY_FETCH], latency);
+}
+
+/**
+ * Records the DBCAPI call that has sent or received a piece of LOB data.
+ */
+static void
+Stats_RecordLob (Stmt_State * stmt_state_ptr, Tcl_WideInt started, Tcl_WideInt sent, Tcl_WideInt read, bool failed)
+{
+    Hdbtcl_Stats delta = { .lob_time = GetMonotonicTime() - started, .lob_sent = sent, .lob_read = read, .calls = 1, .errors = failed };
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta);
+}
+
+/**
+ * Changes the size of the memory the statement, its connection and the module hold.
+ */
+static void
+Memory_Add (Stmt_State * stmt_state_ptr, int kind, Tcl_WideInt bytes)
+{
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    Hdbtcl_Memory * levels[][2] = {
+        { &stmt_state_ptr->memory, &stmt_state_ptr->memory_peak },
+        { &conn_state_ptr->memory, &conn_state_ptr->memory_peak },
+        { &conn_state_ptr->hdbtcl_state_ptr->memory, &conn_state_ptr->hdbtcl_state_ptr->memory_peak }
+    };
+    for ( int i = 0; i < 3; i++ ) {
+        Tcl_WideInt * sizes = (Tcl_WideInt *) levels[i][0];
+        Tcl_WideInt * peaks = (Tcl_WideInt *) levels[i][1];
+        sizes[kind] += bytes;
+        sizes[MEMORY_TOTAL] += bytes;
+        if ( sizes[kind] > peaks[kind] ) peaks[kind] = sizes[kind];
+        if ( sizes[MEMORY_TOTAL] > peaks[MEMORY_TOTAL] ) peaks[MEMORY_TOTAL] = sizes[MEMORY_TOTAL];
+    }
+}
+
+/**
+ * Releases the memory that was accounted by `Memory_Add` or `Memory_Reserve`.
+ */
+static void
+Memory_Release (Stmt_State * stmt_state_ptr, const Hdbtcl_Memory * memory_ptr)
+{
+    const Tcl_WideInt * sizes = (const Tcl_WideInt *) memory_ptr;
+    for ( int kind = 0; kind < MEMORY_TOTAL; kind++ ) {
+        if ( sizes[kind] != 0 ) {
+            Memory_Add(stmt_state_ptr, kind, -sizes[kind]);
+        }
+    }
+}
+
+/**
+ * Returns the number of bytes the next fetch of the connection statement may build. Returns 0 if
+ * the fetch is not limited.
+ */
+static Tcl_WideInt
+Memory_GetFetchLimit (Conn_State * conn_state_ptr)
+{
+    Hdbtcl_State * hdbtcl_state_ptr = conn_state_ptr->hdbtcl_state_ptr;
+    Tcl_WideInt limit = conn_state_ptr->memory_limit;
+    if ( hdbtcl_state_ptr->memory_limit > 0 ) {
+        Tcl_WideInt available = hdbtcl_state_ptr->memory_limit - hdbtcl_state_ptr->memory.total;
+        if ( available < 1 ) {
+            available = 1;
+        }
+        if ( limit == 0 || available < limit ) {
+            limit = available;
+        }
+    }
+    return limit;
+}
+
+/**
+ * Accounts memory of the data the fetch (or execution) in progress has built. `fetch_ptr` collects
+ * the sizes of the call, so they could be released when the data are handed over to the application.
+ * Fails if the call exceeds the connection memory limit or makes statements exceed the module memory
+ * limit.
+ */
+static int
+Memory_Reserve (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Hdbtcl_Memory * fetch_ptr, int kind, Tcl_WideInt bytes)
+{
+    if ( fetch_ptr == NULL ) {
+        return TCL_OK;
+    }
+    Memory_Add(stmt_state_ptr, kind, bytes);
+    ((Tcl_WideInt *) fetch_ptr)[kind] += bytes;
+    fetch_ptr->total += bytes;
+
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    Hdbtcl_State * hdbtcl_state_ptr = conn_state_ptr->hdbtcl_state_ptr;
+    if ( conn_state_ptr->memory_limit > 0 && fetch_ptr->total > conn_state_ptr->memory_limit ) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("Fetched data exceed the connection memory limit of %lld bytes", (long long) conn_state_ptr->memory_limit));
+        return TCL_ERROR;
+    }
+    if ( hdbtcl_state_ptr->memory_limit > 0 && hdbtcl_state_ptr->memory.total > hdbtcl_state_ptr->memory_limit ) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("Fetched data exceed the memory limit of %lld bytes", (long long) hdbtcl_state_ptr->memory_limit));
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Releases column metadata objects of the previous result set.
+ */
+static void
+Stmt_ClearColumnObjs (Stmt_State * stmt_state_ptr)
+{
+    if ( stmt_state_ptr->column_objs == NULL ) {
+        return;
+    }
+    Tcl_WideInt size = sizeof(Column_Objs) * stmt_state_ptr->num_column_objs;
+    for ( int col = 0; col < stmt_state_ptr->num_column_objs; col++ ) {
+        Column_Objs * objs = &stmt_state_ptr->column_objs[col];
+        if ( objs->num != NULL ) {
+            size += 4 * sizeof(Tcl_Obj) + objs->name->length + objs->table->length + objs->owner->length;
+            Tcl_DecrRefCount(objs->num);
+            Tcl_DecrRefCount(objs->name);
+            Tcl_DecrRefCount(objs->table);
+            Tcl_DecrRefCount(objs->owner);
+        }
+    }
+    ckfree((char *) stmt_state_ptr->column_objs);
+    stmt_state_ptr->column_objs = NULL;
+    stmt_state_ptr->num_column_objs = 0;
+    if ( stmt_state_ptr->conn_state_ptr != NULL ) {
+        Memory_Add(stmt_state_ptr, MEMORY_METADATA, -size);
+    }
+}
+
+/**
+ * Returns metadata objects of the column of the current result set.
+ */
+static Column_Objs *
+Stmt_GetColumnObjs (Stmt_State * stmt_state_ptr, dbcapi_column_info info[], int num_cols, int col)
+{
+    if ( stmt_state_ptr->num_column_objs != num_cols ) {
+        Stmt_ClearColumnObjs(stmt_state_ptr);
+    }
+    if ( stmt_state_ptr->column_objs == NULL ) {
+        stmt_state_ptr->column_objs = (Column_Objs *) ckalloc(sizeof(Column_Objs) * num_cols);
+        memset(stmt_state_ptr->column_objs, 0, sizeof(Column_Objs) * num_cols);
+        stmt_state_ptr->num_column_objs = num_cols;
+        Memory_Add(stmt_state_ptr, MEMORY_METADATA, sizeof(Column_Objs) * num_cols);
+    }
+    Column_Objs * objs = &stmt_state_ptr->column_objs[col];
+    if ( objs->num == NULL ) {
+        const char * col_name = ( info[col].name != NULL && info[col].name[0] != '\0' ? info[col].name : info[col].column_name );
+        objs->num   = Tcl_NewIntObj(col);
+        objs->name  = Tcl_NewStringObj(col_name, -1);
+        objs->table = Tcl_NewStringObj(info[col].table_name, -1);
+        objs->owner = Tcl_NewStringObj(info[col].owner_name, -1);
+        Tcl_IncrRefCount(objs->num);
+        Tcl_IncrRefCount(objs->name);
+        Tcl_IncrRefCount(objs->table);
+        Tcl_IncrRefCount(objs->owner);
+        Memory_Add(stmt_state_ptr, MEMORY_METADATA, 4 * sizeof(Tcl_Obj) + objs->name->length + objs->table->length + objs->owner->length);
+    }
+    return objs;
+}
+
+/**
+ * Slow statement callback that is waiting for the interpreter to become idle.
+ */
+typedef struct trace_callback {
+    Tcl_Interp *        interp;
+    Tcl_Obj *           command;        /// callback command with the slow log entry appended
+} Trace_Callback;
+
+/**
+ * Calls the slow statement callback.
+ */
+static void
+Trace_RunCommand (ClientData client_data)
+{
+    Trace_Callback * callback_ptr = (Trace_Callback *) client_data;
+    if ( !Tcl_InterpDeleted(callback_ptr->interp) ) {
+        int res = Tcl_EvalObjEx(callback_ptr->interp, callback_ptr->command, TCL_EVAL_GLOBAL);
+        if ( res != TCL_OK ) {
+            Tcl_BackgroundException(callback_ptr->interp, res);
+        }
+    }
+    Tcl_DecrRefCount(callback_ptr->command);
+    Tcl_Release(callback_ptr->interp);
+    ckfree(callback_ptr);
+}
+
+/**
+ * Saves the slow statement entry into the slow log and schedules the connection's trace callback.
+ *
+ * \note The callback is called when the interpreter becomes idle, so it could not interfere with
+ * the command that has completed the statement execution.
+ */
+static void
+Trace_Record (Conn_State * conn_state_ptr, Tcl_Obj * sql, int num_params, const Hdbtcl_Stats * delta_ptr, int affected_rows, Tcl_Obj * error)
+{
+    Tcl_WideInt elapsed = delta_ptr->execute_time + delta_ptr->fetch_time + delta_ptr->convert_time + delta_ptr->lob_time;
+    if ( elapsed < (Tcl_WideInt) conn_state_ptr->trace_threshold * 1000000 ) {
+        return;
+    }
+    Hdbtcl_State * hdbtcl_state_ptr = conn_state_ptr->hdbtcl_state_ptr;
+    if ( hdbtcl_state_ptr->hdb_cmd == NULL ) {
+        // the module is being deleted
+        return;
+    }
+    Tcl_Interp * interp = hdbtcl_state_ptr->interp;
+    Tcl_Time now;
+    Tcl_GetTime(&now);
+
+    Tcl_Obj * entry = Tcl_NewDictObj();
+    if ( conn_state_ptr->conn_cmd != NULL ) {
+        Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("connection", -1), Tcl_NewStringObj(Tcl_GetCommandName(interp, conn_state_ptr->conn_cmd), -1));
+    }
+    if ( Tcl_GetCharLength(sql) > SLOWLOG_SQL_LENGTH ) {
+        sql = Tcl_GetRange(sql, 0, SLOWLOG_SQL_LENGTH - 1);
+        Tcl_AppendToObj(sql, "...", 3);
+    }
+    Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("sql", -1), sql);
+    Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("params", -1), Tcl_NewIntObj(num_params));
+    Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("time", -1), Tcl_NewWideIntObj((Tcl_WideInt) now.sec * 1000 + now.usec / 1000));
+    Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("elapsed", -1), Tcl_NewDoubleObj(elapsed / 1e6));
+    Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("execute", -1), Tcl_NewDoubleObj(delta_ptr->execute_time / 1e6));
+    Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("fetch", -1), Tcl_NewDoubleObj(( delta_ptr->fetch_time + delta_ptr->convert_time + delta_ptr->lob_time ) / 1e6));
+    Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("rows", -1), Tcl_NewWideIntObj(delta_ptr->rows));
+    if ( affected_rows >= 0 ) {
+        Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("affected", -1), Tcl_NewIntObj(affected_rows));
+    }
+    if ( error != NULL ) {
+        Tcl_DictObjPut(NULL, entry, Tcl_NewStringObj("error", -1), Tcl_DuplicateObj(error));
+    }
+
+    Tcl_IncrRefCount(entry);
+    Tcl_Obj * * slot = &hdbtcl_state_ptr->slowlog[hdbtcl_state_ptr->slowlog_next];
+    if ( *slot != NULL ) {
+        Tcl_DecrRefCount(*slot);
+    }
+    *slot = entry;
+    hdbtcl_state_ptr->slowlog_next = ( hdbtcl_state_ptr->slowlog_next + 1 ) % SLOWLOG_SIZE;
+    if ( hdbtcl_state_ptr->slowlog_count < SLOWLOG_SIZE ) {
+        ++hdbtcl_state_ptr->slowlog_count;
+    }
+
+    if ( conn_state_ptr->trace_command != NULL ) {
+        Trace_Callback * callback_ptr = (Trace_Callback *) ckalloc(sizeof(Trace_Callback));
+        callback_ptr->interp = interp;
+        callback_ptr->command = Tcl_DuplicateObj(conn_state_ptr->trace_command);
+        Tcl_IncrRefCount(callback_ptr->command);
+        Tcl_ListObjAppendElement(NULL, callback_ptr->command, entry);
+        Tcl_Preserve(interp);
+        Tcl_DoWhenIdle(Trace_RunCommand, (ClientData) callback_ptr);
+    }
+}
+
+/**
+ * Completes the traced execution of the statement. The execution is complete when its result set has
+ * been fetched, when it failed or when it did not return a result set. `affected_rows` is -1 for statements
+ * that returned a result set.
+ */
+static void
+Trace_Finish (Stmt_State * stmt_state_ptr, int affected_rows, Tcl_Obj * error)
+{
+    if ( !stmt_state_ptr->traced ) {
+        return;
+    }
+    stmt_state_ptr->traced = false;
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    if ( !conn_state_ptr->tracing ) {
+        return;
+    }
+    Hdbtcl_Stats delta = stmt_state_ptr->stats;
+    Tcl_WideInt * counters = (Tcl_WideInt *) &delta;
+    const Tcl_WideInt * base = (const Tcl_WideInt *) &stmt_state_ptr->trace_base;
+    for ( size_t i = 0; i < NUM_STATS_COUNTERS; i++ ) {
+        counters[i] -= base[i];
+    }
+    Trace_Record(conn_state_ptr, stmt_state_ptr->sql, stmt_state_ptr->trace_params, &delta, affected_rows, error);
+}
+
+/**
+ * Starts tracing the statement execution if its connection traces slow statements.
+ */
+static void
+Trace_Start (Stmt_State * stmt_state_ptr, int num_params)
+{
+    // the previous execution is complete even if its result set was not fetched to the end
+    Trace_Finish(stmt_state_ptr, -1, NULL);
+    if ( stmt_state_ptr->conn_state_ptr->tracing && stmt_state_ptr->sql != NULL ) {
+        stmt_state_ptr->traced = true;
+        stmt_state_ptr->trace_params = num_params;
+        stmt_state_ptr->trace_base = stmt_state_ptr->stats;
+    }
+}
+
+/**
+ * Completes the traced execution if the statement did not return a result set.
+ */
+static void
+Trace_Executed (Stmt_State * stmt_state_ptr)
+{
+    if ( stmt_state_ptr->traced && dbcapi.num_cols(stmt_state_ptr->stmt) == 0 ) {
+        Trace_Finish(stmt_state_ptr, dbcapi.affected_rows(stmt_state_ptr->stmt), NULL);
+    }
+}
+
+/**
+ * Destroys and deletes a statement state.
+ */
+static void
+Stmt_DeleteState (Stmt_State * stmt_state_ptr, Tcl_Interp * interp)
+{
+    if ( stmt_state_ptr == NULL ) {
+        return;
+    }
+    Stmt_ClearColumnObjs(stmt_state_ptr);
+    RowsetChannel_Detach(stmt_state_ptr);
+    if ( stmt_state_ptr->conn_state_ptr != NULL ) {
+        Async_Detach(stmt_state_ptr);
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+        Hdbtcl_Memory memory = stmt_state_ptr->memory;
+        Memory_Release(stmt_state_ptr, &memory);
+    }
+    if ( stmt_state_ptr->conn_state_ptr != NULL && stmt_state_ptr->stmt_cmd != NULL ) {
+        // If the statement is being deleted explicitly and not because connection executes finalization clean up
+        // (it is being deleted and it deletes all its statements), then remove statement entry from the set of
+        // connection's open statements
+        if ( stmt_state_ptr->conn_state_ptr->conn_cmd != NULL ) {
+            Tcl_HashEntry * entry = Tcl_FindHashEntry(stmt_state_ptr->conn_state_ptr->open_statements, stmt_state_ptr->stmt_cmd);
+            if ( entry != NULL ) {
+                Tcl_DeleteHashEntry(entry);
+            }
+        }
+        stmt_state_ptr->conn_state_ptr = NULL;
+    }
+    if ( stmt_state_ptr->stmt != NULL ) {
+        dbcapi.free_stmt(stmt_state_ptr->stmt);
+        stmt_state_ptr->stmt = NULL;
+    }
+    if ( stmt_state_ptr->sql != NULL ) {
+        Tcl_DecrRefCount(stmt_state_ptr->sql);
+    }
+    Arena_Free(&stmt_state_ptr->arena);
+    ckfree((char *) stmt_state_ptr);
+}
+
+/**
+ * Reports DBCAPI errors as TCL errors.
+ */
+static void
+SetErrorResult (Tcl_Interp * interp, dbcapi_connection * conn, const char * message, ...)
+{
+    va_list args;
+    va_start(args, message);
+    Tcl_AppendResult(interp, message, NULL);
+    Tcl_AppendResultVA(interp, args);
+    va_end(args);
+
+    size_t msg_size = dbcapi.error_length(conn);
+    char reason[msg_size];
+    int code = dbcapi.error(conn, reason, msg_size);
+
+    char reason_prefix[32];
+    sprintf(reason_prefix, " - Code: %d Reason: ", code);
+
+    Tcl_AppendResult(interp, reason_prefix, reason, NULL);
+}
+
+#define SQL_NO_DATA 100     /// code of the "no (more) data" error `fetch_next` reports at the end of the result set
+
+/**
+ * Checks whether `fetch_next` returned false because it failed rather than because the result set
+ * has no more rows.
+ */
+static bool
+FetchFailed (dbcapi_connection * conn)
+{
+    char reason[1];
+    int code = dbcapi.error(conn, reason, sizeof(reason));
+    return code != 0 && code != SQL_NO_DATA;
+}
+
+/**
+ * Execution timer. Timers are allocated by the threads that execute statements and are linked into
+ * the watchdog list while the statement is being executed.
+ */
+typedef struct watchdog_timer {
+    struct watchdog_timer * next;
+    dbcapi_connection *     conn;       /// NULL when the timer is not armed
+    Tcl_Time                deadline;
+    bool                    expired;    /// set by the watchdog after it has cancelled the execution
+} Watchdog_Timer;
+
+/**
+ * Watchdog that cancels statements that run longer than their timeout.
+ */
+static struct watchdog {
+    Tcl_Mutex               lock;
+    Tcl_Condition           cond;
+    Tcl_ThreadId            thread;
+    Watchdog_Timer *        timers;
+    bool                    exit;
+} watchdog;
+
+/**
+ * Returns true if time `a` is earlier than time `b`.
+ */
+static bool
+IsEarlier (const Tcl_Time * a, const Tcl_Time * b)
+{
+    return a->sec < b->sec || ( a->sec == b->sec && a->usec < b->usec );
+}
+
+/**
+ * Watchdog thread.
+ *
+ * Sleeps until the earliest deadline of the active timers and cancels executions of statements
+ * which timers have expired.
+ */
+static Tcl_ThreadCreateType
+Watchdog_Thread (ClientData client_data)
+{
+    Tcl_MutexLock(&watchdog.lock);
+    while ( !watchdog.exit ) {
+        Tcl_Time now;
+        Tcl_GetTime(&now);
+
+        Tcl_Time * next_deadline = NULL;
+        for ( Watchdog_Timer * timer = watchdog.timers; timer != NULL; timer = timer->next ) {
+            if ( timer->expired ) {
+                continue;
+            }
+            if ( !IsEarlier(&now, &timer->deadline) ) {
+                // Note that the cancellation is requested while the lock is held, so the timer
+                // owner cannot disarm it and release the connection before the request is sent.
+                timer->expired = true;
+                dbcapi.cancel(timer->conn);
+            } else if ( next_deadline == NULL || IsEarlier(&timer->deadline, next_deadline) ) {
+                next_deadline = &timer->deadline;
+            }
+        }
+        if ( next_deadline == NULL ) {
+            Tcl_ConditionWait(&watchdog.cond, &watchdog.lock, NULL);
+        } else {
+            Tcl_Time wait_time;
+            wait_time.sec  = next_deadline->sec  - now.sec;
+            wait_time.usec = next_deadline->usec - now.usec;
+            if ( wait_time.usec < 0 ) {
+                wait_time.sec  -= 1;
+                wait_time.usec += 1000000;
+            }
+            Tcl_ConditionWait(&watchdog.cond, &watchdog.lock, &wait_time);
+        }
+    }
+    Tcl_MutexUnlock(&watchdog.lock);
+
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/**
+ * Starts the execution timer. Timer is not armed when the timeout is 0.
+ *
+ * Returns false if the watchdog thread cannot be started.
+ */
+static bool
+Watchdog_Arm (Watchdog_Timer * timer, dbcapi_connection * conn, int timeout)
+{
+    memset(timer, 0, sizeof(Watchdog_Timer));
+    if ( timeout <= 0 ) {
+        return true;
+    }
+    Tcl_GetTime(&timer->deadline);
+    timer->deadline.sec  += timeout / 1000;
+    timer->deadline.usec += ( timeout % 1000 ) * 1000;
+    if ( timer->deadline.usec >= 1000000 ) {
+        timer->deadline.sec  += 1;
+        timer->deadline.usec -= 1000000;
+    }
+
+    Tcl_MutexLock(&watchdog.lock);
+    if ( watchdog.thread == NULL ) {
+        if ( Tcl_CreateThread(&watchdog.thread, Watchdog_Thread, NULL, TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) != TCL_OK ) {
+            watchdog.thread = NULL;
+            Tcl_MutexUnlock(&watchdog.lock);
+            return false;
+        }
+    }
+    timer->conn = conn;
+    timer->next = watchdog.timers;
+    watchdog.timers = timer;
+    Tcl_ConditionNotify(&watchdog.cond);
+    Tcl_MutexUnlock(&watchdog.lock);
+    return true;
+}
+
+/**
+ * Stops the execution timer. Returns true if the timer has expired and the execution was cancelled.
+ */
+static bool
+Watchdog_Disarm (Watchdog_Timer * timer)
+{
+    if ( timer->conn == NULL ) {
+        return false;
+    }
+    Tcl_MutexLock(&watchdog.lock);
+    for ( Watchdog_Timer * * link = &watchdog.timers; *link != NULL; link = &(*link)->next ) {
+        if ( *link == timer ) {
+            *link = timer->next;
+            break;
+        }
+    }
+    Tcl_MutexUnlock(&watchdog.lock);
+    timer->conn = NULL;
+    return timer->expired;
+}
+
+/**
+ * Stops the watchdog thread.
+ */
+static void
+Watchdog_Shutdown ()
+{
+    if ( watchdog.thread == NULL ) {
+        return;
+    }
+    Tcl_MutexLock(&watchdog.lock);
+    watchdog.exit = true;
+    Tcl_ConditionNotify(&watchdog.cond);
+    Tcl_MutexUnlock(&watchdog.lock);
+
+    int result;
+    Tcl_JoinThread(watchdog.thread, &result);
+    watchdog.thread = NULL;
+    watchdog.exit = false;
+}
+
+/**
+ * Returns the execution timeout of the statement.
+ */
+static int
+GetStmtTimeout (Stmt_State * stmt_state_ptr)
+{
+    return stmt_state_ptr->timeout >= 0 ? stmt_state_ptr->timeout : stmt_state_ptr->conn_state_ptr->timeout;
+}
+
+/**
+ * Reads the execution timeout (ms) from the option value.
+ */
+static int
+GetTimeoutFromObj (Tcl_Interp * interp, Tcl_Obj * obj, int * timeout_ptr)
+{
+    int timeout;
+    if ( Tcl_GetIntFromObj(interp, obj, &timeout) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( timeout < 0 ) {
+        Tcl_SetResult(interp, "timeout cannot be negative", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    *timeout_ptr = timeout;
+    return TCL_OK;
+}
+
+/**
+ * Reads the memory limit (bytes) from the option value.
+ */
+static int
+GetMemoryLimitFromObj (Tcl_Interp * interp, Tcl_Obj * obj, Tcl_WideInt * limit_ptr)
+{
+    Tcl_WideInt limit;
+    if ( Tcl_GetWideIntFromObj(interp, obj, &limit) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( limit < 0 ) {
+        Tcl_SetResult(interp, "memory limit cannot be negative", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    *limit_ptr = limit;
+    return TCL_OK;
+}
+
+/**
+ * Closes the statement.
+ *
+ * # Example
+ * \code{.tcl}
+ * $stmt close
+ * \endcode
+ *
+ * \note After the stemenet is closed the stored command is not longer valid. Also, the explicit
+ * `close` is not necessary. `hdbtcl` will close the statement automatically when all saved
+ * references to it are gone.
+ */
+static int
+Stmt_Close (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( Tcl_DeleteCommandFromToken(interp, stmt_state_ptr->stmt_cmd) != TCL_OK ) {
+        Tcl_SetResult(interp, "Cannot delete statement handle", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Returns the length of the leading run of ASCII characters other than NUL.
+ */
+static size_t
+Utf8_AsciiPrefix (const char * str, size_t len)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for ( ; i + 32 <= len; i += 32 ) {
+        __m256i chars = _mm256_loadu_si256((const __m256i *) (str + i));
+        // NULs are turned into 0xFF, so all stop characters have the high bit set
+        if ( _mm256_movemask_epi8(_mm256_or_si256(chars, _mm256_cmpeq_epi8(chars, zero))) != 0 ) {
+            break;
+        }
+    }
+#elif defined(HAVE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; i + 16 <= len; i += 16 ) {
+        __m128i chars = _mm_loadu_si128((const __m128i *) (str + i));
+        if ( _mm_movemask_epi8(_mm_or_si128(chars, _mm_cmpeq_epi8(chars, zero))) != 0 ) {
+            break;
+        }
+    }
+#else
+    for ( ; i + 8 <= len; i += 8 ) {
+        uint64_t chars;
+        memcpy(&chars, str + i, 8);
+        // a byte gets the high bit if it has it already or if it is 0 (which borrows from it)
+        if ( ( ( chars - UINT64_C(0x0101010101010101) ) | chars ) & UINT64_C(0x8080808080808080) ) {
+            break;
+        }
+    }
+#endif
+    while ( i < len && (unsigned char) str[i] - 1u < 0x7fu ) {
+        ++i;
+    }
+    return i;
+}
+
+/**
+ * Checks whether UTF-8 text is the same in the Tcl internal encoding. It is not when the text has
+ * NULs, which Tcl encodes as 2 bytes, malformed sequences or, when Tcl keeps characters outside of
+ * the BMP as surrogate pairs (Tcl 8.6), 4-byte sequences or surrogates. ASCII runs are skipped
+ * by the vectorized scan.
+ */
+static bool
+Utf8_IsPlain (const char * str, size_t len)
+{
+    const unsigned char * text = (const unsigned char *) str;
+    size_t i = 0;
+    while ( i < len ) {
+        unsigned char c = text[i];
+        size_t n;
+        if ( c - 1u < 0x7fu ) {
+            i += Utf8_AsciiPrefix(str + i, len - i);
+            continue;
+        }
+        if ( 0xc2 <= c && c <= 0xdf ) {
+            n = 1;
+        } else if ( 0xe0 <= c && c <= 0xef ) {
+            n = 2;
+#if TCL_UTF_MAX > 3
+        } else if ( 0xf0 <= c && c <= 0xf4 ) {
+            n = 3;
+#endif
+        } else {
+            // NUL, a continuation byte, an overlong or a 4-byte sequence
+            return false;
+        }
+        if ( len - i <= n ) {
+            return false;
+        }
+        for ( size_t k = 1; k <= n; k++ ) {
+            if ( ( text[i + k] & 0xc0 ) != 0x80 ) {
+                return false;
+            }
+        }
+        if (
+            ( c == 0xe0 && text[i + 1] < 0xa0 ) ||  // overlong
+            ( c == 0xed && text[i + 1] >= 0xa0 ) || // surrogate
+            ( c == 0xf0 && text[i + 1] < 0x90 ) ||  // overlong
+            ( c == 0xf4 && text[i + 1] >= 0x90 )    // beyond U+10FFFF
+        ) {
+            return false;
+        }
+        i += n + 1;
+    }
+    return true;
+}
+
+/**
+ * UTF-8 encoding the text that needs conversion is converted with. It is looked up when the first
+ * such text is converted and is kept until the process exits.
+ */
+static Tcl_Encoding utf8_encoding = NULL;
+TCL_DECLARE_MUTEX(encoding_lock)
+
+/**
+ * Releases the UTF-8 encoding when the process exits.
+ */
+static void
+Utf8_FreeEncoding (ClientData client_data)
+{
+    Tcl_MutexLock(&encoding_lock);
+    if ( utf8_encoding != NULL ) {
+        Tcl_FreeEncoding(utf8_encoding);
+        utf8_encoding = NULL;
+    }
+    Tcl_MutexUnlock(&encoding_lock);
+}
+
+/**
+ * Returns the UTF-8 encoding. Looks it up on the first call.
+ */
+static Tcl_Encoding
+Utf8_GetEncoding ()
+{
+    Tcl_MutexLock(&encoding_lock);
+    if ( utf8_encoding == NULL ) {
+        utf8_encoding = Tcl_GetEncoding(NULL, "utf-8");
+        Tcl_CreateExitHandler(Utf8_FreeEncoding, NULL);
+    }
+    Tcl_Encoding encoding = utf8_encoding;
+    Tcl_MutexUnlock(&encoding_lock);
+    return encoding;
+}
+
+/**
+ * Sets the string object to UTF-8 text DBCAPI has returned. Plain text becomes the string
+ * representation as is, the rest is converted into the Tcl internal encoding.
+ */
+static void
+SetStringObjFromUtf8 (Tcl_Obj * obj, const char * str, size_t len)
+{
+    if ( Utf8_IsPlain(str, len) ) {
+        Tcl_SetStringObj(obj, str, len);
+        return;
+    }
+    Tcl_DString text;
+    Tcl_ExternalToUtfDString(Utf8_GetEncoding(), str, len, &text);
+    Tcl_SetStringObj(obj, Tcl_DStringValue(&text), Tcl_DStringLength(&text));
+    Tcl_DStringFree(&text);
+}
+
+/**
+ * Converts the UTF-8 text DBCAPI has written into the string representation of the (unshared)
+ * object into the Tcl internal encoding.
+ */
+static void
+ConvertStringObjFromUtf8 (Tcl_Obj * obj)
+{
+    if ( !Utf8_IsPlain(obj->bytes, obj->length) ) {
+        Tcl_DString text;
+        Tcl_DStringInit(&text);
+        Tcl_DStringAppend(&text, obj->bytes, obj->length);
+        SetStringObjFromUtf8(obj, Tcl_DStringValue(&text), Tcl_DStringLength(&text));
+        Tcl_DStringFree(&text);
+    }
+}
+
+/**
+ * Returns UTF-8 text of the string object that can be sent to DBCAPI. Plain text is returned as
+ * is. Text that needs conversion is converted into the arena (which must outlive its use).
+ */
+static const char *
+GetUtf8FromObj (Tcl_Obj * obj, int * len_ptr, Stmt_Arena * arena_ptr)
+{
+    const char * str = Tcl_GetStringFromObj(obj, len_ptr);
+    if ( arena_ptr == NULL || Utf8_IsPlain(str, *len_ptr) ) {
+        return str;
+    }
+    Tcl_DString text;
+    Tcl_UtfToExternalDString(Utf8_GetEncoding(), str, *len_ptr, &text);
+    *len_ptr = Tcl_DStringLength(&text);
+    char * converted = (char *) Arena_Alloc(arena_ptr, *len_ptr + 1);
+    memcpy(converted, Tcl_DStringValue(&text), *len_ptr + 1);
+    Tcl_DStringFree(&text);
+    return converted;
+}
+
+/**
+ * Formats binary column values can be fetched in. `list` applies to REAL_VECTOR columns only, other
+ * binary values are fetched as byte arrays then.
+ */
+typedef enum binary_format {
+    BINARY_AS_BYTES, BINARY_AS_HEX, BINARY_AS_BASE64, BINARY_AS_LIST
+} Binary_Format;
+
+static const char * const binary_formats[] = { "bytes", "hex", "base64", "list", NULL };
+
+static const char hex_digits[] = "0123456789abcdef";
+static const char base64_digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * Returns the length of the text binary data of the specified size are encoded into.
+ */
+static size_t
+Binary_EncodedLength (size_t len, Binary_Format format)
+{
+    switch ( format ) {
+        case BINARY_AS_HEX:     return len * 2;
+        case BINARY_AS_BASE64:  return ( len + 2 ) / 3 * 4;
+        default:                return len;
+    }
+}
+
+/**
+ * Encodes binary data as lowercase hex digits. SSE2 encodes 16 bytes at a time.
+ */
+static void
+Binary_EncodeHex (const unsigned char * data, size_t len, char * text)
+{
+    size_t i = 0;
+#if defined(HAVE_SSE2)
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i digit_0 = _mm_set1_epi8('0');
+    const __m128i letter_gap = _mm_set1_epi8('a' - '0' - 10);
+    for ( ; i + 16 <= len; i += 16 ) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble_mask);
+        __m128i lo = _mm_and_si128(bytes, nibble_mask);
+        // nibbles above 9 are moved from the digits to the letters
+        hi = _mm_add_epi8(_mm_add_epi8(hi, digit_0), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letter_gap));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, digit_0), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letter_gap));
+        _mm_storeu_si128((__m128i *) (text + i * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (text + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    for ( ; i < len; i++ ) {
+        text[i * 2]     = hex_digits[data[i] >> 4];
+        text[i * 2 + 1] = hex_digits[data[i] & 0x0f];
+    }
+}
+
+/**
+ * Encodes binary data in base64 (with padding). SSSE3 encodes 12 bytes at a time.
+ */
+static void
+Binary_EncodeBase64 (const unsigned char * data, size_t len, char * text)
+{
+    size_t i = 0;
+#if defined(HAVE_SSSE3)
+    // W. Mula's method: 12 bytes are spread into 16 6-bit indexes that are translated into
+    // characters by adding the offset of the range each index falls into
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    // 16 bytes are loaded, thus the last 4 must be within the data too
+    for ( ; i + 16 <= len; i += 12, text += 16 ) {
+        __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + i)), spread);
+        __m128i ac = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i bd = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i indexes = _mm_or_si128(ac, bd);
+        // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+        __m128i range = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+        range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indexes), _mm_set1_epi8(13)));
+        _mm_storeu_si128((__m128i *) text, _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indexes));
+    }
+#endif
+    for ( ; i + 3 <= len; i += 3, text += 4 ) {
+        uint32_t bits = ( (uint32_t) data[i] << 16 ) | ( (uint32_t) data[i + 1] << 8 ) | data[i + 2];
+        text[0] = base64_digits[bits >> 18];
+        text[1] = base64_digits[( bits >> 12 ) & 0x3f];
+        text[2] = base64_digits[( bits >> 6 ) & 0x3f];
+        text[3] = base64_digits[bits & 0x3f];
+    }
+    if ( i < len ) {
+        uint32_t bits = (uint32_t) data[i] << 16;
+        if ( i + 1 < len ) {
+            bits |= (uint32_t) data[i + 1] << 8;
+        }
+        text[0] = base64_digits[bits >> 18];
+        text[1] = base64_digits[( bits >> 12 ) & 0x3f];
+        text[2] = ( i + 1 < len ? base64_digits[( bits >> 6 ) & 0x3f] : '=' );
+        text[3] = '=';
+    }
+}
+
+/**
+ * Sets the (new) object to the binary data in the specified format. Encoded text is written
+ * directly into the string representation of the object.
+ */
+static void
+SetBinaryObj (Tcl_Obj * obj, const unsigned char * data, size_t len, Binary_Format format)
+{
+    if ( format == BINARY_AS_BYTES || format == BINARY_AS_LIST ) {
+        Tcl_SetByteArrayObj(obj, data, len);
+        return;
+    }
+    Tcl_SetObjLength(obj, Binary_EncodedLength(len, format));
+    if ( format == BINARY_AS_HEX ) {
+        Binary_EncodeHex(data, len, obj->bytes);
+    } else {
+        Binary_EncodeBase64(data, len, obj->bytes);
+    }
+}
+
+/**
+ * Appends the binary data encoded as hex or base64 text.
+ */
+static void
+AppendBinaryText (Tcl_DString * text, const unsigned char * data, size_t len, Binary_Format format)
+{
+    int offset = Tcl_DStringLength(text);
+    Tcl_DStringSetLength(text, offset + Binary_EncodedLength(len, format));
+    if ( format == BINARY_AS_HEX ) {
+        Binary_EncodeHex(data, len, Tcl_DStringValue(text) + offset);
+    } else {
+        Binary_EncodeBase64(data, len, Tcl_DStringValue(text) + offset);
+    }
+}
+
+/**
+ * Reads the `-binaryas` option value - either a format of all binary columns or a list with
+ * a format for each column of the result set (formats of non-binary columns are ignored).
+ */
+static int
+GetBinaryFormatsFromObj (Tcl_Interp * interp, Tcl_Obj * obj, int num_cols, unsigned char formats[])
+{
+    int num_formats;
+    Tcl_Obj ** format_objs;
+    if ( Tcl_ListObjGetElements(interp, obj, &num_formats, &format_objs) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( num_formats != 1 && num_formats != num_cols ) {
+        Tcl_SetObjResult(interp, Tcl_ObjPrintf("expected a binary format or a list of %d formats, one for each column", num_cols));
+        return TCL_ERROR;
+    }
+    for ( int col = 0; col < num_cols; ++col ) {
+        int format;
+        if ( Tcl_GetIndexFromObj(interp, format_objs[num_formats == 1 ? 0 : col], binary_formats, "binary format", 0, &format) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        formats[col] = (unsigned char) format;
+    }
+    return TCL_OK;
+}
+
+#define VECTOR_CHUNK_SIZE 64    /// number of vector elements converted at once
+
+/**
+ * Locates the elements of a REAL_VECTOR value. Vectors are transferred in the fvecs layout - the 4-byte
+ * dimension followed by the float32 elements (both little-endian, which is the byte order of the platforms
+ * hdbtcl runs on). Returns NULL if the value does not have this layout.
+ */
+static const unsigned char *
+Vector_GetElements (const unsigned char * data, size_t len, uint32_t * dim_ptr)
+{
+    uint32_t dim;
+    if ( len < sizeof(dim) ) {
+        return NULL;
+    }
+    memcpy(&dim, data, sizeof(dim));
+    if ( len - sizeof(dim) != (size_t) dim * sizeof(float) ) {
+        return NULL;
+    }
+    *dim_ptr = dim;
+    return data + sizeof(dim);
+}
+
+/**
+ * Widens packed float32 vector elements to doubles. SSE2 converts 4 elements at a time.
+ */
+static void
+Vector_ToDoubles (const unsigned char * elems, size_t num_elems, double * nums)
+{
+    size_t i = 0;
+#if defined(HAVE_SSE2)
+    for ( ; i + 4 <= num_elems; i += 4 ) {
+        __m128 floats = _mm_loadu_ps((const float *) (elems + i * sizeof(float)));
+        _mm_storeu_pd(nums + i, _mm_cvtps_pd(floats));
+        _mm_storeu_pd(nums + i + 2, _mm_cvtps_pd(_mm_movehl_ps(floats, floats)));
+    }
+#endif
+    for ( ; i < num_elems; i++ ) {
+        float num;
+        memcpy(&num, elems + i * sizeof(float), sizeof(float));
+        nums[i] = num;
+    }
+}
+
+/**
+ * Sets the (new) object to the REAL_VECTOR value. Vectors are fetched as packed float32 elements - as they
+ * are or encoded as hex or base64 text - or, with `list`, as lists of doubles. Values that are not in the
+ * fvecs layout are fetched as other binary values.
+ */
+static void
+SetVectorObj (Tcl_Obj * obj, const unsigned char * data, size_t len, Binary_Format format)
+{
+    uint32_t dim;
+    const unsigned char * elems = Vector_GetElements(data, len, &dim);
+    if ( elems == NULL ) {
+        SetBinaryObj(obj, data, len, format);
+        return;
+    }
+    if ( format != BINARY_AS_LIST ) {
+        SetBinaryObj(obj, elems, (size_t) dim * sizeof(float), format);
+        return;
+    }
+    Tcl_SetListObj(obj, 0, NULL);
+    double nums[VECTOR_CHUNK_SIZE];
+    Tcl_Obj * num_objs[VECTOR_CHUNK_SIZE];
+    for ( uint32_t i = 0; i < dim; i += VECTOR_CHUNK_SIZE ) {
+        int num_elems = ( dim - i < VECTOR_CHUNK_SIZE ? dim - i : VECTOR_CHUNK_SIZE );
+        Vector_ToDoubles(elems + i * sizeof(float), num_elems, nums);
+        for ( int j = 0; j < num_elems; j++ ) {
+            num_objs[j] = Tcl_NewDoubleObj(nums[j]);
+        }
+        Tcl_ListObjReplace(NULL, obj, i, 0, num_elems, num_objs);
+    }
+}
+
+/**
+ * Appends the REAL_VECTOR value as an array of numbers - `[0.5,1.25]` - which is both the JSON and the HANA
+ * text form of vectors. Values that are not in the fvecs layout are appended as empty arrays.
+ */
+static void
+AppendVectorText (Tcl_DString * text, const unsigned char * data, size_t len)
+{
+    uint32_t dim = 0;
+    const unsigned char * elems = Vector_GetElements(data, len, &dim);
+    Tcl_DStringAppend(text, "[", 1);
+    double nums[VECTOR_CHUNK_SIZE];
+    for ( uint32_t i = 0; elems != NULL && i < dim; i += VECTOR_CHUNK_SIZE ) {
+        int num_elems = ( dim - i < VECTOR_CHUNK_SIZE ? dim - i : VECTOR_CHUNK_SIZE );
+        Vector_ToDoubles(elems + i * sizeof(float), num_elems, nums);
+        for ( int j = 0; j < num_elems; j++ ) {
+            if ( i + j > 0 ) {
+                Tcl_DStringAppend(text, ",", 1);
+            }
+            if ( isfinite(nums[j]) ) {
+                char num_text[TCL_DOUBLE_SPACE];
+                Tcl_PrintDouble(NULL, nums[j], num_text);
+                Tcl_DStringAppend(text, num_text, -1);
+            } else {
+                Tcl_DStringAppend(text, "null", 4);
+            }
+        }
+    }
+    Tcl_DStringAppend(text, "]", 1);
+}
+
+/**
+ * Returns the fvecs layout of the REAL_VECTOR argument, which is either a byte array with packed float32
+ * elements or a list of numbers. Byte arrays are always bare elements - the ones fetched vectors are
+ * returned as - so the dimension is prepended to them. The layout is allocated from the arena or, when
+ * the arena is NULL, by ckalloc and then the caller frees it.
+ */
+static int
+GetVectorFromObj (Tcl_Interp * interp, Tcl_Obj * obj, Stmt_Arena * arena_ptr, unsigned char * * data_ptr, int * len_ptr)
+{
+    uint32_t dim;
+    unsigned char * data;
+    if ( obj->typePtr != NULL && strcmp(obj->typePtr->name, "bytearray") == 0 ) {
+        int len;
+        const unsigned char * bytes = Tcl_GetByteArrayFromObj(obj, &len);
+        if ( len % sizeof(float) != 0 ) {
+            Tcl_SetResult(interp, "packed vector length must be a multiple of 4 bytes", TCL_STATIC);
+            return TCL_ERROR;
+        }
+        dim = len / sizeof(float);
+        data = (unsigned char *) ( arena_ptr != NULL ? Arena_Alloc(arena_ptr, sizeof(dim) + len) : ckalloc(sizeof(dim) + len) );
+        memcpy(data + sizeof(dim), bytes, len);
+    } else {
+        int num_elems;
+        Tcl_Obj ** elem_objs;
+        if ( Tcl_ListObjGetElements(interp, obj, &num_elems, &elem_objs) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        dim = num_elems;
+        size_t size = sizeof(dim) + (size_t) dim * sizeof(float);
+        data = (unsigned char *) ( arena_ptr != NULL ? Arena_Alloc(arena_ptr, size) : ckalloc(size) );
+        for ( int i = 0; i < num_elems; i++ ) {
+            double num;
+            if ( Tcl_GetDoubleFromObj(interp, elem_objs[i], &num) != TCL_OK ) {
+                if ( arena_ptr == NULL ) {
+                    ckfree(data);
+                }
+                return TCL_ERROR;
+            }
+            float elem = (float) num;
+            memcpy(data + sizeof(dim) + i * sizeof(float), &elem, sizeof(float));
+        }
+    }
+    memcpy(data, &dim, sizeof(dim));
+    *data_ptr = data;
+    *len_ptr = sizeof(dim) + dim * sizeof(float);
+    return TCL_OK;
+}
+
+/**
+ * Type to store bound primitives.
+ */
+typedef union primitive_sql_value {
+    double      double_value;
+    int         int_value;
+    Tcl_WideInt wideint_value;
+    size_t      data_length;
+} PrimitiveSqlValue;
+
+/**
+ * Helper function to report "expected N but got M" type of errors.
+ */
+static void
+SetNumDiffErrorResult (Tcl_Interp * interp, const char * txt_begin, int num1, const char * txt_mid, int num2, const char * txt_end)
+{
+    char txt1[12], txt2[12];
+    Tcl_AppendResult(interp, txt_begin, itoa(num1, txt1, 10), txt_mid, itoa(num2, txt2, 10), txt_end, NULL);
+}
+
+/**
+ * Macro that help to avoid the multiline pattern of binding parameters.
+ */
+#define BIND_PARAM(stmt_state_ptr, interp, i, bind_ptr) do { \
+    if ( !dbcapi.bind_param((stmt_state_ptr)->stmt, (i), (bind_ptr)) ) { \
         char num[12]; \
         SetErrorResult((interp), (stmt_state_ptr)->conn_state_ptr->conn, "Cannot bind SQL argument [", itoa((i), num, 10), "]", NULL); \
         return TCL_ERROR; \
@@ -548,1514 +2267,7969 @@ SetNumDiffErrorResult (Tcl_Interp * interp, const char * txt_begin, int num1, co
 } while (0)
 
 /**
- * Binds statement arguments to the respective placeholders.
+ * Points the bound value of a numeric parameter to the argument's primitive buffer. The type of the
+ * value is changed to the type of the buffer. Strings and binaries are left as they are.
+ */
+static void
+SetBindBuffer (dbcapi_data_value * value, PrimitiveSqlValue * sql_arg)
+{
+    switch ( value->type ) {
+        case A_VAL32: case A_UVAL32: case A_VAL16: case A_UVAL16: case A_VAL8: case A_UVAL8:
+            value->type = A_VAL32;
+            value->buffer = (char *) &sql_arg->int_value;
+            value->buffer_size = sizeof(sql_arg->int_value);
+            value->length = &value->buffer_size;
+            break;
+        case A_VAL64: case A_UVAL64:
+            value->type = A_VAL64;
+            value->buffer = (char *) &sql_arg->wideint_value;
+            value->buffer_size = sizeof(sql_arg->wideint_value);
+            value->length = &value->buffer_size;
+            break;
+        case A_DOUBLE: case A_FLOAT:
+            value->type = A_DOUBLE;
+            value->buffer = (char *) &sql_arg->double_value;
+            value->buffer_size = sizeof(sql_arg->double_value);
+            value->length = &value->buffer_size;
+            break;
+        default: {
+            // Strings and binaries (byte arrays)
+        }
+    }
+}
+
+/**
+ * Loads the input argument into the bound value (that SetBindBuffer has set up). Numbers are
+ * converted into the primitive buffer. Strings and byte arrays are bound to the argument's data.
+ * Strings that are not plain UTF-8 are converted into the arena, unless it is NULL. Vectors are
+ * converted into the arena too. Without the arena - for INOUT arguments, which are bound to the
+ * variable value - the (unshared) argument is replaced by the vector in the fvecs layout.
+ */
+static int
+LoadBindValue (Tcl_Interp * interp, Tcl_Obj * arg_val, bool is_null, dbcapi_native_type native_type, dbcapi_data_value * value, PrimitiveSqlValue * sql_arg, Stmt_Arena * arena_ptr)
+{
+    int len;
+    switch ( value->type ) {
+        case A_VAL32: {
+            if ( is_null ) {
+                break;
+            }
+            int res = (
+                native_type == DT_BOOLEAN
+                    ? Tcl_GetBooleanFromObj(interp, arg_val, &sql_arg->int_value)
+                    : Tcl_GetIntFromObj(interp, arg_val, &sql_arg->int_value)
+            );
+            if ( res != TCL_OK ) {
+                return TCL_ERROR;
+            }
+            break;
+        }
+        case A_VAL64: {
+            if ( !is_null && Tcl_GetWideIntFromObj(interp, arg_val, &sql_arg->wideint_value) != TCL_OK ) {
+                return TCL_ERROR;
+            }
+            break;
+        }
+        case A_DOUBLE: {
+            if ( !is_null && Tcl_GetDoubleFromObj(interp, arg_val, &sql_arg->double_value) != TCL_OK ) {
+                return TCL_ERROR;
+            }
+            break;
+        }
+        case A_STRING: {
+            value->buffer = (char *) GetUtf8FromObj(arg_val, &len, arena_ptr);
+            sql_arg->data_length = len;
+            value->length = &sql_arg->data_length;
+            break;
+        }
+        case A_BINARY: {
+            if ( native_type == NATIVE_TYPE_REAL_VECTOR && !is_null ) {
+                unsigned char * data;
+                if ( GetVectorFromObj(interp, arg_val, arena_ptr, &data, &len) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( arena_ptr == NULL ) {
+                    Tcl_SetByteArrayObj(arg_val, data, len);
+                    ckfree(data);
+                    data = Tcl_GetByteArrayFromObj(arg_val, &len);
+                }
+                value->buffer = (char *) data;
+            } else {
+                value->buffer = (char *) Tcl_GetByteArrayFromObj(arg_val, &len);
+            }
+            sql_arg->data_length = len;
+            value->length = &sql_arg->data_length;
+            break;
+        }
+        default: {
+            // A_INVALID_TYPE
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Binds statement arguments to the respective placeholders. Buffers that receive OUT values are
+ * accounted in `memory_ptr` (if it is not NULL) until the caller releases them.
+ */
+static int
+BindStmtArgs (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int argc, Tcl_Obj * const argv[], dbcapi_bool is_null[], PrimitiveSqlValue sql_args[], Stmt_Arena * arena_ptr, Hdbtcl_Memory * memory_ptr)
+{
+    int num_params = dbcapi.num_params(stmt_state_ptr->stmt);
+    if ( num_params < 0 ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot determine the number of statement parameters", NULL);
+        return TCL_ERROR;
+    }
+    if ( argc != num_params ) {
+        SetNumDiffErrorResult(interp, "Expected ", num_params, " arguments but got ", argc, NULL);
+        return TCL_ERROR;
+    }
+
+    if ( !dbcapi.reset(stmt_state_ptr->stmt) ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot reset statement for execution", NULL);
+        return TCL_ERROR;
+    }
+
+    for ( int i = 0; i < argc; i++ ) {
+        dbcapi_bind_data bind;
+        dbcapi_bind_param_info info;
+        if (
+            !dbcapi.describe_bind_param(stmt_state_ptr->stmt, i, &bind) ||
+            !dbcapi.get_bind_param_info(stmt_state_ptr->stmt, i, &info)
+        ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve information about SQL parameter [", itoa(i, num, 10), "]", NULL);
+            return TCL_ERROR;
+        }
+        if ( bind.value.type == A_INVALID_TYPE ) {
+            char num[12];
+            Tcl_AppendResult(interp, "DBCAPI did not return the type of parameter [", itoa(i, num, 10), "],", NULL);
+            if ( bind.name != NULL && bind.name[0] != '\0' ) {
+                Tcl_AppendResult(interp, " (", bind.name, ")", NULL);
+            }
+            return TCL_ERROR;
+        }
+
+        if ( bind.value.buffer_size == INT32_MAX ) {
+            // It's a LOB. The argument might be an object or an open channel or a pair of channels (for INOUT parameters)
+
+            if ( bind.direction == DD_INPUT && argv[i]->bytes != NULL && 0 < argv[i]->length && argv[i]->length < 32 ) {
+                const char * name = Tcl_GetString(argv[i]);
+                int mode;
+                Tcl_Channel ch = Tcl_GetChannel(interp, name, &mode);
+                if ( ch != NULL ) {
+                    // Check whether it is usable...
+                    if ( ( mode & TCL_READABLE ) == 0 ) {
+                        Tcl_AppendResult(interp, "Channel ", name, " must be open for reading", NULL);
+                        return TCL_ERROR;
+                    }
+                    sql_args[i].data_length = INT32_MAX;
+                    bind.value.length = &sql_args[i].data_length;
+                    bind.value.buffer_size = 0;
+                } else {
+                    Tcl_ResetResult(interp);
+                }
+            } else if ( bind.direction == DD_INPUT_OUTPUT || bind.direction == DD_OUTPUT ) {
+                // Output is always streamed
+                sql_args[i].data_length = INT32_MAX;
+                bind.value.length = &sql_args[i].data_length;
+                bind.value.buffer_size = 0;
+            }
+
+            if ( bind.value.buffer_size == 0 ) {
+                BIND_PARAM(stmt_state_ptr, interp, i, &bind);
+                continue;
+            }
+        }
+
+        SetBindBuffer(&bind.value, &sql_args[i]);
+
+        Tcl_Obj * arg_val;
+        if ( bind.direction == DD_INPUT ) {
+            arg_val = argv[i];
+        } else {
+            if ( bind.direction == DD_INPUT_OUTPUT ) {
+                arg_val = Tcl_ObjGetVar2(interp, argv[i], NULL, TCL_LEAVE_ERR_MSG);
+                if ( arg_val == NULL ) {
+                    return TCL_ERROR;
+                }
+            } else {
+                arg_val = Tcl_ObjGetVar2(interp, argv[i], NULL, 0);
+                if ( arg_val == NULL ) {
+                    arg_val = Tcl_ObjSetVar2(interp, argv[i], NULL, Tcl_NewObj(), TCL_LEAVE_ERR_MSG);
+                }
+            }
+            if ( Tcl_IsShared(arg_val) ) {
+                arg_val = Tcl_ObjSetVar2(interp, argv[i], NULL, Tcl_DuplicateObj(arg_val), TCL_LEAVE_ERR_MSG);
+            }
+        }
+
+        is_null[i] = ( arg_val->bytes != NULL && arg_val->length == 0 );
+        if ( is_null[i] ) {
+            bind.value.is_null = &is_null[i];
+        }
+        if ( bind.direction == DD_INPUT || bind.direction == DD_INPUT_OUTPUT ) {
+            // INOUT strings are bound to the variable value that receives the output
+            Stmt_Arena * input_arena_ptr = ( bind.direction == DD_INPUT ? arena_ptr : NULL );
+            if ( LoadBindValue(interp, arg_val, is_null[i], info.native_type, &bind.value, &sql_args[i], input_arena_ptr) != TCL_OK ) {
+                return TCL_ERROR;
+            }
+        }
+
+        if ( bind.direction == DD_OUTPUT || bind.direction == DD_INPUT_OUTPUT ) {
+            // Make sure Strings and byte arrays have enough space for output
+            if ( bind.value.type == A_STRING ) {
+                // For NVARCHAR DBCAPI sets bind's "buffer size" (and info's "max size") to the number of characters.
+                int output_buffer_size = bind.value.buffer_size * BYTES_PER_CODEPOINT;
+                int len;
+                bind.value.buffer = Tcl_GetStringFromObj(arg_val, &len);
+                if ( len < output_buffer_size ) {
+                    Tcl_SetObjLength(arg_val, output_buffer_size);
+                    bind.value.buffer = (char*) Tcl_GetString(arg_val);
+                    // account for terminating '\0'
+                    bind.value.buffer_size = output_buffer_size + 1;
+                } else {
+                    bind.value.buffer_size = len + 1;
+                }
+                bind.value.length = &sql_args[i].data_length;
+
+            } else if ( bind.value.type == A_BINARY ) {
+                int len;
+                bind.value.buffer = (char *) Tcl_GetByteArrayFromObj(arg_val, &len);
+                if ( len < bind.value.buffer_size ) {
+                    bind.value.buffer = (char*) Tcl_SetByteArrayLength(arg_val, bind.value.buffer_size);
+                } else {
+                    bind.value.buffer_size = len;
+                }
+                bind.value.length = &sql_args[i].data_length;
+                Tcl_InvalidateStringRep(arg_val);
+            }
+            if ( Memory_Reserve(stmt_state_ptr, interp, memory_ptr, MEMORY_PARAMS, sizeof(Tcl_Obj) + bind.value.buffer_size) != TCL_OK ) {
+                return TCL_ERROR;
+            }
+        }
+
+        BIND_PARAM(stmt_state_ptr, interp, i, &bind);
+    }
+
+    return TCL_OK;
+}
+
+#define LOB_CHUNK_SIZE 32768   /// default size of the pieces LOB data are sent and read in
+
+/**
+ * Returns a LOB chunk buffer from the connection pool or a new one if the pool is empty. The caller
+ * owns the returned buffer's reference.
+ */
+static Tcl_Obj *
+LobPool_Acquire (Conn_State * conn_state_ptr)
+{
+    if ( conn_state_ptr->num_lob_buffers > 0 ) {
+        return conn_state_ptr->lob_buffers[--conn_state_ptr->num_lob_buffers];
+    }
+    Tcl_Obj * buff = Tcl_NewObj();
+    Tcl_IncrRefCount(buff);
+    return buff;
+}
+
+/**
+ * Returns the buffer into the connection pool. Buffers that scripts have kept a reference to
+ * cannot be reused and are released.
+ */
+static void
+LobPool_Release (Conn_State * conn_state_ptr, Tcl_Obj * buff)
+{
+    int max_buffers = sizeof(conn_state_ptr->lob_buffers) / sizeof(conn_state_ptr->lob_buffers[0]);
+    if ( !Tcl_IsShared(buff) && conn_state_ptr->num_lob_buffers < max_buffers ) {
+        conn_state_ptr->lob_buffers[conn_state_ptr->num_lob_buffers++] = buff;
+    } else {
+        Tcl_DecrRefCount(buff);
+    }
+}
+
+/**
+ * Sends IN LOB argument data that were provided as a readable channel.
+ */
+static int
+SendDataFromChannel (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int arg_idx, dbcapi_data_type data_type, Tcl_Channel input)
+{
+    int res = TCL_ERROR;
+    Tcl_WideInt lob_sent = stmt_state_ptr->stats.lob_sent;
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    int chunk_size = conn_state_ptr->lob_chunk_size;
+    PROBE3(lob__send__start, stmt_state_ptr, stmt_state_ptr->sql_hash, arg_idx);
+    if ( data_type == A_STRING ) {
+        Tcl_Obj * buff = LobPool_Acquire(conn_state_ptr);
+        int len;
+        do {
+            len = Tcl_ReadChars(input, buff, chunk_size, 0);
+            int byte_len;
+            char * data = Tcl_GetStringFromObj(buff, &byte_len);
+            Tcl_WideInt started = GetMonotonicTime();
+            dbcapi_bool sent = dbcapi.send_param_data(stmt_state_ptr->stmt, arg_idx, data, byte_len);
+            Stats_RecordLob(stmt_state_ptr, started, byte_len, 0, !sent);
+            if ( !sent ) {
+                char num[12];
+                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot send data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
+                LobPool_Release(conn_state_ptr, buff);
+                goto Error_Exit;
+            }
+        } while ( len == chunk_size );
+        LobPool_Release(conn_state_ptr, buff);
+        if ( !dbcapi.finish_param_data(stmt_state_ptr->stmt, arg_idx) ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot finish sending data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
+            goto Error_Exit;
+        }
+    } else if (data_type == A_BINARY ) {
+        Tcl_Obj * buff = LobPool_Acquire(conn_state_ptr);
+        int len;
+        do {
+            len = Tcl_ReadChars(input, buff, chunk_size, 0);
+            int byte_len;
+            unsigned char * data = Tcl_GetByteArrayFromObj(buff, &byte_len);
+            Tcl_WideInt started = GetMonotonicTime();
+            dbcapi_bool sent = dbcapi.send_param_data(stmt_state_ptr->stmt, arg_idx, (char *) data, byte_len);
+            Stats_RecordLob(stmt_state_ptr, started, byte_len, 0, !sent);
+            if ( !sent ) {
+                char num[12];
+                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot send data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
+                LobPool_Release(conn_state_ptr, buff);
+                goto Error_Exit;
+            }
+        } while ( len == chunk_size );
+        LobPool_Release(conn_state_ptr, buff);
+        if ( !dbcapi.finish_param_data(stmt_state_ptr->stmt, arg_idx) ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot finish sending data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
+            goto Error_Exit;
+        }
+    } else {
+        char num[12];
+        Tcl_AppendResult(interp, "DBCAPI reported that LOB parameter [", itoa(arg_idx, num, 10), "] is neither a string, nor it is a binary", NULL);
+        goto Error_Exit;
+    }
+    res = TCL_OK;
+
+Error_Exit:
+    PROBE5(lob__send__done, stmt_state_ptr, stmt_state_ptr->sql_hash, arg_idx, stmt_state_ptr->stats.lob_sent - lob_sent, res);
+    return res;
+}
+
+/**
+ * Sends IN LOB argument data that were provided as a TCL object.
+ */
+static int
+SendDataFromObject (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int arg_idx, dbcapi_data_type data_type, Tcl_Obj * input)
+{
+    int len;
+    char * data;
+
+    if ( data_type == A_STRING ) {
+        data = Tcl_GetStringFromObj(input, &len);
+    } else if (data_type == A_BINARY ) {
+        data = (char *) Tcl_GetByteArrayFromObj(input, &len);
+    } else {
+        char num[12];
+        Tcl_AppendResult(interp, "DBCAPI reported that LOB parameter [", itoa(arg_idx, num, 10), "] is neither a string, nor it is a binary", NULL);
+        return TCL_ERROR;
+    }
+
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool sent = dbcapi.send_param_data(stmt_state_ptr->stmt, arg_idx, data, len);
+    Stats_RecordLob(stmt_state_ptr, started, len, 0, !sent);
+    if ( !sent ) {
+        char num[12];
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot send data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
+        return TCL_ERROR;
+    }
+    if ( !dbcapi.finish_param_data(stmt_state_ptr->stmt, arg_idx) ) {
+        char num[12];
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot finish sending data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Sends IN and INOUT statement LOB arguments to the database.
+ *
+ * \note Data for an IN LOB can be provided as an objects (those are handled elsewhere) or a readable channel (these are handled here).
+ *       Data for INOUT LOBs can be provided (indirectly via a variable) as an object or a read-write channel (IN data will be read
+ *       from that channel and later OUT data will be written to the same channel) or as a list with 2 elements. Element at index 0
+ *       provides data for an IN part of the execution (object, variable or a readable channel) and element at index 0 indicates where
+ *       OUT data should be saved (variable or a writable channel)
+ */
+static int
+SendStmtInput (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int argc, Tcl_Obj * const argv[])
+{
+    for ( int i = 0; i < argc; i++ ) {
+        dbcapi_bind_param_info info;
+        if ( !dbcapi.get_bind_param_info(stmt_state_ptr->stmt, i, &info) ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve information about SQL parameter [", itoa(i, num, 10), "]", NULL);
+            return TCL_ERROR;
+        }
+        if ( info.direction == DD_OUTPUT || info.input_value.buffer_size != 0 ) {
+            continue;
+        }
+
+        if ( info.direction == DD_INPUT ) {
+            // Can only be a channel at this point. It also has been validated during binding.
+            const char * name = Tcl_GetString(argv[i]);
+            Tcl_Channel input = Tcl_GetChannel(interp, name, NULL);
+            if ( SendDataFromChannel(stmt_state_ptr, interp, i, info.input_value.type, input) != TCL_OK ) {
+                return TCL_ERROR;
+            }
+            continue;
+        }
+
+        // DD_INPUT_OUTPUT
+        // This case is a bit complicated as the caller is allowed to specify input and output separately (as a list).
+        int len;
+        if ( Tcl_ListObjLength(interp, argv[i], &len) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        if ( len != 1 && len != 2 ) {
+            SetNumDiffErrorResult(interp, "Argument [", i, "] should have 1 or 2 values in it but ", len, " were found.");
+            return TCL_ERROR;
+        }
+        Tcl_Obj * input;
+        if ( Tcl_ListObjIndex(interp, argv[i], 0, &input) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+
+        if ( len == 1 ) {
+            // This can be either a read-write channel or a variable...
+            const char * name = Tcl_GetString(input);
+            int mode;
+            Tcl_Channel input_channel = Tcl_GetChannel(interp, name, &mode);
+            if ( input_channel != NULL ) {
+                if ( (mode & TCL_READABLE) == 0 || (mode & TCL_WRITABLE) == 0 ) {
+                    Tcl_AppendResult(interp, "Channel ", name, " must be open for reading and writing", NULL);
+                    return TCL_ERROR;
+                }
+                if ( SendDataFromChannel(stmt_state_ptr, interp, i, info.input_value.type, input_channel) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+
+            } else {
+                // A variable then
+                Tcl_ResetResult(interp);
+
+                Tcl_Obj * input_value = Tcl_ObjGetVar2(interp, input, NULL, TCL_LEAVE_ERR_MSG);
+                if ( input_value == NULL ) {
+                    return TCL_ERROR;
+                }
+                if ( SendDataFromObject(stmt_state_ptr, interp, i, info.input_value.type, input_value) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+            }
+        } else {
+            // The first element can be a readable channel or an object
+            // We would rather avoid conversion (in case parameter is for a binary LOB and the "input" is a binary object),
+            // so we'll peek into object to see if what it has might be a channel name.
+            if ( input->bytes != NULL && 0 < input->length && input->length <= 32 ) {
+                const char * name = Tcl_GetString(input);
+                int mode;
+                Tcl_Channel input_channel = Tcl_GetChannel(interp, name, &mode);
+                if ( input_channel != NULL ) {
+                    if ( (mode & TCL_READABLE) == 0 ) {
+                        Tcl_AppendResult(interp, "Channel ", name, " must be open for reading", NULL);
+                        return TCL_ERROR;
+                    }
+                    if ( SendDataFromChannel(stmt_state_ptr, interp, i, info.input_value.type, input_channel) != TCL_OK ) {
+                        return TCL_ERROR;
+                    }
+                    continue;
+                }
+            }
+            // If it is not a channel, then this is an object and we'll send its content
+            if ( SendDataFromObject(stmt_state_ptr, interp, i, info.input_value.type, input) != TCL_OK ) {
+                return TCL_ERROR;
+            }
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * DBCAPI function that reads a piece of LOB data - `get_data` for columns and `get_param_data`
+ * for OUT parameters.
+ */
+typedef dbcapi_i32 (* LobDataReader)( dbcapi_stmt * stmt, dbcapi_u32 index, size_t offset, void * buffer, size_t size );
+
+/**
+ * Reads the next piece of LOB data into the string or byte array object after the first `keep` bytes
+ * of its current data. Returns the number of bytes read or -1 if the read failed.
+ */
+static dbcapi_i32
+ReadLobChunk (LobDataReader read, dbcapi_stmt * stmt, dbcapi_u32 index, size_t offset, dbcapi_data_type data_type, Tcl_Obj * buff, int keep, int chunk_size)
+{
+    char * data;
+    int buff_size;
+    if ( data_type == A_STRING ) {
+        Tcl_SetObjLength(buff, keep + chunk_size);
+        data = Tcl_GetStringFromObj(buff, &buff_size);
+    } else {
+        Tcl_SetByteArrayLength(buff, keep + chunk_size);
+        data = (char *) Tcl_GetByteArrayFromObj(buff, &buff_size);
+    }
+    dbcapi_i32 read_len = read(stmt, index, offset, data + keep, buff_size - keep);
+    if ( read_len >= 0 ) {
+        if ( data_type == A_STRING ) {
+            Tcl_SetObjLength(buff, keep + read_len);
+        } else {
+            Tcl_SetByteArrayLength(buff, keep + read_len);
+        }
+    }
+    return read_len;
+}
+
+/**
+ * Saves LOB data into a writable channel.
+ */
+static int
+SaveDataToChannel (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int arg_idx, dbcapi_data_type data_type, Tcl_Channel output)
+{
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    Tcl_Obj * buff = LobPool_Acquire(conn_state_ptr);
+    size_t offset = 0;
+    int res = TCL_OK;
+    do {
+        Tcl_WideInt started = GetMonotonicTime();
+        int len = ReadLobChunk(dbcapi.get_param_data, stmt_state_ptr->stmt, arg_idx, offset, data_type, buff, 0, conn_state_ptr->lob_chunk_size);
+        Stats_RecordLob(stmt_state_ptr, started, 0, len > 0 ? len : 0, len < 0);
+        if ( len < 0 ) {
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve LOB data from [", arg_idx, "]", NULL);
+            res = TCL_ERROR;
+            break;
+        }
+        if ( len == 0 ) {
+            break;
+        }
+        offset += len;
+
+        if ( Tcl_WriteObj(output, buff) < 0 ) {
+            res = TCL_ERROR;
+        }
+
+    } while ( res == TCL_OK );
+
+    LobPool_Release(conn_state_ptr, buff);
+    return res;
+}
+
+/**
+ * Saves LOB data into a TCL object. This object is expected to be assigned to a variable.
+ */
+static int
+SaveDataToObject (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int arg_idx, dbcapi_data_type data_type, Tcl_Obj * output)
+{
+    size_t offset = 0;
+    int read_len;
+    int res = TCL_OK;
+    Hdbtcl_Memory fetch = { 0 };
+    do {
+        int data_size;
+        if ( data_type == A_STRING ) {
+            Tcl_GetStringFromObj(output, &data_size);
+        } else {
+            Tcl_GetByteArrayFromObj(output, &data_size);
+        }
+        Tcl_WideInt started = GetMonotonicTime();
+        read_len = ReadLobChunk(dbcapi.get_param_data, stmt_state_ptr->stmt, arg_idx, offset, data_type, output, data_size, stmt_state_ptr->conn_state_ptr->lob_chunk_size);
+        Stats_RecordLob(stmt_state_ptr, started, 0, read_len > 0 ? read_len : 0, read_len < 0);
+        if ( read_len < 0 ) {
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve data from parameter [", arg_idx, "]", NULL);
+            res = TCL_ERROR;
+            break;
+        }
+        offset += read_len;
+        res = Memory_Reserve(stmt_state_ptr, interp, &fetch, MEMORY_LOBS, read_len);
+    } while ( read_len > 0 && res == TCL_OK );
+    if ( res == TCL_OK && data_type == A_STRING ) {
+        // pieces may split characters, thus the text is converted when it is complete
+        ConvertStringObjFromUtf8(output);
+    }
+    // the value now belongs to the variable
+    Memory_Release(stmt_state_ptr, &fetch);
+    return res;
+}
+
+/**
+ * Saves data returned for OUT or INOUT bound variables.
+ *
+ * \note OUT LOB data can be saved into a provided variable or into a channel. The latter must be writable.
+ */
+static int
+SaveStmtOutput (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int argc, Tcl_Obj * const argv[], dbcapi_bool is_null[], PrimitiveSqlValue sql_args[])
+{
+    for ( int i = 0; i < argc; i++ ) {
+        dbcapi_bind_param_info info;
+        if ( !dbcapi.get_bind_param_info(stmt_state_ptr->stmt, i, &info) ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve information about SQL argument [", itoa(i, num, 10), "]", NULL);
+            return TCL_ERROR;
+        }
+
+        if ( info.direction == DD_INPUT ) {
+            continue;
+        }
+
+        if ( info.output_value.buffer_size == 0 ) {
+            // An output from a LOB
+
+            Tcl_Obj * output;
+            if ( info.direction == DD_INPUT_OUTPUT ) {
+                // Note that when the input was sent the argument had been converted into a list
+                if ( Tcl_ListObjIndex(interp, argv[i], 1, &output) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+            } else { // DD_OUTPUT
+                output = argv[i];
+            }
+
+            // The argument is either a writable channel or a variable
+            const char * name = Tcl_GetString(output);
+            int mode;
+            Tcl_Channel output_channel = Tcl_GetChannel(interp, name, &mode);
+            if ( output_channel != NULL ) {
+                if ( (mode & TCL_WRITABLE) == 0 ) {
+                    Tcl_AppendResult(interp, "Channel ", name, " must be open for writing", NULL);
+                    return TCL_ERROR;
+                }
+                if ( SaveDataToChannel(stmt_state_ptr, interp, i, info.output_value.type, output_channel) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+            } else {
+                // a variable then
+                Tcl_ResetResult(interp);
+
+                Tcl_Obj * output_value = Tcl_ObjGetVar2(interp, output, NULL, 0);
+                if ( output_value == NULL ) {
+                    output_value = Tcl_ObjSetVar2(interp, output, NULL, Tcl_NewObj(), TCL_LEAVE_ERR_MSG);
+                } else if ( Tcl_IsShared(output_value) ) {
+                    output_value = Tcl_ObjSetVar2(interp, output, NULL, Tcl_DuplicateObj(output_value), TCL_LEAVE_ERR_MSG);
+                }
+                if ( output_value == NULL ) {
+                    return TCL_ERROR;
+                }
+                if ( SaveDataToObject(stmt_state_ptr, interp, i, info.output_value.type, output_value) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+            }
+
+        } else {
+            // Everything else (not a LOB) outputs into an object.
+            // At this time the output has been already completed into the bound buffers.
+
+            Tcl_Obj * output = Tcl_ObjGetVar2(interp, argv[i], NULL, TCL_LEAVE_ERR_MSG);
+            if ( output == NULL ) {
+                return TCL_ERROR;
+            }
+            switch ( info.output_value.type ) {
+                case A_UVAL8:
+                    if ( info.native_type == DT_BOOLEAN ) {
+                        Tcl_SetBooleanObj(output, sql_args[i].int_value);
+                    } else {
+                        Tcl_SetIntObj(output, sql_args[i].int_value);
+                    }
+                    break;
+
+                case A_VAL32: case A_UVAL32: case A_VAL16: case A_UVAL16: case A_VAL8:
+                    Tcl_SetIntObj(output, sql_args[i].int_value);
+                    break;
+
+                case A_VAL64: case A_UVAL64:
+                    Tcl_SetWideIntObj(output, sql_args[i].wideint_value);
+                    break;
+
+                case A_DOUBLE: case A_FLOAT:
+                    Tcl_SetDoubleObj(output, sql_args[i].double_value);
+                    break;
+
+                case A_BINARY:
+                    Tcl_SetByteArrayLength(output, sql_args[i].data_length);
+                    break;
+
+                case A_STRING:
+                    Tcl_SetObjLength(output, sql_args[i].data_length);
+                    ConvertStringObjFromUtf8(output);
+                    break;
+
+                default: {
+                    // A_INVALID_TYPE
+                }
+            }
+        }
+    }
+    return TCL_OK;
+}
+
+static int Async_Execute (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Tcl_Obj * command, int objc, Tcl_Obj * const objv[]);
+
+/**
+ * Checks whether the object is the specified option. Unlike Tcl_GetString this does not generate a string
+ * representation for objects (byte arrays for instance) that do not have it.
+ */
+static bool
+IsOption (Tcl_Obj * obj, const char * option)
+{
+    return obj->bytes != NULL && obj->length > 0 && obj->bytes[0] == '-' && strcmp(obj->bytes, option) == 0;
+}
+
+/**
+ * Binds the arguments and executes the statement in the calling thread.
+ */
+static int
+ExecuteStmt (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    Arena_Mark          mark = Arena_GetMark(&stmt_state_ptr->arena);
+    dbcapi_bool *       is_null = (dbcapi_bool *) Arena_Alloc(&stmt_state_ptr->arena, sizeof(dbcapi_bool) * objc);
+    PrimitiveSqlValue * sql_args = (PrimitiveSqlValue *) Arena_Alloc(&stmt_state_ptr->arena, sizeof(PrimitiveSqlValue) * objc);
+    int                 res = TCL_ERROR;
+    Tcl_WideInt         lob_bytes = stmt_state_ptr->stats.lob_sent + stmt_state_ptr->stats.lob_read;
+    Hdbtcl_Memory       params = { 0 };
+
+    PROBE3(execute__start, stmt_state_ptr, stmt_state_ptr->sql_hash, objc);
+    Stmt_ClearColumnObjs(stmt_state_ptr);
+
+    if ( BindStmtArgs(stmt_state_ptr, interp, objc, objv, is_null, sql_args, &stmt_state_ptr->arena, &params) != TCL_OK ) {
+        goto Error_Exit;
+    }
+
+    Watchdog_Timer timer;
+    if ( !Watchdog_Arm(&timer, stmt_state_ptr->conn_state_ptr->conn, GetStmtTimeout(stmt_state_ptr)) ) {
+        Tcl_SetResult(interp, "cannot start the watchdog thread", TCL_STATIC);
+        goto Error_Exit;
+    }
+    Trace_Start(stmt_state_ptr, objc);
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool executed = dbcapi.execute(stmt_state_ptr->stmt);
+    Hdbtcl_Stats delta = { .executes = 1, .execute_time = GetMonotonicTime() - started, .calls = 1, .errors = !executed };
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta);
+    if ( Watchdog_Disarm(&timer) && !executed ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Statement execution timed out", NULL);
+        Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+        goto Error_Exit;
+    }
+    if ( !executed ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot execute SQL", NULL);
+        Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+        goto Error_Exit;
+    }
+
+    if ( SendStmtInput(stmt_state_ptr, interp, objc, objv) != TCL_OK ) {
+        goto Error_Exit;
+    }
+
+    if ( SaveStmtOutput(stmt_state_ptr, interp, objc, objv, is_null, sql_args) != TCL_OK ) {
+        goto Error_Exit;
+    }
+    Trace_Executed(stmt_state_ptr);
+    res = TCL_OK;
+
+Error_Exit:
+    // OUT values now belong to their variables
+    Memory_Release(stmt_state_ptr, &params);
+    Arena_Release(&stmt_state_ptr->arena, mark);
+    lob_bytes = stmt_state_ptr->stats.lob_sent + stmt_state_ptr->stats.lob_read - lob_bytes;
+    PROBE4(execute__done, stmt_state_ptr, stmt_state_ptr->sql_hash, lob_bytes, res);
+    return res;
+}
+
+/**
+ * Executes a prepared (or previsouly executed and thus prepared) statement.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn prepare "INSERT INTO employees (employee_id, first_name, last_name) VALUES (?, ?, ?)"]
+ * $stmt execute 2 "Hasso" "Plattner"
+ * \endcode
+ *
+ * With `-async -command cmd` the statement is executed by the connection worker thread and `execute`
+ * returns immediately. When the execution completes `cmd` is called from the event loop with 2 extra
+ * arguments - the status (`ok` or `error`) and the error message (empty when the execution succeeded).
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * proc done { status result } {
+ *     # ...
+ * }
+ * $stmt execute -async -command done 2 "Hasso" "Plattner"
+ * \endcode
+ */
+static int
+Stmt_Execute (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc > 0 && IsOption(objv[0], "-async") ) {
+        if ( objc < 3 || !IsOption(objv[1], "-command") ) {
+            Tcl_WrongNumArgs(interp, objc, objv, "execute -async -command cmd ?arg...?");
+            return TCL_ERROR;
+        }
+        return Async_Execute(stmt_state_ptr, interp, objv[2], objc - 3, objv + 3);
+    }
+    return ExecuteStmt(stmt_state_ptr, interp, objc, objv);
+}
+
+#define EXECUTE_BATCH_ROWS 1000    /// number of argument lists executemany sends in one execution
+
+/**
+ * Checks whether arguments of the statement can be bound as arrays. That needs DBCAPI support of array
+ * binding and IN parameters that are not LOBs - LOB arguments might be channels that are streamed and
+ * OUT arguments are variables, thus they are executed one argument list at a time.
+ */
+static bool
+CanBindArrays (Stmt_State * stmt_state_ptr)
+{
+    if ( dbcapi.set_batch_size == NULL || dbcapi.set_param_bind_type == NULL ) {
+        return false;
+    }
+    int num_params = dbcapi.num_params(stmt_state_ptr->stmt);
+    if ( num_params <= 0 ) {
+        return false;
+    }
+    for ( int i = 0; i < num_params; i++ ) {
+        dbcapi_bind_data bind;
+        if (
+            !dbcapi.describe_bind_param(stmt_state_ptr->stmt, i, &bind) ||
+            bind.direction != DD_INPUT ||
+            bind.value.type == A_INVALID_TYPE ||
+            bind.value.buffer_size == INT32_MAX
+        ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Binds the argument lists column-wise - each parameter is bound to an array of values, one value per
+ * argument list. Values of a parameter are converted as `execute` converts them and copied into the
+ * array before the next parameter is converted, as converting the next one might invalidate them.
+ */
+static int
+BindArgArrays (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Tcl_Obj * const row_objs[], int first_row, int num_rows, Stmt_Arena * arena_ptr, Hdbtcl_Memory * memory_ptr)
+{
+    int num_params = dbcapi.num_params(stmt_state_ptr->stmt);
+    if ( num_params < 0 ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot determine the number of statement parameters", NULL);
+        return TCL_ERROR;
+    }
+    Tcl_Obj *** args = (Tcl_Obj ***) Arena_Alloc(arena_ptr, sizeof(Tcl_Obj **) * num_rows);
+    for ( int row = 0; row < num_rows; row++ ) {
+        int num_args;
+        if ( Tcl_ListObjGetElements(interp, row_objs[row], &num_args, &args[row]) != TCL_OK ) {
+            Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf("\n    (executing argument list %d)", first_row + row));
+            return TCL_ERROR;
+        }
+        if ( num_args != num_params ) {
+            SetNumDiffErrorResult(interp, "Expected ", num_params, " arguments but got ", num_args, NULL);
+            Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf("\n    (executing argument list %d)", first_row + row));
+            return TCL_ERROR;
+        }
+    }
+
+    if ( !dbcapi.reset(stmt_state_ptr->stmt) ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot reset statement for execution", NULL);
+        return TCL_ERROR;
+    }
+    if ( !dbcapi.set_param_bind_type(stmt_state_ptr->stmt, 0) || !dbcapi.set_batch_size(stmt_state_ptr->stmt, num_rows) ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot set the number of argument lists of the batch", NULL);
+        return TCL_ERROR;
+    }
+
+    const char ** data = (const char **) Arena_Alloc(arena_ptr, sizeof(char *) * num_rows);
+    for ( int i = 0; i < num_params; i++ ) {
+        dbcapi_bind_data bind;
+        dbcapi_bind_param_info info;
+        if (
+            !dbcapi.describe_bind_param(stmt_state_ptr->stmt, i, &bind) ||
+            !dbcapi.get_bind_param_info(stmt_state_ptr->stmt, i, &info)
+        ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve information about SQL parameter [", itoa(i, num, 10), "]", NULL);
+            return TCL_ERROR;
+        }
+        PrimitiveSqlValue sql_arg;
+        SetBindBuffer(&bind.value, &sql_arg);
+        bool is_primitive = ( bind.value.buffer == (char *) &sql_arg );
+
+        dbcapi_bool * is_null = (dbcapi_bool *) Arena_Alloc(arena_ptr, sizeof(dbcapi_bool) * num_rows);
+        size_t * lengths = (size_t *) Arena_Alloc(arena_ptr, sizeof(size_t) * num_rows);
+        size_t value_size = ( is_primitive ? bind.value.buffer_size : 1 );
+        char * values = NULL;
+        if ( is_primitive ) {
+            values = (char *) Arena_Alloc(arena_ptr, value_size * num_rows);
+        }
+        for ( int row = 0; row < num_rows; row++ ) {
+            Tcl_Obj * arg_val = args[row][i];
+            dbcapi_data_value value = bind.value;
+            is_null[row] = ( arg_val->bytes != NULL && arg_val->length == 0 );
+            if ( LoadBindValue(interp, arg_val, is_null[row], info.native_type, &value, &sql_arg, arena_ptr) != TCL_OK ) {
+                Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf("\n    (executing argument list %d)", first_row + row));
+                return TCL_ERROR;
+            }
+            if ( is_primitive ) {
+                memcpy(values + row * value_size, &sql_arg, value_size);
+                lengths[row] = value_size;
+            } else {
+                data[row] = value.buffer;
+                lengths[row] = sql_arg.data_length;
+                if ( lengths[row] > value_size ) {
+                    value_size = lengths[row];
+                }
+            }
+        }
+        if ( !is_primitive ) {
+            // strings and binaries are copied into slots that fit the longest of them
+            values = (char *) Arena_Alloc(arena_ptr, value_size * num_rows);
+            for ( int row = 0; row < num_rows; row++ ) {
+                memcpy(values + row * value_size, data[row], lengths[row]);
+            }
+        }
+        if ( Memory_Reserve(stmt_state_ptr, interp, memory_ptr, MEMORY_PARAMS, ( value_size + sizeof(size_t) + sizeof(dbcapi_bool) ) * num_rows) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        bind.value.buffer = values;
+        bind.value.buffer_size = value_size;
+        bind.value.length = lengths;
+        bind.value.is_null = is_null;
+        BIND_PARAM(stmt_state_ptr, interp, i, &bind);
+    }
+    return TCL_OK;
+}
+
+/**
+ * Binds the argument lists as arrays and executes the statement once for all of them. Adds the number
+ * of rows the execution affected to `*affected_rows_ptr`.
+ */
+static int
+ExecuteBatch (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Tcl_Obj * const row_objs[], int first_row, int num_rows, Tcl_WideInt * affected_rows_ptr)
+{
+    Arena_Mark          mark = Arena_GetMark(&stmt_state_ptr->arena);
+    int                 res = TCL_ERROR;
+    Hdbtcl_Memory       params = { 0 };
+
+    PROBE3(execute__start, stmt_state_ptr, stmt_state_ptr->sql_hash, num_rows);
+    Stmt_ClearColumnObjs(stmt_state_ptr);
+
+    if ( BindArgArrays(stmt_state_ptr, interp, row_objs, first_row, num_rows, &stmt_state_ptr->arena, &params) != TCL_OK ) {
+        goto Error_Exit;
+    }
+
+    Watchdog_Timer timer;
+    if ( !Watchdog_Arm(&timer, stmt_state_ptr->conn_state_ptr->conn, GetStmtTimeout(stmt_state_ptr)) ) {
+        Tcl_SetResult(interp, "cannot start the watchdog thread", TCL_STATIC);
+        goto Error_Exit;
+    }
+    Trace_Start(stmt_state_ptr, dbcapi.num_params(stmt_state_ptr->stmt));
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool executed = dbcapi.execute(stmt_state_ptr->stmt);
+    Hdbtcl_Stats delta = { .executes = 1, .execute_time = GetMonotonicTime() - started, .calls = 1, .errors = !executed };
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta);
+    if ( Watchdog_Disarm(&timer) && !executed ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Statement execution timed out", NULL);
+        Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+        goto Batch_Error;
+    }
+    if ( !executed ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot execute SQL", NULL);
+        Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+        goto Batch_Error;
+    }
+    if ( dbcapi.num_cols(stmt_state_ptr->stmt) == 0 ) {
+        int num_affected = dbcapi.affected_rows(stmt_state_ptr->stmt);
+        if ( num_affected > 0 ) {
+            *affected_rows_ptr += num_affected;
+        }
+    }
+    Trace_Executed(stmt_state_ptr);
+    res = TCL_OK;
+    goto Error_Exit;
+
+Batch_Error:
+    Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf("\n    (executing argument lists %d to %d)", first_row, first_row + num_rows - 1));
+
+Error_Exit:
+    Memory_Release(stmt_state_ptr, &params);
+    Arena_Release(&stmt_state_ptr->arena, mark);
+    PROBE4(execute__done, stmt_state_ptr, stmt_state_ptr->sql_hash, 0, res);
+    return res;
+}
+
+/**
+ * Executes a prepared statement for each list of arguments. Returns the total number of affected rows.
+ *
+ * Argument lists are bound as arrays and sent to the server in batches of up to 1000 lists, each
+ * batch is a single execution. Statements with LOB or OUT parameters are executed once for each list
+ * (as they are by `execute`). Execution stops at the first failing batch or list. When a batch fails,
+ * the error info tells which lists it had, and the lists of the failed batch that have already been
+ * executed stay executed (unless the transaction is rolled back).
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn prepare "INSERT INTO documents (id, embedding) VALUES (?, ?)"]
+ * $stmt executemany [list [list 1 {0.25 0.5 0.75}] [list 2 [binary format f* {1.0 1.5 2.0}]]]
+ * \endcode
+ */
+static int
+Stmt_ExecuteMany (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 1 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "executemany args_list");
+        return TCL_ERROR;
+    }
+    int num_rows;
+    Tcl_Obj ** row_objs;
+    if ( Tcl_ListObjGetElements(interp, objv[0], &num_rows, &row_objs) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    // output arguments might change the list while it is being executed
+    Tcl_Obj * rows = objv[0];
+    Tcl_IncrRefCount(rows);
+    Tcl_WideInt affected_rows = 0;
+    int res = TCL_OK;
+    if ( num_rows > 1 && CanBindArrays(stmt_state_ptr) ) {
+        for ( int row = 0; row < num_rows && res == TCL_OK; row += EXECUTE_BATCH_ROWS ) {
+            int batch_rows = ( num_rows - row < EXECUTE_BATCH_ROWS ? num_rows - row : EXECUTE_BATCH_ROWS );
+            res = ExecuteBatch(stmt_state_ptr, interp, row_objs + row, row, batch_rows, &affected_rows);
+        }
+        // `execute` binds single values
+        dbcapi.set_batch_size(stmt_state_ptr->stmt, 1);
+    } else {
+        for ( int row = 0; row < num_rows && res == TCL_OK; ++row ) {
+            int num_args;
+            Tcl_Obj ** arg_objs;
+            Tcl_Obj * row_obj = row_objs[row];
+            Tcl_IncrRefCount(row_obj);
+            res = Tcl_ListObjGetElements(interp, row_obj, &num_args, &arg_objs);
+            if ( res == TCL_OK ) {
+                res = ExecuteStmt(stmt_state_ptr, interp, num_args, arg_objs);
+            }
+            if ( res == TCL_OK && dbcapi.num_cols(stmt_state_ptr->stmt) == 0 ) {
+                int num_affected = dbcapi.affected_rows(stmt_state_ptr->stmt);
+                if ( num_affected > 0 ) {
+                    affected_rows += num_affected;
+                }
+            }
+            if ( res != TCL_OK ) {
+                Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf("\n    (executing argument list %d)", row));
+            }
+            Tcl_DecrRefCount(row_obj);
+        }
+    }
+    Tcl_DecrRefCount(rows);
+    if ( res == TCL_OK ) {
+        Tcl_SetObjResult(interp, Tcl_NewWideIntObj(affected_rows));
+    }
+    return res;
+}
+
+/**
+ * Sets TCL (integer) result or TCL error depending on the value returned by a DBCAPI function.
+ */
+static int
+StmtSetIntResult (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int result)
+{
+    if ( result < 0 ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve requested number", NULL);
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(result));
+    return TCL_OK;
+}
+
+/**
+ * Returns information about a column in the result set.
+ *
+ * The column info is returned as a dictionary with the following keys:
+ *  - `owner`     - The name of the owner
+ *  - `table`     - The name of the table
+ *  - `name`      - The alias or the name of the column
+ *  - `type`      - The native type of the column in the database
+ *  - `size`      - The maximum size a data value in this column can take
+ *  - `nullable`  - Indicates whether a value in the column can be null
+ *  - `precision` - The precision
+ *  - `scale`     - The scale
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set col_num 0
+ * set col_info [$stmt get -columninfo $col_num]
+ * \endcode
+ */
+static int
+Stmt_ColumnInfo (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 1 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "get -columninfo column_number");
+        return TCL_ERROR;
+    }
+
+    int col_num;
+    if ( Tcl_GetIntFromObj(interp, objv[0], &col_num) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+
+    dbcapi_column_info info;
+    if ( !dbcapi.get_column_info(stmt_state_ptr->stmt, col_num, &info) ) {
+        char num[12];
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col_num, num, 10), "] info", NULL);
+        return TCL_ERROR;
+    }
+
+    Hdbtcl_Literals * lit = &stmt_state_ptr->conn_state_ptr->hdbtcl_state_ptr->literals;
+
+    Tcl_Obj * res = Tcl_NewDictObj();
+    if ( Tcl_DictObjPut(interp, res, lit->owner, Tcl_NewStringObj(info.owner_name, -1)) != TCL_OK ) {
+        goto Error_Exit;
+    }
+    if ( Tcl_DictObjPut(interp, res, lit->table, Tcl_NewStringObj(info.table_name, -1)) != TCL_OK ) {
+        goto Error_Exit;
+    }
+    if ( Tcl_DictObjPut(interp, res, lit->name, Tcl_NewStringObj(info.column_name, -1)) != TCL_OK ) {
+        goto Error_Exit;
+    }
+    if ( Tcl_DictObjPut(interp, res, lit->type, GetTypeName(lit, info.native_type)) != TCL_OK ) {
+        goto Error_Exit;
+    }
+    Tcl_Obj * value = (info.max_size <= INT_MAX ? Tcl_NewIntObj(info.max_size) : Tcl_NewWideIntObj(info.max_size) );
+    if ( Tcl_DictObjPut(interp, res, lit->size, value) != TCL_OK ) {
+        goto Error_Exit;
+    }
+    if ( Tcl_DictObjPut(interp, res, lit->nullable, Tcl_NewBooleanObj(info.nullable)) != TCL_OK ) {
+        goto Error_Exit;
+    }
+    if ( Tcl_DictObjPut(interp, res, lit->precision, Tcl_NewIntObj(info.precision)) != TCL_OK ) {
+        goto Error_Exit;
+    }
+    if ( Tcl_DictObjPut(interp, res, lit->scale, Tcl_NewIntObj(info.scale)) != TCL_OK ) {
+        goto Error_Exit;
+    }
+
+    Tcl_SetObjResult(interp, res);
+    return TCL_OK;
+
+Error_Exit:
+    Tcl_DecrRefCount(res);
+    return TCL_ERROR;
+}
+
+/**
+ * Retrieves statement column names.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn execute "SELECT * FROM objects WHERE schema_name = ?" "SYS"]
+ * set column_names [$stmt get -columnnames]
+ * while { [$stmt fetch row] } {
+ *     foreach name $column_names value $row {
+ *         puts [format "%20s: %s" $name $value]
+ *     }
+ * }
+ * \endcode
+ */
+static int
+Stmt_ColumnNames (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc > 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "get -columnnames");
+        return TCL_ERROR;
+    }
+
+    int num_cols = dbcapi.num_cols(stmt_state_ptr->stmt);
+    Tcl_Obj * names = Tcl_NewListObj(0, NULL);
+    for ( int col = 0; col < num_cols; ++col ) {
+        dbcapi_column_info info;
+        if ( !dbcapi.get_column_info(stmt_state_ptr->stmt, col, &info) ) {
+            char num[12];
+            Tcl_DecrRefCount(names);
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] info", NULL);
+            return TCL_ERROR;
+        }
+        Tcl_ListObjAppendElement(NULL, names, Tcl_NewStringObj(info.column_name, -1));
+    }
+
+    Tcl_SetObjResult(interp, names);
+    return TCL_OK;
+}
+
+/**
+ * Retrieve a print line printed during execution of a stored procedure.
+ *
+ * The initial call after execution of the stored procedure will retrieve the first line printed.
+ * If the print line is successfully retrieved, it is removed from the queue and subsequent calls
+ * will retrieve following print lines (if available).
+ *
+ * # Example
+ *
+ * \code{.sql}
+ * CREATE PROCEDURE TEST_PROC AS
+ * BEGIN
+ *     USING SQLSCRIPT_PRINT AS PRINT;
+ *     SELECT 1 FROM DUMMY;
+ *     PRINT:PRINT_LINE('Hello, World!');
+ *     SELECT 2 FROM DUMMY;
+ *     PRINT:PRINT_LINE('Hello World, Again!');
+ * END
+ * \endcode
+ *
+ * \code{.tcl}
+ * set stmt [$conn prepare "CALL test_proc"]
+ * $stmt execute
+ * while { [$stmt get -printline line] } {
+ *     puts $line
+ * }
+ * \endcode
+ *
+ */
+static int
+StmtGetPrintLine (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 1 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "get -printline varname");
+        return TCL_ERROR;
+    }
+    Tcl_Obj * line = Tcl_NewObj();
+    int len;
+    char * buffer = Tcl_GetStringFromObj(line, &len);
+
+    bool zero_terminate_line = false;
+    int host_type = 4; // SQLDBC_HOSTTYPE_UTF8
+    size_t text_size;
+    dbcapi_retcode res = dbcapi.get_print_line(stmt_state_ptr->stmt, host_type, buffer, &text_size, len, zero_terminate_line);
+    if ( res == DBCAPI_NO_DATA_FOUND ) {
+        Tcl_SetObjResult(interp, Tcl_NewBooleanObj(0));
+
+    } else {
+        if ( res == DBCAPI_DATA_TRUNC ) {
+            Tcl_SetObjLength(line, text_size);
+            buffer = Tcl_GetStringFromObj(line, &len);
+            res = dbcapi.get_print_line(stmt_state_ptr->stmt, host_type, buffer, &text_size, len, zero_terminate_line);
+            Tcl_SetObjLength(line, text_size);
+        }
+        if ( Tcl_ObjSetVar2(interp, objv[0], NULL, line, TCL_LEAVE_ERR_MSG) != NULL ) {
+            Tcl_SetObjResult(interp, Tcl_NewBooleanObj(1));
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Statement "get" subcommand options multiplexor.
+ */
+static int
+Stmt_Get (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 1 || 2 < objc ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "get -option ?attr?");
+        return TCL_ERROR;
+    }
+
+    static const char * const options[] = {
+        "-colinfo", "-columninfo", "-colnames", "-columnnames", "-numaffectedrows", "-numcols", "-numcolumns", "-numrows", "-printline", NULL
+    };
+    enum {
+        COL_INFO, COLUMN_INFO, COL_NAMES, COLUMN_NAMES, NUM_AFFECTED_ROWS, NUM_COLS, NUM_COLUMNS, NUM_ROWS, PRINT_LINE
+    } option;
+
+    if ( Tcl_GetIndexFromObj(interp, objv[0], options, "option", 0, (int *) &option) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    switch ( option ) {
+        case COLUMN_INFO: case COL_INFO:
+            return Stmt_ColumnInfo  (stmt_state_ptr, interp, objc - 1, objv + 1);
+        case COLUMN_NAMES: case COL_NAMES:
+            return Stmt_ColumnNames (stmt_state_ptr, interp, objc - 1, objv + 1);
+        case NUM_AFFECTED_ROWS:
+            return StmtSetIntResult(stmt_state_ptr, interp, dbcapi.affected_rows(stmt_state_ptr->stmt));
+        case NUM_COLS: case NUM_COLUMNS:
+            return StmtSetIntResult(stmt_state_ptr, interp, dbcapi.num_cols(stmt_state_ptr->stmt));
+        case NUM_ROWS:
+            return StmtSetIntResult(stmt_state_ptr, interp, dbcapi.num_rows(stmt_state_ptr->stmt));
+        case PRINT_LINE:
+            return StmtGetPrintLine(stmt_state_ptr, interp, objc - 1, objv + 1);
+    }
+    return TCL_OK;
+}
+
+/**
+ * Fetches LOB data piece by piece and feeds pieces to the "LOB read command". Pieces of binary
+ * LOBs are encoded into the specified format.
+ */
+static int
+FetchLobColumn (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, dbcapi_column_info info[], int num_cols, int col, Tcl_Obj * lob_read_cmd, Tcl_Obj * lob_read_init_state, Binary_Format binary_format)
+{
+    int res = TCL_OK;
+    if ( lob_read_init_state == NULL ) {
+        lob_read_init_state = Tcl_NewObj();
+    }
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    Column_Objs * col_objs = Stmt_GetColumnObjs(stmt_state_ptr, info, num_cols, col);
+    // cmd $cmd_data $lob_data $col_num $col_name $table_name $table_owner
+    Tcl_Obj * lob_read_objv[7];
+    Tcl_Obj * buff = LobPool_Acquire(conn_state_ptr);
+    lob_read_objv[0] = lob_read_cmd;
+    lob_read_objv[1] = lob_read_init_state;
+    lob_read_objv[2] = buff;
+    lob_read_objv[3] = col_objs->num;
+    lob_read_objv[4] = col_objs->name;
+    lob_read_objv[5] = col_objs->table;
+    lob_read_objv[6] = col_objs->owner;
+    for ( int i = 0; i < 7; ++i ) {
+        if ( i != 2 ) {
+            Tcl_IncrRefCount(lob_read_objv[i]);
+        }
+    }
+    bool encode = ( ( binary_format == BINARY_AS_HEX || binary_format == BINARY_AS_BASE64 ) && info[col].type == A_BINARY );
+    int chunk_size = conn_state_ptr->lob_chunk_size;
+    if ( encode && binary_format == BINARY_AS_BASE64 ) {
+        // pieces are encoded separately, so all but the last one must not need padding
+        chunk_size = ( chunk_size < 3 ? 3 : chunk_size - chunk_size % 3 );
+    }
+    int read_len;
+    size_t offset = 0;
+    PROBE3(lob__read__start, stmt_state_ptr, stmt_state_ptr->sql_hash, col);
+    do {
+        if ( Tcl_IsShared(buff) ) {
+            // the command has kept the previous chunk
+            Tcl_DecrRefCount(buff);
+            buff = LobPool_Acquire(conn_state_ptr);
+        }
+        Tcl_WideInt started = GetMonotonicTime();
+        read_len = ReadLobChunk(dbcapi.get_data, stmt_state_ptr->stmt, col, offset, info[col].type, buff, 0, chunk_size);
+        Stats_RecordLob(stmt_state_ptr, started, 0, read_len > 0 ? read_len : 0, read_len < 0);
+        if ( read_len < 0 ) {
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve data from LOB column ", Tcl_GetString(col_objs->name), NULL);
+            res = TCL_ERROR;
+            break;
+        }
+        offset += read_len;
+
+        if ( encode ) {
+            // the piece is read into the pooled buffer and encoded into a new text object
+            lob_read_objv[2] = Tcl_NewObj();
+            Tcl_IncrRefCount(lob_read_objv[2]);
+            SetBinaryObj(lob_read_objv[2], Tcl_GetByteArrayFromObj(buff, NULL), read_len, binary_format);
+        } else {
+            lob_read_objv[2] = buff;
+        }
+        res = Tcl_EvalObjv(interp, 7, lob_read_objv, 0);
+        if ( encode ) {
+            Tcl_DecrRefCount(lob_read_objv[2]);
+        }
+        if ( res != TCL_OK ) {
+            break;
+        }
+        // tranfer returned result into cmd_data
+        Tcl_DecrRefCount(lob_read_objv[1]);
+        lob_read_objv[1] = Tcl_GetObjResult(interp);
+        Tcl_IncrRefCount(lob_read_objv[1]);
+
+    } while ( read_len > 0 );
+    PROBE5(lob__read__done, stmt_state_ptr, stmt_state_ptr->sql_hash, col, offset, res);
+
+    LobPool_Release(conn_state_ptr, buff);
+    for ( int i = 0; i < 7; ++i ) {
+        if ( i != 2 ) {
+            Tcl_DecrRefCount(lob_read_objv[i]);
+        }
+    }
+    return res;
+}
+
+/**
+ * Returns the size of the column value data.
+ */
+static size_t
+GetValueSize (dbcapi_data_value * value)
+{
+    switch ( value->type ) {
+        case A_VAL8:   case A_UVAL8:    return 1;
+        case A_VAL16:  case A_UVAL16:   return 2;
+        case A_VAL32:  case A_UVAL32:   return 4;
+        case A_VAL64:  case A_UVAL64:   return 8;
+        case A_DOUBLE:                  return sizeof(double);
+        case A_FLOAT:                   return sizeof(float);
+        case A_BINARY: case A_STRING:   return *value->length;
+        default:                        return 0;
+    }
+}
+
+/**
+ * Creates a TCL object for the column value retrieved from the current row of the result set.
+ * Binary values are returned in the specified format.
+ */
+static Tcl_Obj *
+NewColumnValueObj (dbcapi_data_value * value, dbcapi_native_type native_type, Binary_Format binary_format)
+{
+    Tcl_Obj * col_val = Tcl_NewObj();
+    if ( !*value->is_null ) {
+        switch ( value->type ) {
+            case A_UVAL8:
+                if ( native_type == DT_BOOLEAN ) {
+                    Tcl_SetBooleanObj(col_val, *(uint8_t *)value->buffer);
+                } else {
+                    Tcl_SetIntObj(col_val, *(uint8_t *)value->buffer);
+                }
+                break;
+            case A_VAL8:
+                Tcl_SetIntObj(col_val, *(int8_t *)value->buffer);
+                break;
+            case A_UVAL16:
+                Tcl_SetIntObj(col_val, *(uint16_t *)value->buffer);
+                break;
+            case A_VAL16:
+                Tcl_SetIntObj(col_val, *(int16_t *)value->buffer);
+                break;
+            case A_UVAL32:
+                Tcl_SetIntObj(col_val, *(uint32_t *)value->buffer);
+            case A_VAL32:
+                Tcl_SetIntObj(col_val, *(int32_t *)value->buffer);
+                break;
+            case A_UVAL64:
+                Tcl_SetWideIntObj(col_val, *(uint64_t *)value->buffer);
+                break;
+            case A_VAL64:
+                Tcl_SetWideIntObj(col_val, *(int64_t *)value->buffer);
+                break;
+            case A_DOUBLE:
+                Tcl_SetDoubleObj(col_val, *(double *)value->buffer);
+                break;
+            case A_FLOAT:
+                Tcl_SetDoubleObj(col_val, (double)*(float *)value->buffer);
+                break;
+            case A_BINARY:
+                if ( native_type == NATIVE_TYPE_REAL_VECTOR ) {
+                    SetVectorObj(col_val, (unsigned char*) value->buffer, *value->length, binary_format);
+                } else {
+                    SetBinaryObj(col_val, (unsigned char*) value->buffer, *value->length, binary_format);
+                }
+                break;
+            case A_STRING:
+                SetStringObjFromUtf8(col_val, value->buffer, *value->length);
+                break;
+            default: {
+                // A_INVALID_TYPE
+            }
+        }
+    }
+    return col_val;
+}
+
+/**
+ * Returns the number of columns in the current result set. Returns -1 and sets the error result
+ * if the statement did not return a result set.
+ */
+static int
+GetResultNumCols (Stmt_State * stmt_state_ptr, Tcl_Interp * interp)
+{
+    int num_cols = dbcapi.num_cols(stmt_state_ptr->stmt);
+    if ( num_cols < 0 ) {
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve result set info (column count)", NULL);
+        return -1;
+    }
+    if ( num_cols == 0 ) {
+        Tcl_AppendResult(interp, "This statement did not return any rows", NULL);
+        return -1;
+    }
+    return num_cols;
+}
+
+/**
+ * Retrieves information about all columns of the current result set.
+ */
+static int
+GetResultColumnsInfo (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int num_cols, dbcapi_column_info info[])
+{
+    for ( int col = 0; col < num_cols; ++col ) {
+        if ( !dbcapi.get_column_info(stmt_state_ptr->stmt, col, &info[col]) ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] info", NULL);
+            return TCL_ERROR;
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Appends column values of the current (fetched) row to the row list. Adds the size of the converted
+ * values to the `bytes` counter. Binary values are returned in the column formats, which might be
+ * NULL when all of them are returned as byte arrays.
+ */
+static int
+GetRowValues (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, dbcapi_column_info info[], int num_cols, Tcl_Obj * row, Tcl_Obj * lob_read_cmd, Tcl_Obj * lob_read_init_state, const unsigned char * binary_formats, Hdbtcl_Stats * stats_ptr, Hdbtcl_Memory * fetch_ptr)
+{
+    if ( Memory_Reserve(stmt_state_ptr, interp, fetch_ptr, MEMORY_ROWS, sizeof(Tcl_Obj) + sizeof(Tcl_Obj *) * ( num_cols + 4 )) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    for ( int col = 0; col < num_cols; ++col ) {
+        Tcl_Obj * col_val;
+        size_t value_size = 0;
+        Binary_Format binary_format = ( binary_formats != NULL ? binary_formats[col] : BINARY_AS_BYTES );
+        if ( info[col].max_size == INT32_MAX && lob_read_cmd != NULL ) {
+            if ( FetchLobColumn(stmt_state_ptr, interp, info, num_cols, col, lob_read_cmd, lob_read_init_state, binary_format) != TCL_OK ) {
+                return TCL_ERROR;
+            }
+            col_val = Tcl_GetObjResult(interp);
+        } else {
+            dbcapi_data_value value;
+            if ( !dbcapi.get_column(stmt_state_ptr->stmt, col, &value) ) {
+                char num[12];
+                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] data", NULL);
+                return TCL_ERROR;
+            }
+            col_val = NewColumnValueObj(&value, info[col].native_type, binary_format);
+            if ( !*value.is_null ) {
+                value_size = GetValueSize(&value);
+                stats_ptr->bytes += value_size;
+                if ( value.type == A_BINARY ) {
+                    value_size = Binary_EncodedLength(value_size, binary_format);
+                }
+            }
+        }
+        if ( Tcl_ListObjAppendElement(interp, row, col_val) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        int kind = ( info[col].max_size == INT32_MAX ? MEMORY_LOBS : MEMORY_ROWS );
+        if ( Memory_Reserve(stmt_state_ptr, interp, fetch_ptr, kind, sizeof(Tcl_Obj) + value_size) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Fetches the next row from the result set and saves it into the specified variable.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * while { [$stmt fetch row] } {
+ *     # row is a list of column values
+ * }
+ * \endcode
+ *
+ * If one of the columns is a LOB, fetch will try, memory permitting, to fetch the entire
+ * LOB into a string or a binary, depending on the column type. While this works for
+ * some use cases, it might not be feasible for very large LOBs. Large LOBs can be fetched
+ * piece by piece via custom LOB read callbacks:
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * proc read_lob { read_state lob_chunk col_num col_name table_name table_owner } {
+ *     # Where:
+ *     #   read_state  - current reading state. Can be anything. Initial value is {}.
+ *     #   lob_chunk   - current piece of LOB data. It'll be a string or a binary depending
+ *     #                 on the LOB type.
+ *     #   col_num     - LOB column number in the result set row.
+ *     #   col_name    - LOB column name
+ *     #   table_name  - table name from which LOB is retrieved.
+ *     #   table_owner - LOB table schema.
+ *
+ *     # This procedure returns modified state to be passed to the call
+ *     # that reads the next LOB piece.
+ *     return $read_state
+ * }
+ *
+ * while { [$stmt fetch row -lobreadcommand read_lob] } {
+ *     # non LOB columns will be retrieved by fetch
+ *     # LOB columns in the returned row will contain the final "read state"
+ * }
+ * \endcode
+ *
+ * While the default initial read state is {} it can be set to a different value via
+ * -lobreadinitialstate.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set name_prefix "temp_lob_file"
+ * while { [$stmt fetch row -lobreadcommand read_lob_info_file -lobreadinitialstate $name_prefix] } {
+ *     # process columns from the row
+ * }
+ * \endcode
+ *
+ * Binary values (and pieces of binary LOBs passed to the LOB read command) are byte arrays.
+ * `-binaryas` returns them as text instead - `hex` or `base64` - encoded directly from the
+ * fetched data. The option value is either the format of all binary columns or a list with
+ * a format for each column. REAL_VECTOR values are packed floats, `list` returns them as lists
+ * of doubles.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn execute "SELECT id, name, photo FROM employees"]
+ * while { [$stmt fetch row -binaryas base64] } {
+ *     lassign $row id name photo_base64
+ * }
+ * \endcode
+ */
+static int
+Stmt_Fetch (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 1 || objc % 2 == 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "fetch row_var ?-lobreadcommand cmd_name ?-lobreadinitialstate init_state?? ?-binaryas format?");
+        return TCL_ERROR;
+    }
+    Tcl_Obj * lob_read_cmd = NULL;
+    Tcl_Obj * lob_read_init_state = NULL;
+    Tcl_Obj * binary_as = NULL;
+    if ( objc >= 3 ) {
+        static const char * const options[] = { "-binaryas", "-lobreadcmd", "-lobreadcommand", "-lobreadinit", "-lobreadinitialstate", NULL };
+        enum { BINARYAS, LOBREADCMD, LOBREADCOMMAND, LOBREADINIT, LOBREADINITIALSTATE } option;
+        for ( int i = 1; i < objc; i+=2 ) {
+            if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+                return TCL_ERROR;
+            }
+            switch ( option ) {
+                case LOBREADCMD: case LOBREADCOMMAND: {
+                    lob_read_cmd = objv[i+1];
+                    if ( Tcl_GetCommandFromObj(interp, lob_read_cmd) == NULL ) {
+                        const char * cmd_name = Tcl_GetString(lob_read_cmd);
+                        Tcl_AppendResult(interp, "command ", cmd_name, " does not exist", NULL);
+                        return TCL_ERROR;
+                    }
+                    break;
+                }
+                case LOBREADINIT: case LOBREADINITIALSTATE: {
+                    lob_read_init_state = objv[i+1];
+                    break;
+                }
+                case BINARYAS: {
+                    binary_as = objv[i+1];
+                    break;
+                }
+            }
+        }
+    }
+
+    int num_cols = GetResultNumCols(stmt_state_ptr, interp);
+    if ( num_cols < 0 ) {
+        return TCL_ERROR;
+    }
+    Arena_Mark mark = Arena_GetMark(&stmt_state_ptr->arena);
+    dbcapi_column_info * info = (dbcapi_column_info *) Arena_Alloc(&stmt_state_ptr->arena, sizeof(dbcapi_column_info) * num_cols);
+    if ( GetResultColumnsInfo(stmt_state_ptr, interp, num_cols, info) != TCL_OK ) {
+        Arena_Release(&stmt_state_ptr->arena, mark);
+        return TCL_ERROR;
+    }
+    unsigned char * binary_formats = NULL;
+    if ( binary_as != NULL ) {
+        binary_formats = (unsigned char *) Arena_Alloc(&stmt_state_ptr->arena, num_cols);
+        if ( GetBinaryFormatsFromObj(interp, binary_as, num_cols, binary_formats) != TCL_OK ) {
+            Arena_Release(&stmt_state_ptr->arena, mark);
+            return TCL_ERROR;
+        }
+    }
+
+    Tcl_Obj * row = Tcl_ObjSetVar2(interp, objv[0], NULL, Tcl_NewListObj(0, NULL), TCL_LEAVE_ERR_MSG);
+    if ( row == NULL ) {
+        Arena_Release(&stmt_state_ptr->arena, mark);
+        return TCL_ERROR;
+    }
+
+    PROBE2(fetch__start, stmt_state_ptr, stmt_state_ptr->sql_hash);
+    Hdbtcl_Stats delta = { .fetches = 1, .calls = 1 };
+    Hdbtcl_Memory fetch = { 0 };
+    Tcl_WideInt started = GetMonotonicTime();
+    int fetched = dbcapi.fetch_next(stmt_state_ptr->stmt);
+    Tcl_WideInt converting = GetMonotonicTime();
+    delta.fetch_time = converting - started;
+    int res = TCL_OK;
+    if ( fetched ) {
+        delta.rows = 1;
+        // LOBs that are read while the row is converted are accounted separately
+        Tcl_WideInt lob_time = stmt_state_ptr->stats.lob_time;
+        res = GetRowValues(stmt_state_ptr, interp, info, num_cols, row, lob_read_cmd, lob_read_init_state, binary_formats, &delta, &fetch);
+        delta.convert_time = GetMonotonicTime() - converting - ( stmt_state_ptr->stats.lob_time - lob_time );
+    } else if ( FetchFailed(stmt_state_ptr->conn_state_ptr->conn) ) {
+        ++delta.errors;
+        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot fetch rows", NULL);
+        Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+        res = TCL_ERROR;
+    }
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta);
+    // the row now belongs to the variable
+    Memory_Release(stmt_state_ptr, &fetch);
+    Arena_Release(&stmt_state_ptr->arena, mark);
+    PROBE5(fetch__done, stmt_state_ptr, stmt_state_ptr->sql_hash, delta.rows, delta.bytes, res);
+    if ( res != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( !fetched ) {
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(fetched));
+    return TCL_OK;
+}
+
+static int Async_FetchMany (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Tcl_Obj * command, int max_rows, Tcl_Obj * binary_as);
+static int Convert_GetNumParts (int num_rows, int num_cols);
+static int FetchRowsetRows (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, dbcapi_column_info info[], int num_cols, int max_rows, const unsigned char * binary_formats, Hdbtcl_Stats * stats_ptr, Hdbtcl_Memory * fetch_ptr, bool * at_end_ptr, Tcl_Obj * * rows_ptr);
+
+/**
+ * Fetches up to the specified number of rows from the result set. Returns a list of fetched rows.
+ * The returned list is empty when the result set has no more rows.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * while { [llength [set rows [$stmt fetchmany 1000]]] > 0 } {
+ *     foreach row $rows {
+ *         # row is a list of column values
+ *     }
+ * }
+ * \endcode
+ *
+ * With `-async` rows are fetched by the connection worker thread and `fetchmany` returns immediately.
+ * When the rows are fetched `cmd` is called from the event loop with 2 extra arguments - the status
+ * (`ok` or `error`) and the list of fetched rows (or the error message).
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * proc process_rows { status rows } {
+ *     # ...
+ * }
+ * $stmt fetchmany -async 1000 -command process_rows
+ * \endcode
+ *
+ * Like `fetch`, `fetchmany` accepts `-binaryas` to return binary values as `hex` or `base64` text.
+ *
+ * \note LOBs are fetched entirely into the column values.
+ */
+static int
+Stmt_FetchMany (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    bool is_async = ( objc > 0 && IsOption(objv[0], "-async") );
+    int num_args = ( is_async ? 2 : 1 );
+    if ( objc < num_args || ( objc - num_args ) % 2 != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "fetchmany ?-async? max_rows ?-command cmd? ?-binaryas format?");
+        return TCL_ERROR;
+    }
+    Tcl_Obj * command = NULL;
+    Tcl_Obj * binary_as = NULL;
+    static const char * const options[] = { "-binaryas", "-command", NULL };
+    enum { BINARYAS, COMMAND } option;
+    for ( int i = num_args; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        if ( option == BINARYAS ) {
+            binary_as = objv[i + 1];
+        } else {
+            command = objv[i + 1];
+        }
+    }
+    if ( is_async != ( command != NULL ) ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "fetchmany -async max_rows -command cmd ?-binaryas format?");
+        return TCL_ERROR;
+    }
+
+    int max_rows;
+    if ( Tcl_GetIntFromObj(interp, objv[is_async ? 1 : 0], &max_rows) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( max_rows <= 0 ) {
+        Tcl_SetResult(interp, "the number of rows to fetch must be positive", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    if ( is_async ) {
+        return Async_FetchMany(stmt_state_ptr, interp, command, max_rows, binary_as);
+    }
+
+    int num_cols = GetResultNumCols(stmt_state_ptr, interp);
+    if ( num_cols < 0 ) {
+        return TCL_ERROR;
+    }
+    Arena_Mark mark = Arena_GetMark(&stmt_state_ptr->arena);
+    dbcapi_column_info * info = (dbcapi_column_info *) Arena_Alloc(&stmt_state_ptr->arena, sizeof(dbcapi_column_info) * num_cols);
+    if ( GetResultColumnsInfo(stmt_state_ptr, interp, num_cols, info) != TCL_OK ) {
+        Arena_Release(&stmt_state_ptr->arena, mark);
+        return TCL_ERROR;
+    }
+    unsigned char * binary_formats = NULL;
+    if ( binary_as != NULL ) {
+        binary_formats = (unsigned char *) Arena_Alloc(&stmt_state_ptr->arena, num_cols);
+        if ( GetBinaryFormatsFromObj(interp, binary_as, num_cols, binary_formats) != TCL_OK ) {
+            Arena_Release(&stmt_state_ptr->arena, mark);
+            return TCL_ERROR;
+        }
+    }
+
+    Hdbtcl_Stats delta = { .fetches = 1 };
+    Hdbtcl_Memory fetch = { 0 };
+    Tcl_Obj * rows = NULL;
+    int res = TCL_OK;
+    bool at_end = false;
+    bool rows_timed = false;
+    if ( Convert_GetNumParts(max_rows, num_cols) > 1 ) {
+        res = FetchRowsetRows(stmt_state_ptr, interp, info, num_cols, max_rows, binary_formats, &delta, &fetch, &at_end, &rows);
+    } else {
+        rows = Tcl_NewListObj(0, NULL);
+        rows_timed = true;
+        Tcl_WideInt now = GetMonotonicTime();
+        for ( int n = 0; n < max_rows; ++n ) {
+            Tcl_WideInt started = now;
+            dbcapi_bool fetched = dbcapi.fetch_next(stmt_state_ptr->stmt);
+            Tcl_WideInt converting = GetMonotonicTime();
+            delta.fetch_time += converting - now;
+            ++delta.calls;
+            if ( !fetched ) {
+                if ( FetchFailed(stmt_state_ptr->conn_state_ptr->conn) ) {
+                    ++delta.errors;
+                    SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot fetch rows", NULL);
+                    Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+                    res = TCL_ERROR;
+                } else {
+                    at_end = true;
+                }
+                break;
+            }
+            ++delta.rows;
+            Tcl_Obj * row = Tcl_NewListObj(0, NULL);
+            Tcl_ListObjAppendElement(NULL, rows, row);
+            res = GetRowValues(stmt_state_ptr, interp, info, num_cols, row, NULL, NULL, binary_formats, &delta, &fetch);
+            now = GetMonotonicTime();
+            delta.convert_time += now - converting;
+            Stats_RecordRow(stmt_state_ptr, now - started);
+            if ( res != TCL_OK ) {
+                break;
+            }
+        }
+    }
+    Stats_RecordCall(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta, rows_timed);
+    // rows now belong to the result
+    Memory_Release(stmt_state_ptr, &fetch);
+    Arena_Release(&stmt_state_ptr->arena, mark);
+    if ( res != TCL_OK ) {
+        if ( rows != NULL ) {
+            Tcl_DecrRefCount(rows);
+        }
+        return TCL_ERROR;
+    }
+    if ( at_end ) {
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+    }
+    Tcl_SetObjResult(interp, rows);
+    return TCL_OK;
+}
+
+/**
+ * Types of the packed arrays `fetchcolumn` fetches numeric columns into.
+ */
+typedef enum column_array_type {
+    COLUMN_AS_INT64, COLUMN_AS_DOUBLE, COLUMN_AS_INT32
+} Column_Array_Type;
+
+static const char * const column_array_types[] = { "int64", "double", "int32", NULL };
+static const size_t column_array_elem_sizes[] = { sizeof(int64_t), sizeof(double), sizeof(int32_t) };
+
+#define COLUMN_ARRAY_MIN_ROWS 4096  /// number of elements the packed column array starts with
+
+/**
+ * Checks whether values of the column can be stored in the packed array. Integers fit all arrays (int32
+ * arrays check the range of each value), floating point numbers fit only double arrays. Decimals are
+ * parsed from their text and fit integer arrays only when their scale is 0.
+ */
+static bool
+ColumnArray_Accepts (dbcapi_column_info * info_ptr, Column_Array_Type type)
+{
+    switch ( info_ptr->type ) {
+        case A_VAL8: case A_UVAL8: case A_VAL16: case A_UVAL16:
+        case A_VAL32: case A_UVAL32: case A_VAL64: case A_UVAL64:
+            return true;
+        case A_DOUBLE: case A_FLOAT:
+            return type == COLUMN_AS_DOUBLE;
+        case A_STRING:
+            return info_ptr->native_type == DT_DECIMAL && ( type == COLUMN_AS_DOUBLE || info_ptr->scale == 0 );
+        default:
+            return false;
+    }
+}
+
+/**
+ * Stores the (not NULL) column value as the element of the packed array. Returns false if the value
+ * does not fit the array type.
+ */
+static bool
+ColumnArray_Store (dbcapi_data_value * value, Column_Array_Type type, unsigned char * elem)
+{
+    int64_t int_num = 0;
+    double num = 0;
+    bool is_int = true;
+    switch ( value->type ) {
+        case A_VAL8:    int_num = *(int8_t *) value->buffer;    break;
+        case A_UVAL8:   int_num = *(uint8_t *) value->buffer;   break;
+        case A_VAL16:   int_num = *(int16_t *) value->buffer;   break;
+        case A_UVAL16:  int_num = *(uint16_t *) value->buffer;  break;
+        case A_VAL32:   int_num = *(int32_t *) value->buffer;   break;
+        case A_UVAL32:  int_num = *(uint32_t *) value->buffer;  break;
+        case A_VAL64:   int_num = *(int64_t *) value->buffer;   break;
+        case A_UVAL64:
+            if ( *(uint64_t *) value->buffer > INT64_MAX ) {
+                return false;
+            }
+            int_num = (int64_t) *(uint64_t *) value->buffer;
+            break;
+        case A_DOUBLE:  num = *(double *) value->buffer; is_int = false; break;
+        case A_FLOAT:   num = *(float *) value->buffer;  is_int = false; break;
+        case A_STRING: {
+            // decimal text is short, but it is not NUL-terminated
+            char text[64];
+            size_t len = *value->length;
+            if ( len == 0 || len >= sizeof(text) ) {
+                return false;
+            }
+            memcpy(text, value->buffer, len);
+            text[len] = '\0';
+            char * end;
+            errno = 0;
+            if ( type == COLUMN_AS_DOUBLE ) {
+                num = strtod(text, &end);
+                is_int = false;
+            } else {
+                int_num = strtoll(text, &end, 10);
+            }
+            if ( *end != '\0' || errno == ERANGE ) {
+                return false;
+            }
+            break;
+        }
+        default:
+            return false;
+    }
+    switch ( type ) {
+        case COLUMN_AS_INT64:
+            if ( !is_int ) return false;
+            memcpy(elem, &int_num, sizeof(int64_t));
+            break;
+        case COLUMN_AS_INT32: {
+            if ( !is_int || int_num < INT32_MIN || int_num > INT32_MAX ) return false;
+            int32_t int32_num = (int32_t) int_num;
+            memcpy(elem, &int32_num, sizeof(int32_t));
+            break;
+        }
+        case COLUMN_AS_DOUBLE:
+            if ( is_int ) num = (double) int_num;
+            memcpy(elem, &num, sizeof(double));
+            break;
+    }
+    return true;
+}
+
+/**
+ * Fetches values of a numeric column into a packed array - a byte array of native-endian 64-bit or 32-bit
+ * integers or doubles, which is what `binary scan` reads with `w*`, `n*` or `q*` (on little-endian
+ * platforms) and what C extensions can use in place. No Tcl value is created for the fetched values, thus
+ * large columns take a fraction of the memory their lists would.
+ *
+ * The column is specified by its name or number. By default all remaining rows are fetched, `-maxrows`
+ * limits their number. NULLs are stored as 0. With `-nulls` the variable is set to a bitmap where the bit
+ * of each NULL is set - bit `i % 8` of byte `i / 8` for row `i`.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn execute "SELECT id, amount FROM orders"]
+ * set amounts [$stmt fetchcolumn 1 -as double -nulls nulls]
+ * binary scan $amounts q* amount_list
+ * \endcode
+ */
+static int
+Stmt_FetchColumn (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 1 || objc % 2 != 1 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "fetchcolumn column ?-as int64|double|int32? ?-maxrows n? ?-nulls var_name?");
+        return TCL_ERROR;
+    }
+    Column_Array_Type type = COLUMN_AS_INT64;
+    int max_rows = INT_MAX;
+    Tcl_Obj * nulls_var = NULL;
+    static const char * const options[] = { "-as", "-maxrows", "-nulls", NULL };
+    enum { AS, MAXROWS, NULLS } option;
+    for ( int i = 1; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case AS:
+                if ( Tcl_GetIndexFromObj(interp, objv[i + 1], column_array_types, "array type", 0, (int *) &type) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            case MAXROWS:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &max_rows) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( max_rows <= 0 ) {
+                    Tcl_SetResult(interp, "the number of rows to fetch must be positive", TCL_STATIC);
+                    return TCL_ERROR;
+                }
+                break;
+            case NULLS:
+                nulls_var = objv[i + 1];
+                break;
+        }
+    }
+
+    int num_cols = GetResultNumCols(stmt_state_ptr, interp);
+    if ( num_cols < 0 ) {
+        return TCL_ERROR;
+    }
+    Arena_Mark mark = Arena_GetMark(&stmt_state_ptr->arena);
+    dbcapi_column_info * info = (dbcapi_column_info *) Arena_Alloc(&stmt_state_ptr->arena, sizeof(dbcapi_column_info) * num_cols);
+    if ( GetResultColumnsInfo(stmt_state_ptr, interp, num_cols, info) != TCL_OK ) {
+        Arena_Release(&stmt_state_ptr->arena, mark);
+        return TCL_ERROR;
+    }
+    // names are looked up first, as merge keys are, so columns named by numbers can be fetched
+    int col = -1;
+    const char * name = Tcl_GetString(objv[0]);
+    for ( int i = 0; i < num_cols && col < 0; ++i ) {
+        if ( strcmp(info[i].name, name) == 0 ) {
+            col = i;
+        }
+    }
+    if ( col < 0 && Tcl_GetIntFromObj(NULL, objv[0], &col) != TCL_OK ) {
+        col = -1;
+    }
+    if ( col < 0 || col >= num_cols ) {
+        Tcl_AppendResult(interp, "Result set has no column ", Tcl_GetString(objv[0]), NULL);
+        Arena_Release(&stmt_state_ptr->arena, mark);
+        return TCL_ERROR;
+    }
+    if ( !ColumnArray_Accepts(&info[col], type) ) {
+        Tcl_AppendResult(interp, "Values of column ", info[col].name, " cannot be fetched as ", column_array_types[type], NULL);
+        Arena_Release(&stmt_state_ptr->arena, mark);
+        return TCL_ERROR;
+    }
+    // the name is owned by DBCAPI, it outlives the arena copy of the column info
+    const char * col_name = info[col].name;
+    Arena_Release(&stmt_state_ptr->arena, mark);
+
+    size_t elem_size = column_array_elem_sizes[type];
+    if ( max_rows > INT_MAX / (int) elem_size ) {
+        // byte arrays are limited to 2GB, the next fetchcolumn returns the rest
+        max_rows = INT_MAX / (int) elem_size;
+    }
+    int capacity = ( max_rows < COLUMN_ARRAY_MIN_ROWS ? max_rows : COLUMN_ARRAY_MIN_ROWS );
+    Tcl_Obj * data = Tcl_NewByteArrayObj(NULL, 0);
+    unsigned char * elems = Tcl_SetByteArrayLength(data, capacity * elem_size);
+    Tcl_Obj * nulls = NULL;
+    unsigned char * null_bits = NULL;
+    if ( nulls_var != NULL ) {
+        nulls = Tcl_NewByteArrayObj(NULL, 0);
+        null_bits = Tcl_SetByteArrayLength(nulls, ( capacity + 7 ) / 8);
+    }
+
+    Hdbtcl_Stats delta = { .fetches = 1 };
+    Hdbtcl_Memory fetch = { 0 };
+    int res = Memory_Reserve(stmt_state_ptr, interp, &fetch, MEMORY_ROWS, capacity * elem_size);
+    int num_rows = 0;
+    bool at_end = false;
+    Tcl_WideInt now = GetMonotonicTime();
+    while ( res == TCL_OK && num_rows < max_rows ) {
+        dbcapi_bool fetched = dbcapi.fetch_next(stmt_state_ptr->stmt);
+        Tcl_WideInt converting = GetMonotonicTime();
+        delta.fetch_time += converting - now;
+        ++delta.calls;
+        if ( !fetched ) {
+            if ( FetchFailed(stmt_state_ptr->conn_state_ptr->conn) ) {
+                ++delta.errors;
+                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot fetch rows", NULL);
+                Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+                res = TCL_ERROR;
+            } else {
+                at_end = true;
+            }
+            break;
+        }
+        ++delta.rows;
+        if ( num_rows == capacity ) {
+            int new_capacity = ( capacity > max_rows / 2 ? max_rows : capacity * 2 );
+            res = Memory_Reserve(stmt_state_ptr, interp, &fetch, MEMORY_ROWS, ( new_capacity - capacity ) * elem_size);
+            if ( res != TCL_OK ) {
+                break;
+            }
+            capacity = new_capacity;
+            elems = Tcl_SetByteArrayLength(data, capacity * elem_size);
+            if ( nulls != NULL ) {
+                null_bits = Tcl_SetByteArrayLength(nulls, ( capacity + 7 ) / 8);
+            }
+        }
+        dbcapi_data_value value;
+        if ( !dbcapi.get_column(stmt_state_ptr->stmt, col, &value) ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] data", NULL);
+            res = TCL_ERROR;
+            break;
+        }
+        unsigned char * elem = elems + num_rows * elem_size;
+        if ( null_bits != NULL && num_rows % 8 == 0 ) {
+            null_bits[num_rows / 8] = 0;
+        }
+        if ( *value.is_null ) {
+            memset(elem, 0, elem_size);
+            if ( null_bits != NULL ) {
+                null_bits[num_rows / 8] |= 1 << ( num_rows % 8 );
+            }
+        } else if ( ColumnArray_Store(&value, type, elem) ) {
+            delta.bytes += elem_size;
+        } else {
+            Tcl_SetObjResult(interp, Tcl_ObjPrintf("Value of column %s in row %d does not fit %s", col_name, num_rows, column_array_types[type]));
+            res = TCL_ERROR;
+            break;
+        }
+        ++num_rows;
+        now = GetMonotonicTime();
+        delta.convert_time += now - converting;
+    }
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta);
+    // the array now belongs to the result
+    Memory_Release(stmt_state_ptr, &fetch);
+    if ( res == TCL_OK && nulls != NULL ) {
+        Tcl_SetByteArrayLength(nulls, ( num_rows + 7 ) / 8);
+        if ( Tcl_ObjSetVar2(interp, nulls_var, NULL, nulls, TCL_LEAVE_ERR_MSG) == NULL ) {
+            res = TCL_ERROR;
+        }
+        nulls = NULL;
+    }
+    if ( res != TCL_OK ) {
+        Tcl_DecrRefCount(data);
+        if ( nulls != NULL ) {
+            Tcl_DecrRefCount(nulls);
+        }
+        return TCL_ERROR;
+    }
+    if ( at_end ) {
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+    }
+    Tcl_SetByteArrayLength(data, num_rows * elem_size);
+    Tcl_SetObjResult(interp, data);
+    return TCL_OK;
+}
+
+/**
+ * Formats of the exported text.
+ */
+typedef enum export_format {
+    EXPORT_CSV,
+    EXPORT_TSV,
+    EXPORT_NDJSON       /// newline delimited JSON objects, only the result set channel renders it
+} Export_Format;
+
+/**
+ * Appends the text to the line of delimited text. CSV values are quoted when they contain a separator,
+ * a quote or a line break. TSV escapes tabs, line breaks and backslashes.
+ */
+static void
+AppendDelimitedText (Tcl_DString * line, const char * str, int len, Export_Format format)
+{
+    if ( format == EXPORT_TSV ) {
+        int start = 0;
+        for ( int i = 0; i < len; i++ ) {
+            const char * esc = NULL;
+            switch ( str[i] ) {
+                case '\t': esc = "\\t";  break;
+                case '\n': esc = "\\n";  break;
+                case '\r': esc = "\\r";  break;
+                case '\\': esc = "\\\\"; break;
+            }
+            if ( esc != NULL ) {
+                Tcl_DStringAppend(line, str + start, i - start);
+                Tcl_DStringAppend(line, esc, 2);
+                start = i + 1;
+            }
+        }
+        Tcl_DStringAppend(line, str + start, len - start);
+        return;
+    }
+    bool quote = false;
+    for ( int i = 0; i < len && !quote; i++ ) {
+        quote = ( str[i] == ',' || str[i] == '"' || str[i] == '\n' || str[i] == '\r' );
+    }
+    if ( !quote ) {
+        Tcl_DStringAppend(line, str, len);
+        return;
+    }
+    Tcl_DStringAppend(line, "\"", 1);
+    int start = 0;
+    for ( int i = 0; i < len; i++ ) {
+        if ( str[i] == '"' ) {
+            Tcl_DStringAppend(line, str + start, i + 1 - start);
+            Tcl_DStringAppend(line, "\"", 1);
+            start = i + 1;
+        }
+    }
+    Tcl_DStringAppend(line, str + start, len - start);
+    Tcl_DStringAppend(line, "\"", 1);
+}
+
+/**
+ * Appends the value to the line of delimited text.
+ */
+static void
+AppendDelimitedValue (Tcl_DString * line, Tcl_Obj * value, Export_Format format)
+{
+    int len;
+    const char * str = Tcl_GetStringFromObj(value, &len);
+    AppendDelimitedText(line, str, len, format);
+}
+
+#define JSON_FLUSH_SIZE 65536   /// size of the JSON text fetchjson writes into the channel at once
+
+/**
+ * Returns the length of the leading part of the text that can be copied into a JSON string as is -
+ * without quotes, backslashes and control characters. SSE2 checks 16 bytes at a time.
+ */
+static size_t
+Json_PlainPrefix (const char * str, size_t len)
+{
+    size_t i = 0;
+#if defined(HAVE_SSE2)
+    const __m128i last_control = _mm_set1_epi8(0x1f);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    for ( ; i + 16 <= len; i += 16 ) {
+        __m128i chars = _mm_loadu_si128((const __m128i *) (str + i));
+        // unsigned chars that are not above 0x1f are the only ones min() leaves unchanged
+        __m128i special = _mm_cmpeq_epi8(_mm_min_epu8(chars, last_control), chars);
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(chars, quote));
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(chars, backslash));
+        if ( _mm_movemask_epi8(special) != 0 ) {
+            break;
+        }
+    }
+#endif
+    while ( i < len && (unsigned char) str[i] >= 0x20 && str[i] != '"' && str[i] != '\\' ) {
+        ++i;
+    }
+    return i;
+}
+
+/**
+ * Appends UTF-8 text as a JSON string.
+ */
+static void
+AppendJsonString (Tcl_DString * json, const char * str, size_t len)
+{
+    Tcl_DStringAppend(json, "\"", 1);
+    size_t i = 0;
+    while ( i < len ) {
+        size_t plain = Json_PlainPrefix(str + i, len - i);
+        Tcl_DStringAppend(json, str + i, plain);
+        i += plain;
+        if ( i == len ) {
+            break;
+        }
+        unsigned char c = str[i++];
+        switch ( c ) {
+            case '"':  Tcl_DStringAppend(json, "\\\"", 2); break;
+            case '\\': Tcl_DStringAppend(json, "\\\\", 2); break;
+            case '\n': Tcl_DStringAppend(json, "\\n", 2);  break;
+            case '\r': Tcl_DStringAppend(json, "\\r", 2);  break;
+            case '\t': Tcl_DStringAppend(json, "\\t", 2);  break;
+            default: {
+                char esc[7] = { '\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0x0f], '\0' };
+                Tcl_DStringAppend(json, esc, 6);
+            }
+        }
+    }
+    Tcl_DStringAppend(json, "\"", 1);
+}
+
+/**
+ * Appends the integer to the JSON text.
+ */
+static void
+AppendJsonInteger (Tcl_DString * json, int64_t value, bool is_unsigned)
+{
+    char digits[24];
+    char * end = digits + sizeof(digits);
+    char * start = end;
+    uint64_t num = ( is_unsigned || value >= 0 ? (uint64_t) value : 0 - (uint64_t) value );
+    do {
+        *--start = (char) ( '0' + num % 10 );
+        num /= 10;
+    } while ( num > 0 );
+    if ( !is_unsigned && value < 0 ) {
+        *--start = '-';
+    }
+    Tcl_DStringAppend(json, start, end - start);
+}
+
+/**
+ * Appends the decimal DBCAPI has returned as text to the JSON text. Decimals are written as
+ * numbers, the leading zero the text might omit is added. Text that is not a number is written
+ * as a string.
+ */
+static void
+AppendJsonDecimal (Tcl_DString * json, const char * str, size_t len)
+{
+    size_t i = 0;
+    if ( i < len && str[i] == '-' ) {
+        ++i;
+    }
+    size_t int_start = i;
+    while ( i < len && isdigit((unsigned char) str[i]) ) {
+        ++i;
+    }
+    size_t int_digits = i - int_start;
+    bool valid = ( int_digits == 0 || str[int_start] != '0' || int_digits == 1 );
+    if ( valid && i < len && str[i] == '.' ) {
+        size_t frac_start = ++i;
+        while ( i < len && isdigit((unsigned char) str[i]) ) {
+            ++i;
+        }
+        valid = ( i > frac_start );
+    } else {
+        valid = valid && int_digits > 0;
+    }
+    if ( valid && i < len && ( str[i] == 'e' || str[i] == 'E' ) ) {
+        if ( ++i < len && ( str[i] == '+' || str[i] == '-' ) ) {
+            ++i;
+        }
+        size_t exp_start = i;
+        while ( i < len && isdigit((unsigned char) str[i]) ) {
+            ++i;
+        }
+        valid = ( i > exp_start );
+    }
+    if ( !valid || i != len || len == 0 ) {
+        AppendJsonString(json, str, len);
+        return;
+    }
+    if ( int_digits == 0 ) {
+        // .5 -> 0.5
+        Tcl_DStringAppend(json, str, int_start);
+        Tcl_DStringAppend(json, "0", 1);
+        Tcl_DStringAppend(json, str + int_start, len - int_start);
+    } else {
+        Tcl_DStringAppend(json, str, len);
+    }
+}
+
+/**
+ * Appends the column value to the JSON text. Numbers and booleans are written according to the
+ * column type, NULLs (and non-finite doubles) are written as `null`, vectors as arrays of numbers, other
+ * binary values as hex or base64 strings.
+ */
+static void
+AppendJsonValue (Tcl_DString * json, dbcapi_data_value * value, dbcapi_native_type native_type, Binary_Format binary_format)
+{
+    if ( *value->is_null ) {
+        Tcl_DStringAppend(json, "null", 4);
+        return;
+    }
+    switch ( value->type ) {
+        case A_UVAL8:
+            if ( native_type == DT_BOOLEAN ) {
+                if ( *(uint8_t *) value->buffer ) {
+                    Tcl_DStringAppend(json, "true", 4);
+                } else {
+                    Tcl_DStringAppend(json, "false", 5);
+                }
+            } else {
+                AppendJsonInteger(json, *(uint8_t *) value->buffer, true);
+            }
+            break;
+        case A_VAL8:    AppendJsonInteger(json, *(int8_t *) value->buffer, false);   break;
+        case A_UVAL16:  AppendJsonInteger(json, *(uint16_t *) value->buffer, true);  break;
+        case A_VAL16:   AppendJsonInteger(json, *(int16_t *) value->buffer, false);  break;
+        case A_UVAL32:  AppendJsonInteger(json, *(uint32_t *) value->buffer, true);  break;
+        case A_VAL32:   AppendJsonInteger(json, *(int32_t *) value->buffer, false);  break;
+        case A_UVAL64:  AppendJsonInteger(json, *(int64_t *) value->buffer, true);   break;
+        case A_VAL64:   AppendJsonInteger(json, *(int64_t *) value->buffer, false);  break;
+        case A_DOUBLE: case A_FLOAT: {
+            double num = ( value->type == A_DOUBLE ? *(double *) value->buffer : (double) *(float *) value->buffer );
+            if ( isfinite(num) ) {
+                char text[TCL_DOUBLE_SPACE];
+                Tcl_PrintDouble(NULL, num, text);
+                Tcl_DStringAppend(json, text, -1);
+            } else {
+                Tcl_DStringAppend(json, "null", 4);
+            }
+            break;
+        }
+        case A_BINARY:
+            if ( native_type == NATIVE_TYPE_REAL_VECTOR ) {
+                AppendVectorText(json, (unsigned char *) value->buffer, *value->length);
+                break;
+            }
+            Tcl_DStringAppend(json, "\"", 1);
+            AppendBinaryText(json, (unsigned char *) value->buffer, *value->length, binary_format);
+            Tcl_DStringAppend(json, "\"", 1);
+            break;
+        case A_STRING:
+            if ( native_type == DT_DECIMAL ) {
+                AppendJsonDecimal(json, value->buffer, *value->length);
+            } else {
+                AppendJsonString(json, value->buffer, *value->length);
+            }
+            break;
+        default:
+            Tcl_DStringAppend(json, "null", 4);
+    }
+}
+
+/**
+ * Checks whether the column holds binary values (other than vectors, which are always rendered as arrays
+ * of numbers) that would be fetched as bytes, which JSON and delimited text cannot hold.
+ */
+static bool
+IsBinaryAsBytes (dbcapi_column_info * info_ptr, Binary_Format binary_format)
+{
+    return info_ptr->type == A_BINARY && info_ptr->native_type != NATIVE_TYPE_REAL_VECTOR
+        && ( binary_format == BINARY_AS_BYTES || binary_format == BINARY_AS_LIST );
+}
+
+/**
+ * Builds the keys of the JSON objects the result set rows are rendered as - `{"COL1":`, `,"COL2":`, ... -
+ * and saves where each of them ends in the text.
+ */
+static void
+AppendJsonKeys (Tcl_DString * keys, dbcapi_column_info info[], int num_cols, int key_ends[])
+{
+    for ( int col = 0; col < num_cols; ++col ) {
+        Tcl_DStringAppend(keys, col == 0 ? "{" : ",", 1);
+        AppendJsonString(keys, info[col].name, strlen(info[col].name));
+        Tcl_DStringAppend(keys, ":", 1);
+        key_ends[col] = Tcl_DStringLength(keys);
+    }
+}
+
+/**
+ * Fetches rows of the result set and renders them as JSON objects, where keys are column names, directly
+ * from the fetched data. Numbers, booleans and NULLs are written according to the column types. Other
+ * values, dates and times included, are strings. Binary values are base64 strings unless `-binaryas hex`
+ * is specified.
+ *
+ * By default all remaining rows are fetched, `-maxrows` limits their number. Rows are rendered as
+ * a JSON array (`-format array`, which is the default) or as newline delimited JSON (`-format ndjson`).
+ * `fetchjson` returns the JSON text or, when `-channel` is specified, writes it into the channel and
+ * returns the number of rendered rows. Text written into the channel is always in UTF-8.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn execute "SELECT id, name, salary FROM employees"]
+ * set json [$stmt fetchjson]
+ * # [{"ID":1,"NAME":"Hasso","SALARY":1000.5},...]
+ *
+ * set stmt [$conn execute "SELECT * FROM events"]
+ * while { [$stmt fetchjson -maxrows 10000 -format ndjson -channel $sock] > 0 } {}
+ * \endcode
+ */
+static int
+Stmt_FetchJson (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc % 2 != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "fetchjson ?-maxrows n? ?-channel ch? ?-format array|ndjson? ?-binaryas hex|base64?");
+        return TCL_ERROR;
+    }
+    static const char * const options[] = { "-binaryas", "-channel", "-format", "-maxrows", NULL };
+    enum { BINARYAS, CHANNEL, FORMAT, MAXROWS } option;
+    static const char * const formats[] = { "array", "ndjson", NULL };
+    enum { JSON_ARRAY, JSON_NDJSON } format = JSON_ARRAY;
+    Tcl_Obj * binary_as = NULL;
+    Tcl_Channel channel = NULL;
+    int max_rows = 0;
+    for ( int i = 0; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case BINARYAS:
+                binary_as = objv[i + 1];
+                break;
+            case CHANNEL: {
+                int mode;
+                channel = Tcl_GetChannel(interp, Tcl_GetString(objv[i + 1]), &mode);
+                if ( channel == NULL ) {
+                    return TCL_ERROR;
+                }
+                if ( ( mode & TCL_WRITABLE ) == 0 ) {
+                    Tcl_AppendResult(interp, "Channel ", Tcl_GetString(objv[i + 1]), " must be open for writing", NULL);
+                    return TCL_ERROR;
+                }
+                break;
+            }
+            case FORMAT:
+                if ( Tcl_GetIndexFromObj(interp, objv[i + 1], formats, "format", 0, (int *) &format) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            case MAXROWS:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &max_rows) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( max_rows <= 0 ) {
+                    Tcl_SetResult(interp, "the number of rows to fetch must be positive", TCL_STATIC);
+                    return TCL_ERROR;
+                }
+                break;
+        }
+    }
+
+    int num_cols = GetResultNumCols(stmt_state_ptr, interp);
+    if ( num_cols < 0 ) {
+        return TCL_ERROR;
+    }
+    Arena_Mark mark = Arena_GetMark(&stmt_state_ptr->arena);
+    dbcapi_column_info * info = (dbcapi_column_info *) Arena_Alloc(&stmt_state_ptr->arena, sizeof(dbcapi_column_info) * num_cols);
+    if ( GetResultColumnsInfo(stmt_state_ptr, interp, num_cols, info) != TCL_OK ) {
+        Arena_Release(&stmt_state_ptr->arena, mark);
+        return TCL_ERROR;
+    }
+    unsigned char * binary_formats = (unsigned char *) Arena_Alloc(&stmt_state_ptr->arena, num_cols);
+    memset(binary_formats, BINARY_AS_BASE64, num_cols);
+    if ( binary_as != NULL && GetBinaryFormatsFromObj(interp, binary_as, num_cols, binary_formats) != TCL_OK ) {
+        Arena_Release(&stmt_state_ptr->arena, mark);
+        return TCL_ERROR;
+    }
+    for ( int col = 0; col < num_cols; ++col ) {
+        if ( IsBinaryAsBytes(&info[col], binary_formats[col]) ) {
+            Tcl_SetResult(interp, "JSON can hold binary values only as hex or base64 text", TCL_STATIC);
+            Arena_Release(&stmt_state_ptr->arena, mark);
+            return TCL_ERROR;
+        }
+    }
+
+    Tcl_DString keys;
+    Tcl_DStringInit(&keys);
+    int * key_ends = (int *) Arena_Alloc(&stmt_state_ptr->arena, sizeof(int) * num_cols);
+    AppendJsonKeys(&keys, info, num_cols, key_ends);
+    const char * key_text = Tcl_DStringValue(&keys);
+
+    Hdbtcl_Stats delta = { .fetches = 1 };
+    Hdbtcl_Memory fetch = { 0 };
+    Tcl_DString json;
+    Tcl_DStringInit(&json);
+    if ( format == JSON_ARRAY ) {
+        Tcl_DStringAppend(&json, "[", 1);
+    }
+    int res = TCL_OK;
+    bool at_end = false;
+    int num_rows = 0;
+    Tcl_WideInt now = GetMonotonicTime();
+    while ( max_rows == 0 || num_rows < max_rows ) {
+        dbcapi_bool fetched = dbcapi.fetch_next(stmt_state_ptr->stmt);
+        Tcl_WideInt converting = GetMonotonicTime();
+        delta.fetch_time += converting - now;
+        ++delta.calls;
+        if ( !fetched ) {
+            if ( FetchFailed(stmt_state_ptr->conn_state_ptr->conn) ) {
+                ++delta.errors;
+                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot fetch rows", NULL);
+                Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+                res = TCL_ERROR;
+            } else {
+                at_end = true;
+            }
+            break;
+        }
+        ++delta.rows;
+        int row_start = Tcl_DStringLength(&json);
+        if ( format == JSON_ARRAY && num_rows > 0 ) {
+            Tcl_DStringAppend(&json, ",", 1);
+        }
+        for ( int col = 0; col < num_cols && res == TCL_OK; ++col ) {
+            int key_start = ( col == 0 ? 0 : key_ends[col - 1] );
+            Tcl_DStringAppend(&json, key_text + key_start, key_ends[col] - key_start);
+            dbcapi_data_value value;
+            if ( !dbcapi.get_column(stmt_state_ptr->stmt, col, &value) ) {
+                char num[12];
+                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] data", NULL);
+                res = TCL_ERROR;
+                break;
+            }
+            AppendJsonValue(&json, &value, info[col].native_type, binary_formats[col]);
+            if ( !*value.is_null ) {
+                delta.bytes += GetValueSize(&value);
+            }
+        }
+        if ( res == TCL_OK ) {
+            Tcl_DStringAppend(&json, format == JSON_NDJSON ? "}\n" : "}", format == JSON_NDJSON ? 2 : 1);
+            ++num_rows;
+            if ( channel == NULL ) {
+                res = Memory_Reserve(stmt_state_ptr, interp, &fetch, MEMORY_ROWS, Tcl_DStringLength(&json) - row_start);
+            } else if ( Tcl_DStringLength(&json) >= JSON_FLUSH_SIZE ) {
+                if ( Tcl_Write(channel, Tcl_DStringValue(&json), Tcl_DStringLength(&json)) < 0 ) {
+                    Tcl_AppendResult(interp, "Cannot write JSON: ", Tcl_ErrnoMsg(Tcl_GetErrno()), NULL);
+                    res = TCL_ERROR;
+                }
+                Tcl_DStringSetLength(&json, 0);
+            }
+        }
+        now = GetMonotonicTime();
+        delta.convert_time += now - converting;
+        if ( res != TCL_OK ) {
+            break;
+        }
+    }
+    if ( res == TCL_OK ) {
+        if ( format == JSON_ARRAY ) {
+            Tcl_DStringAppend(&json, "]", 1);
+        }
+        if ( channel != NULL ) {
+            if ( Tcl_Write(channel, Tcl_DStringValue(&json), Tcl_DStringLength(&json)) < 0 ) {
+                Tcl_AppendResult(interp, "Cannot write JSON: ", Tcl_ErrnoMsg(Tcl_GetErrno()), NULL);
+                res = TCL_ERROR;
+            } else {
+                Tcl_SetObjResult(interp, Tcl_NewIntObj(num_rows));
+            }
+        } else {
+            Tcl_Obj * result = Tcl_NewObj();
+            SetStringObjFromUtf8(result, Tcl_DStringValue(&json), Tcl_DStringLength(&json));
+            Tcl_SetObjResult(interp, result);
+        }
+    }
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta);
+    // the text now belongs to the result
+    Memory_Release(stmt_state_ptr, &fetch);
+    Tcl_DStringFree(&json);
+    Tcl_DStringFree(&keys);
+    Arena_Release(&stmt_state_ptr->arena, mark);
+    if ( res != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( at_end ) {
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+    }
+    return TCL_OK;
+}
+
+/**
+ * Advances to the next result set in a multiple result set query.
+ *
+ * If a query (such as a call to a stored procedure) returns multiple result sets,
+ * then "nextresult" advances from the current result set to the next.
+ *
+ * "nextresult" returns true if the statement successfully advances to the next
+ * result set, false otherwise.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn execute "call multiple_results_procedure()"]
+ * while { 1 } {
+ *     while { [$stmt fetch row] } {
+ *         # process columns from the fetched row
+ *     }
+ *     if { ![$stmt nextresult] } {
+ *         break
+ *     }
+ * }
+ * \endcode
+ */
+static int
+Stmt_NextResult (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "nextresult");
+        return TCL_ERROR;
+    }
+    dbcapi_bool has_advanced = dbcapi.get_next_result(stmt_state_ptr->stmt);
+    Stmt_ClearColumnObjs(stmt_state_ptr);
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(has_advanced));
+    return TCL_OK;
+}
+
+/**
+ * Column values copied out of DBCAPI buffers, so they could be converted into TCL objects later
+ * and by a thread other than the one that fetched them.
+ */
+typedef struct raw_value {
+    size_t              offset;     /// position of the value in the rowset data
+    size_t              length;
+    dbcapi_data_type    type;
+    dbcapi_bool         is_null;
+} Raw_Value;
+
+typedef struct raw_rowset {
+    Raw_Value *         values;
+    char *              data;
+    size_t              data_size;
+    size_t              data_capacity;
+    size_t              value_bytes;    /// total size of the column values
+    int                 num_cols;
+    int                 num_rows;
+    int                 max_rows;   /// number of rows values can hold
+} Raw_Rowset;
+
+/**
+ * Releases memory held by the rowset.
+ */
+static void
+RawRowset_Free (Raw_Rowset * rowset_ptr)
+{
+    if ( rowset_ptr->values != NULL ) ckfree(rowset_ptr->values);
+    if ( rowset_ptr->data   != NULL ) ckfree(rowset_ptr->data);
+    memset(rowset_ptr, 0, sizeof(Raw_Rowset));
+}
+
+/**
+ * Returns the number of bytes the rowset has allocated.
+ */
+static size_t
+RawRowset_GetSize (Raw_Rowset * rowset_ptr)
+{
+    return rowset_ptr->data_capacity + sizeof(Raw_Value) * rowset_ptr->max_rows * rowset_ptr->num_cols;
+}
+
+/**
+ * Copies values of the current (fetched) row into the rowset.
+ *
+ * \note This function does not use TCL objects and thus can be called from any thread.
+ */
+static bool
+RawRowset_AppendRow (Raw_Rowset * rowset_ptr, dbcapi_stmt * stmt)
+{
+    if ( rowset_ptr->num_rows == rowset_ptr->max_rows ) {
+        rowset_ptr->max_rows = ( rowset_ptr->max_rows == 0 ? 64 : rowset_ptr->max_rows * 2 );
+        rowset_ptr->values = ckrealloc(rowset_ptr->values, sizeof(Raw_Value) * rowset_ptr->max_rows * rowset_ptr->num_cols);
+    }
+    Raw_Value * row = rowset_ptr->values + rowset_ptr->num_rows * rowset_ptr->num_cols;
+    for ( int col = 0; col < rowset_ptr->num_cols; ++col ) {
+        dbcapi_data_value value;
+        if ( !dbcapi.get_column(stmt, col, &value) ) {
+            return false;
+        }
+        row[col].type    = value.type;
+        row[col].is_null = *value.is_null;
+        row[col].length  = ( row[col].is_null ? 0 : GetValueSize(&value) );
+        // keep values aligned, so primitives could be read directly from the data buffer
+        size_t offset = ( rowset_ptr->data_size + 7 ) & ~(size_t) 7;
+        if ( offset + row[col].length > rowset_ptr->data_capacity ) {
+            size_t capacity = ( rowset_ptr->data_capacity == 0 ? 4096 : rowset_ptr->data_capacity * 2 );
+            while ( capacity < offset + row[col].length ) {
+                capacity *= 2;
+            }
+            rowset_ptr->data = ckrealloc(rowset_ptr->data, capacity);
+            rowset_ptr->data_capacity = capacity;
+        }
+        if ( !row[col].is_null ) {
+            memcpy(rowset_ptr->data + offset, value.buffer, row[col].length);
+        }
+        row[col].offset = offset;
+        rowset_ptr->data_size = offset + row[col].length;
+        rowset_ptr->value_bytes += row[col].length;
+    }
+    ++rowset_ptr->num_rows;
+    return true;
+}
+
+/**
+ * Describes the column value of the rowset row as if it was returned by `get_column`.
+ */
+static void
+RawRowset_GetValue (Raw_Rowset * rowset_ptr, int row_num, int col, dbcapi_data_value * value)
+{
+    Raw_Value * raw = rowset_ptr->values + row_num * rowset_ptr->num_cols + col;
+    value->buffer      = rowset_ptr->data + raw->offset;
+    value->buffer_size = raw->length;
+    value->length      = &raw->length;
+    value->type        = raw->type;
+    value->is_null     = &raw->is_null;
+}
+
+/**
+ * Creates a list of column values of the rowset row. Binary values are returned in the column
+ * formats, which might be NULL when all of them are returned as byte arrays.
+ */
+static Tcl_Obj *
+RawRowset_NewRowObj (Raw_Rowset * rowset_ptr, int row_num, dbcapi_column_info info[], const unsigned char * binary_formats)
+{
+    Tcl_Obj * values = Tcl_NewListObj(0, NULL);
+    for ( int col = 0; col < rowset_ptr->num_cols; ++col ) {
+        dbcapi_data_value value;
+        RawRowset_GetValue(rowset_ptr, row_num, col, &value);
+        Tcl_ListObjAppendElement(NULL, values, NewColumnValueObj(&value, info[col].native_type, binary_formats != NULL ? binary_formats[col] : BINARY_AS_BYTES));
+    }
+    return values;
+}
+
+/**
+ * Conversion threads.
+ *
+ * Large rowsets are converted into Tcl values, or rendered as text, by several threads at once. Rows
+ * are split into ranges of consecutive rows and each range is converted by one thread - either by a
+ * thread of the process wide conversion pool or by the thread that requested the conversion, which
+ * then waits for the other ranges. Objects created by a pool thread are handed over to the requesting
+ * thread once the whole conversion completes and are never shared by the threads.
+ */
+#define CONVERT_MAX_THREADS     16
+#define CONVERT_DEFAULT_THREADS 4
+#define CONVERT_MIN_VALUES      8192    /// the smallest number of values worth converting by a separate thread
+
+/**
+ * Converts rows [first_row, end_row) of the part of the conversion.
+ */
+typedef void (Convert_Proc) (void * data, int part, int first_row, int end_row);
+
+/**
+ * Range of rows that is converted by one thread.
+ */
+typedef struct convert_part {
+    Convert_Proc *          proc;
+    void *                  data;
+    int                     part;
+    int                     first_row;
+    int                     end_row;
+    int *                   pending_ptr;    /// number of parts of the conversion that are not converted yet
+    struct convert_part *   next;
+} Convert_Part;
+
+static struct {
+    Tcl_ThreadId            threads[CONVERT_MAX_THREADS];
+    int                     num_threads;    /// number of started pool threads
+    int                     max_threads;    /// number of threads, the requesting one included, a conversion may use
+    bool                    exit;
+    Convert_Part *          queue;          /// parts waiting for a pool thread
+    Tcl_Condition           work_cond;
+    Tcl_Condition           done_cond;
+} convert_pool;
+TCL_DECLARE_MUTEX(convert_lock)
+
+/**
+ * Conversion pool thread.
+ */
+static Tcl_ThreadCreateType
+Convert_Worker (ClientData client_data)
+{
+    Tcl_MutexLock(&convert_lock);
+    while ( !convert_pool.exit ) {
+        Convert_Part * part_ptr = convert_pool.queue;
+        if ( part_ptr == NULL ) {
+            Tcl_ConditionWait(&convert_pool.work_cond, &convert_lock, NULL);
+            continue;
+        }
+        convert_pool.queue = part_ptr->next;
+        Tcl_MutexUnlock(&convert_lock);
+
+        part_ptr->proc(part_ptr->data, part_ptr->part, part_ptr->first_row, part_ptr->end_row);
+
+        Tcl_MutexLock(&convert_lock);
+        if ( --*part_ptr->pending_ptr == 0 ) {
+            Tcl_ConditionNotify(&convert_pool.done_cond);
+        }
+    }
+    Tcl_MutexUnlock(&convert_lock);
+
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/**
+ * Stops the conversion pool threads when the process exits.
+ */
+static void
+Convert_Shutdown (ClientData client_data)
+{
+    Tcl_MutexLock(&convert_lock);
+    convert_pool.exit = true;
+    Tcl_ConditionNotify(&convert_pool.work_cond);
+    int num_threads = convert_pool.num_threads;
+    Tcl_MutexUnlock(&convert_lock);
+
+    for ( int i = 0; i < num_threads; i++ ) {
+        int result;
+        Tcl_JoinThread(convert_pool.threads[i], &result);
+    }
+    convert_pool.num_threads = 0;
+    convert_pool.exit = false;
+    Tcl_ConditionFinalize(&convert_pool.work_cond);
+    Tcl_ConditionFinalize(&convert_pool.done_cond);
+}
+
+/**
+ * Returns the number of threads conversions may use by default - up to 4, but no more than there are
+ * processors.
+ */
+static int
+Convert_GetDefaultThreads ()
+{
+#ifdef _WIN32
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+    int num_cpus = (int) sys_info.dwNumberOfProcessors;
+#else
+    int num_cpus = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return num_cpus < 1 ? 1 : num_cpus < CONVERT_DEFAULT_THREADS ? num_cpus : CONVERT_DEFAULT_THREADS;
+}
+
+/**
+ * Returns the number of threads conversions may use.
+ */
+static int
+Convert_GetMaxThreads ()
+{
+    Tcl_MutexLock(&convert_lock);
+    if ( convert_pool.max_threads == 0 ) {
+        convert_pool.max_threads = Convert_GetDefaultThreads();
+    }
+    int max_threads = convert_pool.max_threads;
+    Tcl_MutexUnlock(&convert_lock);
+    return max_threads;
+}
+
+/**
+ * Returns the number of parts the conversion of the rowset should be split into.
+ */
+static int
+Convert_GetNumParts (int num_rows, int num_cols)
+{
+    Tcl_WideInt num_parts = (Tcl_WideInt) num_rows * num_cols / CONVERT_MIN_VALUES;
+    if ( num_parts <= 1 ) {
+        return 1;
+    }
+    int max_threads = Convert_GetMaxThreads();
+    if ( num_parts > max_threads ) {
+        num_parts = max_threads;
+    }
+    return (int) ( num_parts < num_rows ? num_parts : num_rows );
+}
+
+/**
+ * Converts rows split into the specified number of parts. The calling thread converts the first part,
+ * the rest are handed over to the pool threads. Returns when all parts have been converted.
+ */
+static void
+Convert_Rows (int num_parts, int num_rows, Convert_Proc * proc, void * data)
+{
+    int part_rows = ( num_rows + num_parts - 1 ) / num_parts;
+    Convert_Part parts[CONVERT_MAX_THREADS];
+    int pending = 0;
+    int num_queued = 0;
+    if ( num_parts > 1 ) {
+        Tcl_MutexLock(&convert_lock);
+        while ( convert_pool.num_threads < num_parts - 1 ) {
+            if ( Tcl_CreateThread(&convert_pool.threads[convert_pool.num_threads], Convert_Worker, NULL, TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) != TCL_OK ) {
+                break;
+            }
+            if ( convert_pool.num_threads++ == 0 ) {
+                Tcl_CreateExitHandler(Convert_Shutdown, NULL);
+            }
+        }
+        if ( convert_pool.num_threads > 0 ) {
+            for ( int part = 1; part < num_parts && part * part_rows < num_rows; part++ ) {
+                Convert_Part * part_ptr = &parts[part];
+                part_ptr->proc        = proc;
+                part_ptr->data        = data;
+                part_ptr->part        = part;
+                part_ptr->first_row   = part * part_rows;
+                part_ptr->end_row     = ( num_rows - part_ptr->first_row < part_rows ? num_rows : part_ptr->first_row + part_rows );
+                part_ptr->pending_ptr = &pending;
+                part_ptr->next        = convert_pool.queue;
+                convert_pool.queue    = part_ptr;
+                ++num_queued;
+            }
+            pending = num_queued;
+            Tcl_ConditionNotify(&convert_pool.work_cond);
+        }
+        Tcl_MutexUnlock(&convert_lock);
+    }
+    // without pool threads the calling thread converts all rows
+    proc(data, 0, 0, num_queued > 0 ? part_rows : num_rows);
+    if ( num_queued > 0 ) {
+        Tcl_MutexLock(&convert_lock);
+        while ( pending > 0 ) {
+            Tcl_ConditionWait(&convert_pool.done_cond, &convert_lock, NULL);
+        }
+        Tcl_MutexUnlock(&convert_lock);
+    }
+}
+
+/**
+ * Rowset that is converted into row lists.
+ */
+typedef struct rows_conversion {
+    Raw_Rowset *            rowset_ptr;
+    dbcapi_column_info *    info;
+    const unsigned char *   binary_formats;
+    Tcl_Obj * *             rows;
+} Rows_Conversion;
+
+static void
+RawRowset_ConvertRows (void * data, int part, int first_row, int end_row)
+{
+    Rows_Conversion * conv_ptr = (Rows_Conversion *) data;
+    for ( int row = first_row; row < end_row; ++row ) {
+        conv_ptr->rows[row] = RawRowset_NewRowObj(conv_ptr->rowset_ptr, row, conv_ptr->info, conv_ptr->binary_formats);
+    }
+}
+
+/**
+ * Creates a list of all rows of the rowset. Large rowsets are converted by the conversion threads.
+ */
+static Tcl_Obj *
+RawRowset_NewRowsObj (Raw_Rowset * rowset_ptr, dbcapi_column_info info[], const unsigned char * binary_formats)
+{
+    int num_rows = rowset_ptr->num_rows;
+    if ( num_rows == 0 ) {
+        return Tcl_NewListObj(0, NULL);
+    }
+    Rows_Conversion conv = { rowset_ptr, info, binary_formats, (Tcl_Obj * *) ckalloc(sizeof(Tcl_Obj *) * num_rows) };
+    Convert_Rows(Convert_GetNumParts(num_rows, rowset_ptr->num_cols), num_rows, RawRowset_ConvertRows, &conv);
+    Tcl_Obj * rows = Tcl_NewListObj(num_rows, conv.rows);
+    ckfree(conv.rows);
+    return rows;
+}
+
+/**
+ * Fetches up to max_rows rows into a rowset and then converts them all at once, so large rowsets could
+ * be converted by the conversion threads. The converted rows take as much memory as `GetRowValues`
+ * would have reserved for them.
+ */
+static int
+FetchRowsetRows (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, dbcapi_column_info info[], int num_cols, int max_rows, const unsigned char * binary_formats, Hdbtcl_Stats * stats_ptr, Hdbtcl_Memory * fetch_ptr, bool * at_end_ptr, Tcl_Obj * * rows_ptr)
+{
+    Raw_Rowset rowset;
+    memset(&rowset, 0, sizeof(Raw_Rowset));
+    rowset.num_cols = num_cols;
+    int res = TCL_OK;
+    Tcl_WideInt started = GetMonotonicTime();
+    while ( rowset.num_rows < max_rows ) {
+        ++stats_ptr->calls;
+        if ( !dbcapi.fetch_next(stmt_state_ptr->stmt) ) {
+            if ( FetchFailed(stmt_state_ptr->conn_state_ptr->conn) ) {
+                ++stats_ptr->errors;
+                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot fetch rows", NULL);
+                Trace_Finish(stmt_state_ptr, -1, Tcl_GetObjResult(interp));
+                res = TCL_ERROR;
+            } else {
+                *at_end_ptr = true;
+            }
+            break;
+        }
+        if ( !RawRowset_AppendRow(&rowset, stmt_state_ptr->stmt) ) {
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot fetch rows", NULL);
+            res = TCL_ERROR;
+            break;
+        }
+        Tcl_WideInt row_size = sizeof(Tcl_Obj) + sizeof(Tcl_Obj *) * ( num_cols + 4 );
+        Tcl_WideInt lob_size = 0;
+        for ( int col = 0; col < num_cols; ++col ) {
+            dbcapi_data_value value;
+            RawRowset_GetValue(&rowset, rowset.num_rows - 1, col, &value);
+            size_t value_size = ( *value.is_null ? 0 : GetValueSize(&value) );
+            if ( value.type == A_BINARY && binary_formats != NULL ) {
+                value_size = Binary_EncodedLength(value_size, binary_formats[col]);
+            }
+            if ( info[col].max_size == INT32_MAX ) {
+                lob_size += sizeof(Tcl_Obj) + value_size;
+            } else {
+                row_size += sizeof(Tcl_Obj) + value_size;
+            }
+        }
+        if ( Memory_Reserve(stmt_state_ptr, interp, fetch_ptr, MEMORY_ROWS, row_size) != TCL_OK
+          || ( lob_size > 0 && Memory_Reserve(stmt_state_ptr, interp, fetch_ptr, MEMORY_LOBS, lob_size) != TCL_OK )
+        ) {
+            res = TCL_ERROR;
+            break;
+        }
+    }
+    Tcl_WideInt converting = GetMonotonicTime();
+    stats_ptr->fetch_time += converting - started;
+    stats_ptr->rows += rowset.num_rows;
+    stats_ptr->bytes += rowset.value_bytes;
+    if ( res == TCL_OK ) {
+        // fetched rows are held by the statement until they are converted
+        Tcl_WideInt raw_size = RawRowset_GetSize(&rowset);
+        Memory_Add(stmt_state_ptr, MEMORY_ROWS, raw_size);
+        *rows_ptr = RawRowset_NewRowsObj(&rowset, info, binary_formats);
+        Memory_Add(stmt_state_ptr, MEMORY_ROWS, -raw_size);
+        stats_ptr->convert_time += GetMonotonicTime() - converting;
+    }
+    RawRowset_Free(&rowset);
+    return res;
+}
+
+/**
+ * Types of asynchronous requests.
+ */
+typedef enum async_job_type {
+    ASYNC_EXECUTE,
+    ASYNC_FETCH,
+    ASYNC_QUERY         /// execute and fetch all rows
+} Async_Job_Type;
+
+/**
+ * States of an asynchronous request.
+ */
+typedef enum async_job_state {
+    ASYNC_QUEUED,       /// submitted to the worker, but the worker has not picked it up yet
+    ASYNC_RUNNING,      /// worker is executing the request
+    ASYNC_DONE          /// worker has completed the request and posted the completion event
+} Async_Job_State;
+
+/**
+ * Asynchronous request executed by the connection worker thread.
+ */
+typedef struct async_job {
+    Async_Job_Type      type;
+    Async_Job_State     state;
+    Stmt_State *        stmt_state_ptr; /// NULL when the statement has been closed before the request completed
+    Tcl_Interp *        interp;
+    Tcl_ThreadId        owner;          /// thread that submitted the request and that will process the completion event
+    Tcl_Obj *           command;        /// completion callback
+    int                 timeout;
+    bool                cancelled;      /// cancellation has been requested by the statement
+    bool                timed_out;
+    bool                success;
+    const char *        error_message;
+    int                 error_code;
+    char *              error_reason;
+    Tcl_WideInt         elapsed;        /// time (us) the worker spent on the request
+    Hdbtcl_Stats        stats;          /// counters of the worker part of the request
+    struct parallel_batch * batch;      /// batch of parallel jobs the job belongs to
+    struct async_job *  next;           /// next completed job of the batch
+    int                 index;          /// position of the job in the batch
+    Tcl_WideInt         memory_limit;   /// bytes fetched rows may take, 0 - no limit
+    Hdbtcl_Memory       memory;         /// memory the request holds on behalf of the statement
+    Stmt_Arena          arena;          /// converted string arguments
+    // execute
+    int                 argc;
+    Tcl_Obj * *         argv;
+    dbcapi_bool *       is_null;
+    PrimitiveSqlValue * sql_args;
+    int                 affected_rows;
+    // fetch
+    int                 max_rows;
+    dbcapi_column_info* info;
+    unsigned char *     binary_formats; /// formats of binary columns, NULL - byte arrays
+    Raw_Rowset          rows;
+    // completion
+    void             (* done_proc) (struct async_job *);  /// completes the request instead of the callback
+    void *              done_data;
+} Async_Job;
+
+/**
+ * Event that delivers the completed asynchronous request to the thread that submitted it.
+ */
+typedef struct async_event {
+    Tcl_Event           header;
+    Async_Job *         job;
+} Async_Event;
+
+/**
+ * Releases the asynchronous request.
+ */
+static void
+Async_FreeJob (Async_Job * job)
+{
+    if ( job->argv != NULL ) {
+        for ( int i = 0; i < job->argc; i++ ) {
+            Tcl_DecrRefCount(job->argv[i]);
+        }
+        ckfree(job->argv);
+    }
+    if ( job->is_null      != NULL ) ckfree(job->is_null);
+    if ( job->sql_args     != NULL ) ckfree(job->sql_args);
+    if ( job->info         != NULL ) ckfree(job->info);
+    if ( job->binary_formats != NULL ) ckfree(job->binary_formats);
+    if ( job->error_reason != NULL ) ckfree(job->error_reason);
+    if ( job->command      != NULL ) Tcl_DecrRefCount(job->command);
+    RawRowset_Free(&job->rows);
+    Arena_Free(&job->arena);
+    ckfree(job);
+}
+
+/**
+ * Saves the DBCAPI error, so it could be reported when the request completion is processed.
+ */
+static void
+Async_SaveError (Async_Job * job, dbcapi_connection * conn, const char * message)
+{
+    job->error_message = message;
+    size_t msg_size = dbcapi.error_length(conn);
+    job->error_reason = ckalloc(msg_size + 1);
+    job->error_code = dbcapi.error(conn, job->error_reason, msg_size);
+    job->error_reason[msg_size] = '\0';
+    job->success = false;
+}
+
+/**
+ * Checks whether the statement has requested cancellation of the request.
+ */
+static bool
+Async_IsCancelled (Async_Job * job, Conn_State * conn_state_ptr)
+{
+    Tcl_MutexLock(&conn_state_ptr->worker_lock);
+    bool cancelled = job->cancelled;
+    Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+    return cancelled;
+}
+
+/**
+ * Executes the statement.
+ */
+static bool
+Async_ExecuteStmt (Async_Job * job, Conn_State * conn_state_ptr, dbcapi_stmt * stmt)
+{
+    Watchdog_Timer timer;
+    if ( !Watchdog_Arm(&timer, conn_state_ptr->conn, job->timeout) ) {
+        job->error_message = "cannot start the watchdog thread";
+        job->success = false;
+        return false;
+    }
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool executed = dbcapi.execute(stmt);
+    job->stats.execute_time += GetMonotonicTime() - started;
+    job->stats.executes += 1;
+    job->stats.calls += 1;
+    job->stats.errors += !executed;
+    job->timed_out = Watchdog_Disarm(&timer);
+    if ( !executed ) {
+        Async_SaveError(job, conn_state_ptr->conn, "Cannot execute SQL");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Fetches up to max_rows rows into the job rowset.
+ */
+static void
+Async_FetchRows (Async_Job * job, Conn_State * conn_state_ptr, dbcapi_stmt * stmt)
+{
+    for ( int col = 0; col < job->rows.num_cols; ++col ) {
+        if ( !dbcapi.get_column_info(stmt, col, &job->info[col]) ) {
+            Async_SaveError(job, conn_state_ptr->conn, "Cannot retrieve column info");
+            return;
+        }
+    }
+    int num_rows = job->rows.num_rows;
+    Tcl_WideInt started = GetMonotonicTime();
+    job->stats.fetches += 1;
+    while ( job->rows.num_rows < job->max_rows ) {
+        ++job->stats.calls;
+        if ( !dbcapi.fetch_next(stmt) ) {
+            // errors (a lost connection, for instance) must not be mistaken for the end of the result set
+            if ( !Async_IsCancelled(job, conn_state_ptr) && FetchFailed(conn_state_ptr->conn) ) {
+                ++job->stats.errors;
+                Async_SaveError(job, conn_state_ptr->conn, "Cannot fetch rows");
+            }
+            break;
+        }
+        if ( !RawRowset_AppendRow(&job->rows, stmt) ) {
+            Async_SaveError(job, conn_state_ptr->conn, "Cannot fetch rows");
+            break;
+        }
+        if ( job->memory_limit > 0 && (Tcl_WideInt) RawRowset_GetSize(&job->rows) > job->memory_limit ) {
+            job->error_message = "Fetched data exceed the memory limit";
+            job->success = false;
+            break;
+        }
+        if ( Async_IsCancelled(job, conn_state_ptr) ) {
+            break;
+        }
+    }
+    job->stats.fetch_time += GetMonotonicTime() - started;
+    job->stats.rows += job->rows.num_rows - num_rows;
+    if ( !job->success ) {
+        return;
+    }
+    if ( Async_IsCancelled(job, conn_state_ptr) ) {
+        // fetch_next also returns false when it was interrupted
+        job->success = false;
+    }
+}
+
+/**
+ * Executes DBCAPI part of the asynchronous request.
+ *
+ * \note This function runs in the worker thread and thus must not use interpreter or TCL objects.
+ */
+static void
+Async_RunJob (Async_Job * job, Conn_State * conn_state_ptr, dbcapi_stmt * stmt)
+{
+    job->success = true;
+    switch ( job->type ) {
+        case ASYNC_EXECUTE: {
+            Async_ExecuteStmt(job, conn_state_ptr, stmt);
+            break;
+        }
+        case ASYNC_FETCH: {
+            Async_FetchRows(job, conn_state_ptr, stmt);
+            break;
+        }
+        case ASYNC_QUERY: {
+            if ( !Async_ExecuteStmt(job, conn_state_ptr, stmt) ) {
+                break;
+            }
+            int num_cols = dbcapi.num_cols(stmt);
+            if ( num_cols < 0 ) {
+                Async_SaveError(job, conn_state_ptr->conn, "Cannot retrieve the number of result set columns");
+            } else if ( num_cols == 0 ) {
+                job->affected_rows = dbcapi.affected_rows(stmt);
+            } else {
+                job->rows.num_cols = num_cols;
+                job->info = (dbcapi_column_info *) ckalloc(sizeof(dbcapi_column_info) * num_cols);
+                Async_FetchRows(job, conn_state_ptr, stmt);
+            }
+            break;
+        }
+    }
+}
+
+static void Parallel_Complete (Async_Job * job);
+
+static int Async_EventProc (Tcl_Event * event_ptr, int flags);
+
+/**
+ * Connection worker thread.
+ *
+ * The worker waits for asynchronous requests and executes them one at a time. When the request is
+ * completed the worker posts the completion event to the thread that submitted the request.
+ */
+static Tcl_ThreadCreateType
+Async_Worker (ClientData client_data)
+{
+    Conn_State * conn_state_ptr = (Conn_State *) client_data;
+
+    Tcl_MutexLock(&conn_state_ptr->worker_lock);
+    while ( !conn_state_ptr->worker_exit ) {
+        Async_Job * job = conn_state_ptr->job;
+        if ( job == NULL || job->state != ASYNC_QUEUED ) {
+            Tcl_ConditionWait(&conn_state_ptr->worker_cond, &conn_state_ptr->worker_lock, NULL);
+            continue;
+        }
+        job->state = ASYNC_RUNNING;
+        dbcapi_stmt * stmt = job->stmt_state_ptr->stmt;
+        bool cancelled = job->cancelled;
+        Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+
+        Tcl_Time started, finished;
+        Tcl_GetTime(&started);
+        if ( cancelled ) {
+            job->success = false;
+        } else {
+            Async_RunJob(job, conn_state_ptr, stmt);
+        }
+        Tcl_GetTime(&finished);
+        job->elapsed = ( (Tcl_WideInt) finished.sec - started.sec ) * 1000000 + ( finished.usec - started.usec );
+
+        Tcl_MutexLock(&conn_state_ptr->worker_lock);
+        job->state = ASYNC_DONE;
+        Tcl_ConditionNotify(&conn_state_ptr->worker_cond);
+        // Note that once the job is handed over it belongs to the submitting thread
+        if ( job->batch != NULL ) {
+            Parallel_Complete(job);
+        } else {
+            Async_Event * event = (Async_Event *) ckalloc(sizeof(Async_Event));
+            event->header.proc = Async_EventProc;
+            event->job = job;
+            Tcl_ThreadQueueEvent(job->owner, (Tcl_Event *) event, TCL_QUEUE_TAIL);
+            Tcl_ThreadAlert(job->owner);
+        }
+    }
+    Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/**
+ * Waits until the worker completes the current asynchronous request of the connection.
+ */
+static void
+Async_Wait (Conn_State * conn_state_ptr)
+{
+    Tcl_MutexLock(&conn_state_ptr->worker_lock);
+    while ( conn_state_ptr->job != NULL && conn_state_ptr->job->state != ASYNC_DONE ) {
+        Tcl_ConditionWait(&conn_state_ptr->worker_cond, &conn_state_ptr->worker_lock, NULL);
+    }
+    Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+}
+
+/**
+ * Detaches the statement that is being deleted from the asynchronous request.
+ *
+ * As the statement cannot be released while the worker might be using the connection, this waits for
+ * the current request to complete. If the request was made by this statement, the request is orphaned
+ * and its completion event will be discarded.
+ */
+static void
+Async_Detach (Stmt_State * stmt_state_ptr)
+{
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    if ( conn_state_ptr->job == NULL ) {
+        return;
+    }
+    Async_Wait(conn_state_ptr);
+    if ( conn_state_ptr->job->stmt_state_ptr == stmt_state_ptr ) {
+        conn_state_ptr->job->stmt_state_ptr = NULL;
+        conn_state_ptr->job = NULL;
+    }
+}
+
+/**
+ * Waits for the outstanding asynchronous request to complete and orphans it, so its completion event
+ * would be discarded. The connection worker thread keeps running.
+ */
+static void
+Async_Abandon (Conn_State * conn_state_ptr)
+{
+    if ( conn_state_ptr->job != NULL ) {
+        Async_Wait(conn_state_ptr);
+        conn_state_ptr->job->stmt_state_ptr = NULL;
+        conn_state_ptr->job = NULL;
+    }
+}
+
+/**
+ * Waits for the outstanding asynchronous request to complete and stops the connection worker thread.
+ */
+static void
+Async_Shutdown (Conn_State * conn_state_ptr)
+{
+    Async_Abandon(conn_state_ptr);
+    if ( conn_state_ptr->worker != NULL ) {
+        Tcl_MutexLock(&conn_state_ptr->worker_lock);
+        conn_state_ptr->worker_exit = true;
+        Tcl_ConditionNotify(&conn_state_ptr->worker_cond);
+        Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+
+        int result;
+        Tcl_JoinThread(conn_state_ptr->worker, &result);
+        conn_state_ptr->worker = NULL;
+        conn_state_ptr->worker_exit = false;
+    }
+    Tcl_ConditionFinalize(&conn_state_ptr->worker_cond);
+    Tcl_MutexFinalize(&conn_state_ptr->worker_lock);
+}
+
+/**
+ * Reports an error if the connection is executing an asynchronous request.
+ */
+static int
+Async_CheckIdle (Conn_State * conn_state_ptr, Tcl_Interp * interp)
+{
+    if ( conn_state_ptr->job != NULL ) {
+        Tcl_SetResult(interp, "connection is busy executing an asynchronous request", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Creates a new asynchronous request.
+ */
+static Async_Job *
+Async_NewJob (Async_Job_Type type, Tcl_Obj * command)
+{
+    Async_Job * job = (Async_Job *) ckalloc(sizeof(Async_Job));
+    memset(job, 0, sizeof(Async_Job));
+    job->type = type;
+    job->command = command;
+    if ( command != NULL ) {
+        Tcl_IncrRefCount(command);
+    }
+    return job;
+}
+
+/**
+ * Hands the request over to the connection worker. Starts the worker if it is not running yet.
+ */
+static int
+Async_Submit (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Async_Job * job)
+{
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    if ( conn_state_ptr->worker == NULL ) {
+        if ( Tcl_CreateThread(&conn_state_ptr->worker, Async_Worker, (ClientData) conn_state_ptr, TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) != TCL_OK ) {
+            conn_state_ptr->worker = NULL;
+            Async_FreeJob(job);
+            Tcl_SetResult(interp, "cannot create connection worker thread", TCL_STATIC);
+            return TCL_ERROR;
+        }
+    }
+    job->stmt_state_ptr = stmt_state_ptr;
+    job->interp = interp;
+    job->owner = Tcl_GetCurrentThread();
+    job->state = ASYNC_QUEUED;
+    job->memory_limit = Memory_GetFetchLimit(conn_state_ptr);
+    if ( job->memory.params != 0 ) {
+        Memory_Add(stmt_state_ptr, MEMORY_PARAMS, job->memory.params);
+    }
+
+    Tcl_MutexLock(&conn_state_ptr->worker_lock);
+    conn_state_ptr->job = job;
+    Tcl_ConditionNotify(&conn_state_ptr->worker_cond);
+    Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+    return TCL_OK;
+}
+
+/**
+ * Creates the error message of the failed request.
+ */
+static Tcl_Obj *
+Async_NewErrorObj (Async_Job * job)
+{
+    const char * message = (
+        job->timed_out ? "Statement execution timed out" :
+        job->cancelled ? "Statement execution was cancelled" :
+        job->error_message
+    );
+    if ( job->error_reason != NULL ) {
+        return Tcl_ObjPrintf("%s - Code: %d Reason: %s", message, job->error_code, job->error_reason);
+    }
+    return Tcl_NewStringObj(message, -1);
+}
+
+/**
+ * Processes the completed asynchronous request - finishes the parts of it that need the interpreter
+ * and calls the completion callback.
+ */
+static int
+Async_EventProc (Tcl_Event * event_ptr, int flags)
+{
+    if ( (flags & TCL_FILE_EVENTS) == 0 ) {
+        return 0;
+    }
+    Async_Job * job = ((Async_Event *) event_ptr)->job;
+    Stmt_State * stmt_state_ptr = job->stmt_state_ptr;
+    if ( stmt_state_ptr == NULL ) {
+        Async_FreeJob(job);
+        return 1;
+    }
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    Tcl_MutexLock(&conn_state_ptr->worker_lock);
+    conn_state_ptr->job = NULL;
+    Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+    if ( job->done_proc != NULL ) {
+        job->done_proc(job);
+        return 1;
+    }
+
+    Tcl_Interp * interp = job->interp;
+    Tcl_Preserve(interp);
+
+    Tcl_WideInt converting = GetMonotonicTime();
+    Memory_Release(stmt_state_ptr, &job->memory);
+    // fetched rows are held by the statement until they are converted
+    Tcl_WideInt raw_size = RawRowset_GetSize(&job->rows);
+    Memory_Add(stmt_state_ptr, MEMORY_ROWS, raw_size);
+
+    Tcl_Obj * result = NULL;
+    if ( !job->success ) {
+        result = Async_NewErrorObj(job);
+    } else if ( job->type == ASYNC_EXECUTE ) {
+        Tcl_ResetResult(interp);
+        if ( SendStmtInput(stmt_state_ptr, interp, job->argc, job->argv) != TCL_OK ) {
+            job->success = false;
+            result = Tcl_GetObjResult(interp);
+        } else {
+            result = Tcl_NewObj();
+        }
+    } else {
+        result = RawRowset_NewRowsObj(&job->rows, job->info, job->binary_formats);
+        job->stats.bytes += job->rows.value_bytes;
+        job->stats.convert_time += GetMonotonicTime() - converting;
+    }
+    Memory_Add(stmt_state_ptr, MEMORY_ROWS, -raw_size);
+    Stats_Record(conn_state_ptr, stmt_state_ptr, &job->stats);
+    if ( !job->success ) {
+        Trace_Finish(stmt_state_ptr, -1, result);
+    } else if ( job->type == ASYNC_EXECUTE ) {
+        Trace_Executed(stmt_state_ptr);
+    } else if ( job->rows.num_rows < job->max_rows ) {
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+    }
+
+    Tcl_Obj * cmd = Tcl_DuplicateObj(job->command);
+    Tcl_IncrRefCount(cmd);
+    int res = Tcl_ListObjAppendElement(interp, cmd, Tcl_NewStringObj(job->success ? "ok" : "error", -1));
+    if ( res == TCL_OK ) {
+        res = Tcl_ListObjAppendElement(interp, cmd, result);
+    }
+    Async_FreeJob(job);
+    if ( res == TCL_OK ) {
+        res = Tcl_EvalObjEx(interp, cmd, TCL_EVAL_GLOBAL);
+    }
+    Tcl_DecrRefCount(cmd);
+    if ( res != TCL_OK ) {
+        Tcl_BackgroundException(interp, res);
+    }
+    Tcl_Release(interp);
+    return 1;
+}
+
+/**
+ * Matches the completion event of the request.
+ */
+static int
+Async_IsJobEvent (Tcl_Event * event_ptr, ClientData client_data)
+{
+    return event_ptr->proc == Async_EventProc && ((Async_Event *) event_ptr)->job == (Async_Job *) client_data;
+}
+
+/**
+ * Waits for the current asynchronous request of the connection and processes its completion right
+ * away instead of leaving it to the event loop. The request must not be a part of a parallel batch.
+ */
+static void
+Async_Complete (Conn_State * conn_state_ptr)
+{
+    Async_Job * job = conn_state_ptr->job;
+    Async_Wait(conn_state_ptr);
+    // the worker has queued the completion event before it marked the request done
+    Tcl_DeleteEvents(Async_IsJobEvent, (ClientData) job);
+    Async_Event event = { .header = { .proc = Async_EventProc }, .job = job };
+    Async_EventProc((Tcl_Event *) &event, TCL_FILE_EVENTS);
+}
+
+/**
+ * Binds statement arguments into the buffers of the request. Only IN parameters can be bound.
+ * `usage` names the kind of the request for the error message.
+ */
+static int
+Async_BindArgs (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Async_Job * job, int objc, Tcl_Obj * const objv[], const char * usage)
+{
+    // bound buffers must outlive this call
+    job->is_null  = (dbcapi_bool *) ckalloc(sizeof(dbcapi_bool) * (objc + 1));
+    job->sql_args = (PrimitiveSqlValue *) ckalloc(sizeof(PrimitiveSqlValue) * (objc + 1));
+
+    // OUT parameters are rejected before anything is bound into the job buffers; BindStmtArgs reports
+    // a mismatched number of arguments
+    int num_params = dbcapi.num_params(stmt_state_ptr->stmt);
+    for ( int i = 0; i < objc && i < num_params; i++ ) {
+        dbcapi_bind_param_info info;
+        if ( !dbcapi.get_bind_param_info(stmt_state_ptr->stmt, i, &info) ) {
+            char num[12];
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve information about SQL parameter [", itoa(i, num, 10), "]", NULL);
+            return TCL_ERROR;
+        }
+        if ( info.direction != DD_INPUT ) {
+            char num[12];
+            Tcl_AppendResult(interp, "Parameter [", itoa(i, num, 10), "] is an OUT parameter, which cannot be used by ", usage, NULL);
+            return TCL_ERROR;
+        }
+    }
+    if ( BindStmtArgs(stmt_state_ptr, interp, objc, objv, job->is_null, job->sql_args, &job->arena, NULL) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    // Arguments are kept until the request is completed as bound string and binary buffers point into them
+    job->argc = objc;
+    job->argv = (Tcl_Obj * *) ckalloc(sizeof(Tcl_Obj *) * (objc + 1));
+    for ( int i = 0; i < objc; i++ ) {
+        job->argv[i] = objv[i];
+        Tcl_IncrRefCount(objv[i]);
+    }
+    return TCL_OK;
+}
+
+/**
+ * Binds statement arguments and submits the statement for asynchronous execution.
+ */
+static int
+Async_Execute (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Tcl_Obj * command, int objc, Tcl_Obj * const objv[])
+{
+    Async_Job * job = Async_NewJob(ASYNC_EXECUTE, command);
+    job->timeout = GetStmtTimeout(stmt_state_ptr);
+    if ( Async_BindArgs(stmt_state_ptr, interp, job, objc, objv, "an asynchronous execution") != TCL_OK ) {
+        Async_FreeJob(job);
+        return TCL_ERROR;
+    }
+    // bound buffers and the arguments they point into are kept until the request is completed
+    job->memory.params = ( sizeof(dbcapi_bool) + sizeof(PrimitiveSqlValue) + sizeof(Tcl_Obj *) ) * ( objc + 1 );
+    for ( int i = 0; i < objc; i++ ) {
+        job->memory.params += objv[i]->length;
+    }
+    Stmt_ClearColumnObjs(stmt_state_ptr);
+    Trace_Start(stmt_state_ptr, objc);
+    return Async_Submit(stmt_state_ptr, interp, job);
+}
+
+/**
+ * Submits the request to fetch rows from the result set to the connection worker.
+ */
+static int
+Async_FetchMany (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, Tcl_Obj * command, int max_rows, Tcl_Obj * binary_as)
+{
+    int num_cols = GetResultNumCols(stmt_state_ptr, interp);
+    if ( num_cols < 0 ) {
+        return TCL_ERROR;
+    }
+    unsigned char * binary_formats = NULL;
+    if ( binary_as != NULL ) {
+        binary_formats = (unsigned char *) ckalloc(num_cols);
+        if ( GetBinaryFormatsFromObj(interp, binary_as, num_cols, binary_formats) != TCL_OK ) {
+            ckfree(binary_formats);
+            return TCL_ERROR;
+        }
+    }
+    Async_Job * job = Async_NewJob(ASYNC_FETCH, command);
+    job->binary_formats = binary_formats;
+    job->max_rows = max_rows;
+    job->rows.num_cols = num_cols;
+    job->info = (dbcapi_column_info *) ckalloc(sizeof(dbcapi_column_info) * num_cols);
+    return Async_Submit(stmt_state_ptr, interp, job);
+}
+
+/**
+ * State of the channel that reads rows of the statement result set as text.
+ */
+typedef struct rowset_channel {
+    Tcl_Channel         channel;
+    Tcl_Interp *        interp;
+    Stmt_State *        stmt_state_ptr; /// NULL when the statement has been closed
+    Export_Format       format;
+    int                 num_cols;
+    dbcapi_column_info* info;
+    unsigned char *     binary_formats;
+    dbcapi_data_value * values;         /// values of the row that is being rendered
+    Tcl_DString         keys;           /// JSON keys of the columns
+    int *               key_ends;
+    Tcl_DString         text;           /// rendered rows
+    int                 text_offset;    /// start of the text that has not been read yet
+    int                 batch_size;     /// number of rows the connection worker fetches at once
+    Async_Job *         job;            /// outstanding request that fetches the next batch of rows
+    Tcl_Obj *           error;          /// error of the last fetch that has not been reported yet
+    bool                at_end;
+    bool                blocking;
+    int                 watch_mask;
+    Tcl_TimerToken      timer;
+} Rowset_Channel;
+
+/**
+ * Drops the text that has been read, so the next rows are appended to the unread rest.
+ */
+static void
+RowsetChannel_Compact (Rowset_Channel * ch_ptr)
+{
+    int unread = Tcl_DStringLength(&ch_ptr->text) - ch_ptr->text_offset;
+    if ( ch_ptr->text_offset > 0 ) {
+        memmove(Tcl_DStringValue(&ch_ptr->text), Tcl_DStringValue(&ch_ptr->text) + ch_ptr->text_offset, unread);
+        Tcl_DStringSetLength(&ch_ptr->text, unread);
+        ch_ptr->text_offset = 0;
+    }
+}
+
+/**
+ * Renders the row and appends it to the text.
+ */
+static void
+RowsetChannel_AppendRow (Rowset_Channel * ch_ptr, dbcapi_data_value values[], Tcl_DString * text)
+{
+    if ( ch_ptr->format == EXPORT_NDJSON ) {
+        const char * key_text = Tcl_DStringValue(&ch_ptr->keys);
+        for ( int col = 0; col < ch_ptr->num_cols; ++col ) {
+            int key_start = ( col == 0 ? 0 : ch_ptr->key_ends[col - 1] );
+            Tcl_DStringAppend(text, key_text + key_start, ch_ptr->key_ends[col] - key_start);
+            AppendJsonValue(text, &values[col], ch_ptr->info[col].native_type, ch_ptr->binary_formats[col]);
+        }
+        Tcl_DStringAppend(text, "}\n", 2);
+        return;
+    }
+    for ( int col = 0; col < ch_ptr->num_cols; ++col ) {
+        if ( col > 0 ) {
+            Tcl_DStringAppend(text, ch_ptr->format == EXPORT_TSV ? "\t" : ",", 1);
+        }
+        dbcapi_data_value * value = &values[col];
+        if ( *value->is_null ) {
+            continue;
+        }
+        if ( value->type == A_STRING ) {
+            // the channel text is UTF-8, so strings are copied as they were fetched
+            AppendDelimitedText(text, value->buffer, *value->length, ch_ptr->format);
+        } else if ( value->type == A_BINARY && ch_ptr->info[col].native_type == NATIVE_TYPE_REAL_VECTOR ) {
+            Tcl_DString vector;
+            Tcl_DStringInit(&vector);
+            AppendVectorText(&vector, (unsigned char *) value->buffer, *value->length);
+            AppendDelimitedText(text, Tcl_DStringValue(&vector), Tcl_DStringLength(&vector), ch_ptr->format);
+            Tcl_DStringFree(&vector);
+        } else if ( value->type == A_BINARY ) {
+            AppendBinaryText(text, (unsigned char *) value->buffer, *value->length, ch_ptr->binary_formats[col]);
+        } else {
+            Tcl_Obj * obj = NewColumnValueObj(value, ch_ptr->info[col].native_type, BINARY_AS_BYTES);
+            Tcl_IncrRefCount(obj);
+            AppendDelimitedValue(text, obj, ch_ptr->format);
+            Tcl_DecrRefCount(obj);
+        }
+    }
+    Tcl_DStringAppend(text, "\n", 1);
+}
+
+/**
+ * Saves the error, so it would be reported by the next read.
+ */
+static void
+RowsetChannel_SaveError (Rowset_Channel * ch_ptr, Tcl_Obj * error)
+{
+    if ( ch_ptr->error != NULL ) {
+        Tcl_DecrRefCount(ch_ptr->error);
+    }
+    ch_ptr->error = error;
+    Tcl_IncrRefCount(error);
+}
+
+/**
+ * Fetches and renders rows until the channel has at least `min_bytes` of unread text or the result
+ * set ends. Used when the channel is in the blocking mode. Saves an error instead if the connection
+ * is executing an asynchronous request, as the connection cannot be used by two threads at once.
+ */
+static void
+RowsetChannel_FetchRows (Rowset_Channel * ch_ptr, int min_bytes)
+{
+    Stmt_State * stmt_state_ptr = ch_ptr->stmt_state_ptr;
+    if ( Async_CheckIdle(stmt_state_ptr->conn_state_ptr, ch_ptr->interp) != TCL_OK ) {
+        RowsetChannel_SaveError(ch_ptr, Tcl_GetObjResult(ch_ptr->interp));
+        Tcl_ResetResult(ch_ptr->interp);
+        return;
+    }
+    Hdbtcl_Stats delta = { .fetches = 1 };
+    RowsetChannel_Compact(ch_ptr);
+    Tcl_WideInt now = GetMonotonicTime();
+    while ( Tcl_DStringLength(&ch_ptr->text) < min_bytes ) {
+        dbcapi_bool fetched = dbcapi.fetch_next(stmt_state_ptr->stmt);
+        Tcl_WideInt converting = GetMonotonicTime();
+        delta.fetch_time += converting - now;
+        ++delta.calls;
+        if ( !fetched ) {
+            if ( FetchFailed(stmt_state_ptr->conn_state_ptr->conn) ) {
+                ++delta.errors;
+                SetErrorResult(ch_ptr->interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot fetch rows", NULL);
+                RowsetChannel_SaveError(ch_ptr, Tcl_GetObjResult(ch_ptr->interp));
+                Tcl_ResetResult(ch_ptr->interp);
+            } else {
+                ch_ptr->at_end = true;
+            }
+            break;
+        }
+        ++delta.rows;
+        for ( int col = 0; col < ch_ptr->num_cols; ++col ) {
+            if ( !dbcapi.get_column(stmt_state_ptr->stmt, col, &ch_ptr->values[col]) ) {
+                char num[12];
+                SetErrorResult(ch_ptr->interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] data", NULL);
+                RowsetChannel_SaveError(ch_ptr, Tcl_GetObjResult(ch_ptr->interp));
+                Tcl_ResetResult(ch_ptr->interp);
+                break;
+            }
+            if ( !*ch_ptr->values[col].is_null ) {
+                delta.bytes += GetValueSize(&ch_ptr->values[col]);
+            }
+        }
+        if ( ch_ptr->error != NULL ) {
+            break;
+        }
+        RowsetChannel_AppendRow(ch_ptr, ch_ptr->values, &ch_ptr->text);
+        now = GetMonotonicTime();
+        delta.convert_time += now - converting;
+    }
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta);
+    if ( ch_ptr->error != NULL ) {
+        Trace_Finish(stmt_state_ptr, -1, ch_ptr->error);
+    } else if ( ch_ptr->at_end ) {
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+    }
+}
+
+/**
+ * Timer callback that tells the channel readers that the channel can be read.
+ */
+static void
+RowsetChannel_TimerProc (ClientData client_data)
+{
+    Rowset_Channel * ch_ptr = (Rowset_Channel *) client_data;
+    ch_ptr->timer = NULL;
+    Tcl_NotifyChannel(ch_ptr->channel, TCL_READABLE);
+}
+
+/**
+ * Schedules the notification of the channel readers.
+ */
+static void
+RowsetChannel_ScheduleNotify (Rowset_Channel * ch_ptr)
+{
+    if ( ch_ptr->timer == NULL ) {
+        ch_ptr->timer = Tcl_CreateTimerHandler(0, RowsetChannel_TimerProc, (ClientData) ch_ptr);
+    }
+}
+
+/**
+ * Rows the connection worker has fetched for the channel. The first part of the conversion renders its
+ * rows directly into the channel text, the others into their own texts.
+ */
+typedef struct rowset_channel_rendering {
+    Rowset_Channel *    ch_ptr;
+    Async_Job *         job;
+    Tcl_DString *       texts;
+} RowsetChannel_Rendering;
+
+static void
+RowsetChannel_RenderRows (void * data, int part, int first_row, int end_row)
+{
+    RowsetChannel_Rendering * rendering_ptr = (RowsetChannel_Rendering *) data;
+    Rowset_Channel * ch_ptr = rendering_ptr->ch_ptr;
+    Tcl_DString * text = ( part == 0 ? &ch_ptr->text : &rendering_ptr->texts[part] );
+    dbcapi_data_value * values = ( part == 0 ? ch_ptr->values : (dbcapi_data_value *) ckalloc(sizeof(dbcapi_data_value) * ch_ptr->num_cols) );
+    for ( int row = first_row; row < end_row; ++row ) {
+        for ( int col = 0; col < ch_ptr->num_cols; ++col ) {
+            RawRowset_GetValue(&rendering_ptr->job->rows, row, col, &values[col]);
+        }
+        RowsetChannel_AppendRow(ch_ptr, values, text);
+    }
+    if ( part != 0 ) {
+        ckfree(values);
+    }
+}
+
+/**
+ * Renders rows the connection worker has fetched for the channel in the non-blocking mode and notifies
+ * the channel readers. The job is completed even if the channel has been closed meanwhile.
+ */
+static void
+RowsetChannel_Fetched (Async_Job * job)
+{
+    Stmt_State * stmt_state_ptr = job->stmt_state_ptr;
+    Rowset_Channel * ch_ptr = (Rowset_Channel *) job->done_data;
+    Tcl_WideInt converting = GetMonotonicTime();
+    Memory_Release(stmt_state_ptr, &job->memory);
+    Tcl_Obj * error = NULL;
+    if ( !job->success ) {
+        error = Async_NewErrorObj(job);
+        Tcl_IncrRefCount(error);
+    }
+    if ( ch_ptr != NULL ) {
+        ch_ptr->job = NULL;
+        if ( error != NULL ) {
+            RowsetChannel_SaveError(ch_ptr, error);
+        } else {
+            RowsetChannel_Compact(ch_ptr);
+            Tcl_DString texts[CONVERT_MAX_THREADS];
+            int num_parts = Convert_GetNumParts(job->rows.num_rows, ch_ptr->num_cols);
+            for ( int i = 1; i < num_parts; i++ ) {
+                Tcl_DStringInit(&texts[i]);
+            }
+            RowsetChannel_Rendering rendering = { ch_ptr, job, texts };
+            Convert_Rows(num_parts, job->rows.num_rows, RowsetChannel_RenderRows, &rendering);
+            for ( int i = 1; i < num_parts; i++ ) {
+                Tcl_DStringAppend(&ch_ptr->text, Tcl_DStringValue(&texts[i]), Tcl_DStringLength(&texts[i]));
+                Tcl_DStringFree(&texts[i]);
+            }
+            ch_ptr->at_end = ( job->rows.num_rows < job->max_rows );
+        }
+        if ( ch_ptr->watch_mask & TCL_READABLE ) {
+            RowsetChannel_ScheduleNotify(ch_ptr);
+        }
+    }
+    job->stats.bytes += job->rows.value_bytes;
+    job->stats.convert_time += GetMonotonicTime() - converting;
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &job->stats);
+    if ( error != NULL ) {
+        Trace_Finish(stmt_state_ptr, -1, error);
+        Tcl_DecrRefCount(error);
+    } else if ( job->rows.num_rows < job->max_rows ) {
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+    }
+    Async_FreeJob(job);
+}
+
+/**
+ * Submits the request to fetch the next batch of rows to the connection worker.
+ */
+static void
+RowsetChannel_Submit (Rowset_Channel * ch_ptr)
+{
+    Stmt_State * stmt_state_ptr = ch_ptr->stmt_state_ptr;
+    if ( Async_CheckIdle(stmt_state_ptr->conn_state_ptr, ch_ptr->interp) != TCL_OK ) {
+        RowsetChannel_SaveError(ch_ptr, Tcl_GetObjResult(ch_ptr->interp));
+        Tcl_ResetResult(ch_ptr->interp);
+        return;
+    }
+    Async_Job * job = Async_NewJob(ASYNC_FETCH, NULL);
+    job->max_rows = ch_ptr->batch_size;
+    job->rows.num_cols = ch_ptr->num_cols;
+    job->info = (dbcapi_column_info *) ckalloc(sizeof(dbcapi_column_info) * ch_ptr->num_cols);
+    job->done_proc = RowsetChannel_Fetched;
+    job->done_data = ch_ptr;
+    if ( Async_Submit(stmt_state_ptr, ch_ptr->interp, job) != TCL_OK ) {
+        RowsetChannel_SaveError(ch_ptr, Tcl_GetObjResult(ch_ptr->interp));
+        Tcl_ResetResult(ch_ptr->interp);
+        return;
+    }
+    ch_ptr->job = job;
+}
+
+/**
+ * Reads the rendered rows. In the blocking mode rows are fetched right away. In the non-blocking mode
+ * they are fetched by the connection worker and the read reports EAGAIN until they arrive.
+ */
+static int
+RowsetChannel_Input (ClientData instance_data, char * buf, int to_read, int * error_code_ptr)
+{
+    Rowset_Channel * ch_ptr = (Rowset_Channel *) instance_data;
+    if ( Tcl_DStringLength(&ch_ptr->text) == ch_ptr->text_offset && ch_ptr->error == NULL && !ch_ptr->at_end ) {
+        if ( ch_ptr->stmt_state_ptr == NULL ) {
+            RowsetChannel_SaveError(ch_ptr, Tcl_NewStringObj("statement has been closed", -1));
+        } else if ( ch_ptr->blocking ) {
+            if ( ch_ptr->job != NULL ) {
+                // the channel has been switched to the blocking mode while the worker was fetching rows
+                Async_Complete(ch_ptr->stmt_state_ptr->conn_state_ptr);
+            }
+            if ( Tcl_DStringLength(&ch_ptr->text) == ch_ptr->text_offset && ch_ptr->error == NULL && !ch_ptr->at_end ) {
+                RowsetChannel_FetchRows(ch_ptr, to_read);
+            }
+        } else {
+            if ( ch_ptr->job == NULL ) {
+                RowsetChannel_Submit(ch_ptr);
+            }
+            if ( ch_ptr->job != NULL ) {
+                *error_code_ptr = EAGAIN;
+                return -1;
+            }
+        }
+    }
+    int unread = Tcl_DStringLength(&ch_ptr->text) - ch_ptr->text_offset;
+    if ( unread > 0 ) {
+        int len = ( unread < to_read ? unread : to_read );
+        memcpy(buf, Tcl_DStringValue(&ch_ptr->text) + ch_ptr->text_offset, len);
+        ch_ptr->text_offset += len;
+        if ( ch_ptr->text_offset == Tcl_DStringLength(&ch_ptr->text) ) {
+            Tcl_DStringSetLength(&ch_ptr->text, 0);
+            ch_ptr->text_offset = 0;
+        }
+        return len;
+    }
+    if ( ch_ptr->error != NULL ) {
+        // the channel error is a list of return options followed by the message
+        Tcl_SetChannelError(ch_ptr->channel, Tcl_NewListObj(1, &ch_ptr->error));
+        Tcl_DecrRefCount(ch_ptr->error);
+        ch_ptr->error = NULL;
+        *error_code_ptr = EIO;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * The channel is read-only.
+ */
+static int
+RowsetChannel_Output (ClientData instance_data, const char * buf, int to_write, int * error_code_ptr)
+{
+    *error_code_ptr = EINVAL;
+    return -1;
+}
+
+/**
+ * Tracks whether the channel readers wait for the channel to become readable. The channel is
+ * readable unless the connection worker is fetching rows.
+ */
+static void
+RowsetChannel_Watch (ClientData instance_data, int mask)
+{
+    Rowset_Channel * ch_ptr = (Rowset_Channel *) instance_data;
+    ch_ptr->watch_mask = mask;
+    if ( ( mask & TCL_READABLE ) == 0 ) {
+        if ( ch_ptr->timer != NULL ) {
+            Tcl_DeleteTimerHandler(ch_ptr->timer);
+            ch_ptr->timer = NULL;
+        }
+    } else if ( ch_ptr->job == NULL ) {
+        RowsetChannel_ScheduleNotify(ch_ptr);
+    }
+}
+
+/**
+ * Switches the channel between blocking and non-blocking mode.
+ */
+static int
+RowsetChannel_BlockMode (ClientData instance_data, int mode)
+{
+    Rowset_Channel * ch_ptr = (Rowset_Channel *) instance_data;
+    ch_ptr->blocking = ( mode == TCL_MODE_BLOCKING );
+    return 0;
+}
+
+/**
+ * The channel has no OS handle.
+ */
+static int
+RowsetChannel_GetHandle (ClientData instance_data, int direction, ClientData * handle_ptr)
+{
+    return TCL_ERROR;
+}
+
+/**
+ * Detaches the channel from the statement and releases it. The request the connection worker might
+ * still be executing will be completed without the channel.
+ */
+static int
+RowsetChannel_Close (ClientData instance_data, Tcl_Interp * interp)
+{
+    Rowset_Channel * ch_ptr = (Rowset_Channel *) instance_data;
+    if ( ch_ptr->timer != NULL ) {
+        Tcl_DeleteTimerHandler(ch_ptr->timer);
+    }
+    if ( ch_ptr->job != NULL ) {
+        ch_ptr->job->done_data = NULL;
+    }
+    if ( ch_ptr->stmt_state_ptr != NULL ) {
+        ch_ptr->stmt_state_ptr->channel = NULL;
+    }
+    if ( ch_ptr->error != NULL ) {
+        Tcl_DecrRefCount(ch_ptr->error);
+    }
+    Tcl_DStringFree(&ch_ptr->text);
+    Tcl_DStringFree(&ch_ptr->keys);
+    ckfree(ch_ptr->info);
+    ckfree(ch_ptr->binary_formats);
+    ckfree(ch_ptr->values);
+    ckfree(ch_ptr->key_ends);
+    ckfree(ch_ptr);
+    return 0;
+}
+
+static Tcl_ChannelType rowset_channel_type = {
+    "hdbrowset",
+    TCL_CHANNEL_VERSION_5,
+    RowsetChannel_Close,
+    RowsetChannel_Input,
+    RowsetChannel_Output,
+    NULL,                       /// seek
+    NULL,                       /// set option
+    NULL,                       /// get option
+    RowsetChannel_Watch,
+    RowsetChannel_GetHandle,
+    NULL,                       /// close2
+    RowsetChannel_BlockMode,
+    NULL,                       /// flush
+    NULL,                       /// handler
+    NULL,                       /// wide seek
+    NULL,                       /// thread action
+    NULL                        /// truncate
+};
+
+/**
+ * Detaches the channel from the statement that is being deleted. Reading the channel afterwards
+ * reports an error.
+ */
+static void
+RowsetChannel_Detach (Stmt_State * stmt_state_ptr)
+{
+    Rowset_Channel * ch_ptr = stmt_state_ptr->channel;
+    if ( ch_ptr == NULL ) {
+        return;
+    }
+    // the outstanding request will be orphaned by the statement
+    ch_ptr->job = NULL;
+    ch_ptr->stmt_state_ptr = NULL;
+    stmt_state_ptr->channel = NULL;
+    if ( ch_ptr->watch_mask & TCL_READABLE ) {
+        RowsetChannel_ScheduleNotify(ch_ptr);
+    }
+}
+
+/**
+ * Creates a readable channel that renders rows of the result set as text - CSV (the default), TSV
+ * or newline delimited JSON (`-format ndjson`). Rows are fetched as the channel is read, so the
+ * result set can be streamed into another channel with `fcopy`. When the channel is in the
+ * non-blocking mode, which is the case for `fcopy -command`, rows are fetched in batches of
+ * `-batchsize` rows (1000 by default) by the connection worker thread while the event loop keeps
+ * running, and the next batch is requested only when the reader has consumed the previous one.
+ *
+ * CSV and TSV values are rendered like `hdb export` renders them, `-header true` adds a line with
+ * column names. NDJSON objects are rendered like `fetchjson` renders them. Binary values are base64
+ * text unless `-binaryas hex` is specified. The channel is read-only, its text is UTF-8.
+ *
+ * The statement cannot be used while the worker fetches rows for the channel. The channel stops
+ * working when the statement is closed. Only one channel can read the result set at a time.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn execute "SELECT * FROM orders"]
+ * set rows [$stmt channel -format csv -header true]
+ * fcopy $rows $sock -command [list done $rows $sock]
+ * \endcode
+ */
+static int
+Stmt_Channel (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc % 2 != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "channel ?-format csv|ndjson|tsv? ?-header bool? ?-binaryas hex|base64? ?-batchsize n?");
+        return TCL_ERROR;
+    }
+    static const char * const options[] = { "-batchsize", "-binaryas", "-format", "-header", NULL };
+    enum { BATCHSIZE, BINARYAS, FORMAT, HEADER } option;
+    static const char * const formats[] = { "csv", "ndjson", "tsv", NULL };
+    static const Export_Format format_values[] = { EXPORT_CSV, EXPORT_NDJSON, EXPORT_TSV };
+    int format_index = 0;
+    int header = 0;
+    int batch_size = 1000;
+    Tcl_Obj * binary_as = NULL;
+    for ( int i = 0; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case BATCHSIZE:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &batch_size) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( batch_size <= 0 ) {
+                    Tcl_SetResult(interp, "the batch size must be positive", TCL_STATIC);
+                    return TCL_ERROR;
+                }
+                break;
+            case BINARYAS:
+                binary_as = objv[i + 1];
+                break;
+            case FORMAT:
+                if ( Tcl_GetIndexFromObj(interp, objv[i + 1], formats, "format", 0, &format_index) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            case HEADER:
+                if ( Tcl_GetBooleanFromObj(interp, objv[i + 1], &header) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+        }
+    }
+    if ( stmt_state_ptr->channel != NULL ) {
+        Tcl_AppendResult(interp, "result set is already read by channel ", Tcl_GetChannelName(stmt_state_ptr->channel->channel), NULL);
+        return TCL_ERROR;
+    }
+    int num_cols = GetResultNumCols(stmt_state_ptr, interp);
+    if ( num_cols < 0 ) {
+        return TCL_ERROR;
+    }
+    dbcapi_column_info * info = (dbcapi_column_info *) ckalloc(sizeof(dbcapi_column_info) * num_cols);
+    unsigned char * binary_formats = (unsigned char *) ckalloc(num_cols);
+    memset(binary_formats, BINARY_AS_BASE64, num_cols);
+    if ( GetResultColumnsInfo(stmt_state_ptr, interp, num_cols, info) != TCL_OK
+      || ( binary_as != NULL && GetBinaryFormatsFromObj(interp, binary_as, num_cols, binary_formats) != TCL_OK )
+    ) {
+        ckfree(info);
+        ckfree(binary_formats);
+        return TCL_ERROR;
+    }
+    for ( int col = 0; col < num_cols; ++col ) {
+        if ( IsBinaryAsBytes(&info[col], binary_formats[col]) ) {
+            Tcl_SetResult(interp, "the channel can render binary values only as hex or base64 text", TCL_STATIC);
+            ckfree(info);
+            ckfree(binary_formats);
+            return TCL_ERROR;
+        }
+    }
+
+    Rowset_Channel * ch_ptr = (Rowset_Channel *) ckalloc(sizeof(Rowset_Channel));
+    memset(ch_ptr, 0, sizeof(Rowset_Channel));
+    ch_ptr->interp = interp;
+    ch_ptr->stmt_state_ptr = stmt_state_ptr;
+    ch_ptr->format = format_values[format_index];
+    ch_ptr->num_cols = num_cols;
+    ch_ptr->info = info;
+    ch_ptr->binary_formats = binary_formats;
+    ch_ptr->values = (dbcapi_data_value *) ckalloc(sizeof(dbcapi_data_value) * num_cols);
+    ch_ptr->key_ends = (int *) ckalloc(sizeof(int) * num_cols);
+    ch_ptr->batch_size = batch_size;
+    ch_ptr->blocking = true;
+    Tcl_DStringInit(&ch_ptr->keys);
+    Tcl_DStringInit(&ch_ptr->text);
+    if ( ch_ptr->format == EXPORT_NDJSON ) {
+        AppendJsonKeys(&ch_ptr->keys, info, num_cols, ch_ptr->key_ends);
+    } else if ( header ) {
+        for ( int col = 0; col < num_cols; ++col ) {
+            if ( col > 0 ) {
+                Tcl_DStringAppend(&ch_ptr->text, ch_ptr->format == EXPORT_TSV ? "\t" : ",", 1);
+            }
+            AppendDelimitedText(&ch_ptr->text, info[col].name, strlen(info[col].name), ch_ptr->format);
+        }
+        Tcl_DStringAppend(&ch_ptr->text, "\n", 1);
+    }
+
+    char name[40];
+    sprintf(name, "hdbrowset%" PRIxPTR, (uintptr_t) ch_ptr);
+    ch_ptr->channel = Tcl_CreateChannel(&rowset_channel_type, name, (ClientData) ch_ptr, TCL_READABLE);
+    Tcl_RegisterChannel(interp, ch_ptr->channel);
+    Tcl_SetChannelOption(NULL, ch_ptr->channel, "-encoding", "utf-8");
+    Tcl_SetChannelOption(NULL, ch_ptr->channel, "-translation", "lf");
+    stmt_state_ptr->channel = ch_ptr;
+
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(name, -1));
+    return TCL_OK;
+}
+
+/**
+ * Cancels the asynchronous request of the statement. Returns `true` if the statement had a request
+ * that was still in progress and `false` otherwise.
+ *
+ * The cancelled request completes with the `error` status.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $stmt execute -async -command done
+ * after 5000 [list $stmt cancel]
+ * \endcode
+ */
+static int
+Stmt_Cancel (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "cancel");
+        return TCL_ERROR;
+    }
+    Conn_State * conn_state_ptr = stmt_state_ptr->conn_state_ptr;
+    bool cancelled = false;
+
+    Tcl_MutexLock(&conn_state_ptr->worker_lock);
+    Async_Job * job = conn_state_ptr->job;
+    if ( job != NULL && job->stmt_state_ptr == stmt_state_ptr && job->state != ASYNC_DONE && !job->cancelled ) {
+        job->cancelled = true;
+        if ( job->state == ASYNC_RUNNING ) {
+            dbcapi.cancel(conn_state_ptr->conn);
+        }
+        cancelled = true;
+    }
+    Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(cancelled));
+    return TCL_OK;
+}
+
+/**
+ * Configures the statement. Supported options are:
+ *  -timeout
+ *      Sets the statement execution timeout in milliseconds. The statement is cancelled if it
+ *      runs longer. 0 disables the timeout. By default statements use the connection timeout.
+ *  -label
+ *      Latencies of the labelled statements are also reported separately by `hdb metrics`.
+ *      Statements that share the label share the histograms. An empty label removes it.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $stmt configure -timeout 30000 -label orders
+ * \endcode
+ */
+static int
+Stmt_Configure (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 2 || objc % 2 != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "configure -option value ?-option value...?");
+        return TCL_ERROR;
+    }
+
+    static const char * const options[] = {
+        "-label", "-timeout",
+        NULL
+    };
+    enum {
+        LABEL, TIMEOUT
+    } option;
+
+    for ( int i = 0; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case LABEL: {
+                const char * label = Tcl_GetString(objv[i + 1]);
+                if ( *label == '\0' ) {
+                    stmt_state_ptr->label = NULL;
+                    break;
+                }
+                Tcl_HashTable * labels = stmt_state_ptr->conn_state_ptr->hdbtcl_state_ptr->labels;
+                int is_new;
+                Tcl_HashEntry * entry = Tcl_CreateHashEntry(labels, label, &is_new);
+                if ( is_new ) {
+                    Latency_Metrics * metrics_ptr = (Latency_Metrics *) ckalloc(sizeof(Latency_Metrics));
+                    memset(metrics_ptr, 0, sizeof(Latency_Metrics));
+                    Tcl_SetHashValue(entry, metrics_ptr);
+                }
+                stmt_state_ptr->label = entry;
+                break;
+            }
+            case TIMEOUT: {
+                if ( GetTimeoutFromObj(interp, objv[i + 1], &stmt_state_ptr->timeout) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            }
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Retrieves statement configuration. Returns the effective timeout for -timeout.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set timeout [$stmt cget -timeout]
+ * \endcode
+ */
+static int
+Stmt_Cget (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 1 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "cget -option");
+        return TCL_ERROR;
+    }
+
+    static const char * const options[] = {
+        "-label", "-timeout",
+        NULL
+    };
+    enum {
+        LABEL, TIMEOUT
+    } option;
+
+    if ( Tcl_GetIndexFromObj(interp, objv[0], options, "option", 0, (int *) &option) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    switch ( option ) {
+        case LABEL: {
+            if ( stmt_state_ptr->label != NULL ) {
+                Tcl_SetObjResult(interp, Tcl_NewStringObj(Tcl_GetHashKey(stmt_state_ptr->conn_state_ptr->hdbtcl_state_ptr->labels, stmt_state_ptr->label), -1));
+            }
+            break;
+        }
+        case TIMEOUT: {
+            Tcl_SetObjResult(interp, Tcl_NewIntObj(GetStmtTimeout(stmt_state_ptr)));
+            break;
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Returns performance counters of the statement as a dictionary. With `-reset` the counters are
+ * reset after they are returned.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stats [$stmt stats]
+ * puts "fetched [dict get $stats rows] rows in [dict get $stats fetch_time] us"
+ * \endcode
+ */
+static int
+Stmt_Stats (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    return Stats_Report(&stmt_state_ptr->stats, interp, objc, objv, "stats ?-reset?");
+}
+
+/**
+ * Statement subcommands multiplexor.
+ */
+static int
+Stmt_Cmd (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 2 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "method ?option...?");
+        return TCL_ERROR;
+    }
+
+    static const char * const methods[] = {
+        "cancel", "cget", "channel", "close", "configure", "execute", "executemany", "fetch", "fetchcolumn", "fetchjson", "fetchmany", "get", "nextresult", "stats", NULL
+    };
+    enum {
+        CANCEL, CGET, CHANNEL, CLOSE, CONFIGURE, EXECUTE, EXECUTE_MANY, FETCH, FETCH_COLUMN, FETCH_JSON, FETCH_MANY, GET, NEXT_RESULT, STATS
+    } method;
+
+    if ( Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, (int *) &method) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( method != CANCEL && method != CLOSE && method != STATS && Async_CheckIdle(stmt_state_ptr->conn_state_ptr, interp) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    switch ( method ) {
+        case CANCEL:
+            return Stmt_Cancel      (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case CGET:
+            return Stmt_Cget        (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case CHANNEL:
+            return Stmt_Channel     (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case CLOSE:
+            return Stmt_Close       (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case CONFIGURE:
+            return Stmt_Configure   (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case EXECUTE:
+            return Stmt_Execute     (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case EXECUTE_MANY:
+            return Stmt_ExecuteMany (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case FETCH:
+            return Stmt_Fetch       (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case FETCH_COLUMN:
+            return Stmt_FetchColumn (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case FETCH_JSON:
+            return Stmt_FetchJson   (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case FETCH_MANY:
+            return Stmt_FetchMany   (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case GET:
+            return Stmt_Get         (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case NEXT_RESULT:
+            return Stmt_NextResult  (stmt_state_ptr, interp, objc - 2, objv + 2);
+        case STATS:
+            return Stmt_Stats       (stmt_state_ptr, interp, objc - 2, objv + 2);
+    }
+    return TCL_OK;
+}
+
+/**
+ * Closes the current database connection.
+ *
+ * All currently opened cursors (statements) are also closed. Saved connection and statement
+ * become invalid as corresponding command are deleted.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $conn close
+ * \endcode
+ *
+ * \note It is not necessary to close a connection explicitly. `hdbtcl` will close it automatically
+ * when all references to the connection are gone.
+ */
+static int
+Conn_Close (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( Tcl_DeleteCommandFromToken(interp, conn_state_ptr->conn_cmd) != TCL_OK ) {
+        Tcl_SetResult(interp, "Cannot delete connection handle", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Changes current connection configuration.
+ *
+ * Supported options:
+ *  -autocommit
+ *      Sets the AUTOCOMMIT mode to be on or off. The default AUTOCOMMIT mode is off, so
+ *      calling the commit or rollback is required for each transaction. When the AUTOCOMMIT
+ *      mode is set to on, all statements are committed after they execute. They cannot be
+ *      rolled back.
+ *  -isolation
+ *      Sets the transaction isolation level. The default isolation level is "READ COMMITTED".
+ *      Other two possible options are "REPEATABLE READ" and "SERIALIZABLE".
+ *  -timeout
+ *      Sets the default statement execution timeout in milliseconds. Statements that run longer
+ *      are cancelled. 0 (the default) disables the timeout.
+ *  -memorylimit
+ *      Sets the number of bytes a single fetch (or the OUT values of a single execution) of the
+ *      connection statements may build. Calls that exceed it fail. The limit does not bound the
+ *      data the script keeps after they are returned. 0 (the default) disables the limit.
+ *  -lobchunksize
+ *      Sets the size (in bytes or characters) of the pieces LOB data are sent and read in. The
+ *      default is 32768.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $conn configure -autocommit true -isolation "REPEATABLE READ"
+ * \endcode
+ */
+static int
+Conn_Configure (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 4 || objc % 2 != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "configure -option value ?-option value...?");
+        return TCL_ERROR;
+    }
+
+    static const char * const options[] = {
+        "-autocommit", "-isolation", "-lobchunksize", "-memorylimit", "-timeout",
+        NULL
+    };
+    enum {
+        AUTOCOMMIT, ISOLATION, LOB_CHUNK, MEMORY_LIMIT, TIMEOUT
+    } option;
+
+    for ( int i = 2; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case AUTOCOMMIT: {
+                int autocommit;
+                if ( Tcl_GetBooleanFromObj(interp, objv[i + 1], &autocommit) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( !dbcapi.set_autocommit(conn_state_ptr->conn, autocommit) ) {
+                    SetErrorResult(interp, conn_state_ptr->conn, "Cannot set autocommit", NULL);
+                    return TCL_ERROR;
+                }
+                break;
+            }
+            case ISOLATION: {
+                static const char * const levels[] = {
+                    "READ COMMITTED", "REPEATABLE READ", "SERIALIZABLE",
+                    NULL
+                };
+                int level;
+                if ( Tcl_GetIndexFromObj(interp, objv[i + 1], levels, "isolation level", 0, &level) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( !dbcapi.set_transaction_isolation(conn_state_ptr->conn, level + 1) ) {
+                    SetErrorResult(interp, conn_state_ptr->conn, "Cannot set transaction isolation level", NULL);
+                    return TCL_ERROR;
+                }
+                break;
+            }
+            case LOB_CHUNK: {
+                int chunk_size;
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &chunk_size) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( chunk_size <= 0 ) {
+                    Tcl_SetResult(interp, "LOB chunk size must be positive", TCL_STATIC);
+                    return TCL_ERROR;
+                }
+                conn_state_ptr->lob_chunk_size = chunk_size;
+                break;
+            }
+            case MEMORY_LIMIT: {
+                if ( GetMemoryLimitFromObj(interp, objv[i + 1], &conn_state_ptr->memory_limit) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            }
+            case TIMEOUT: {
+                if ( GetTimeoutFromObj(interp, objv[i + 1], &conn_state_ptr->timeout) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            }
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Retrieves connection configration. Only -autocommit, -lobchunksize, -memorylimit and -timeout are supported.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set is_autocommitting [$conn cget -autocommit]
+ * \endcode
+ */
+static int
+Conn_Cget (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 3 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "cget -option");
+        return TCL_ERROR;
+    }
+
+    static const char * const options[] = {
+        "-autocommit", "-lobchunksize", "-memorylimit", "-timeout",
+        NULL
+    };
+    enum {
+        AUTOCOMMIT, LOB_CHUNK, MEMORY_LIMIT, TIMEOUT
+    } option;
+
+    if ( Tcl_GetIndexFromObj(interp, objv[2], options, "option", 0, (int *) &option) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    switch ( option ) {
+        case AUTOCOMMIT: {
+            dbcapi_bool autocommit;
+            if ( !dbcapi.get_autocommit(conn_state_ptr->conn, &autocommit) ) {
+                SetErrorResult(interp, conn_state_ptr->conn, "Cannot retrieve autocommit setting", NULL);
+                return TCL_ERROR;
+            }
+            Tcl_SetObjResult(interp, Tcl_NewBooleanObj(autocommit));
+            break;
+        }
+        case LOB_CHUNK: {
+            Tcl_SetObjResult(interp, Tcl_NewIntObj(conn_state_ptr->lob_chunk_size));
+            break;
+        }
+        case MEMORY_LIMIT: {
+            Tcl_SetObjResult(interp, Tcl_NewWideIntObj(conn_state_ptr->memory_limit));
+            break;
+        }
+        case TIMEOUT: {
+            Tcl_SetObjResult(interp, Tcl_NewIntObj(conn_state_ptr->timeout));
+            break;
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Sets or retrieves session-specific client information (name and value pair).
+ *
+ * \see https://help.sap.com/viewer/0eec0d68141541d1b07893a39944924e/2.0.04/en-US/e90fa1f0e06e4840aa3ee2278afae16b.html
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set current_app_name [$conn set APPLICATION]
+ * $conn set APPLICATION tclapp
+ * \endcode
+ *
+ * \note When setting client information this subcommand behaves like TCL's `set` command
+ * and returns the value that was provided to it.
+ */
+static int
+Conn_Set (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc == 4 ) {
+
+        char * var = Tcl_GetString(objv[2]);
+        char * val = Tcl_GetString(objv[3]);
+        if ( !dbcapi.set_clientinfo(conn_state_ptr->conn, var, val) ) {
+            SetErrorResult(interp, conn_state_ptr->conn, "Cannot set session variable ", var, NULL);
+            return TCL_ERROR;
+        }
+        if ( conn_state_ptr->pool != NULL ) {
+            // remember the variable, so it could be reset when the connection is checked out again
+            if ( conn_state_ptr->clientinfo == NULL ) {
+                conn_state_ptr->clientinfo = Tcl_NewListObj(0, NULL);
+                Tcl_IncrRefCount(conn_state_ptr->clientinfo);
+            }
+            Tcl_ListObjAppendElement(NULL, conn_state_ptr->clientinfo, objv[2]);
+        }
+        Tcl_SetObjResult(interp, objv[3]);
+
+    } else if ( objc == 3 ) {
+
+        char * var = Tcl_GetString(objv[2]);
+        const char * val = dbcapi.get_clientinfo(conn_state_ptr->conn, var);
+        if ( val == NULL ) {
+            Tcl_AppendResult(interp, "Session variable ", var, " does not exist.", NULL);
+            return TCL_ERROR;
+        }
+        Tcl_SetObjResult(interp, Tcl_NewStringObj(val, -1));
+
+    } else {
+
+        Tcl_WrongNumArgs(interp, objc, objv, "set session_variable ?value?");
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Creates the statement command to miltiplex the statement subcommands for the DBCAPI statement.
+ *
+ * \note If the command cannot be created the DBCAPI statement is freed.
+ */
+static int
+CreateStmtCmd (Conn_State * conn_state_ptr, Tcl_Interp * interp, dbcapi_stmt * stmt, Stmt_State * * stmt_state_ptr_ptr)
+{
+    Stmt_State * stmt_state_ptr = ckalloc(sizeof(Stmt_State));
+    if ( stmt_state_ptr == NULL ) {
+        dbcapi.free_stmt(stmt);
+        Tcl_SetResult(interp, "cannot allocate memory for the statement internal state", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    memset(stmt_state_ptr, 0, sizeof(Stmt_State));
+    stmt_state_ptr->conn_state_ptr = conn_state_ptr;
+    stmt_state_ptr->stmt = stmt;
+    stmt_state_ptr->timeout = -1;
+
+    char name[24];
+    int name_len = sprintf(name, "hdbstmt%" PRIxPTR, (uintptr_t) stmt_state_ptr->stmt);
+
+    stmt_state_ptr->stmt_cmd = Tcl_CreateObjCommand(interp, name, (Tcl_ObjCmdProc *) Stmt_Cmd, (ClientData) stmt_state_ptr, (Tcl_CmdDeleteProc *) Stmt_DeleteState);
+    if ( stmt_state_ptr->stmt_cmd == NULL ) {
+        Tcl_SetResult(interp, "cannot create statement command handler", TCL_STATIC);
+        Stmt_DeleteState(stmt_state_ptr, interp);
+        return TCL_ERROR;
+    }
+    int is_new;
+    Tcl_HashEntry * entry = Tcl_CreateHashEntry(conn_state_ptr->open_statements, stmt_state_ptr->stmt_cmd, &is_new);
+    Tcl_SetHashValue(entry, stmt_state_ptr->stmt_cmd);
+
+    if ( stmt_state_ptr_ptr != NULL ) {
+        *stmt_state_ptr_ptr = stmt_state_ptr;
+    }
+
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(name, name_len));
+    return TCL_OK;
+}
+
+/**
+ * Saves the SQL text of the statement and accounts the statement memory.
+ */
+static void
+SetStmtSql (Stmt_State * stmt_state_ptr, Tcl_Obj * sql, uint32_t sql_hash)
+{
+    int sql_len;
+    Tcl_GetStringFromObj(sql, &sql_len);
+    stmt_state_ptr->sql = sql;
+    stmt_state_ptr->sql_hash = sql_hash;
+    Tcl_IncrRefCount(sql);
+    Memory_Add(stmt_state_ptr, MEMORY_METADATA, sizeof(Stmt_State) + sizeof(Tcl_Obj) + sql_len + 1);
+}
+
+/**
+ * Calls DBCAPI to prepare SQL and then creates and returns the statement command to miltiplex the statement subcommands.
+ */
+static int
+PrepareStmt (Conn_State * conn_state_ptr, Tcl_Interp * interp, Tcl_Obj * sql, Stmt_State * * stmt_state_ptr_ptr)
+{
+    uint32_t sql_hash = GetSqlHash(sql);
+    PROBE3(prepare__start, conn_state_ptr, Tcl_GetString(sql), sql_hash);
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_stmt * stmt = dbcapi.prepare(conn_state_ptr->conn, Tcl_GetString(sql));
+    Hdbtcl_Stats delta = { .prepares = 1, .prepare_time = GetMonotonicTime() - started, .calls = 1, .errors = ( stmt == NULL ) };
+    if ( stmt == NULL ) {
+        Stats_Record(conn_state_ptr, NULL, &delta);
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot prepare statement for execution", NULL);
+        PROBE4(prepare__done, conn_state_ptr, NULL, sql_hash, TCL_ERROR);
+        return TCL_ERROR;
+    }
+    Stmt_State * stmt_state_ptr;
+    if ( CreateStmtCmd(conn_state_ptr, interp, stmt, &stmt_state_ptr) != TCL_OK ) {
+        Stats_Record(conn_state_ptr, NULL, &delta);
+        PROBE4(prepare__done, conn_state_ptr, NULL, sql_hash, TCL_ERROR);
+        return TCL_ERROR;
+    }
+    SetStmtSql(stmt_state_ptr, sql, sql_hash);
+    Stats_Record(conn_state_ptr, stmt_state_ptr, &delta);
+    if ( stmt_state_ptr_ptr != NULL ) {
+        *stmt_state_ptr_ptr = stmt_state_ptr;
+    }
+    PROBE4(prepare__done, conn_state_ptr, stmt_state_ptr, sql_hash, TCL_OK);
+    return TCL_OK;
+}
+
+/**
+ * Prepares the SQL statement for execution. Returns the prepared statement, so it could be executed
+ * later.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn prepare "INSERT INTO employees (employee_id, first_name, last_name) VALUES (?, ?, ?)"]
+ * \endcode
+ */
+static int
+Conn_Prepare (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 3 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "prepare sql_string");
+        return TCL_ERROR;
+    }
+    return PrepareStmt(conn_state_ptr, interp, objv[2], NULL);
+}
+
+/**
+ * Prepares and executes the SQL statement. Returns the prepared statement, so it could be executed
+ * again with different arguments.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn execute "INSERT INTO employees (employee_id, first_name, last_name) VALUES (?, ?, ?)" 2 "Hasso" "Plattner"]
+ * \endcode
+ */
+static int
+Conn_Execute (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 3 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "execute sql_string ?arg...?");
+        return TCL_ERROR;
+    }
+    Stmt_State * stmt_state_ptr;
+    if ( PrepareStmt(conn_state_ptr, interp, objv[2], &stmt_state_ptr) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    // Note that PrepareStmt has set the name of the statement command as result.
+    // So, unless Stmt_Execute below resets it on error, that's what [$conn execute ...] will return
+
+    if ( Stmt_Execute(stmt_state_ptr, interp, objc - 3, objv + 3) != TCL_OK ) {
+        goto Error_Exit;
+    }
+
+    return TCL_OK;
+
+Error_Exit:
+    if ( Tcl_DeleteCommandFromToken(interp, stmt_state_ptr->stmt_cmd) != TCL_OK ) {
+        Stmt_DeleteState(stmt_state_ptr, interp);
+    }
+    return TCL_ERROR;
+}
+
+/**
+ * Executes the SQL statement that does not have parameters and does not return a result set.
+ * The statement is sent to the server without being prepared first and no statement command
+ * is created.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $conn exec "SET SCHEMA hr"
+ * \endcode
+ */
+static int
+Conn_Exec (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 3 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "exec sql_string");
+        return TCL_ERROR;
+    }
+    char * sql = Tcl_GetString(objv[2]);
+    Watchdog_Timer timer;
+    if ( !Watchdog_Arm(&timer, conn_state_ptr->conn, conn_state_ptr->timeout) ) {
+        Tcl_SetResult(interp, "cannot start the watchdog thread", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool executed = dbcapi.execute_immediate(conn_state_ptr->conn, sql);
+    Hdbtcl_Stats delta = { .executes = 1, .execute_time = GetMonotonicTime() - started, .calls = 1, .errors = !executed };
+    Stats_Record(conn_state_ptr, NULL, &delta);
+    if ( Watchdog_Disarm(&timer) && !executed ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Statement execution timed out", NULL);
+    } else if ( !executed ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot execute SQL", NULL);
+    }
+    if ( conn_state_ptr->tracing ) {
+        Trace_Record(conn_state_ptr, objv[2], 0, &delta, -1, executed ? NULL : Tcl_GetObjResult(interp));
+    }
+    return executed ? TCL_OK : TCL_ERROR;
+}
+
+/**
+ * Executes the SQL statement that does not have parameters without preparing it first. Returns
+ * the statement, so the result set could be fetched.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stmt [$conn query "SELECT schema_name FROM schemas"]
+ * \endcode
+ */
+static int
+Conn_Query (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 3 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "query sql_string");
+        return TCL_ERROR;
+    }
+    char * sql = Tcl_GetString(objv[2]);
+    Watchdog_Timer timer;
+    if ( !Watchdog_Arm(&timer, conn_state_ptr->conn, conn_state_ptr->timeout) ) {
+        Tcl_SetResult(interp, "cannot start the watchdog thread", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_stmt * stmt = dbcapi.execute_direct(conn_state_ptr->conn, sql);
+    Hdbtcl_Stats delta = { .executes = 1, .execute_time = GetMonotonicTime() - started, .calls = 1, .errors = ( stmt == NULL ) };
+    if ( Watchdog_Disarm(&timer) && stmt == NULL ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Statement execution timed out", NULL);
+    } else if ( stmt == NULL ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot execute SQL", NULL);
+    }
+    if ( stmt == NULL ) {
+        Stats_Record(conn_state_ptr, NULL, &delta);
+        if ( conn_state_ptr->tracing ) {
+            Trace_Record(conn_state_ptr, objv[2], 0, &delta, -1, Tcl_GetObjResult(interp));
+        }
+        return TCL_ERROR;
+    }
+    Stmt_State * stmt_state_ptr;
+    if ( CreateStmtCmd(conn_state_ptr, interp, stmt, &stmt_state_ptr) != TCL_OK ) {
+        Stats_Record(conn_state_ptr, NULL, &delta);
+        return TCL_ERROR;
+    }
+    SetStmtSql(stmt_state_ptr, objv[2], GetSqlHash(objv[2]));
+    Trace_Start(stmt_state_ptr, 0);
+    Stats_Record(conn_state_ptr, stmt_state_ptr, &delta);
+    Trace_Executed(stmt_state_ptr);
+    return TCL_OK;
+}
+
+/**
+ * Commits the current transaction.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $conn commit
+ * \endcode
+ */
+static int
+Conn_Commit (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    PROBE1(commit__start, conn_state_ptr);
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool committed = dbcapi.commit(conn_state_ptr->conn);
+    Hdbtcl_Stats delta = { .commits = 1, .commit_time = GetMonotonicTime() - started, .calls = 1, .errors = !committed };
+    Stats_Record(conn_state_ptr, NULL, &delta);
+    PROBE2(commit__done, conn_state_ptr, committed ? TCL_OK : TCL_ERROR);
+    if ( !committed ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot commit transaction", NULL);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Rolls back the current transaction.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $conn rollback
+ * \endcode
+ */
+static int
+Conn_Rollback (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rolled_back = dbcapi.rollback(conn_state_ptr->conn);
+    Hdbtcl_Stats delta = { .rollbacks = 1, .rollback_time = GetMonotonicTime() - started, .calls = 1, .errors = !rolled_back };
+    Stats_Record(conn_state_ptr, NULL, &delta);
+    if ( !rolled_back ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot roll back transaction", NULL);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Configures tracing of slow statements. A statement is slow when the time it takes to execute and
+ * to fetch its result set exceeds the threshold (ms). Slow statements are saved in the slow log (see
+ * `hdb slowlog`). If the callback command is set, it is called when the interpreter becomes idle with
+ * the slow log entry appended. A negative threshold turns tracing off. Setting the command while tracing
+ * is off without `-threshold` turns tracing on with the threshold 0, so every statement is reported.
+ * Without options returns the current configuration.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * proc log_slow { entry } {
+ *     puts stderr "slow SQL ([dict get $entry elapsed] ms): [dict get $entry sql]"
+ * }
+ * $conn trace -threshold 500 -command log_slow
+ * \endcode
+ */
+static int
+Conn_Trace (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc % 2 != 0 ) {
+        Tcl_WrongNumArgs(interp, 2, objv, "?-command cmd? ?-threshold ms?");
+        return TCL_ERROR;
+    }
+    if ( objc == 2 ) {
+        Tcl_Obj * result = Tcl_NewDictObj();
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("-command", -1), conn_state_ptr->trace_command != NULL ? conn_state_ptr->trace_command : Tcl_NewObj());
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("-threshold", -1), Tcl_NewIntObj(conn_state_ptr->tracing ? conn_state_ptr->trace_threshold : -1));
+        Tcl_SetObjResult(interp, result);
+        return TCL_OK;
+    }
+
+    static const char * const options[] = { "-command", "-threshold", NULL };
+    enum { COMMAND, THRESHOLD } option;
+
+    Tcl_Obj * command = NULL;
+    int threshold = conn_state_ptr->tracing ? conn_state_ptr->trace_threshold : -1;
+    bool threshold_set = false;
+    for ( int i = 2; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case COMMAND:
+                command = objv[i + 1];
+                break;
+            case THRESHOLD:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &threshold) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                threshold_set = true;
+                break;
+        }
+    }
+    if ( command != NULL && !threshold_set && threshold < 0 && Tcl_GetCharLength(command) > 0 ) {
+        // the callback would never be called otherwise
+        threshold = 0;
+    }
+    conn_state_ptr->tracing = ( threshold >= 0 );
+    conn_state_ptr->trace_threshold = threshold;
+    if ( command != NULL ) {
+        if ( conn_state_ptr->trace_command != NULL ) {
+            Tcl_DecrRefCount(conn_state_ptr->trace_command);
+            conn_state_ptr->trace_command = NULL;
+        }
+        int len;
+        Tcl_GetStringFromObj(command, &len);
+        if ( len > 0 ) {
+            conn_state_ptr->trace_command = command;
+            Tcl_IncrRefCount(command);
+        }
+    }
+    return TCL_OK;
+}
+
+/**
+ * Returns performance counters of the connection as a dictionary. Connection counters include
+ * counters of all statements that the connection has executed. With `-reset` the counters are
+ * reset after they are returned. Counters of the connection statements are not affected.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stats [$conn stats -reset]
+ * \endcode
+ */
+static int
+Conn_Stats (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    return Stats_Report(&conn_state_ptr->stats, interp, objc - 2, objv + 2, "stats ?-reset?");
+}
+
+/**
+ * Creates the dictionary of the memory the connection and its statements hold.
+ */
+static Tcl_Obj *
+Conn_NewResourcesObj (Conn_State * conn_state_ptr, Tcl_Interp * interp)
+{
+    Tcl_Obj * result = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("memory", -1), Memory_NewDictObj(&conn_state_ptr->memory));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("peak", -1), Memory_NewDictObj(&conn_state_ptr->memory_peak));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("memorylimit", -1), Tcl_NewWideIntObj(conn_state_ptr->memory_limit));
+    Tcl_Obj * stmts = Tcl_NewDictObj();
+    if ( conn_state_ptr->open_statements != NULL ) {
+        Tcl_HashSearch iter;
+        for (
+            Tcl_HashEntry * entry = Tcl_FirstHashEntry(conn_state_ptr->open_statements, &iter);
+            entry != NULL;
+            entry = Tcl_NextHashEntry(&iter)
+        ) {
+            Tcl_Command stmt_cmd = Tcl_GetHashValue(entry);
+            Tcl_CmdInfo info;
+            if ( Tcl_GetCommandInfoFromToken(stmt_cmd, &info) ) {
+                Stmt_State * stmt_state_ptr = (Stmt_State *) info.objClientData;
+                Tcl_Obj * stmt = Tcl_NewDictObj();
+                Tcl_DictObjPut(NULL, stmt, Tcl_NewStringObj("sql", -1), stmt_state_ptr->sql != NULL ? stmt_state_ptr->sql : Tcl_NewObj());
+                Tcl_DictObjPut(NULL, stmt, Tcl_NewStringObj("memory", -1), Memory_NewDictObj(&stmt_state_ptr->memory));
+                Tcl_DictObjPut(NULL, stmt, Tcl_NewStringObj("peak", -1), Memory_NewDictObj(&stmt_state_ptr->memory_peak));
+                Tcl_DictObjPut(NULL, stmts, Tcl_NewStringObj(Tcl_GetCommandName(interp, stmt_cmd), -1), stmt);
+            }
+        }
+    }
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("statements", -1), stmts);
+    return result;
+}
+
+/**
+ * Returns memory the connection statements hold as a dictionary:
+ * - `memory` - current sizes (bytes) of `rows`, `lobs`, `params`, `metadata` and their `total`.
+ * - `peak` - the largest sizes the connection has held.
+ * - `memorylimit` - the connection memory limit.
+ * - `statements` - open statements of the connection. Each is a dictionary of its `sql`, `memory`
+ *   and `peak`.
+ *
+ * Sizes are estimates of the memory held by the statement data, rather than exact numbers of
+ * allocated bytes. Rows, LOBs and OUT values are accounted only while a call builds them or an
+ * asynchronous request holds them. Once they are returned they belong to the script and are not
+ * accounted anymore, so `peak` shows the largest result of a single call.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * dict for { stmt info } [dict get [$conn resources] statements] {
+ *     puts "$stmt: [dict get $info memory total] bytes"
+ * }
+ * \endcode
+ */
+static int
+Conn_Resources (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 2 ) {
+        Tcl_WrongNumArgs(interp, 2, objv, NULL);
+        return TCL_ERROR;
+    }
+    Tcl_SetObjResult(interp, Conn_NewResourcesObj(conn_state_ptr, interp));
+    return TCL_OK;
+}
+
+/**
+ * Connection subcommands multiplexor.
+ */
+static int
+Conn_Cmd (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 2 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "method ?option...?");
+        return TCL_ERROR;
+    }
+
+    static const char * const methods[] = {
+        "cget", "close", "commit", "configure", "exec", "execute", "prepare", "query", "resources", "rollback", "set", "stats", "trace", NULL
+    };
+    enum {
+        CGET, CLOSE, COMMIT, CONFIGURE, EXEC, EXECUTE, PREPARE, QUERY, RESOURCES, ROLLBACK, SET, STATS, TRACE
+    } method;
+
+    if ( Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, (int *) &method) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( method != CLOSE && method != STATS && method != RESOURCES && Async_CheckIdle(conn_state_ptr, interp) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    switch ( method ) {
+        case CONFIGURE:
+            return Conn_Configure(conn_state_ptr, interp, objc, objv);
+        case CGET:
+            return Conn_Cget(conn_state_ptr, interp, objc, objv);
+        case SET:
+            return Conn_Set(conn_state_ptr, interp, objc, objv);
+        case EXEC:
+            return Conn_Exec(conn_state_ptr, interp, objc, objv);
+        case EXECUTE:
+            return Conn_Execute(conn_state_ptr, interp, objc, objv);
+        case QUERY:
+            return Conn_Query(conn_state_ptr, interp, objc, objv);
+        case PREPARE:
+            return Conn_Prepare(conn_state_ptr, interp, objc, objv);
+        case COMMIT:
+            return Conn_Commit(conn_state_ptr, interp, objc, objv);
+        case ROLLBACK:
+            return Conn_Rollback(conn_state_ptr, interp, objc, objv);
+        case CLOSE:
+            return Conn_Close(conn_state_ptr, interp, objc, objv);
+        case STATS:
+            return Conn_Stats(conn_state_ptr, interp, objc, objv);
+        case RESOURCES:
+            return Conn_Resources(conn_state_ptr, interp, objc, objv);
+        case TRACE:
+            return Conn_Trace(conn_state_ptr, interp, objc, objv);
+    }
+    return TCL_OK;
+}
+
+/**
+ * Creates a new connection state and connects to the database using provided connection properties.
+ *
+ * Returns NULL if connection cannot be established.
+ */
+static Conn_State *
+NewConnState (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    Conn_State * conn_state_ptr = ckalloc(sizeof(Conn_State));
+    if ( conn_state_ptr == NULL ) {
+        Tcl_SetResult(interp, "cannot allocate memory for the connection internal state", TCL_STATIC);
+        return NULL;
+    }
+    memset(conn_state_ptr, 0, sizeof(Conn_State));
+    conn_state_ptr->hdbtcl_state_ptr = hdbtcl_state_ptr;
+    conn_state_ptr->lob_chunk_size = LOB_CHUNK_SIZE;
+
+    conn_state_ptr->conn = dbcapi.new_connection();
+    for ( int i = 0; i < objc; ) {
+        char * opt_name  = Tcl_GetString(objv[i++]);
+        char * opt_value = Tcl_GetString(objv[i++]);
+        if ( opt_name == NULL || opt_value == NULL ) {
+            Tcl_SetResult(interp, "malformed argument list", TCL_STATIC);
+            goto Error_Exit;
+        }
+        if ( *opt_name == '-' ) {
+            ++opt_name;
+        }
+        if ( !dbcapi.set_connect_property(conn_state_ptr->conn, opt_name, opt_value) ) {
+            SetErrorResult(interp, conn_state_ptr->conn, "Cannot set connection property ", opt_name, NULL);
+            goto Error_Exit;
+        }
+    }
+    if ( !dbcapi.set_connect_property(conn_state_ptr->conn, "charset", "UTF-8") ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot configure character set for the connection", NULL);
+        goto Error_Exit;
+    }
+    Tcl_WideInt started = GetMonotonicTime();
+    conn_state_ptr->connected = dbcapi.connect2(conn_state_ptr->conn);
+    Hdbtcl_Stats delta = { .connects = 1, .connect_time = GetMonotonicTime() - started, .calls = 1, .errors = !conn_state_ptr->connected };
+    Stats_Record(conn_state_ptr, NULL, &delta);
+    if ( !conn_state_ptr->connected ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot connect to the database", NULL);
+        goto Error_Exit;
+    }
+    return conn_state_ptr;
+
+Error_Exit:
+    Conn_DeleteState(conn_state_ptr, interp);
+    return NULL;
+}
+
+/**
+ * Creates the command that is used to manipulate the connection and sets its name as the result.
  */
 static int
-BindStmtArgs (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int argc, Tcl_Obj * const argv[], dbcapi_bool is_null[], PrimitiveSqlValue sql_args[])
+CreateConnCmd (Conn_State * conn_state_ptr, Tcl_Interp * interp)
 {
-    int num_params = dbcapi.num_params(stmt_state_ptr->stmt);
-    if ( num_params < 0 ) {
-        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot determine the number of statement parameters", NULL);
+    if ( conn_state_ptr->open_statements == NULL ) {
+        conn_state_ptr->open_statements = ckalloc(sizeof(Tcl_HashTable));
+        Tcl_InitHashTable(conn_state_ptr->open_statements, TCL_ONE_WORD_KEYS);
+    }
+
+    char name[24];
+    int name_len = sprintf(name, "hdbconn%" PRIxPTR, (uintptr_t) conn_state_ptr);
+
+    conn_state_ptr->conn_cmd = Tcl_CreateObjCommand(interp, name, (Tcl_ObjCmdProc *) Conn_Cmd, (ClientData) conn_state_ptr, (Tcl_CmdDeleteProc *) Conn_DeleteState);
+    if ( conn_state_ptr->conn_cmd == NULL ) {
+        Tcl_SetResult(interp, "cannot create connection command handler", TCL_STATIC);
         return TCL_ERROR;
     }
-    if ( argc != num_params ) {
-        SetNumDiffErrorResult(interp, "Expected ", num_params, " arguments but got ", argc, NULL);
+    int is_new;
+    Tcl_HashEntry * entry = Tcl_CreateHashEntry(conn_state_ptr->hdbtcl_state_ptr->open_connections, conn_state_ptr->conn_cmd, &is_new);
+    Tcl_SetHashValue(entry, conn_state_ptr->conn_cmd);
+
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(name, name_len));
+    return TCL_OK;
+}
+
+/**
+ * Establishes a database connection and returns the command that is used to manipulate the current connection.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set conn [hdb connect -serverNode localhost:39041 -uid username -pwd password]
+ * \endcode
+ *
+ * \see https://help.sap.com/viewer/0eec0d68141541d1b07893a39944924e/2.0.04/en-US/4fe9978ebac44f35b9369ef5a4a26f4c.html
+ *      for a list of acceptable connection options/properties
+ *
+ * \note The `charset` option, if provided, will be overwritten and set to `UTF-8`
+ */
+static int
+Hdb_Connect (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 2 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "connect -option value ?-option value...?");
         return TCL_ERROR;
     }
 
-    if ( !dbcapi.reset(stmt_state_ptr->stmt) ) {
-        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot reset statement for execution", NULL);
+    PROBE1(connect__start, hdbtcl_state_ptr);
+    Conn_State * conn_state_ptr = NewConnState(hdbtcl_state_ptr, interp, objc, objv);
+    if ( conn_state_ptr == NULL ) {
+        PROBE2(connect__done, NULL, TCL_ERROR);
+        return TCL_ERROR;
+    }
+    if ( CreateConnCmd(conn_state_ptr, interp) != TCL_OK ) {
+        Conn_DeleteState(conn_state_ptr, interp);
+        PROBE2(connect__done, NULL, TCL_ERROR);
         return TCL_ERROR;
     }
+    PROBE2(connect__done, conn_state_ptr, TCL_OK);
+    return TCL_OK;
+}
 
-    for ( int i = 0; i < argc; i++ ) {
-        dbcapi_bind_data bind;
-        dbcapi_bind_param_info info;
-        if (
-            !dbcapi.describe_bind_param(stmt_state_ptr->stmt, i, &bind) ||
-            !dbcapi.get_bind_param_info(stmt_state_ptr->stmt, i, &info)
-        ) {
-            char num[12];
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve information about SQL parameter [", itoa(i, num, 10), "]", NULL);
+/**
+ * Internal connection pool state.
+ */
+typedef struct conn_pool {
+    Hdbtcl_State *      hdbtcl_state_ptr;
+    Tcl_Command         pool_cmd;
+    Tcl_Obj *           connect_options;    /// connection properties (list of -option value pairs)
+    int                 min_size;
+    int                 max_size;
+    int                 idle_timeout;       /// ms after which connections above min_size are closed, 0 - never
+    int                 health_check;       /// ms of idleness after which connections are checked before checkout, -1 - never
+    int                 autocommit;
+    int                 isolation;
+    Tcl_Obj *           clientinfo;         /// client info (name value pairs) set on checkout
+    Conn_State * *      idle;               /// idle connections, the least recently used first
+    int                 num_idle;
+    int                 num_busy;           /// number of checked out connections
+    Tcl_TimerToken      sweep_timer;
+    bool                closing;
+} Conn_Pool;
+
+/**
+ * Returns number of milliseconds that have passed since the specified time.
+ */
+static long
+GetElapsedMs (const Tcl_Time * since)
+{
+    Tcl_Time now;
+    Tcl_GetTime(&now);
+    return ( now.sec - since->sec ) * 1000 + ( now.usec - since->usec ) / 1000;
+}
+
+static void Pool_Sweep (ClientData client_data);
+
+/**
+ * Schedules closing of the connections that have been idle for too long.
+ */
+static void
+Pool_ScheduleSweep (Conn_Pool * pool_ptr)
+{
+    if ( pool_ptr->sweep_timer != NULL || pool_ptr->idle_timeout <= 0 || pool_ptr->num_idle == 0 ) {
+        return;
+    }
+    if ( pool_ptr->num_idle + pool_ptr->num_busy <= pool_ptr->min_size ) {
+        return;
+    }
+    long wait_ms = pool_ptr->idle_timeout - GetElapsedMs(&pool_ptr->idle[0]->idle_since);
+    pool_ptr->sweep_timer = Tcl_CreateTimerHandler(wait_ms > 0 ? (int) wait_ms : 0, Pool_Sweep, (ClientData) pool_ptr);
+}
+
+/**
+ * Removes the idle connection from the pool.
+ */
+static Conn_State *
+Pool_TakeIdle (Conn_Pool * pool_ptr, int index)
+{
+    Conn_State * conn_state_ptr = pool_ptr->idle[index];
+    memmove(pool_ptr->idle + index, pool_ptr->idle + index + 1, sizeof(Conn_State *) * (pool_ptr->num_idle - index - 1));
+    --pool_ptr->num_idle;
+    conn_state_ptr->pool = NULL;
+    return conn_state_ptr;
+}
+
+/**
+ * Closes connections that have been idle longer than the idle timeout as long as the pool has more
+ * than the minimum number of connections.
+ */
+static void
+Pool_Sweep (ClientData client_data)
+{
+    Conn_Pool * pool_ptr = (Conn_Pool *) client_data;
+    pool_ptr->sweep_timer = NULL;
+    while (
+        pool_ptr->num_idle > 0 &&
+        pool_ptr->num_idle + pool_ptr->num_busy > pool_ptr->min_size &&
+        GetElapsedMs(&pool_ptr->idle[0]->idle_since) >= pool_ptr->idle_timeout
+    ) {
+        Conn_DeleteState(Pool_TakeIdle(pool_ptr, 0), NULL);
+    }
+    Pool_ScheduleSweep(pool_ptr);
+}
+
+/**
+ * Returns the checked out connection back to the pool. Called when the connection command is deleted
+ * after its statements have been closed.
+ *
+ * Returns false if the pool does not want the connection back, in which case it is closed.
+ */
+static bool
+Pool_Release (Conn_Pool * pool_ptr, Conn_State * conn_state_ptr)
+{
+    --pool_ptr->num_busy;
+    if ( pool_ptr->closing || pool_ptr->hdbtcl_state_ptr->hdb_cmd == NULL ) {
+        return false;
+    }
+    if ( !conn_state_ptr->connected || !dbcapi.rollback(conn_state_ptr->conn) ) {
+        return false;
+    }
+    Tcl_GetTime(&conn_state_ptr->idle_since);
+    pool_ptr->idle[pool_ptr->num_idle++] = conn_state_ptr;
+    Pool_ScheduleSweep(pool_ptr);
+    return true;
+}
+
+/**
+ * Checks whether the connection that has been idle is still usable.
+ */
+static bool
+Pool_IsHealthy (Conn_Pool * pool_ptr, Conn_State * conn_state_ptr)
+{
+    if ( pool_ptr->health_check < 0 || GetElapsedMs(&conn_state_ptr->idle_since) < pool_ptr->health_check ) {
+        return true;
+    }
+    dbcapi_stmt * stmt = dbcapi.execute_direct(conn_state_ptr->conn, "SELECT 1 FROM DUMMY");
+    if ( stmt == NULL ) {
+        return false;
+    }
+    dbcapi.free_stmt(stmt);
+    return true;
+}
+
+/**
+ * Resets the session configuration of the connection to the one configured for the pool.
+ */
+static int
+Pool_ResetConn (Conn_Pool * pool_ptr, Conn_State * conn_state_ptr, Tcl_Interp * interp)
+{
+    if ( !dbcapi.set_autocommit(conn_state_ptr->conn, pool_ptr->autocommit) ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot set autocommit", NULL);
+        return TCL_ERROR;
+    }
+    if ( !dbcapi.set_transaction_isolation(conn_state_ptr->conn, pool_ptr->isolation) ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot set transaction isolation level", NULL);
+        return TCL_ERROR;
+    }
+    if ( conn_state_ptr->clientinfo != NULL ) {
+        int num_vars;
+        Tcl_Obj * * vars;
+        Tcl_ListObjGetElements(NULL, conn_state_ptr->clientinfo, &num_vars, &vars);
+        for ( int i = 0; i < num_vars; i++ ) {
+            if ( !dbcapi.set_clientinfo(conn_state_ptr->conn, Tcl_GetString(vars[i]), "") ) {
+                SetErrorResult(interp, conn_state_ptr->conn, "Cannot reset session variable ", Tcl_GetString(vars[i]), NULL);
+                return TCL_ERROR;
+            }
+        }
+        Tcl_DecrRefCount(conn_state_ptr->clientinfo);
+        conn_state_ptr->clientinfo = NULL;
+    }
+    int num_elems;
+    Tcl_Obj * * elems;
+    Tcl_ListObjGetElements(NULL, pool_ptr->clientinfo, &num_elems, &elems);
+    for ( int i = 0; i + 1 < num_elems; i += 2 ) {
+        if ( !dbcapi.set_clientinfo(conn_state_ptr->conn, Tcl_GetString(elems[i]), Tcl_GetString(elems[i + 1])) ) {
+            SetErrorResult(interp, conn_state_ptr->conn, "Cannot set session variable ", Tcl_GetString(elems[i]), NULL);
             return TCL_ERROR;
         }
-        if ( bind.value.type == A_INVALID_TYPE ) {
-            char num[12];
-            Tcl_AppendResult(interp, "DBCAPI did not return the type of parameter [", itoa(i, num, 10), "],", NULL);
-            if ( bind.name != NULL && bind.name[0] != '\0' ) {
-                Tcl_AppendResult(interp, " (", bind.name, ")", NULL);
+    }
+    conn_state_ptr->timeout = 0;
+    conn_state_ptr->memory_limit = 0;
+    conn_state_ptr->lob_chunk_size = LOB_CHUNK_SIZE;
+    conn_state_ptr->tracing = false;
+    if ( conn_state_ptr->trace_command != NULL ) {
+        Tcl_DecrRefCount(conn_state_ptr->trace_command);
+        conn_state_ptr->trace_command = NULL;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Opens a new pooled connection.
+ */
+static Conn_State *
+Pool_Connect (Conn_Pool * pool_ptr, Tcl_Interp * interp)
+{
+    int objc;
+    Tcl_Obj * * objv;
+    Tcl_ListObjGetElements(NULL, pool_ptr->connect_options, &objc, &objv);
+    return NewConnState(pool_ptr->hdbtcl_state_ptr, interp, objc, objv);
+}
+
+/**
+ * Takes a connection from the pool - reuses the most recently used healthy idle connection or opens
+ * a new one. The connection is counted as checked out.
+ */
+static Conn_State *
+Pool_Acquire (Conn_Pool * pool_ptr, Tcl_Interp * interp)
+{
+    Conn_State * conn_state_ptr = NULL;
+    while ( pool_ptr->num_idle > 0 ) {
+        conn_state_ptr = Pool_TakeIdle(pool_ptr, pool_ptr->num_idle - 1);
+        if ( Pool_IsHealthy(pool_ptr, conn_state_ptr) ) {
+            break;
+        }
+        Conn_DeleteState(conn_state_ptr, interp);
+        conn_state_ptr = NULL;
+    }
+    if ( conn_state_ptr == NULL ) {
+        if ( pool_ptr->num_busy >= pool_ptr->max_size ) {
+            Tcl_SetResult(interp, "connection pool is exhausted", TCL_STATIC);
+            return NULL;
+        }
+        conn_state_ptr = Pool_Connect(pool_ptr, interp);
+        if ( conn_state_ptr == NULL ) {
+            return NULL;
+        }
+    }
+    if ( Pool_ResetConn(pool_ptr, conn_state_ptr, interp) != TCL_OK ) {
+        Conn_DeleteState(conn_state_ptr, interp);
+        return NULL;
+    }
+    conn_state_ptr->pool = pool_ptr;
+    ++pool_ptr->num_busy;
+    return conn_state_ptr;
+}
+
+/**
+ * Checks out a connection from the pool. Returns the connection command.
+ *
+ * The most recently used idle connection is reused. If the pool has no idle connections a new one is opened,
+ * unless the pool has already reached its maximum size.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set conn [$pool checkout]
+ * \endcode
+ *
+ * \note Connection is returned to the pool when it is closed. Its open transaction is rolled back and its
+ * statements are closed.
+ */
+static int
+Pool_Checkout (Conn_Pool * pool_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 2 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "checkout");
+        return TCL_ERROR;
+    }
+    Conn_State * conn_state_ptr = Pool_Acquire(pool_ptr, interp);
+    if ( conn_state_ptr == NULL ) {
+        return TCL_ERROR;
+    }
+    if ( CreateConnCmd(conn_state_ptr, interp) != TCL_OK ) {
+        Conn_DeleteState(conn_state_ptr, interp);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Returns the checked out connection to the pool. This is the same as closing the connection.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $pool checkin $conn
+ * \endcode
+ */
+static int
+Pool_Checkin (Conn_Pool * pool_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 3 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "checkin connection");
+        return TCL_ERROR;
+    }
+    Tcl_CmdInfo info;
+    if ( !Tcl_GetCommandInfo(interp, Tcl_GetString(objv[2]), &info) || info.objProc != (Tcl_ObjCmdProc *) Conn_Cmd ) {
+        Tcl_AppendResult(interp, Tcl_GetString(objv[2]), " is not a connection", NULL);
+        return TCL_ERROR;
+    }
+    Conn_State * conn_state_ptr = (Conn_State *) info.objClientData;
+    if ( conn_state_ptr->pool != pool_ptr ) {
+        Tcl_AppendResult(interp, Tcl_GetString(objv[2]), " was not checked out from this pool", NULL);
+        return TCL_ERROR;
+    }
+    return Conn_Close(conn_state_ptr, interp, 0, NULL);
+}
+
+/**
+ * Returns the pool status as a dictionary with the following keys:
+ * - size    - total number of connections
+ * - idle    - number of idle connections
+ * - busy    - number of checked out connections
+ * - minsize - minimum number of connections
+ * - maxsize - maximum number of connections
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set num_idle [dict get [$pool info] idle]
+ * \endcode
+ */
+static int
+Pool_Info (Conn_Pool * pool_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 2 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "info");
+        return TCL_ERROR;
+    }
+    Tcl_Obj * info = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("size",    -1), Tcl_NewIntObj(pool_ptr->num_idle + pool_ptr->num_busy));
+    Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("idle",    -1), Tcl_NewIntObj(pool_ptr->num_idle));
+    Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("busy",    -1), Tcl_NewIntObj(pool_ptr->num_busy));
+    Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("minsize", -1), Tcl_NewIntObj(pool_ptr->min_size));
+    Tcl_DictObjPut(NULL, info, Tcl_NewStringObj("maxsize", -1), Tcl_NewIntObj(pool_ptr->max_size));
+    Tcl_SetObjResult(interp, info);
+    return TCL_OK;
+}
+
+/**
+ * Closes the pool and all its idle connections.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * $pool close
+ * \endcode
+ *
+ * \note Connections that are checked out stay open. They are closed, rather than returned to the pool,
+ * when they are closed by the application.
+ */
+static int
+Pool_Close (Conn_Pool * pool_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( Tcl_DeleteCommandFromToken(interp, pool_ptr->pool_cmd) != TCL_OK ) {
+        Tcl_SetResult(interp, "Cannot delete pool handle", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+/**
+ * Destroys and deletes the pool state.
+ */
+static void
+Pool_DeleteState (Conn_Pool * pool_ptr, Tcl_Interp * interp)
+{
+    if ( pool_ptr == NULL ) {
+        return;
+    }
+    pool_ptr->closing = true;
+    if ( pool_ptr->sweep_timer != NULL ) {
+        Tcl_DeleteTimerHandler(pool_ptr->sweep_timer);
+    }
+    if ( pool_ptr->pool_cmd != NULL && pool_ptr->hdbtcl_state_ptr->hdb_cmd != NULL ) {
+        Tcl_HashEntry * entry = Tcl_FindHashEntry(pool_ptr->hdbtcl_state_ptr->open_pools, pool_ptr->pool_cmd);
+        if ( entry != NULL ) {
+            Tcl_DeleteHashEntry(entry);
+        }
+    }
+    // Detach checked out connections. They will be closed when the application closes them.
+    Tcl_HashSearch iter;
+    for (
+        Tcl_HashEntry * entry = Tcl_FirstHashEntry(pool_ptr->hdbtcl_state_ptr->open_connections, &iter);
+        entry != NULL;
+        entry = Tcl_NextHashEntry(&iter)
+    ) {
+        Tcl_CmdInfo info;
+        if ( Tcl_GetCommandInfoFromToken(Tcl_GetHashValue(entry), &info) ) {
+            Conn_State * conn_state_ptr = (Conn_State *) info.objClientData;
+            if ( conn_state_ptr->pool == pool_ptr ) {
+                conn_state_ptr->pool = NULL;
             }
-            return TCL_ERROR;
         }
+    }
+    while ( pool_ptr->num_idle > 0 ) {
+        Conn_DeleteState(Pool_TakeIdle(pool_ptr, pool_ptr->num_idle - 1), interp);
+    }
+    if ( pool_ptr->idle            != NULL ) ckfree(pool_ptr->idle);
+    if ( pool_ptr->connect_options != NULL ) Tcl_DecrRefCount(pool_ptr->connect_options);
+    if ( pool_ptr->clientinfo      != NULL ) Tcl_DecrRefCount(pool_ptr->clientinfo);
+    ckfree((char *) pool_ptr);
+}
+
+/**
+ * Pool subcommands multiplexor.
+ */
+static int
+Pool_Cmd (Conn_Pool * pool_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 2 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "method ?option...?");
+        return TCL_ERROR;
+    }
+
+    static const char * const methods[] = {
+        "checkin", "checkout", "close", "info", NULL
+    };
+    enum {
+        CHECKIN, CHECKOUT, CLOSE, INFO
+    } method;
+
+    if ( Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, (int *) &method) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    switch ( method ) {
+        case CHECKIN:
+            return Pool_Checkin(pool_ptr, interp, objc, objv);
+        case CHECKOUT:
+            return Pool_Checkout(pool_ptr, interp, objc, objv);
+        case CLOSE:
+            return Pool_Close(pool_ptr, interp, objc, objv);
+        case INFO:
+            return Pool_Info(pool_ptr, interp, objc, objv);
+    }
+    return TCL_OK;
+}
 
-        if ( bind.value.buffer_size == INT32_MAX ) {
-            // It's a LOB. The argument might be an object or an open channel or a pair of channels (for INOUT parameters)
+/**
+ * Creates a connection pool and returns the command that is used to manipulate it.
+ *
+ * Pool options:
+ *  -minsize
+ *      Number of connections that are opened when the pool is created and that are kept open
+ *      even when they are idle. The default is 0.
+ *  -maxsize
+ *      Maximum number of connections. The default is 10.
+ *  -idletimeout
+ *      Number of milliseconds after which idle connections above the minimum pool size are
+ *      closed. The default is 300000 (5 minutes). 0 keeps idle connections open.
+ *  -healthcheck
+ *      Number of milliseconds of idleness after which the connection is checked before it is
+ *      checked out. The default is 30000. 0 checks connection on every checkout, -1 disables
+ *      health checks.
+ *  -autocommit
+ *      AUTOCOMMIT mode the checked out connections are reset to. The default is off.
+ *  -isolation
+ *      Transaction isolation level the checked out connections are reset to. The default is
+ *      "READ COMMITTED".
+ *  -clientinfo
+ *      Session-specific client information (a list of name value pairs) that is set on every
+ *      checkout.
+ *
+ * All other options are connection properties that are used to open pooled connections.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set pool [hdb pool create -serverNode localhost:39041 -uid username -pwd password -maxsize 20]
+ * \endcode
+ */
+static int
+Hdb_PoolCreate (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 2 || objc % 2 != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "pool create -option value ?-option value...?");
+        return TCL_ERROR;
+    }
 
-            if ( bind.direction == DD_INPUT && argv[i]->bytes != NULL && 0 < argv[i]->length && argv[i]->length < 32 ) {
-                const char * name = Tcl_GetString(argv[i]);
-                int mode;
-                Tcl_Channel ch = Tcl_GetChannel(interp, name, &mode);
-                if ( ch != NULL ) {
-                    // Check whether it is usable...
-                    if ( ( mode & TCL_READABLE ) == 0 ) {
-                        Tcl_AppendResult(interp, "Channel ", name, " must be open for reading", NULL);
-                        return TCL_ERROR;
-                    }
-                    sql_args[i].data_length = INT32_MAX;
-                    bind.value.length = &sql_args[i].data_length;
-                    bind.value.buffer_size = 0;
-                } else {
-                    Tcl_ResetResult(interp);
-                }
-            } else if ( bind.direction == DD_INPUT_OUTPUT || bind.direction == DD_OUTPUT ) {
-                // Output is always streamed
-                sql_args[i].data_length = INT32_MAX;
-                bind.value.length = &sql_args[i].data_length;
-                bind.value.buffer_size = 0;
-            }
+    static const char * const options[] = {
+        "-minsize", "-maxsize", "-idletimeout", "-healthcheck", "-autocommit", "-isolation", "-clientinfo",
+        NULL
+    };
+    enum {
+        MINSIZE, MAXSIZE, IDLETIMEOUT, HEALTHCHECK, AUTOCOMMIT, ISOLATION, CLIENTINFO
+    } option;
 
-            if ( bind.value.buffer_size == 0 ) {
-                BIND_PARAM(stmt_state_ptr, interp, i, &bind);
-                continue;
-            }
+    Conn_Pool * pool_ptr = ckalloc(sizeof(Conn_Pool));
+    memset(pool_ptr, 0, sizeof(Conn_Pool));
+    pool_ptr->hdbtcl_state_ptr = hdbtcl_state_ptr;
+    pool_ptr->max_size         = 10;
+    pool_ptr->idle_timeout     = 300000;
+    pool_ptr->health_check     = 30000;
+    pool_ptr->isolation        = 1;
+    pool_ptr->connect_options  = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(pool_ptr->connect_options);
+    pool_ptr->clientinfo       = Tcl_NewListObj(0, NULL);
+    Tcl_IncrRefCount(pool_ptr->clientinfo);
+
+    for ( int i = 0; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(NULL, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            Tcl_ListObjAppendElement(NULL, pool_ptr->connect_options, objv[i]);
+            Tcl_ListObjAppendElement(NULL, pool_ptr->connect_options, objv[i + 1]);
+            continue;
         }
-
-        // Set up buffers for primitives
-        switch ( bind.value.type ) {
-            case A_VAL32: case A_UVAL32: case A_VAL16: case A_UVAL16: case A_VAL8: case A_UVAL8:
-                bind.value.type = A_VAL32;
-                bind.value.buffer = (char *) &sql_args[i].int_value;
-                bind.value.buffer_size = sizeof(sql_args[i].int_value);
-                bind.value.length = &bind.value.buffer_size;
-                break;
-            case A_VAL64: case A_UVAL64:
-                bind.value.type = A_VAL64;
-                bind.value.buffer = (char *) &sql_args[i].wideint_value;
-                bind.value.buffer_size = sizeof(sql_args[i].wideint_value);
-                bind.value.length = &bind.value.buffer_size;
+        switch ( option ) {
+            case MINSIZE:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &pool_ptr->min_size) != TCL_OK ) {
+                    goto Error_Exit;
+                }
                 break;
-            case A_DOUBLE: case A_FLOAT:
-                bind.value.type = A_DOUBLE;
-                bind.value.buffer = (char *) &sql_args[i].double_value;
-                bind.value.buffer_size = sizeof(sql_args[i].double_value);
-                bind.value.length = &bind.value.buffer_size;
+            case MAXSIZE:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &pool_ptr->max_size) != TCL_OK ) {
+                    goto Error_Exit;
+                }
                 break;
-            default: {
-                // Strings and binaries (byte arrays)
-            }
-        }
-
-        Tcl_Obj * arg_val;
-        if ( bind.direction == DD_INPUT ) {
-            arg_val = argv[i];
-        } else {
-            if ( bind.direction == DD_INPUT_OUTPUT ) {
-                arg_val = Tcl_ObjGetVar2(interp, argv[i], NULL, TCL_LEAVE_ERR_MSG);
-                if ( arg_val == NULL ) {
-                    return TCL_ERROR;
+            case IDLETIMEOUT:
+                if ( GetTimeoutFromObj(interp, objv[i + 1], &pool_ptr->idle_timeout) != TCL_OK ) {
+                    goto Error_Exit;
                 }
-            } else {
-                arg_val = Tcl_ObjGetVar2(interp, argv[i], NULL, 0);
-                if ( arg_val == NULL ) {
-                    arg_val = Tcl_ObjSetVar2(interp, argv[i], NULL, Tcl_NewObj(), TCL_LEAVE_ERR_MSG);
+                break;
+            case HEALTHCHECK:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &pool_ptr->health_check) != TCL_OK ) {
+                    goto Error_Exit;
                 }
-            }
-            if ( Tcl_IsShared(arg_val) ) {
-                arg_val = Tcl_ObjSetVar2(interp, argv[i], NULL, Tcl_DuplicateObj(arg_val), TCL_LEAVE_ERR_MSG);
-            }
-        }
-
-        is_null[i] = ( arg_val->bytes != NULL && arg_val->length == 0 );
-        if ( is_null[i] ) {
-            bind.value.is_null = &is_null[i];
-        } else if ( bind.direction == DD_INPUT || bind.direction == DD_INPUT_OUTPUT ) {
-            // Load primities into local buffers
-            switch ( bind.value.type ) {
-                case A_VAL32: case A_UVAL32: case A_VAL16: case A_UVAL16: case A_VAL8: case A_UVAL8: {
-                    int res = (
-                        info.native_type == DT_BOOLEAN
-                            ? Tcl_GetBooleanFromObj(interp, arg_val, &sql_args[i].int_value)
-                            : Tcl_GetIntFromObj(interp, arg_val, &sql_args[i].int_value)
-                    );
-                    if ( res != TCL_OK ) {
-                        return TCL_ERROR;
-                    }
-                    break;
+                break;
+            case AUTOCOMMIT:
+                if ( Tcl_GetBooleanFromObj(interp, objv[i + 1], &pool_ptr->autocommit) != TCL_OK ) {
+                    goto Error_Exit;
                 }
-                case A_VAL64: case A_UVAL64: {
-                    if ( Tcl_GetWideIntFromObj(interp, arg_val, &sql_args[i].wideint_value) != TCL_OK ) {
-                        return TCL_ERROR;
-                    }
-                    break;
+                break;
+            case ISOLATION: {
+                static const char * const levels[] = {
+                    "READ COMMITTED", "REPEATABLE READ", "SERIALIZABLE",
+                    NULL
+                };
+                int level;
+                if ( Tcl_GetIndexFromObj(interp, objv[i + 1], levels, "isolation level", 0, &level) != TCL_OK ) {
+                    goto Error_Exit;
                 }
-                case A_DOUBLE: case A_FLOAT: {
-                    if ( Tcl_GetDoubleFromObj(interp, arg_val, &sql_args[i].double_value) != TCL_OK ) {
-                        return TCL_ERROR;
-                    }
-                    break;
+                pool_ptr->isolation = level + 1;
+                break;
+            }
+            case CLIENTINFO: {
+                int num_elems;
+                if ( Tcl_ListObjLength(interp, objv[i + 1], &num_elems) != TCL_OK ) {
+                    goto Error_Exit;
                 }
-                default: {
-                    // Strings and binaries (byte arrays)
+                if ( num_elems % 2 != 0 ) {
+                    Tcl_SetResult(interp, "client info must be a list of name value pairs", TCL_STATIC);
+                    goto Error_Exit;
                 }
+                Tcl_DecrRefCount(pool_ptr->clientinfo);
+                pool_ptr->clientinfo = objv[i + 1];
+                Tcl_IncrRefCount(pool_ptr->clientinfo);
+                break;
             }
         }
+    }
+    if ( pool_ptr->max_size < 1 || pool_ptr->min_size < 0 || pool_ptr->min_size > pool_ptr->max_size ) {
+        Tcl_SetResult(interp, "pool size must satisfy 0 <= minsize <= maxsize and maxsize > 0", TCL_STATIC);
+        goto Error_Exit;
+    }
+    pool_ptr->idle = ckalloc(sizeof(Conn_State *) * pool_ptr->max_size);
 
-        // Strings and byte arrays
-        if ( bind.direction == DD_INPUT || bind.direction == DD_INPUT_OUTPUT ) {
-            int len;
-            switch ( bind.value.type ) {
-                case A_STRING:
-                    bind.value.buffer = Tcl_GetStringFromObj(arg_val, &len);
-                    sql_args[i].data_length = len;
-                    bind.value.length = &sql_args[i].data_length;
-                    break;
-                case A_BINARY:
-                    bind.value.buffer = (char *) Tcl_GetByteArrayFromObj(arg_val, &len);
-                    sql_args[i].data_length = len;
-                    bind.value.length = &sql_args[i].data_length;
-                    break;
-                default: {
-                    // primitives
-                }
-            }
+    while ( pool_ptr->num_idle < pool_ptr->min_size ) {
+        Conn_State * conn_state_ptr = Pool_Connect(pool_ptr, interp);
+        if ( conn_state_ptr == NULL ) {
+            goto Error_Exit;
         }
+        Tcl_GetTime(&conn_state_ptr->idle_since);
+        pool_ptr->idle[pool_ptr->num_idle++] = conn_state_ptr;
+    }
 
-        if ( bind.direction == DD_OUTPUT || bind.direction == DD_INPUT_OUTPUT ) {
-            // Make sure Strings and byte arrays have enough space for output
-            if ( bind.value.type == A_STRING ) {
-                // For NVARCHAR DBCAPI sets bind's "buffer size" (and info's "max size") to the number of characters.
-                int output_buffer_size = bind.value.buffer_size * BYTES_PER_CODEPOINT;
-                int len;
-                bind.value.buffer = Tcl_GetStringFromObj(arg_val, &len);
-                if ( len < output_buffer_size ) {
-                    Tcl_SetObjLength(arg_val, output_buffer_size);
-                    bind.value.buffer = (char*) Tcl_GetString(arg_val);
-                    // account for terminating '\0'
-                    bind.value.buffer_size = output_buffer_size + 1;
-                } else {
-                    bind.value.buffer_size = len + 1;
-                }
-                bind.value.length = &sql_args[i].data_length;
+    char name[24];
+    int name_len = sprintf(name, "hdbpool%" PRIxPTR, (uintptr_t) pool_ptr);
 
-            } else if ( bind.value.type == A_BINARY ) {
-                int len;
-                bind.value.buffer = (char *) Tcl_GetByteArrayFromObj(arg_val, &len);
-                if ( len < bind.value.buffer_size ) {
-                    bind.value.buffer = (char*) Tcl_SetByteArrayLength(arg_val, bind.value.buffer_size);
-                } else {
-                    bind.value.buffer_size = len;
-                }
-                bind.value.length = &sql_args[i].data_length;
-                Tcl_InvalidateStringRep(arg_val);
-            }
-        }
+    pool_ptr->pool_cmd = Tcl_CreateObjCommand(interp, name, (Tcl_ObjCmdProc *) Pool_Cmd, (ClientData) pool_ptr, (Tcl_CmdDeleteProc *) Pool_DeleteState);
+    if ( pool_ptr->pool_cmd == NULL ) {
+        Tcl_SetResult(interp, "cannot create pool command handler", TCL_STATIC);
+        goto Error_Exit;
+    }
+    int is_new;
+    Tcl_HashEntry * entry = Tcl_CreateHashEntry(hdbtcl_state_ptr->open_pools, pool_ptr->pool_cmd, &is_new);
+    Tcl_SetHashValue(entry, pool_ptr->pool_cmd);
 
-        BIND_PARAM(stmt_state_ptr, interp, i, &bind);
+    Tcl_SetObjResult(interp, Tcl_NewStringObj(name, name_len));
+    return TCL_OK;
+
+Error_Exit:
+    Pool_DeleteState(pool_ptr, interp);
+    return TCL_ERROR;
+}
+
+/**
+ * Implements the "hdb pool" command.
+ */
+static int
+Hdb_Pool (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 1 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "pool create ?-option value...?");
+        return TCL_ERROR;
     }
 
+    static const char * const methods[] = {
+        "create", NULL
+    };
+    enum {
+        CREATE
+    } method;
+
+    if ( Tcl_GetIndexFromObj(interp, objv[0], methods, "method", 0, (int *) &method) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    switch ( method ) {
+        case CREATE:
+            return Hdb_PoolCreate(hdbtcl_state_ptr, interp, objc - 1, objv + 1);
+    }
     return TCL_OK;
 }
 
 /**
- * Sends IN LOB argument data that were provided as a readable channel.
+ * Batch of queries that are executed in parallel. Connection workers hand completed requests
+ * back to the waiting thread through the batch.
+ */
+typedef struct parallel_batch {
+    Tcl_Mutex           lock;
+    Tcl_Condition       cond;
+    Async_Job *         done;           /// completed requests that have not been processed yet
+} Parallel_Batch;
+
+/**
+ * Hands the completed request over to the thread that waits for the batch.
+ *
+ * \note This function runs in the worker thread.
+ */
+static void
+Parallel_Complete (Async_Job * job)
+{
+    Parallel_Batch * batch_ptr = job->batch;
+    Tcl_MutexLock(&batch_ptr->lock);
+    job->next = batch_ptr->done;
+    batch_ptr->done = job;
+    Tcl_ConditionNotify(&batch_ptr->cond);
+    Tcl_MutexUnlock(&batch_ptr->lock);
+}
+
+/**
+ * Creates the result of a failed job.
+ */
+static Tcl_Obj *
+Parallel_NewErrorObj (Tcl_Obj * message, double elapsed_ms)
+{
+    Tcl_Obj * result = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("status", -1), Tcl_NewStringObj("error", -1));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("error", -1), message);
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("elapsed", -1), Tcl_NewDoubleObj(elapsed_ms));
+    return result;
+}
+
+/**
+ * Marks the connection of the completed job as idle.
+ */
+static void
+Parallel_Detach (Async_Job * job)
+{
+    Conn_State * conn_state_ptr = job->stmt_state_ptr->conn_state_ptr;
+    Tcl_MutexLock(&conn_state_ptr->worker_lock);
+    conn_state_ptr->job = NULL;
+    Tcl_MutexUnlock(&conn_state_ptr->worker_lock);
+    // statements of parallel jobs do not have commands, so only the connection keeps their counters
+    Stats_Record(conn_state_ptr, NULL, &job->stats);
+}
+
+/**
+ * Closes the statement that was prepared for the job.
+ */
+static void
+Parallel_FreeStmt (Stmt_State * stmt_state_ptr)
+{
+    dbcapi.free_stmt(stmt_state_ptr->stmt);
+    ckfree(stmt_state_ptr);
+}
+
+/**
+ * Checks whether the parameter is a LOB.
+ */
+static bool
+IsLobNativeType (dbcapi_native_type native_type)
+{
+    switch ( native_type ) {
+        case DT_CLOB: case DT_NCLOB: case DT_BLOB: case DT_TEXT: case DT_BINTEXT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Prepares the job's statement on the connection, binds its arguments and submits it to the
+ * connection worker. Returns TCL_ERROR, with the error message in the interpreter result, if
+ * the job could not be started.
  */
 static int
-SendDataFromChannel (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int arg_idx, dbcapi_data_type data_type, Tcl_Channel input)
+Parallel_Submit (Parallel_Batch * batch_ptr, Conn_State * conn_state_ptr, Tcl_Interp * interp, Tcl_Obj * job_obj, int index, int max_rows)
 {
-    if ( data_type == A_STRING ) {
-        Tcl_Obj * buff = Tcl_NewObj();
-        int len = 32768;
-        Tcl_SetObjLength(buff, len);
-        do {
-            len = Tcl_ReadChars(input, buff, 32768, 0);
-            int byte_len;
-            char * data = Tcl_GetStringFromObj(buff, &byte_len);
-            if ( !dbcapi.send_param_data(stmt_state_ptr->stmt, arg_idx, data, byte_len) ) {
-                char num[12];
-                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot send data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
-                Tcl_DecrRefCount(buff);
-                return TCL_ERROR;
-            }
-        } while ( len == 32768 );
-        Tcl_DecrRefCount(buff);
-        if ( !dbcapi.finish_param_data(stmt_state_ptr->stmt, arg_idx) ) {
-            char num[12];
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot finish sending data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
-            return TCL_ERROR;
-        }
-    } else if (data_type == A_BINARY ) {
-        Tcl_Obj * buff = Tcl_NewObj();
-        int len = 32768;
-        Tcl_SetByteArrayLength(buff, len);
-        do {
-            len = Tcl_ReadChars(input, buff, 32768, 0);
-            int byte_len;
-            unsigned char * data = Tcl_GetByteArrayFromObj(buff, &byte_len);
-            if ( !dbcapi.send_param_data(stmt_state_ptr->stmt, arg_idx, (char *) data, byte_len) ) {
-                char num[12];
-                SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot send data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
-                Tcl_DecrRefCount(buff);
-                return TCL_ERROR;
-            }
-        } while ( len == 32768 );
-        Tcl_DecrRefCount(buff);
-        if ( !dbcapi.finish_param_data(stmt_state_ptr->stmt, arg_idx) ) {
+    int objc;
+    Tcl_Obj * * objv;
+    Tcl_ListObjGetElements(NULL, job_obj, &objc, &objv);
+
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_stmt * stmt = dbcapi.prepare(conn_state_ptr->conn, Tcl_GetString(objv[0]));
+    Hdbtcl_Stats delta = { .prepares = 1, .prepare_time = GetMonotonicTime() - started, .calls = 1, .errors = ( stmt == NULL ) };
+    Stats_Record(conn_state_ptr, NULL, &delta);
+    if ( stmt == NULL ) {
+        SetErrorResult(interp, conn_state_ptr->conn, "Cannot prepare statement for execution", NULL);
+        return TCL_ERROR;
+    }
+    // The statement does not get a command. It is closed as soon as the job is completed.
+    Stmt_State * stmt_state_ptr = ckalloc(sizeof(Stmt_State));
+    memset(stmt_state_ptr, 0, sizeof(Stmt_State));
+    stmt_state_ptr->stmt = stmt;
+    stmt_state_ptr->conn_state_ptr = conn_state_ptr;
+    stmt_state_ptr->timeout = -1;
+
+    Async_Job * job = Async_NewJob(ASYNC_QUERY, NULL);
+    job->timeout = GetStmtTimeout(stmt_state_ptr);
+    job->memory_limit = Memory_GetFetchLimit(conn_state_ptr);
+    job->max_rows = max_rows;
+    job->batch = batch_ptr;
+    job->index = index;
+
+    if ( Async_BindArgs(stmt_state_ptr, interp, job, objc - 1, objv + 1, "a parallel query") != TCL_OK ) {
+        goto Error_Exit;
+    }
+    for ( int i = 0; i < job->argc; i++ ) {
+        // Streamed LOB arguments need the interpreter after the statement is executed
+        dbcapi_bind_param_info info;
+        Tcl_Obj * arg = job->argv[i];
+        if (
+            dbcapi.get_bind_param_info(stmt, i, &info) && IsLobNativeType(info.native_type)
+            && ( info.input_value.type == A_BINARY || info.input_value.type == A_STRING )
+            && arg->bytes != NULL && 0 < arg->length && arg->length < 32 && Tcl_GetChannel(interp, arg->bytes, NULL) != NULL
+        ) {
             char num[12];
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot finish sending data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
-            return TCL_ERROR;
-        }
-    } else {
-        char num[12];
-        Tcl_AppendResult(interp, "DBCAPI reported that LOB parameter [", itoa(arg_idx, num, 10), "] is neither a string, nor it is a binary", NULL);
+            Tcl_AppendResult(interp, "Argument [", itoa(i, num, 10), "] is a channel, which cannot be used by a parallel query", NULL);
+            goto Error_Exit;
+        }
+        Tcl_ResetResult(interp);
+    }
+    if ( Async_Submit(stmt_state_ptr, interp, job) != TCL_OK ) {
+        // the job has been released already
+        Parallel_FreeStmt(stmt_state_ptr);
         return TCL_ERROR;
     }
     return TCL_OK;
+
+Error_Exit:
+    Async_FreeJob(job);
+    Parallel_FreeStmt(stmt_state_ptr);
+    return TCL_ERROR;
 }
 
 /**
- * Sends IN LOB argument data that were provided as a TCL object.
+ * Waits until at least one job of the batch is completed. Returns the list of completed jobs.
  */
-static int
-SendDataFromObject (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int arg_idx, dbcapi_data_type data_type, Tcl_Obj * input)
+static Async_Job *
+Parallel_Wait (Parallel_Batch * batch_ptr)
 {
-    int len;
-    char * data;
-
-    if ( data_type == A_STRING ) {
-        data = Tcl_GetStringFromObj(input, &len);
-    } else if (data_type == A_BINARY ) {
-        data = (char *) Tcl_GetByteArrayFromObj(input, &len);
-    } else {
-        char num[12];
-        Tcl_AppendResult(interp, "DBCAPI reported that LOB parameter [", itoa(arg_idx, num, 10), "] is neither a string, nor it is a binary", NULL);
-        return TCL_ERROR;
-    }
-
-    if ( !dbcapi.send_param_data(stmt_state_ptr->stmt, arg_idx, data, len) ) {
-        char num[12];
-        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot send data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
-        return TCL_ERROR;
+    Tcl_MutexLock(&batch_ptr->lock);
+    while ( batch_ptr->done == NULL ) {
+        Tcl_ConditionWait(&batch_ptr->cond, &batch_ptr->lock, NULL);
     }
-    if ( !dbcapi.finish_param_data(stmt_state_ptr->stmt, arg_idx) ) {
-        char num[12];
-        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot finish sending data for LOB argument [", itoa(arg_idx, num, 10), "]", NULL);
-        return TCL_ERROR;
-    }
-    return TCL_OK;
+    Async_Job * done = batch_ptr->done;
+    batch_ptr->done = NULL;
+    Tcl_MutexUnlock(&batch_ptr->lock);
+    return done;
 }
 
 /**
- * Sends IN and INOUT statement LOB arguments to the database.
- *
- * \note Data for an IN LOB can be provided as an objects (those are handled elsewhere) or a readable channel (these are handled here).
- *       Data for INOUT LOBs can be provided (indirectly via a variable) as an object or a read-write channel (IN data will be read
- *       from that channel and later OUT data will be written to the same channel) or as a list with 2 elements. Element at index 0
- *       provides data for an IN part of the execution (object, variable or a readable channel) and element at index 0 indicates where
- *       OUT data should be saved (variable or a writable channel)
+ * Creates the result of the completed job and releases the job and its statement.
  */
-static int
-SendStmtInput (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int argc, Tcl_Obj * const argv[])
+static Tcl_Obj *
+Parallel_Finish (Async_Job * job)
 {
-    for ( int i = 0; i < argc; i++ ) {
-        dbcapi_bind_param_info info;
-        if ( !dbcapi.get_bind_param_info(stmt_state_ptr->stmt, i, &info) ) {
-            char num[12];
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve information about SQL parameter [", itoa(i, num, 10), "]", NULL);
-            return TCL_ERROR;
-        }
-        if ( info.direction == DD_OUTPUT || info.input_value.buffer_size != 0 ) {
-            continue;
-        }
-
-        if ( info.direction == DD_INPUT ) {
-            // Can only be a channel at this point. It also has been validated during binding.
-            const char * name = Tcl_GetString(argv[i]);
-            Tcl_Channel input = Tcl_GetChannel(interp, name, NULL);
-            if ( SendDataFromChannel(stmt_state_ptr, interp, i, info.input_value.type, input) != TCL_OK ) {
-                return TCL_ERROR;
-            }
-            continue;
-        }
-
-        // DD_INPUT_OUTPUT
-        // This case is a bit complicated as the caller is allowed to specify input and output separately (as a list).
-        int len;
-        if ( Tcl_ListObjLength(interp, argv[i], &len) != TCL_OK ) {
-            return TCL_ERROR;
-        }
-        if ( len != 1 && len != 2 ) {
-            SetNumDiffErrorResult(interp, "Argument [", i, "] should have 1 or 2 values in it but ", len, " were found.");
-            return TCL_ERROR;
-        }
-        Tcl_Obj * input;
-        if ( Tcl_ListObjIndex(interp, argv[i], 0, &input) != TCL_OK ) {
-            return TCL_ERROR;
-        }
-
-        if ( len == 1 ) {
-            // This can be either a read-write channel or a variable...
-            const char * name = Tcl_GetString(input);
-            int mode;
-            Tcl_Channel input_channel = Tcl_GetChannel(interp, name, &mode);
-            if ( input_channel != NULL ) {
-                if ( (mode & TCL_READABLE) == 0 || (mode & TCL_WRITABLE) == 0 ) {
-                    Tcl_AppendResult(interp, "Channel ", name, " must be open for reading and writing", NULL);
-                    return TCL_ERROR;
-                }
-                if ( SendDataFromChannel(stmt_state_ptr, interp, i, info.input_value.type, input_channel) != TCL_OK ) {
-                    return TCL_ERROR;
-                }
-
-            } else {
-                // A variable then
-                Tcl_ResetResult(interp);
+    Parallel_Detach(job);
 
-                Tcl_Obj * input_value = Tcl_ObjGetVar2(interp, input, NULL, TCL_LEAVE_ERR_MSG);
-                if ( input_value == NULL ) {
-                    return TCL_ERROR;
-                }
-                if ( SendDataFromObject(stmt_state_ptr, interp, i, info.input_value.type, input_value) != TCL_OK ) {
-                    return TCL_ERROR;
-                }
-            }
+    double elapsed_ms = job->elapsed / 1000.0;
+    Tcl_Obj * result;
+    if ( !job->success ) {
+        result = Parallel_NewErrorObj(Async_NewErrorObj(job), elapsed_ms);
+    } else {
+        result = Tcl_NewDictObj();
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("status", -1), Tcl_NewStringObj("ok", -1));
+        if ( job->info != NULL ) {
+            Tcl_WideInt converting = GetMonotonicTime();
+            Tcl_Obj * rows = RawRowset_NewRowsObj(&job->rows, job->info, job->binary_formats);
+            Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("rows", -1), rows);
+            Hdbtcl_Stats delta = { .bytes = job->rows.value_bytes, .convert_time = GetMonotonicTime() - converting };
+            Stats_Record(job->stmt_state_ptr->conn_state_ptr, NULL, &delta);
         } else {
-            // The first element can be a readable channel or an object
-            // We would rather avoid conversion (in case parameter is for a binary LOB and the "input" is a binary object),
-            // so we'll peek into object to see if what it has might be a channel name.
-            if ( input->bytes != NULL && 0 < input->length && input->length <= 32 ) {
-                const char * name = Tcl_GetString(input);
-                int mode;
-                Tcl_Channel input_channel = Tcl_GetChannel(interp, name, &mode);
-                if ( input_channel != NULL ) {
-                    if ( (mode & TCL_READABLE) == 0 ) {
-                        Tcl_AppendResult(interp, "Channel ", name, " must be open for reading", NULL);
-                        return TCL_ERROR;
-                    }
-                    if ( SendDataFromChannel(stmt_state_ptr, interp, i, info.input_value.type, input_channel) != TCL_OK ) {
-                        return TCL_ERROR;
-                    }
-                    continue;
-                }
-            }
-            // If it is not a channel, then this is an object and we'll send its content
-            if ( SendDataFromObject(stmt_state_ptr, interp, i, info.input_value.type, input) != TCL_OK ) {
-                return TCL_ERROR;
-            }
+            Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("affected", -1), Tcl_NewIntObj(job->affected_rows));
         }
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("elapsed", -1), Tcl_NewDoubleObj(elapsed_ms));
     }
-    return TCL_OK;
+    Stmt_State * stmt_state_ptr = job->stmt_state_ptr;
+    Async_FreeJob(job);
+    Parallel_FreeStmt(stmt_state_ptr);
+    return result;
 }
 
 /**
- * Saves LOB data into a writable channel.
+ * Finds the pool by its command name.
  */
 static int
-SaveDataToChannel (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int arg_idx, dbcapi_data_type data_type, Tcl_Channel output)
+Parallel_GetPool (Tcl_Interp * interp, Tcl_Obj * pool_name, Conn_Pool * * pool_ptr_ptr)
 {
-    Tcl_Obj * buff = Tcl_NewObj();
-    Tcl_IncrRefCount(buff);
-    size_t offset = 0;
-    int res = TCL_OK;
-    do {
-        char * data;
-        int buff_size;
-        if ( data_type == A_STRING ) {
-            Tcl_SetObjLength(buff, 32768);
-            data = Tcl_GetStringFromObj(buff, &buff_size);
-        } else {
-            Tcl_SetByteArrayLength(buff, 32768);
-            data = (char *) Tcl_GetByteArrayFromObj(buff, &buff_size);
-        }
+    Tcl_CmdInfo info;
+    if ( !Tcl_GetCommandInfo(interp, Tcl_GetString(pool_name), &info) || info.objProc != (Tcl_ObjCmdProc *) Pool_Cmd ) {
+        Tcl_AppendResult(interp, Tcl_GetString(pool_name), " is not a connection pool", NULL);
+        return TCL_ERROR;
+    }
+    *pool_ptr_ptr = (Conn_Pool *) info.objClientData;
+    return TCL_OK;
+}
 
-        int len = dbcapi.get_param_data(stmt_state_ptr->stmt, arg_idx, offset, data, buff_size);
-        if ( len < 0 ) {
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve LOB data from [", arg_idx, "]", NULL);
-            res = TCL_ERROR;
-            break;
+/**
+ * Collects connections that will execute parallel jobs - either the listed connections or up to
+ * `max_conns` connections checked out from the pool. Returns an array of connections that should
+ * be released with `Parallel_ReleaseConns`.
+ */
+static Conn_State * *
+Parallel_AcquireConns (Tcl_Interp * interp, Tcl_Obj * conn_list, Conn_Pool * pool_ptr, int max_conns, int * num_conns_ptr)
+{
+    int num_conns = 0;
+    Conn_State * * conns = NULL;
+    if ( conn_list != NULL ) {
+        int num_elems;
+        Tcl_Obj * * elems;
+        if ( Tcl_ListObjGetElements(interp, conn_list, &num_elems, &elems) != TCL_OK ) {
+            return NULL;
         }
-        if ( len == 0 ) {
-            break;
+        if ( num_elems == 0 ) {
+            Tcl_SetResult(interp, "no connections to execute jobs", TCL_STATIC);
+            return NULL;
         }
-        offset += len;
-
-        if ( data_type == A_STRING ) {
-            Tcl_SetObjLength(buff, len);
-        } else {
-            Tcl_SetByteArrayLength(buff, len);
+        conns = (Conn_State * *) ckalloc(sizeof(Conn_State *) * num_elems);
+        for ( int i = 0; i < num_elems; i++ ) {
+            Tcl_CmdInfo info;
+            if ( !Tcl_GetCommandInfo(interp, Tcl_GetString(elems[i]), &info) || info.objProc != (Tcl_ObjCmdProc *) Conn_Cmd ) {
+                Tcl_AppendResult(interp, Tcl_GetString(elems[i]), " is not a connection", NULL);
+                goto Error_Exit;
+            }
+            Conn_State * conn_state_ptr = (Conn_State *) info.objClientData;
+            for ( int j = 0; j < num_conns; j++ ) {
+                if ( conns[j] == conn_state_ptr ) {
+                    Tcl_AppendResult(interp, Tcl_GetString(elems[i]), " is listed more than once", NULL);
+                    goto Error_Exit;
+                }
+            }
+            if ( Async_CheckIdle(conn_state_ptr, interp) != TCL_OK ) {
+                goto Error_Exit;
+            }
+            conns[num_conns++] = conn_state_ptr;
         }
-
-        if ( Tcl_WriteObj(output, buff) < 0 ) {
-            res = TCL_ERROR;
+    } else {
+        conns = (Conn_State * *) ckalloc(sizeof(Conn_State *) * max_conns);
+        while ( num_conns < max_conns ) {
+            Conn_State * conn_state_ptr = Pool_Acquire(pool_ptr, interp);
+            if ( conn_state_ptr == NULL ) {
+                break;
+            }
+            conns[num_conns++] = conn_state_ptr;
         }
+        if ( num_conns == 0 ) {
+            goto Error_Exit;
+        }
+        Tcl_ResetResult(interp);
+    }
+    *num_conns_ptr = num_conns;
+    return conns;
 
-    } while ( res == TCL_OK );
-
-    Tcl_DecrRefCount(buff);
-    return res;
+Error_Exit:
+    ckfree(conns);
+    return NULL;
 }
 
 /**
- * Saves LOB data into a TCL object. This object is expected to be assigned to a variable.
+ * Returns connections that were checked out from the pool and releases the array of connections.
  */
-static int
-SaveDataToObject (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int arg_idx, dbcapi_data_type data_type, Tcl_Obj * output)
+static void
+Parallel_ReleaseConns (Tcl_Interp * interp, Conn_Pool * pool_ptr, Conn_State * * conns, int num_conns)
 {
-    size_t offset = 0;
-    int read_len;
-    do {
-        char * data;
-        int data_size;
-        int buff_size;
-        if ( data_type == A_STRING ) {
-            data = Tcl_GetStringFromObj(output, &data_size);
-            Tcl_SetObjLength(output, data_size + 32768);
-            data = Tcl_GetStringFromObj(output, &buff_size);
-        } else {
-            data = (char *) Tcl_GetByteArrayFromObj(output, &data_size);
-            Tcl_SetByteArrayLength(output, data_size + 32768);
-            data = (char *) Tcl_GetByteArrayFromObj(output, &buff_size);
-        }
-        read_len = dbcapi.get_param_data(stmt_state_ptr->stmt, arg_idx, offset, data + data_size, buff_size - data_size);
-        if ( read_len < 0 ) {
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve data from parameter [", arg_idx, "]", NULL);
-            return TCL_ERROR;
-        }
-        if ( data_type == A_STRING ) {
-            Tcl_SetObjLength(output, data_size + read_len);
-        } else {
-            Tcl_SetByteArrayLength(output, data_size + read_len);
+    if ( pool_ptr != NULL ) {
+        for ( int i = 0; i < num_conns; i++ ) {
+            // returns the connection to the pool
+            Conn_DeleteState(conns[i], interp);
         }
-        offset += read_len;
-    } while ( read_len > 0 );
-    return TCL_OK;
+    }
+    ckfree(conns);
 }
 
 /**
- * Saves data returned for OUT or INOUT bound variables.
+ * Executes independent queries concurrently - each on its own connection - and returns their results
+ * in the order of the jobs. Each job is a list of an SQL statement and its arguments.
  *
- * \note OUT LOB data can be saved into a provided variable or into a channel. The latter must be writable.
+ * Connections are either listed explicitly via `-connections` or are checked out from the pool via `-pool`.
+ * In the latter case up to as many connections as there are jobs are checked out from the pool for the
+ * duration of the command. When there are more jobs than connections, each connection executes the next job
+ * as soon as it completes the previous one.
+ *
+ * The result of each job is a dictionary with the following keys:
+ * - status   - `ok` or `error`
+ * - rows     - list of rows (if the statement returned a result set)
+ * - affected - number of affected rows (if the statement did not return a result set)
+ * - error    - error message (if the job failed)
+ * - elapsed  - time (ms) it took to execute the statement and to fetch its rows
+ *
+ * `-maxrows` limits the number of rows fetched for each job. By default all rows are fetched.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set results [hdb parallel -pool $pool {
+ *     {"SELECT region, SUM(amount) FROM sales WHERE period = ? GROUP BY region" 202409}
+ *     {"SELECT COUNT(*) FROM returns WHERE period = ?" 202409}
+ * }]
+ * foreach res $results {
+ *     if { [dict get $res status] == "ok" } {
+ *         puts [dict get $res rows]
+ *     }
+ * }
+ * \endcode
+ *
+ * \note The command blocks until all jobs are completed. Statements are prepared and their arguments are bound
+ * by the calling thread. Only IN parameters are supported and LOB arguments cannot be streamed from channels.
  */
 static int
-SaveStmtOutput (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int argc, Tcl_Obj * const argv[], dbcapi_bool is_null[], PrimitiveSqlValue sql_args[])
+Hdb_Parallel (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    for ( int i = 0; i < argc; i++ ) {
-        dbcapi_bind_param_info info;
-        if ( !dbcapi.get_bind_param_info(stmt_state_ptr->stmt, i, &info) ) {
-            char num[12];
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve information about SQL argument [", itoa(i, num, 10), "]", NULL);
-            return TCL_ERROR;
-        }
-
-        if ( info.direction == DD_INPUT ) {
-            continue;
-        }
-
-        if ( info.output_value.buffer_size == 0 ) {
-            // An output from a LOB
-
-            Tcl_Obj * output;
-            if ( info.direction == DD_INPUT_OUTPUT ) {
-                // Note that when the input was sent the argument had been converted into a list
-                if ( Tcl_ListObjIndex(interp, argv[i], 1, &output) != TCL_OK ) {
-                    return TCL_ERROR;
-                }
-            } else { // DD_OUTPUT
-                output = argv[i];
-            }
+    if ( objc < 3 || objc % 2 == 0 ) {
+        Tcl_WrongNumArgs(interp, 0, objv, "parallel (-connections list | -pool pool) ?-maxrows n? jobs");
+        return TCL_ERROR;
+    }
 
-            // The argument is either a writable channel or a variable
-            const char * name = Tcl_GetString(output);
-            int mode;
-            Tcl_Channel output_channel = Tcl_GetChannel(interp, name, &mode);
-            if ( output_channel != NULL ) {
-                if ( (mode & TCL_WRITABLE) == 0 ) {
-                    Tcl_AppendResult(interp, "Channel ", name, " must be open for writing", NULL);
-                    return TCL_ERROR;
-                }
-                if ( SaveDataToChannel(stmt_state_ptr, interp, i, info.output_value.type, output_channel) != TCL_OK ) {
-                    return TCL_ERROR;
-                }
-            } else {
-                // a variable then
-                Tcl_ResetResult(interp);
+    static const char * const options[] = {
+        "-connections", "-pool", "-maxrows", NULL
+    };
+    enum {
+        CONNECTIONS, POOL, MAXROWS
+    } option;
 
-                Tcl_Obj * output_value = Tcl_ObjGetVar2(interp, output, NULL, 0);
-                if ( output_value == NULL ) {
-                    output_value = Tcl_ObjSetVar2(interp, output, NULL, Tcl_NewObj(), TCL_LEAVE_ERR_MSG);
-                } else if ( Tcl_IsShared(output_value) ) {
-                    output_value = Tcl_ObjSetVar2(interp, output, NULL, Tcl_DuplicateObj(output_value), TCL_LEAVE_ERR_MSG);
+    Tcl_Obj * conn_list = NULL;
+    Conn_Pool * pool_ptr = NULL;
+    int max_rows = INT_MAX;
+    for ( int i = 0; i < objc - 1; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case CONNECTIONS:
+                conn_list = objv[i + 1];
+                break;
+            case POOL:
+                if ( Parallel_GetPool(interp, objv[i + 1], &pool_ptr) != TCL_OK ) {
+                    return TCL_ERROR;
                 }
-                if ( output_value == NULL ) {
+                break;
+            case MAXROWS:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &max_rows) != TCL_OK ) {
                     return TCL_ERROR;
                 }
-                if ( SaveDataToObject(stmt_state_ptr, interp, i, info.output_value.type, output_value) != TCL_OK ) {
+                if ( max_rows < 0 ) {
+                    Tcl_SetResult(interp, "maxrows cannot be negative", TCL_STATIC);
                     return TCL_ERROR;
                 }
-            }
+                break;
+        }
+    }
+    if ( ( conn_list == NULL ) == ( pool_ptr == NULL ) ) {
+        Tcl_SetResult(interp, "either -connections or -pool must be specified", TCL_STATIC);
+        return TCL_ERROR;
+    }
 
-        } else {
-            // Everything else (not a LOB) outputs into an object.
-            // At this time the output has been already completed into the bound buffers.
+    int num_jobs;
+    Tcl_Obj * * jobs;
+    if ( Tcl_ListObjGetElements(interp, objv[objc - 1], &num_jobs, &jobs) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    for ( int i = 0; i < num_jobs; i++ ) {
+        int job_len;
+        if ( Tcl_ListObjLength(interp, jobs[i], &job_len) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        if ( job_len == 0 ) {
+            char num[12];
+            Tcl_AppendResult(interp, "job [", itoa(i, num, 10), "] does not have SQL", NULL);
+            return TCL_ERROR;
+        }
+    }
+    if ( num_jobs == 0 ) {
+        return TCL_OK;
+    }
 
-            Tcl_Obj * output = Tcl_ObjGetVar2(interp, argv[i], NULL, TCL_LEAVE_ERR_MSG);
-            if ( output == NULL ) {
-                return TCL_ERROR;
+    int num_conns;
+    Conn_State * * conns = Parallel_AcquireConns(interp, conn_list, pool_ptr, num_jobs, &num_conns);
+    if ( conns == NULL ) {
+        return TCL_ERROR;
+    }
+    Tcl_Obj * * results = (Tcl_Obj * *) ckalloc(sizeof(Tcl_Obj *) * num_jobs);
+
+    Parallel_Batch batch;
+    memset(&batch, 0, sizeof(batch));
+
+    int next_job = 0;
+    int num_running = 0;
+    for ( int i = 0; i < num_conns && next_job < num_jobs; i++ ) {
+        // a job that cannot be started does not occupy the connection
+        while ( next_job < num_jobs && Parallel_Submit(&batch, conns[i], interp, jobs[next_job], next_job, max_rows) != TCL_OK ) {
+            results[next_job++] = Parallel_NewErrorObj(Tcl_GetObjResult(interp), 0.0);
+            Tcl_ResetResult(interp);
+        }
+        if ( next_job < num_jobs ) {
+            ++next_job;
+            ++num_running;
+        }
+    }
+    while ( num_running > 0 ) {
+        Async_Job * done = Parallel_Wait(&batch);
+        while ( done != NULL ) {
+            Async_Job * job = done;
+            done = job->next;
+            Conn_State * conn_state_ptr = job->stmt_state_ptr->conn_state_ptr;
+            results[job->index] = Parallel_Finish(job);
+            --num_running;
+
+            while ( next_job < num_jobs && Parallel_Submit(&batch, conn_state_ptr, interp, jobs[next_job], next_job, max_rows) != TCL_OK ) {
+                results[next_job++] = Parallel_NewErrorObj(Tcl_GetObjResult(interp), 0.0);
+                Tcl_ResetResult(interp);
             }
-            switch ( info.output_value.type ) {
-                case A_UVAL8:
-                    if ( info.native_type == DT_BOOLEAN ) {
-                        Tcl_SetBooleanObj(output, sql_args[i].int_value);
-                    } else {
-                        Tcl_SetIntObj(output, sql_args[i].int_value);
-                    }
-                    break;
+            if ( next_job < num_jobs ) {
+                ++next_job;
+                ++num_running;
+            }
+        }
+    }
+    Tcl_ConditionFinalize(&batch.cond);
+    Tcl_MutexFinalize(&batch.lock);
 
-                case A_VAL32: case A_UVAL32: case A_VAL16: case A_UVAL16: case A_VAL8:
-                    Tcl_SetIntObj(output, sql_args[i].int_value);
-                    break;
+    Tcl_SetObjResult(interp, Tcl_NewListObj(num_jobs, results));
+    ckfree(results);
+    Parallel_ReleaseConns(interp, pool_ptr, conns, num_conns);
+    return TCL_OK;
+}
 
-                case A_VAL64: case A_UVAL64:
-                    Tcl_SetWideIntObj(output, sql_args[i].wideint_value);
-                    break;
+/**
+ * State of one key range of the exported query.
+ */
+typedef struct export_partition {
+    Tcl_Obj *           job;            /// partition query and its arguments
+    Stmt_State *        stmt_state_ptr; /// statement that fetches rows of the partition
+    Async_Job *         pending;        /// fetched rows that have not been written yet
+    Tcl_Channel         channel;        /// output file of the partition
+    Tcl_WideInt         num_rows;
+    bool                finished;
+} Export_Partition;
 
-                case A_DOUBLE: case A_FLOAT:
-                    Tcl_SetDoubleObj(output, sql_args[i].double_value);
-                    break;
+/**
+ * State of the export.
+ */
+typedef struct export_task {
+    Parallel_Batch      batch;
+    Export_Partition *  parts;
+    int                 num_parts;
+    int                 next_part;      /// next partition to start
+    int                 current_part;   /// partition that is written into the shared channel
+    int                 num_running;    /// number of submitted requests
+    int                 batch_size;
+    Export_Format       format;
+    int                 header;
+    Tcl_Channel         channel;        /// shared output channel or NULL when each partition is written into its own file
+    Tcl_Obj *           file_pattern;
+    Tcl_Obj *           error;          /// the first error
+} Export_Task;
 
-                case A_BINARY:
-                    Tcl_SetByteArrayLength(output, sql_args[i].data_length);
-                    break;
+/**
+ * Saves the interpreter result as the export error unless an error has been saved already.
+ */
+static void
+Export_SaveError (Export_Task * task_ptr, Tcl_Interp * interp, Tcl_Obj * error)
+{
+    if ( task_ptr->error == NULL ) {
+        task_ptr->error = error != NULL ? error : Tcl_GetObjResult(interp);
+        Tcl_IncrRefCount(task_ptr->error);
+    }
+    Tcl_ResetResult(interp);
+}
 
-                case A_STRING:
-                    Tcl_SetObjLength(output, sql_args[i].data_length);
-                    break;
+/**
+ * Opens the output file of the partition. Its name is the file name pattern with `%d` replaced by the partition number.
+ * Files are written in UTF-8.
+ */
+static int
+Export_OpenFile (Export_Task * task_ptr, Tcl_Interp * interp, int part)
+{
+    const char * pattern = Tcl_GetString(task_ptr->file_pattern);
+    const char * subst = strstr(pattern, "%d");
+    Tcl_DString file_name;
+    Tcl_DStringInit(&file_name);
+    if ( subst != NULL ) {
+        char num[12];
+        Tcl_DStringAppend(&file_name, pattern, subst - pattern);
+        Tcl_DStringAppend(&file_name, itoa(part, num, 10), -1);
+        Tcl_DStringAppend(&file_name, subst + 2, -1);
+    } else {
+        Tcl_DStringAppend(&file_name, pattern, -1);
+    }
+    Tcl_Channel channel = Tcl_OpenFileChannel(interp, Tcl_DStringValue(&file_name), "w", 0666);
+    Tcl_DStringFree(&file_name);
+    if ( channel == NULL ) {
+        return TCL_ERROR;
+    }
+    Tcl_SetChannelOption(NULL, channel, "-encoding", "utf-8");
+    task_ptr->parts[part].channel = channel;
+    return TCL_OK;
+}
 
-                default: {
-                    // A_INVALID_TYPE
+/**
+ * Starts the next partition on the connection.
+ */
+static void
+Export_StartNext (Export_Task * task_ptr, Conn_State * conn_state_ptr, Tcl_Interp * interp)
+{
+    if ( task_ptr->error != NULL || task_ptr->next_part == task_ptr->num_parts ) {
+        return;
+    }
+    int part = task_ptr->next_part++;
+    if ( task_ptr->channel == NULL && Export_OpenFile(task_ptr, interp, part) != TCL_OK ) {
+        Export_SaveError(task_ptr, interp, NULL);
+        return;
+    }
+    if ( Parallel_Submit(&task_ptr->batch, conn_state_ptr, interp, task_ptr->parts[part].job, part, task_ptr->batch_size) != TCL_OK ) {
+        Export_SaveError(task_ptr, interp, NULL);
+        return;
+    }
+    ++task_ptr->num_running;
+}
+
+/**
+ * Fetched rows of the partition that are rendered as text. Each part of the conversion renders its
+ * rows into its own text.
+ */
+typedef struct export_rendering {
+    Async_Job *         job;
+    Export_Format       format;
+    Tcl_DString *       texts;
+} Export_Rendering;
+
+static void
+Export_RenderRows (void * data, int part, int first_row, int end_row)
+{
+    Export_Rendering * rendering_ptr = (Export_Rendering *) data;
+    Async_Job * job = rendering_ptr->job;
+    Tcl_DString * text = &rendering_ptr->texts[part];
+    const char * separator = rendering_ptr->format == EXPORT_TSV ? "\t" : ",";
+    for ( int row = first_row; row < end_row; ++row ) {
+        Tcl_Obj * row_obj = RawRowset_NewRowObj(&job->rows, row, job->info, job->binary_formats);
+        Tcl_IncrRefCount(row_obj);
+        int num_cols;
+        Tcl_Obj * * values;
+        Tcl_ListObjGetElements(NULL, row_obj, &num_cols, &values);
+        for ( int col = 0; col < num_cols; ++col ) {
+            if ( col > 0 ) {
+                Tcl_DStringAppend(text, separator, 1);
+            }
+            if ( job->info[col].native_type == NATIVE_TYPE_REAL_VECTOR ) {
+                dbcapi_data_value value;
+                RawRowset_GetValue(&job->rows, row, col, &value);
+                if ( !*value.is_null ) {
+                    Tcl_DString vector;
+                    Tcl_DStringInit(&vector);
+                    AppendVectorText(&vector, (unsigned char *) value.buffer, *value.length);
+                    AppendDelimitedText(text, Tcl_DStringValue(&vector), Tcl_DStringLength(&vector), rendering_ptr->format);
+                    Tcl_DStringFree(&vector);
                 }
+                continue;
             }
+            AppendDelimitedValue(text, values[col], rendering_ptr->format);
         }
+        Tcl_DStringAppend(text, "\n", 1);
+        Tcl_DecrRefCount(row_obj);
     }
-    return TCL_OK;
 }
 
 /**
- * Executes a prepared (or previsouly executed and thus prepared) statement.
- *
- * # Example
- *
- * \code{.tcl}
- * set stmt [$conn prepare "INSERT INTO employees (employee_id, first_name, last_name) VALUES (?, ?, ?)"]
- * $stmt execute 2 "Hasso" "Plattner"
- * \endcode
+ * Writes fetched rows of the partition.
  */
 static int
-Stmt_Execute (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Export_WriteRows (Export_Task * task_ptr, Tcl_Interp * interp, int part, Async_Job * job)
 {
-    dbcapi_bool         is_null[objc];
-    PrimitiveSqlValue   sql_args[objc];
+    Export_Partition * part_ptr = &task_ptr->parts[part];
+    Tcl_Channel channel = task_ptr->channel != NULL ? task_ptr->channel : part_ptr->channel;
+    const char * separator = task_ptr->format == EXPORT_TSV ? "\t" : ",";
+
+    int num_parts = Convert_GetNumParts(job->rows.num_rows, job->rows.num_cols);
+    Tcl_DString texts[CONVERT_MAX_THREADS];
+    for ( int i = 0; i < num_parts; i++ ) {
+        Tcl_DStringInit(&texts[i]);
+    }
+    if ( task_ptr->header && job->type == ASYNC_QUERY && ( task_ptr->channel == NULL || part == 0 ) ) {
+        for ( int col = 0; col < job->rows.num_cols; ++col ) {
+            if ( col > 0 ) {
+                Tcl_DStringAppend(&texts[0], separator, 1);
+            }
+            Tcl_Obj * name = Tcl_NewStringObj(job->info[col].name, -1);
+            AppendDelimitedValue(&texts[0], name, task_ptr->format);
+            Tcl_DecrRefCount(name);
+        }
+        Tcl_DStringAppend(&texts[0], "\n", 1);
+    }
+    Export_Rendering rendering = { job, task_ptr->format, texts };
+    Convert_Rows(num_parts, job->rows.num_rows, Export_RenderRows, &rendering);
+    int res = TCL_OK;
+    for ( int i = 0; i < num_parts; i++ ) {
+        if ( res == TCL_OK && Tcl_WriteChars(channel, Tcl_DStringValue(&texts[i]), Tcl_DStringLength(&texts[i])) < 0 ) {
+            Tcl_AppendResult(interp, "Cannot write exported rows: ", Tcl_ErrnoMsg(Tcl_GetErrno()), NULL);
+            res = TCL_ERROR;
+        }
+        Tcl_DStringFree(&texts[i]);
+    }
+    part_ptr->num_rows += job->rows.num_rows;
+    return res;
+}
 
-    if ( BindStmtArgs(stmt_state_ptr, interp, objc, objv, is_null, sql_args) != TCL_OK ) {
-        return TCL_ERROR;
+/**
+ * Closes the statement and the output file of the partition.
+ */
+static void
+Export_FinishPartition (Export_Task * task_ptr, Tcl_Interp * interp, int part)
+{
+    Export_Partition * part_ptr = &task_ptr->parts[part];
+    part_ptr->finished = true;
+    if ( part_ptr->stmt_state_ptr != NULL ) {
+        Parallel_FreeStmt(part_ptr->stmt_state_ptr);
+        part_ptr->stmt_state_ptr = NULL;
+    }
+    if ( part_ptr->channel != NULL ) {
+        if ( Tcl_Close(interp, part_ptr->channel) != TCL_OK ) {
+            Export_SaveError(task_ptr, interp, NULL);
+        }
+        part_ptr->channel = NULL;
     }
+}
 
-    if ( !dbcapi.execute(stmt_state_ptr->stmt) ) {
-        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot execute SQL", NULL);
-        return TCL_ERROR;
+/**
+ * Writes rows that the partition has fetched and requests the next batch of rows. When all rows of the partition
+ * are written, closes the partition and starts the next one on its connection.
+ */
+static void
+Export_Advance (Export_Task * task_ptr, Tcl_Interp * interp, int part)
+{
+    Export_Partition * part_ptr = &task_ptr->parts[part];
+    Async_Job * job = part_ptr->pending;
+    part_ptr->pending = NULL;
+
+    bool more = false;
+    if ( task_ptr->error == NULL ) {
+        if ( Export_WriteRows(task_ptr, interp, part, job) != TCL_OK ) {
+            Export_SaveError(task_ptr, interp, NULL);
+        } else {
+            more = ( job->rows.num_rows == task_ptr->batch_size );
+        }
+    }
+    int num_cols = job->rows.num_cols;
+    Async_FreeJob(job);
+
+    Conn_State * conn_state_ptr = part_ptr->stmt_state_ptr->conn_state_ptr;
+    if ( more ) {
+        job = Async_NewJob(ASYNC_FETCH, NULL);
+        job->max_rows = task_ptr->batch_size;
+        job->rows.num_cols = num_cols;
+        job->info = (dbcapi_column_info *) ckalloc(sizeof(dbcapi_column_info) * num_cols);
+        job->batch = &task_ptr->batch;
+        job->index = part;
+        if ( Async_Submit(part_ptr->stmt_state_ptr, interp, job) != TCL_OK ) {
+            Export_SaveError(task_ptr, interp, NULL);
+        } else {
+            ++task_ptr->num_running;
+            return;
+        }
     }
+    Export_FinishPartition(task_ptr, interp, part);
+    Export_StartNext(task_ptr, conn_state_ptr, interp);
+}
 
-    if ( SendStmtInput(stmt_state_ptr, interp, objc, objv) != TCL_OK ) {
-        return TCL_ERROR;
+/**
+ * Processes the completed fetch request.
+ */
+static void
+Export_Complete (Export_Task * task_ptr, Tcl_Interp * interp, Async_Job * job)
+{
+    --task_ptr->num_running;
+    Parallel_Detach(job);
+    int part = job->index;
+    Export_Partition * part_ptr = &task_ptr->parts[part];
+    part_ptr->stmt_state_ptr = job->stmt_state_ptr;
+
+    if ( !job->success || job->info == NULL ) {
+        Export_SaveError(task_ptr, interp, job->success ? Tcl_NewStringObj("Exported query did not return a result set", -1) : Async_NewErrorObj(job));
+        Conn_State * conn_state_ptr = part_ptr->stmt_state_ptr->conn_state_ptr;
+        Async_FreeJob(job);
+        Export_FinishPartition(task_ptr, interp, part);
+        Export_StartNext(task_ptr, conn_state_ptr, interp);
+        return;
+    }
+    part_ptr->pending = job;
+    if ( task_ptr->channel == NULL ) {
+        Export_Advance(task_ptr, interp, part);
+        return;
+    }
+    // Partitions share the output channel. They are written in order, thus the following partitions
+    // keep their fetched rows until all preceding partitions are written.
+    while ( task_ptr->current_part < task_ptr->num_parts ) {
+        Export_Partition * current_ptr = &task_ptr->parts[task_ptr->current_part];
+        if ( current_ptr->pending != NULL ) {
+            Export_Advance(task_ptr, interp, task_ptr->current_part);
+        }
+        if ( !current_ptr->finished ) {
+            break;
+        }
+        ++task_ptr->current_part;
     }
+}
 
-    if ( SaveStmtOutput(stmt_state_ptr, interp, objc, objv, is_null, sql_args) != TCL_OK ) {
-        return TCL_ERROR;
+/**
+ * Appends the text to the SQL with each single quote doubled.
+ */
+static void
+AppendQuotedSqlString (Tcl_Obj * sql, const char * text)
+{
+    Tcl_AppendToObj(sql, "'", 1);
+    for ( const char * quote; (quote = strchr(text, '\'')) != NULL; text = quote + 1 ) {
+        Tcl_AppendToObj(sql, text, quote + 1 - text);
+        Tcl_AppendToObj(sql, "'", 1);
     }
+    Tcl_AppendStringsToObj(sql, text, "'", NULL);
+}
 
-    return TCL_OK;
+/**
+ * Creates the query that wraps the exported query.
+ */
+static Tcl_Obj *
+Export_NewQuery (const char * select_list, Tcl_Obj * query, const char * where, Tcl_Obj * key, Tcl_Obj * as_of)
+{
+    Tcl_Obj * sql = Tcl_NewStringObj("SELECT ", -1);
+    Tcl_AppendStringsToObj(sql, select_list, " FROM (", Tcl_GetString(query), ") hdbtcl_export", NULL);
+    if ( where != NULL ) {
+        Tcl_AppendStringsToObj(sql, " WHERE ", where, NULL);
+    }
+    if ( key != NULL ) {
+        Tcl_AppendStringsToObj(sql, " ORDER BY ", Tcl_GetString(key), NULL);
+    }
+    if ( as_of != NULL ) {
+        Tcl_AppendToObj(sql, " AS OF UTCTIMESTAMP ", -1);
+        AppendQuotedSqlString(sql, Tcl_GetString(as_of));
+    }
+    return sql;
 }
 
 /**
- * Sets TCL (integer) result or TCL error depending on the value returned by a DBCAPI function.
+ * Finds the range of the partitioning key values.
  */
 static int
-StmtSetIntResult (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int result)
+Export_GetKeyRange (Export_Task * task_ptr, Conn_State * conn_state_ptr, Tcl_Interp * interp, Tcl_Obj * job, Tcl_WideInt range[2], bool * empty_ptr)
 {
-    if ( result < 0 ) {
-        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve requested number", NULL);
+    if ( Parallel_Submit(&task_ptr->batch, conn_state_ptr, interp, job, 0, 1) != TCL_OK ) {
         return TCL_ERROR;
     }
-    Tcl_SetObjResult(interp, Tcl_NewIntObj(result));
-    return TCL_OK;
+    Tcl_Obj * result = Parallel_Finish(Parallel_Wait(&task_ptr->batch));
+    Tcl_IncrRefCount(result);
+    int res = TCL_ERROR;
+    Tcl_Obj * keys[3] = { Tcl_NewStringObj("status", -1), Tcl_NewStringObj("error", -1), Tcl_NewStringObj("rows", -1) };
+    for ( int i = 0; i < 3; i++ ) {
+        Tcl_IncrRefCount(keys[i]);
+    }
+    Tcl_Obj * value;
+    Tcl_Obj * status;
+    Tcl_DictObjGet(NULL, result, keys[0], &status);
+    if ( strcmp(Tcl_GetString(status), "ok") != 0 ) {
+        Tcl_DictObjGet(NULL, result, keys[1], &value);
+        Tcl_SetObjResult(interp, value);
+    } else {
+        Tcl_DictObjGet(NULL, result, keys[2], &value);
+        Tcl_Obj * row;
+        Tcl_Obj * min;
+        Tcl_Obj * max;
+        Tcl_ListObjIndex(NULL, value, 0, &row);
+        Tcl_ListObjIndex(NULL, row, 0, &min);
+        Tcl_ListObjIndex(NULL, row, 1, &max);
+        *empty_ptr = ( min == NULL || max == NULL || Tcl_GetCharLength(min) == 0 || Tcl_GetCharLength(max) == 0 );
+        if ( *empty_ptr ) {
+            res = TCL_OK;
+        } else if ( Tcl_GetWideIntFromObj(interp, min, &range[0]) == TCL_OK && Tcl_GetWideIntFromObj(interp, max, &range[1]) == TCL_OK ) {
+            res = TCL_OK;
+        }
+    }
+    for ( int i = 0; i < 3; i++ ) {
+        Tcl_DecrRefCount(keys[i]);
+    }
+    Tcl_DecrRefCount(result);
+    return res;
 }
 
 /**
- * Returns information about a column in the result set.
+ * Exports the result set of a query into delimited text files. The query is split into key ranges that are
+ * fetched concurrently, each on its own connection.
  *
- * The column info is returned as a dictionary with the following keys:
- *  - `owner`     - The name of the owner
- *  - `table`     - The name of the table
- *  - `name`      - The alias or the name of the column
- *  - `type`      - The native type of the column in the database
- *  - `size`      - The maximum size a data value in this column can take
- *  - `nullable`  - Indicates whether a value in the column can be null
- *  - `precision` - The precision
- *  - `scale`     - The scale
+ * The partitioning key must be an integer column of the query result. Its range is split into `-partitions`
+ * ranges of equal width. The first partition also includes rows where the key is NULL.
+ *
+ * Each partition is written into its own file when `-file` is used. The name of the file is the specified
+ * pattern with `%d` replaced by the partition number. Alternatively, all partitions are written into the
+ * `-channel` in the order of the key.
+ *
+ * Options:
+ * - `-connections` or `-pool` - connections that fetch partitions
+ * - `-partitions`  - number of partitions (the default is the number of listed connections or 4 for pools)
+ * - `-key`         - partitioning column
+ * - `-file`        - output file name pattern
+ * - `-channel`     - output channel
+ * - `-format`      - `csv` (default) or `tsv`
+ * - `-header`      - whether to write column names as the first line (the default is false)
+ * - `-batchsize`   - number of rows fetched at once (the default is 10000)
+ * - `-asof`        - UTC timestamp of the snapshot all partitions read (uses `AS OF UTCTIMESTAMP`)
+ *
+ * Returns the list of the number of rows exported from each partition.
  *
  * # Example
  *
  * \code{.tcl}
- * set col_num 0
- * set col_info [$stmt get -columninfo $col_num]
+ * hdb export -pool $pool -partitions 8 -key order_id -file /data/orders_%d.csv -header yes \
+ *     "SELECT * FROM orders WHERE order_date < ?" 2024-01-01
  * \endcode
+ *
+ * \note Statements are prepared and rows are converted into text by the calling thread. Connections only
+ * execute statements and fetch rows concurrently.
  */
 static int
-Stmt_ColumnInfo (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Hdb_Export (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    if ( objc != 1 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "get -columninfo column_number");
+    static const char * const options[] = {
+        "-asof", "-batchsize", "-channel", "-connections", "-file", "-format", "-header", "-key", "-partitions", "-pool", NULL
+    };
+    enum {
+        ASOF, BATCHSIZE, CHANNEL, CONNECTIONS, FILE_NAME, FORMAT, HEADER, KEY, PARTITIONS, POOL
+    } option;
+
+    Export_Task task;
+    memset(&task, 0, sizeof(task));
+    task.batch_size = 10000;
+
+    Tcl_Obj * conn_list = NULL;
+    Conn_Pool * pool_ptr = NULL;
+    Tcl_Obj * key = NULL;
+    Tcl_Obj * as_of = NULL;
+    int i = 0;
+    for ( ; i + 1 < objc && Tcl_GetString(objv[i])[0] == '-'; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case ASOF:
+                as_of = objv[i + 1];
+                break;
+            case BATCHSIZE:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &task.batch_size) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( task.batch_size <= 0 ) {
+                    Tcl_SetResult(interp, "batch size must be positive", TCL_STATIC);
+                    return TCL_ERROR;
+                }
+                break;
+            case CHANNEL: {
+                int mode;
+                task.channel = Tcl_GetChannel(interp, Tcl_GetString(objv[i + 1]), &mode);
+                if ( task.channel == NULL ) {
+                    return TCL_ERROR;
+                }
+                if ( ( mode & TCL_WRITABLE ) == 0 ) {
+                    Tcl_AppendResult(interp, "Channel ", Tcl_GetString(objv[i + 1]), " must be open for writing", NULL);
+                    return TCL_ERROR;
+                }
+                break;
+            }
+            case CONNECTIONS:
+                conn_list = objv[i + 1];
+                break;
+            case FILE_NAME:
+                task.file_pattern = objv[i + 1];
+                break;
+            case FORMAT: {
+                static const char * const formats[] = { "csv", "tsv", NULL };
+                if ( Tcl_GetIndexFromObj(interp, objv[i + 1], formats, "format", 0, (int *) &task.format) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            }
+            case HEADER:
+                if ( Tcl_GetBooleanFromObj(interp, objv[i + 1], &task.header) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            case KEY:
+                key = objv[i + 1];
+                break;
+            case PARTITIONS:
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &task.num_parts) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( task.num_parts <= 0 ) {
+                    Tcl_SetResult(interp, "number of partitions must be positive", TCL_STATIC);
+                    return TCL_ERROR;
+                }
+                break;
+            case POOL:
+                if ( Parallel_GetPool(interp, objv[i + 1], &pool_ptr) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+        }
+    }
+    if ( i >= objc ) {
+        Tcl_WrongNumArgs(interp, 0, objv, "export (-connections list | -pool pool) -key column (-file pattern | -channel channel) ?-option value...? sql ?arg...?");
         return TCL_ERROR;
     }
-
-    int col_num;
-    if ( Tcl_GetIntFromObj(interp, objv[0], &col_num) != TCL_OK ) {
+    if ( ( conn_list == NULL ) == ( pool_ptr == NULL ) ) {
+        Tcl_SetResult(interp, "either -connections or -pool must be specified", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    if ( ( task.file_pattern == NULL ) == ( task.channel == NULL ) ) {
+        Tcl_SetResult(interp, "either -file or -channel must be specified", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    if ( key == NULL ) {
+        Tcl_SetResult(interp, "partitioning -key must be specified", TCL_STATIC);
         return TCL_ERROR;
     }
-
-    dbcapi_column_info info;
-    if ( !dbcapi.get_column_info(stmt_state_ptr->stmt, col_num, &info) ) {
-        char num[12];
-        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col_num, num, 10), "] info", NULL);
+    if ( task.num_parts == 0 ) {
+        if ( conn_list == NULL || Tcl_ListObjLength(interp, conn_list, &task.num_parts) != TCL_OK || task.num_parts == 0 ) {
+            task.num_parts = 4;
+        }
+    }
+    if ( task.file_pattern != NULL && task.num_parts > 1 && strstr(Tcl_GetString(task.file_pattern), "%d") == NULL ) {
+        Tcl_SetResult(interp, "file name pattern must include %d", TCL_STATIC);
         return TCL_ERROR;
     }
+    Tcl_Obj * query = objv[i];
+    int num_args = objc - i - 1;
+    Tcl_Obj * const * args = objv + i + 1;
 
-    Hdbtcl_Literals * lit = &stmt_state_ptr->conn_state_ptr->hdbtcl_state_ptr->literals;
-
-    Tcl_Obj * res = Tcl_NewDictObj();
-    if ( Tcl_DictObjPut(interp, res, lit->owner, Tcl_NewStringObj(info.owner_name, -1)) != TCL_OK ) {
-        goto Error_Exit;
+    int num_conns;
+    Conn_State * * conns = Parallel_AcquireConns(interp, conn_list, pool_ptr, task.num_parts, &num_conns);
+    if ( conns == NULL ) {
+        return TCL_ERROR;
     }
-    if ( Tcl_DictObjPut(interp, res, lit->table, Tcl_NewStringObj(info.table_name, -1)) != TCL_OK ) {
-        goto Error_Exit;
+    int res = TCL_ERROR;
+    task.parts = (Export_Partition *) ckalloc(sizeof(Export_Partition) * task.num_parts);
+    memset(task.parts, 0, sizeof(Export_Partition) * task.num_parts);
+
+    Tcl_WideInt range[2] = { 0, 0 };
+    bool empty = true;
+    if ( task.num_parts > 1 ) {
+        Tcl_Obj * select_list = Tcl_ObjPrintf("TO_BIGINT(MIN(%s)), TO_BIGINT(MAX(%s))", Tcl_GetString(key), Tcl_GetString(key));
+        Tcl_Obj * sql = Export_NewQuery(Tcl_GetString(select_list), query, NULL, NULL, as_of);
+        Tcl_Obj * job = Tcl_NewListObj(num_args, args);
+        Tcl_ListObjReplace(NULL, job, 0, 0, 1, &sql);
+        Tcl_IncrRefCount(job);
+        Tcl_DecrRefCount(select_list);
+        int rc = Export_GetKeyRange(&task, conns[0], interp, job, range, &empty);
+        Tcl_DecrRefCount(job);
+        if ( rc != TCL_OK ) {
+            goto Exit;
+        }
     }
-    if ( Tcl_DictObjPut(interp, res, lit->name, Tcl_NewStringObj(info.column_name, -1)) != TCL_OK ) {
-        goto Error_Exit;
+    if ( empty ) {
+        task.num_parts = 1;
     }
-    if ( Tcl_DictObjPut(interp, res, lit->type, GetTypeName(lit, info.native_type)) != TCL_OK ) {
-        goto Error_Exit;
+
+    // key ranges: [min, b1) + NULL, [b1, b2), ... [bN-1, max]
+    Tcl_Obj * order_by = ( task.channel != NULL ? key : NULL );
+    Tcl_Obj * lt_where = Tcl_ObjPrintf("%s < ? OR %s IS NULL", Tcl_GetString(key), Tcl_GetString(key));
+    Tcl_Obj * ge_where = Tcl_ObjPrintf("%s >= ?", Tcl_GetString(key));
+    Tcl_Obj * range_where = Tcl_ObjPrintf("%s >= ? AND %s < ?", Tcl_GetString(key), Tcl_GetString(key));
+    Tcl_Obj * objs[] = { lt_where, ge_where, range_where };
+    for ( int k = 0; k < 3; k++ ) {
+        Tcl_IncrRefCount(objs[k]);
     }
-    Tcl_Obj * value = (info.max_size <= INT_MAX ? Tcl_NewIntObj(info.max_size) : Tcl_NewWideIntObj(info.max_size) );
-    if ( Tcl_DictObjPut(interp, res, lit->size, value) != TCL_OK ) {
-        goto Error_Exit;
+    Tcl_WideUInt span = (Tcl_WideUInt) range[1] - (Tcl_WideUInt) range[0];
+    Tcl_WideInt prev_bound = 0;
+    for ( int part = 0; part < task.num_parts; part++ ) {
+        Tcl_Obj * job = Tcl_NewListObj(num_args, args);
+        const char * where = NULL;
+        if ( task.num_parts > 1 ) {
+            Tcl_WideInt bound = range[0] + (Tcl_WideInt) ( (span / task.num_parts) * (part + 1) + ((span % task.num_parts) * (part + 1)) / task.num_parts );
+            if ( part == 0 ) {
+                where = Tcl_GetString(lt_where);
+                Tcl_ListObjAppendElement(NULL, job, Tcl_NewWideIntObj(bound));
+            } else if ( part == task.num_parts - 1 ) {
+                where = Tcl_GetString(ge_where);
+                Tcl_ListObjAppendElement(NULL, job, Tcl_NewWideIntObj(prev_bound));
+            } else {
+                where = Tcl_GetString(range_where);
+                Tcl_ListObjAppendElement(NULL, job, Tcl_NewWideIntObj(prev_bound));
+                Tcl_ListObjAppendElement(NULL, job, Tcl_NewWideIntObj(bound));
+            }
+            prev_bound = bound;
+        }
+        Tcl_Obj * sql = Export_NewQuery("*", query, where, order_by, as_of);
+        Tcl_ListObjReplace(NULL, job, 0, 0, 1, &sql);
+        task.parts[part].job = job;
+        Tcl_IncrRefCount(job);
     }
-    if ( Tcl_DictObjPut(interp, res, lit->nullable, Tcl_NewBooleanObj(info.nullable)) != TCL_OK ) {
-        goto Error_Exit;
+    for ( int k = 0; k < 3; k++ ) {
+        Tcl_DecrRefCount(objs[k]);
     }
-    if ( Tcl_DictObjPut(interp, res, lit->precision, Tcl_NewIntObj(info.precision)) != TCL_OK ) {
-        goto Error_Exit;
+
+    for ( int c = 0; c < num_conns && task.error == NULL; c++ ) {
+        Export_StartNext(&task, conns[c], interp);
     }
-    if ( Tcl_DictObjPut(interp, res, lit->scale, Tcl_NewIntObj(info.scale)) != TCL_OK ) {
-        goto Error_Exit;
+    while ( task.num_running > 0 ) {
+        Async_Job * done = Parallel_Wait(&task.batch);
+        while ( done != NULL ) {
+            Async_Job * job = done;
+            done = job->next;
+            Export_Complete(&task, interp, job);
+        }
     }
 
-    Tcl_SetObjResult(interp, res);
-    return TCL_OK;
+    if ( task.error != NULL ) {
+        Tcl_SetObjResult(interp, task.error);
+    } else {
+        Tcl_Obj * counts = Tcl_NewListObj(0, NULL);
+        for ( int part = 0; part < task.num_parts; part++ ) {
+            Tcl_ListObjAppendElement(NULL, counts, Tcl_NewWideIntObj(task.parts[part].num_rows));
+        }
+        Tcl_SetObjResult(interp, counts);
+        res = TCL_OK;
+    }
 
-Error_Exit:
-    Tcl_DecrRefCount(res);
-    return TCL_ERROR;
+Exit:
+    for ( int part = 0; part < task.num_parts; part++ ) {
+        Export_Partition * part_ptr = &task.parts[part];
+        if ( part_ptr->pending != NULL ) {
+            Async_FreeJob(part_ptr->pending);
+        }
+        if ( part_ptr->stmt_state_ptr != NULL ) {
+            Parallel_FreeStmt(part_ptr->stmt_state_ptr);
+        }
+        if ( part_ptr->channel != NULL ) {
+            Tcl_Close(NULL, part_ptr->channel);
+        }
+        if ( part_ptr->job != NULL ) {
+            Tcl_DecrRefCount(part_ptr->job);
+        }
+    }
+    ckfree(task.parts);
+    if ( task.error != NULL ) {
+        Tcl_DecrRefCount(task.error);
+    }
+    Tcl_ConditionFinalize(&task.batch.cond);
+    Tcl_MutexFinalize(&task.batch.lock);
+    Parallel_ReleaseConns(interp, pool_ptr, conns, num_conns);
+    return res;
 }
 
 /**
- * Retrieves statement column names.
- *
- * # Example
- *
- * \code{.tcl}
- * set stmt [$conn execute "SELECT * FROM objects WHERE schema_name = ?" "SYS"]
- * set column_names [$stmt get -columnnames]
- * while { [$stmt fetch row] } {
- *     foreach name $column_names value $row {
- *         puts [format "%20s: %s" $name $value]
- *     }
- * }
- * \endcode
+ * Returns the value of an integer column as a signed 64-bit integer. Unsigned 64-bit values that
+ * do not fit are clamped, which is only relevant for comparison with negative values.
  */
-static int
-Stmt_ColumnNames (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+static Tcl_WideInt
+GetIntegerValue (dbcapi_data_value * value)
 {
-    if ( objc > 0 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "get -columnnames");
-        return TCL_ERROR;
-    }
-
-    int num_cols = dbcapi.num_cols(stmt_state_ptr->stmt);
-    Tcl_Obj * names[num_cols];
-    for ( int col = 0; col < num_cols; ++col ) {
-        dbcapi_column_info info;
-        if ( !dbcapi.get_column_info(stmt_state_ptr->stmt, col, &info) ) {
-            char num[12];
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] info", NULL);
-            return TCL_ERROR;
+    switch ( value->type ) {
+        case A_VAL8:   return *(int8_t *)   value->buffer;
+        case A_UVAL8:  return *(uint8_t *)  value->buffer;
+        case A_VAL16:  return *(int16_t *)  value->buffer;
+        case A_UVAL16: return *(uint16_t *) value->buffer;
+        case A_VAL32:  return *(int32_t *)  value->buffer;
+        case A_UVAL32: return *(uint32_t *) value->buffer;
+        case A_VAL64:  return *(int64_t *)  value->buffer;
+        case A_UVAL64: {
+            uint64_t v = *(uint64_t *) value->buffer;
+            return v > INT64_MAX ? INT64_MAX : (Tcl_WideInt) v;
         }
-        names[col] = Tcl_NewStringObj(info.column_name, -1);
+        default:       return 0;
     }
-
-    Tcl_SetObjResult(interp, Tcl_NewListObj(num_cols, names));
-    return TCL_OK;
 }
 
 /**
- * Retrieve a print line printed during execution of a stored procedure.
- *
- * The initial call after execution of the stored procedure will retrieve the first line printed.
- * If the print line is successfully retrieved, it is removed from the queue and subsequent calls
- * will retrieve following print lines (if available).
- *
- * # Example
- *
- * \code{.sql}
- * CREATE PROCEDURE TEST_PROC AS
- * BEGIN
- *     USING SQLSCRIPT_PRINT AS PRINT;
- *     SELECT 1 FROM DUMMY;
- *     PRINT:PRINT_LINE('Hello, World!');
- *     SELECT 2 FROM DUMMY;
- *     PRINT:PRINT_LINE('Hello World, Again!');
- * END
- * \endcode
- *
- * \code{.tcl}
- * set stmt [$conn prepare "CALL test_proc"]
- * $stmt execute
- * while { [$stmt get -printline line] } {
- *     puts $line
- * }
- * \endcode
- *
+ * Returns the value of a numeric column as a double.
  */
-static int
-StmtGetPrintLine (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+static double
+GetDoubleValue (dbcapi_data_value * value)
 {
-    if ( objc != 1 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "get -printline varname");
-        return TCL_ERROR;
-    }
-    Tcl_Obj * line = Tcl_NewObj();
-    int len;
-    char * buffer = Tcl_GetStringFromObj(line, &len);
-
-    bool zero_terminate_line = false;
-    int host_type = 4; // SQLDBC_HOSTTYPE_UTF8
-    size_t text_size;
-    dbcapi_retcode res = dbcapi.get_print_line(stmt_state_ptr->stmt, host_type, buffer, &text_size, len, zero_terminate_line);
-    if ( res == DBCAPI_NO_DATA_FOUND ) {
-        Tcl_SetObjResult(interp, Tcl_NewBooleanObj(0));
-
-    } else {
-        if ( res == DBCAPI_DATA_TRUNC ) {
-            Tcl_SetObjLength(line, text_size);
-            buffer = Tcl_GetStringFromObj(line, &len);
-            res = dbcapi.get_print_line(stmt_state_ptr->stmt, host_type, buffer, &text_size, len, zero_terminate_line);
-            Tcl_SetObjLength(line, text_size);
-        }
-        if ( Tcl_ObjSetVar2(interp, objv[0], NULL, line, TCL_LEAVE_ERR_MSG) != NULL ) {
-            Tcl_SetObjResult(interp, Tcl_NewBooleanObj(1));
-        }
+    switch ( value->type ) {
+        case A_DOUBLE: return *(double *) value->buffer;
+        case A_FLOAT:  return *(float *)  value->buffer;
+        case A_UVAL64: return (double) *(uint64_t *) value->buffer;
+        default:       return (double) GetIntegerValue(value);
     }
-    return TCL_OK;
 }
 
 /**
- * Statement "get" subcommand options multiplexor.
+ * Compares two decimal numbers in their text form without converting them into binary.
  */
 static int
-Stmt_Get (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+CompareDecimalText (const char * a, size_t a_len, const char * b, size_t b_len)
 {
-    if ( objc < 1 || 2 < objc ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "get -option ?attr?");
-        return TCL_ERROR;
-    }
-
-    static const char * const options[] = {
-        "-colinfo", "-columninfo", "-colnames", "-columnnames", "-numaffectedrows", "-numcols", "-numcolumns", "-numrows", "-printline", NULL
-    };
-    enum {
-        COL_INFO, COLUMN_INFO, COL_NAMES, COLUMN_NAMES, NUM_AFFECTED_ROWS, NUM_COLS, NUM_COLUMNS, NUM_ROWS, PRINT_LINE
-    } option;
-
-    if ( Tcl_GetIndexFromObj(interp, objv[0], options, "option", 0, (int *) &option) != TCL_OK ) {
-        return TCL_ERROR;
+    const char * a_end = a + a_len;
+    const char * b_end = b + b_len;
+    bool a_neg = ( a < a_end && *a == '-' );
+    bool b_neg = ( b < b_end && *b == '-' );
+    if ( a < a_end && ( *a == '-' || *a == '+' ) ) ++a;
+    if ( b < b_end && ( *b == '-' || *b == '+' ) ) ++b;
+    while ( a < a_end && *a == '0' ) ++a;
+    while ( b < b_end && *b == '0' ) ++b;
+
+    const char * a_dot = memchr(a, '.', a_end - a);
+    const char * b_dot = memchr(b, '.', b_end - b);
+    if ( a_dot == NULL ) a_dot = a_end;
+    if ( b_dot == NULL ) b_dot = b_end;
+
+    int cmp = 0;
+    if ( a_dot - a != b_dot - b ) {
+        cmp = ( a_dot - a < b_dot - b ? -1 : 1 );
+    } else {
+        cmp = memcmp(a, b, a_dot - a);
+        // compare fractions digit by digit, missing digits are zeros
+        for ( const char * fa = a_dot + 1, * fb = b_dot + 1; cmp == 0 && ( fa < a_end || fb < b_end ); ++fa, ++fb ) {
+            char da = fa < a_end ? *fa : '0';
+            char db = fb < b_end ? *fb : '0';
+            cmp = ( da > db ) - ( da < db );
+        }
     }
-    switch ( option ) {
-        case COLUMN_INFO: case COL_INFO:
-            return Stmt_ColumnInfo  (stmt_state_ptr, interp, objc - 1, objv + 1);
-        case COLUMN_NAMES: case COL_NAMES:
-            return Stmt_ColumnNames (stmt_state_ptr, interp, objc - 1, objv + 1);
-        case NUM_AFFECTED_ROWS:
-            return StmtSetIntResult(stmt_state_ptr, interp, dbcapi.affected_rows(stmt_state_ptr->stmt));
-        case NUM_COLS: case NUM_COLUMNS:
-            return StmtSetIntResult(stmt_state_ptr, interp, dbcapi.num_cols(stmt_state_ptr->stmt));
-        case NUM_ROWS:
-            return StmtSetIntResult(stmt_state_ptr, interp, dbcapi.num_rows(stmt_state_ptr->stmt));
-        case PRINT_LINE:
-            return StmtGetPrintLine(stmt_state_ptr, interp, objc - 1, objv + 1);
+    if ( a_neg != b_neg ) {
+        // -0 and 0 are equal
+        bool a_zero = true;
+        bool b_zero = true;
+        for ( ; a < a_end && a_zero; ++a ) a_zero = ( *a == '0' || *a == '.' );
+        for ( ; b < b_end && b_zero; ++b ) b_zero = ( *b == '0' || *b == '.' );
+        if ( a_zero && b_zero ) {
+            return 0;
+        }
+        return a_neg ? -1 : 1;
     }
-    return TCL_OK;
+    return a_neg ? -cmp : cmp;
 }
 
 /**
- * Fetches LOB data piece by piece and feeds pieces to the "LOB read command"
+ * Compares two column values. NULLs are less than any other value.
  */
 static int
-FetchLobColumn (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, dbcapi_column_info info[], int col, Tcl_Obj * lob_read_cmd, Tcl_Obj * lob_read_init_state)
+CompareColumnValues (dbcapi_data_value * a, dbcapi_data_value * b, dbcapi_native_type native_type)
 {
-    int res = TCL_OK;
-    if ( lob_read_init_state == NULL ) {
-        lob_read_init_state = Tcl_NewObj();
-    }
-    const char * col_name = ( info[col].name != NULL && info[col].name[0] != '\0' ? info[col].name : info[col].column_name );
-    // cmd $cmd_data $lob_data $col_num $col_name $table_name $table_owner
-    Tcl_Obj * lob_read_objv[7];
-    lob_read_objv[0] = lob_read_cmd;
-    lob_read_objv[1] = lob_read_init_state;
-    lob_read_objv[2] = Tcl_NewObj();
-    lob_read_objv[3] = Tcl_NewIntObj(col);
-    lob_read_objv[4] = Tcl_NewStringObj(col_name, -1);
-    lob_read_objv[5] = Tcl_NewStringObj(info[col].table_name, -1);
-    lob_read_objv[6] = Tcl_NewStringObj(info[col].owner_name, -1);
-    for ( int i = 0; i < 7; ++i ) {
-        Tcl_IncrRefCount(lob_read_objv[i]);
+    bool a_is_null = *a->is_null;
+    bool b_is_null = *b->is_null;
+    if ( a_is_null || b_is_null ) {
+        return b_is_null - a_is_null;
     }
-    Tcl_Obj * buff = lob_read_objv[2];
-    int read_len;
-    size_t offset = 0;
-    do {
-        char * data;
-        int buff_size;
-
-        if ( info[col].type == A_STRING ) {
-            Tcl_SetObjLength(buff, 32768);
-            data = Tcl_GetStringFromObj(buff, &buff_size);
-        } else {
-            Tcl_SetByteArrayLength(buff, 32768);
-            data = (char *) Tcl_GetByteArrayFromObj(buff, &buff_size);
-        }
-
-        read_len = dbcapi.get_data(stmt_state_ptr->stmt, col, offset, data, buff_size);
-        if ( read_len < 0 ) {
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve data from LOB column ", col_name, NULL);
-            res = TCL_ERROR;
-            break;
-        }
-        if ( info[col].type == A_STRING ) {
-            Tcl_SetObjLength(buff, read_len);
-        } else {
-            Tcl_SetByteArrayLength(buff, read_len);
+    switch ( a->type ) {
+        case A_VAL8: case A_UVAL8: case A_VAL16: case A_UVAL16: case A_VAL32: case A_UVAL32: case A_VAL64:
+            if ( b->type != A_DOUBLE && b->type != A_FLOAT && b->type != A_UVAL64 ) {
+                Tcl_WideInt va = GetIntegerValue(a);
+                Tcl_WideInt vb = GetIntegerValue(b);
+                return ( va > vb ) - ( va < vb );
+            }
+            // fall through
+        case A_UVAL64: case A_DOUBLE: case A_FLOAT: {
+            double va = GetDoubleValue(a);
+            double vb = GetDoubleValue(b);
+            return ( va > vb ) - ( va < vb );
         }
-        offset += read_len;
-
-        res = Tcl_EvalObjv(interp, 7, lob_read_objv, 0);
-        if ( res != TCL_OK ) {
-            break;
+        default: {
+            if ( native_type == DT_DECIMAL ) {
+                return CompareDecimalText(a->buffer, *a->length, b->buffer, *b->length);
+            }
+            // Strings (UTF-8 byte order is the code point order), binaries, dates and times (ISO text)
+            size_t len = *a->length < *b->length ? *a->length : *b->length;
+            int cmp = memcmp(a->buffer, b->buffer, len);
+            if ( cmp == 0 ) {
+                cmp = ( *a->length > *b->length ) - ( *a->length < *b->length );
+            }
+            return cmp;
         }
-        // tranfer returned result into cmd_data
-        Tcl_DecrRefCount(lob_read_objv[1]);
-        lob_read_objv[1] = Tcl_GetObjResult(interp);
-        Tcl_IncrRefCount(lob_read_objv[1]);
-
-    } while ( read_len > 0 );
-
-    for ( int i = 0; i < 7; ++i ) {
-        Tcl_DecrRefCount(lob_read_objv[i]);
     }
-    return res;
 }
 
-/**
- * Fetches the next row from the result set and saves it into the specified variable.
- *
- * # Example
- *
- * \code{.tcl}
- * while { [$stmt fetch row] } {
- *     # row is a list of column values
- * }
- * \endcode
- *
- * If one of the columns is a LOB, fetch will try, memory permitting, to fetch the entire
- * LOB into a string or a binary, depending on the column type. While this works for
- * some use cases, it might not be feasible for very large LOBs. Large LOBs can be fetched
- * piece by piece via custom LOB read callbacks:
- *
- * # Example
- *
- * \code{.tcl}
- * proc read_lob { read_state lob_chunk col_num col_name table_name table_owner } {
- *     # Where:
- *     #   read_state  - current reading state. Can be anything. Initial value is {}.
- *     #   lob_chunk   - current piece of LOB data. It'll be a string or a binary depending
- *     #                 on the LOB type.
- *     #   col_num     - LOB column number in the result set row.
- *     #   col_name    - LOB column name
- *     #   table_name  - table name from which LOB is retrieved.
- *     #   table_owner - LOB table schema.
- *
- *     # This procedure returns modified state to be passed to the call
- *     # that reads the next LOB piece.
- *     return $read_state
- * }
- *
- * while { [$stmt fetch row -lobreadcommand read_lob] } {
- *     # non LOB columns will be retrieved by fetch
- *     # LOB columns in the returned row will contain the final "read state"
- * }
- * \endcode
- *
- * While the default initial read state is {} it can be set to a different value via
- * -lobreadinitialstate.
- *
- * # Example
- *
- * \code{.tcl}
- * set name_prefix "temp_lob_file"
- * while { [$stmt fetch row -lobreadcommand read_lob_info_file -lobreadinitialstate $name_prefix] } {
- *     # process columns from the row
- * }
- * \endcode
+/**
+ * Current state of one merged statement.
+ */
+typedef struct merge_input {
+    Tcl_Obj *           stmt_name;
+    Stmt_State *        stmt_state_ptr;
+    dbcapi_column_info* info;
+    dbcapi_data_value * keys;           /// key values of the current row
+} Merge_Input;
+
+/**
+ * Internal state of the merge cursor.
+ */
+typedef struct merge_state {
+    Tcl_Command         merge_cmd;
+    Tcl_Obj *           key_list;       /// key columns - names or numbers
+    int                 num_keys;
+    int *               key_cols;
+    int                 direction;      /// 1 - ascending, -1 - descending
+    int                 num_cols;
+    int                 num_inputs;
+    Merge_Input *       inputs;
+    int *               heap;           /// indexes of inputs that have rows, the input with the least key first
+    int                 heap_size;
+    bool                started;
+    Tcl_Obj *           error;          /// error that stopped the merge after rows were consumed
+} Merge_State;
+
+/**
+ * Compares current rows of two merge inputs.
  */
 static int
-Stmt_Fetch (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Merge_Compare (Merge_State * merge_ptr, int a, int b)
 {
-    if ( objc != 1 && objc != 3 && objc != 5 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "fetch row_var ?-lobreadcommand cmd_name ?-lobreadinitialstate init_state??");
-        return TCL_ERROR;
-    }
-    Tcl_Obj * lob_read_cmd = NULL;
-    Tcl_Obj * lob_read_init_state = NULL;
-    if ( objc >= 3 ) {
-        static const char * const options[] = { "-lobreadcmd", "-lobreadcommand", "-lobreadinit", "-lobreadinitialstate", NULL };
-        enum { LOBREADCMD, LOBREADCOMMAND, LOBREADINIT, LOBREADINITIALSTATE } option;
-        for ( int i = 1; i < objc; i+=2 ) {
-            if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
-                return TCL_ERROR;
-            }
-            switch ( option ) {
-                case LOBREADCMD: case LOBREADCOMMAND: {
-                    lob_read_cmd = objv[i+1];
-                    if ( Tcl_GetCommandFromObj(interp, lob_read_cmd) == NULL ) {
-                        const char * cmd_name = Tcl_GetString(lob_read_cmd);
-                        Tcl_AppendResult(interp, "command ", cmd_name, " does not exist", NULL);
-                        return TCL_ERROR;
-                    }
-                    break;
-                }
-                case LOBREADINIT: case LOBREADINITIALSTATE: {
-                    lob_read_init_state = objv[i+1];
-                    break;
-                }
-            }
+    Merge_Input * a_ptr = &merge_ptr->inputs[a];
+    Merge_Input * b_ptr = &merge_ptr->inputs[b];
+    for ( int k = 0; k < merge_ptr->num_keys; k++ ) {
+        int cmp = CompareColumnValues(&a_ptr->keys[k], &b_ptr->keys[k], a_ptr->info[merge_ptr->key_cols[k]].native_type);
+        if ( cmp != 0 ) {
+            return cmp * merge_ptr->direction;
         }
     }
+    // rows with equal keys are returned in the order of the statements
+    return ( a > b ) - ( a < b );
+}
 
-    int num_cols = dbcapi.num_cols(stmt_state_ptr->stmt);
-    if ( num_cols < 0 ) {
-        SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve result set info (column count)", NULL);
-        return TCL_ERROR;
+/**
+ * Restores the heap order after the key of the top input has changed.
+ */
+static void
+Merge_SiftDown (Merge_State * merge_ptr, int pos)
+{
+    int * heap = merge_ptr->heap;
+    for (;;) {
+        int least = pos;
+        int left  = 2 * pos + 1;
+        int right = left + 1;
+        if ( left < merge_ptr->heap_size && Merge_Compare(merge_ptr, heap[left], heap[least]) < 0 ) {
+            least = left;
+        }
+        if ( right < merge_ptr->heap_size && Merge_Compare(merge_ptr, heap[right], heap[least]) < 0 ) {
+            least = right;
+        }
+        if ( least == pos ) {
+            break;
+        }
+        int tmp = heap[pos];
+        heap[pos] = heap[least];
+        heap[least] = tmp;
+        pos = least;
     }
-    if ( num_cols == 0 ) {
-        Tcl_AppendResult(interp, "This statement did not return any rows");
-        return TCL_ERROR;
+}
+
+/**
+ * Fetches the next row of the input and reads its key values. Returns 1 if the row was fetched,
+ * 0 if the input has no more rows and -1 on error.
+ */
+static int
+Merge_FetchInput (Merge_State * merge_ptr, Tcl_Interp * interp, Merge_Input * input_ptr)
+{
+    Stmt_State * stmt_state_ptr = input_ptr->stmt_state_ptr;
+    if ( !dbcapi.fetch_next(stmt_state_ptr->stmt) ) {
+        if ( FetchFailed(stmt_state_ptr->conn_state_ptr->conn) ) {
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot fetch rows", NULL);
+            return -1;
+        }
+        return 0;
     }
-    dbcapi_column_info info[num_cols];
-    for ( int col = 0; col < num_cols; ++col ) {
-        if ( !dbcapi.get_column_info(stmt_state_ptr->stmt, col, &info[col]) ) {
+    for ( int k = 0; k < merge_ptr->num_keys; k++ ) {
+        // values stay valid until the next fetch from the same statement
+        if ( !dbcapi.get_column(stmt_state_ptr->stmt, merge_ptr->key_cols[k], &input_ptr->keys[k]) ) {
             char num[12];
-            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] info", NULL);
-            return TCL_ERROR;
+            SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(merge_ptr->key_cols[k], num, 10), "] data", NULL);
+            return -1;
         }
     }
+    return 1;
+}
 
-    Tcl_Obj * row = Tcl_ObjSetVar2(interp, objv[0], NULL, Tcl_NewListObj(0, NULL), TCL_LEAVE_ERR_MSG);
-    if ( row == NULL ) {
-        return TCL_ERROR;
-    }
+/**
+ * Stops the merge after an error that happened when rows of the statements have already been consumed.
+ * The merge cannot continue without losing rows, so all following fetches report the same error.
+ */
+static void
+Merge_Fail (Merge_State * merge_ptr, Tcl_Interp * interp)
+{
+    merge_ptr->error = Tcl_GetObjResult(interp);
+    Tcl_IncrRefCount(merge_ptr->error);
+}
 
-    int fetched = dbcapi.fetch_next(stmt_state_ptr->stmt);
-    if ( fetched ) {
-        for ( int col = 0; col < num_cols; ++col ) {
-            Tcl_Obj * col_val;
-            if ( info[col].max_size == INT32_MAX && lob_read_cmd != NULL ) {
-                if ( FetchLobColumn(stmt_state_ptr, interp, info, col, lob_read_cmd, lob_read_init_state) != TCL_OK ) {
-                    return TCL_ERROR;
-                }
-                col_val = Tcl_GetObjResult(interp);
-            } else {
-                dbcapi_data_value value;
-                if ( !dbcapi.get_column(stmt_state_ptr->stmt, col, &value) ) {
-                    char num[12];
-                    SetErrorResult(interp, stmt_state_ptr->conn_state_ptr->conn, "Cannot retrieve column [", itoa(col, num, 10), "] data", NULL);
-                    return TCL_ERROR;
-                }
-                col_val = Tcl_NewObj();
-                if ( !*value.is_null ) {
-                    switch ( value.type ) {
-                        case A_UVAL8:
-                            if ( info[col].native_type == DT_BOOLEAN ) {
-                                Tcl_SetBooleanObj(col_val, *(uint8_t *)value.buffer);
-                            } else {
-                                Tcl_SetIntObj(col_val, *(uint8_t *)value.buffer);
-                            }
-                            break;
-                        case A_VAL8:
-                            Tcl_SetIntObj(col_val, *(int8_t *)value.buffer);
-                            break;
-                        case A_UVAL16:
-                            Tcl_SetIntObj(col_val, *(uint16_t *)value.buffer);
-                            break;
-                        case A_VAL16:
-                            Tcl_SetIntObj(col_val, *(int16_t *)value.buffer);
-                            break;
-                        case A_UVAL32:
-                            Tcl_SetIntObj(col_val, *(uint32_t *)value.buffer);
-                        case A_VAL32:
-                            Tcl_SetIntObj(col_val, *(int32_t *)value.buffer);
-                            break;
-                        case A_UVAL64:
-                            Tcl_SetWideIntObj(col_val, *(uint64_t *)value.buffer);
-                            break;
-                        case A_VAL64:
-                            Tcl_SetWideIntObj(col_val, *(int64_t *)value.buffer);
-                            break;
-                        case A_DOUBLE:
-                            Tcl_SetDoubleObj(col_val, *(double *)value.buffer);
-                            break;
-                        case A_FLOAT:
-                            Tcl_SetDoubleObj(col_val, (double)*(float *)value.buffer);
-                            break;
-                        case A_BINARY:
-                            Tcl_SetByteArrayObj(col_val, (unsigned char*) value.buffer, *value.length);
-                            break;
-                        case A_STRING:
-                            Tcl_SetStringObj(col_val, value.buffer, *value.length);
-                            break;
-                        default: {
-                            // A_INVALID_TYPE
-                        }
-                    }
-                }
-            }
-            if ( Tcl_ListObjAppendElement(interp, row, col_val) != TCL_OK ) {
-                return TCL_ERROR;
-            }
+/**
+ * Finds statements of the merge and checks that they are still usable.
+ */
+static int
+Merge_ResolveInputs (Merge_State * merge_ptr, Tcl_Interp * interp)
+{
+    for ( int i = 0; i < merge_ptr->num_inputs; i++ ) {
+        Merge_Input * input_ptr = &merge_ptr->inputs[i];
+        Tcl_CmdInfo info;
+        if (
+            !Tcl_GetCommandInfo(interp, Tcl_GetString(input_ptr->stmt_name), &info) ||
+            info.objProc != (Tcl_ObjCmdProc *) Stmt_Cmd ||
+            ( input_ptr->stmt_state_ptr != NULL && info.objClientData != (ClientData) input_ptr->stmt_state_ptr )
+        ) {
+            Tcl_AppendResult(interp, "statement ", Tcl_GetString(input_ptr->stmt_name), " has been closed", NULL);
+            return TCL_ERROR;
+        }
+        input_ptr->stmt_state_ptr = (Stmt_State *) info.objClientData;
+        if ( Async_CheckIdle(input_ptr->stmt_state_ptr->conn_state_ptr, interp) != TCL_OK ) {
+            return TCL_ERROR;
         }
     }
-
-    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(fetched));
     return TCL_OK;
 }
 
 /**
- * Advances to the next result set in a multiple result set query.
- *
- * If a query (such as a call to a stored procedure) returns multiple result sets,
- * then "nextresult" advances from the current result set to the next.
- *
- * "nextresult" returns true if the statement successfully advances to the next
- * result set, false otherwise.
- *
- * # Example
- *
- * \code{.tcl}
- * set stmt [$conn execute "call multiple_results_procedure()"]
- * while { 1 } {
- *     while { [$stmt fetch row] } {
- *         # process columns from the fetched row
- *     }
- *     if { ![$stmt nextresult] } {
- *         break
- *     }
- * }
- * \endcode
+ * Finds the position of the key column in the result set.
  */
 static int
-Stmt_NextResult (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Merge_FindKeyColumn (Merge_State * merge_ptr, Tcl_Interp * interp, Merge_Input * input_ptr, Tcl_Obj * key, int * col_ptr)
 {
-    if ( objc != 0 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "nextresult");
-        return TCL_ERROR;
+    const char * name = Tcl_GetString(key);
+    for ( int col = 0; col < merge_ptr->num_cols; col++ ) {
+        if ( strcmp(input_ptr->info[col].name, name) == 0 ) {
+            *col_ptr = col;
+            return TCL_OK;
+        }
     }
-    dbcapi_bool has_advanced = dbcapi.get_next_result(stmt_state_ptr->stmt);
-    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(has_advanced));
-    return TCL_OK;
+    if ( Tcl_GetIntFromObj(NULL, key, col_ptr) == TCL_OK && 0 <= *col_ptr && *col_ptr < merge_ptr->num_cols ) {
+        return TCL_OK;
+    }
+    Tcl_AppendResult(interp, "result set of ", Tcl_GetString(input_ptr->stmt_name), " does not have column ", name, NULL);
+    return TCL_ERROR;
 }
 
 /**
- * Statement subcommands multiplexor.
+ * Reads result set metadata of all statements and fetches their first rows. The merge is started only
+ * when all of that succeeds. If reading the metadata fails the next fetch tries again. Failure to fetch
+ * the first rows stops the merge as the rows that have been fetched already cannot be fetched again.
  */
 static int
-Stmt_Cmd (Stmt_State * stmt_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Merge_Start (Merge_State * merge_ptr, Tcl_Interp * interp)
 {
-    if ( objc < 2 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "method ?option...?");
-        return TCL_ERROR;
+    for ( int i = 0; i < merge_ptr->num_inputs; i++ ) {
+        Merge_Input * input_ptr = &merge_ptr->inputs[i];
+        int num_cols = GetResultNumCols(input_ptr->stmt_state_ptr, interp);
+        if ( num_cols < 0 ) {
+            goto Error_Exit;
+        }
+        if ( i == 0 ) {
+            merge_ptr->num_cols = num_cols;
+        } else if ( num_cols != merge_ptr->num_cols ) {
+            Tcl_AppendResult(interp, "result set of ", Tcl_GetString(input_ptr->stmt_name), " has a different number of columns", NULL);
+            goto Error_Exit;
+        }
+        input_ptr->info = (dbcapi_column_info *) ckalloc(sizeof(dbcapi_column_info) * num_cols);
+        input_ptr->keys = (dbcapi_data_value *) ckalloc(sizeof(dbcapi_data_value) * merge_ptr->num_keys);
+        if ( GetResultColumnsInfo(input_ptr->stmt_state_ptr, interp, num_cols, input_ptr->info) != TCL_OK ) {
+            goto Error_Exit;
+        }
     }
 
-    static const char * const methods[] = {
-        "close", "execute", "fetch", "get", "nextresult", NULL
-    };
-    enum {
-        CLOSE, EXECUTE, FETCH, GET, NEXT_RESULT
-    } method;
+    Tcl_Obj * * keys;
+    Tcl_ListObjGetElements(NULL, merge_ptr->key_list, &merge_ptr->num_keys, &keys);
+    for ( int k = 0; k < merge_ptr->num_keys; k++ ) {
+        if ( Merge_FindKeyColumn(merge_ptr, interp, &merge_ptr->inputs[0], keys[k], &merge_ptr->key_cols[k]) != TCL_OK ) {
+            goto Error_Exit;
+        }
+        int col = merge_ptr->key_cols[k];
+        for ( int i = 1; i < merge_ptr->num_inputs; i++ ) {
+            Merge_Input * input_ptr = &merge_ptr->inputs[i];
+            if ( input_ptr->info[col].native_type != merge_ptr->inputs[0].info[col].native_type ) {
+                Tcl_AppendResult(interp, "key column ", Tcl_GetString(keys[k]), " of ", Tcl_GetString(input_ptr->stmt_name), " has a different type", NULL);
+                goto Error_Exit;
+            }
+        }
+    }
 
-    if ( Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, (int *) &method) != TCL_OK ) {
-        return TCL_ERROR;
+    for ( int i = 0; i < merge_ptr->num_inputs; i++ ) {
+        int fetched = Merge_FetchInput(merge_ptr, interp, &merge_ptr->inputs[i]);
+        if ( fetched < 0 ) {
+            Merge_Fail(merge_ptr, interp);
+            goto Error_Exit;
+        }
+        if ( fetched ) {
+            merge_ptr->heap[merge_ptr->heap_size++] = i;
+        }
     }
-    switch ( method ) {
-        case CLOSE:
-            return Stmt_Close       (stmt_state_ptr, interp, objc - 2, objv + 2);
-        case EXECUTE:
-            return Stmt_Execute     (stmt_state_ptr, interp, objc - 2, objv + 2);
-        case FETCH:
-            return Stmt_Fetch       (stmt_state_ptr, interp, objc - 2, objv + 2);
-        case GET:
-            return Stmt_Get         (stmt_state_ptr, interp, objc - 2, objv + 2);
-        case NEXT_RESULT:
-            return Stmt_NextResult  (stmt_state_ptr, interp, objc - 2, objv + 2);
+    for ( int pos = merge_ptr->heap_size / 2 - 1; pos >= 0; pos-- ) {
+        Merge_SiftDown(merge_ptr, pos);
     }
+    merge_ptr->started = true;
     return TCL_OK;
+
+Error_Exit:
+    for ( int i = 0; i < merge_ptr->num_inputs; i++ ) {
+        Merge_Input * input_ptr = &merge_ptr->inputs[i];
+        if ( input_ptr->info != NULL ) {
+            ckfree(input_ptr->info);
+            input_ptr->info = NULL;
+        }
+        if ( input_ptr->keys != NULL ) {
+            ckfree(input_ptr->keys);
+            input_ptr->keys = NULL;
+        }
+    }
+    merge_ptr->heap_size = 0;
+    return TCL_ERROR;
 }
 
 /**
- * Closes the current database connection.
- *
- * All currently opened cursors (statements) are also closed. Saved connection and statement
- * become invalid as corresponding command are deleted.
- *
- * # Example
- *
- * \code{.tcl}
- * $conn close
- * \endcode
- *
- * \note It is not necessary to close a connection explicitly. `hdbtcl` will close it automatically
- * when all references to the connection are gone.
+ * Appends the next row in the key order to the row list. Returns 1 if the row was appended, 0 if all
+ * statements have no more rows and -1 on error.
  */
 static int
-Conn_Close (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Merge_NextRow (Merge_State * merge_ptr, Tcl_Interp * interp, Tcl_Obj * row)
 {
-    if ( Tcl_DeleteCommandFromToken(interp, conn_state_ptr->conn_cmd) != TCL_OK ) {
-        Tcl_SetResult(interp, "Cannot delete connection handle", TCL_STATIC);
+    if ( merge_ptr->heap_size == 0 ) {
+        return 0;
+    }
+    Merge_Input * input_ptr = &merge_ptr->inputs[merge_ptr->heap[0]];
+    Stmt_State * stmt_state_ptr = input_ptr->stmt_state_ptr;
+    Hdbtcl_Stats delta = { .fetches = 1, .rows = 1, .calls = 1 };
+    Tcl_WideInt started = GetMonotonicTime();
+    int res = GetRowValues(stmt_state_ptr, interp, input_ptr->info, merge_ptr->num_cols, row, NULL, NULL, NULL, &delta, NULL);
+    Tcl_WideInt fetching = GetMonotonicTime();
+    delta.convert_time = fetching - started;
+    int fetched = ( res == TCL_OK ? Merge_FetchInput(merge_ptr, interp, input_ptr) : -1 );
+    delta.fetch_time = GetMonotonicTime() - fetching;
+    Stats_Record(stmt_state_ptr->conn_state_ptr, stmt_state_ptr, &delta);
+    if ( fetched < 0 ) {
+        Merge_Fail(merge_ptr, interp);
+        return -1;
+    }
+    if ( !fetched ) {
+        merge_ptr->heap[0] = merge_ptr->heap[--merge_ptr->heap_size];
+        Trace_Finish(stmt_state_ptr, -1, NULL);
+    }
+    Merge_SiftDown(merge_ptr, 0);
+    return 1;
+}
+
+/**
+ * Prepares the merge for fetching.
+ */
+static int
+Merge_Prepare (Merge_State * merge_ptr, Tcl_Interp * interp)
+{
+    if ( merge_ptr->error != NULL ) {
+        Tcl_SetObjResult(interp, merge_ptr->error);
         return TCL_ERROR;
     }
+    if ( Merge_ResolveInputs(merge_ptr, interp) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    if ( !merge_ptr->started ) {
+        return Merge_Start(merge_ptr, interp);
+    }
     return TCL_OK;
 }
 
 /**
- * Changes current connection configuration.
- *
- * Supported options:
- *  -autocommit
- *      Sets the AUTOCOMMIT mode to be on or off. The default AUTOCOMMIT mode is off, so
- *      calling the commit or rollback is required for each transaction. When the AUTOCOMMIT
- *      mode is set to on, all statements are committed after they execute. They cannot be
- *      rolled back.
- *  -isolation
- *      Sets the transaction isolation level. The default isolation level is "READ COMMITTED".
- *      Other two possible options are "REPEATABLE READ" and "SERIALIZABLE".
+ * Fetches the next row in the key order and saves it into the specified variable. Returns false
+ * when all merged statements have no more rows.
  *
  * # Example
  *
  * \code{.tcl}
- * $conn configure -autocommit true -isolation "REPEATABLE READ"
+ * while { [$merge fetch row] } {
+ *     # row is a list of column values
+ * }
  * \endcode
- */
-static int
-Conn_Configure (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
-{
-    if ( objc < 4 || objc % 2 != 0 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "configure -option value ?-option value...?");
-        return TCL_ERROR;
-    }
-
-    static const char * const options[] = {
-        "-autocommit", "-isolation",
-        NULL
-    };
-    enum {
-        AUTOCOMMIT, ISOLATION
-    } option;
-
-    for ( int i = 2; i < objc; i += 2 ) {
-        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
-            return TCL_ERROR;
-        }
-        switch ( option ) {
-            case AUTOCOMMIT: {
-                int autocommit;
-                if ( Tcl_GetBooleanFromObj(interp, objv[i + 1], &autocommit) != TCL_OK ) {
-                    return TCL_ERROR;
-                }
-                if ( !dbcapi.set_autocommit(conn_state_ptr->conn, autocommit) ) {
-                    SetErrorResult(interp, conn_state_ptr->conn, "Cannot set autocommit", NULL);
-                    return TCL_ERROR;
-                }
-                break;
-            }
-            case ISOLATION: {
-                static const char * const levels[] = {
-                    "READ COMMITTED", "REPEATABLE READ", "SERIALIZABLE",
-                    NULL
-                };
-                int level;
-                if ( Tcl_GetIndexFromObj(interp, objv[i + 1], levels, "isolation level", 0, &level) != TCL_OK ) {
-                    return TCL_ERROR;
-                }
-                if ( !dbcapi.set_transaction_isolation(conn_state_ptr->conn, level + 1) ) {
-                    SetErrorResult(interp, conn_state_ptr->conn, "Cannot set transaction isolation level", NULL);
-                    return TCL_ERROR;
-                }
-                break;
-            }
-        }
+ */
+static int
+Merge_Fetch (Merge_State * merge_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc != 1 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "fetch row_var");
+        return TCL_ERROR;
+    }
+    if ( Merge_Prepare(merge_ptr, interp) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    Tcl_Obj * row = Tcl_ObjSetVar2(interp, objv[0], NULL, Tcl_NewListObj(0, NULL), TCL_LEAVE_ERR_MSG);
+    if ( row == NULL ) {
+        return TCL_ERROR;
+    }
+    int fetched = Merge_NextRow(merge_ptr, interp, row);
+    if ( fetched < 0 ) {
+        return TCL_ERROR;
     }
+    Tcl_SetObjResult(interp, Tcl_NewBooleanObj(fetched));
     return TCL_OK;
 }
 
 /**
- * Retrieves connection configration. Only -autocommit is supported.
+ * Fetches up to the specified number of rows in the key order. Returns a list of fetched rows.
+ * The returned list is empty when all merged statements have no more rows.
  *
  * # Example
  *
  * \code{.tcl}
- * set is_autocommitting [$conn cget -autocommit]
+ * while { [llength [set rows [$merge fetchmany 1000]]] > 0 } {
+ *     foreach row $rows {
+ *         # row is a list of column values
+ *     }
+ * }
  * \endcode
  */
 static int
-Conn_Cget (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Merge_FetchMany (Merge_State * merge_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    if ( objc != 3 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "cget -option");
+    if ( objc != 1 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "fetchmany max_rows");
         return TCL_ERROR;
     }
-
-    static const char * const options[] = {
-        "-autocommit",
-        NULL
-    };
-    enum {
-        AUTOCOMMIT
-    } option;
-
-    if ( Tcl_GetIndexFromObj(interp, objv[2], options, "option", 0, (int *) &option) != TCL_OK ) {
+    int max_rows;
+    if ( Tcl_GetIntFromObj(interp, objv[0], &max_rows) != TCL_OK ) {
         return TCL_ERROR;
     }
-    switch ( option ) {
-        case AUTOCOMMIT: {
-            dbcapi_bool autocommit;
-            if ( !dbcapi.get_autocommit(conn_state_ptr->conn, &autocommit) ) {
-                SetErrorResult(interp, conn_state_ptr->conn, "Cannot retrieve autocommit setting", NULL);
+    if ( max_rows <= 0 ) {
+        Tcl_SetResult(interp, "the number of rows to fetch must be positive", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    if ( Merge_Prepare(merge_ptr, interp) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    Tcl_Obj * rows = Tcl_NewListObj(0, NULL);
+    for ( int n = 0; n < max_rows; ++n ) {
+        Tcl_Obj * row = Tcl_NewListObj(0, NULL);
+        int fetched = Merge_NextRow(merge_ptr, interp, row);
+        if ( fetched <= 0 ) {
+            Tcl_DecrRefCount(row);
+            if ( fetched < 0 ) {
+                Tcl_DecrRefCount(rows);
                 return TCL_ERROR;
             }
-            Tcl_SetObjResult(interp, Tcl_NewBooleanObj(autocommit));
             break;
         }
+        Tcl_ListObjAppendElement(NULL, rows, row);
     }
+    Tcl_SetObjResult(interp, rows);
     return TCL_OK;
 }
 
 /**
- * Sets or retrieves session-specific client information (name and value pair).
- *
- * \see https://help.sap.com/viewer/0eec0d68141541d1b07893a39944924e/2.0.04/en-US/e90fa1f0e06e4840aa3ee2278afae16b.html
+ * Closes the merge cursor. Merged statements stay open.
  *
  * # Example
  *
  * \code{.tcl}
- * set current_app_name [$conn set APPLICATION]
- * $conn set APPLICATION tclapp
+ * $merge close
  * \endcode
- *
- * \note When setting client information this subcommand behaves like TCL's `set` command
- * and returns the value that was provided to it.
  */
 static int
-Conn_Set (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Merge_Close (Merge_State * merge_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    if ( objc == 4 ) {
-
-        char * var = Tcl_GetString(objv[2]);
-        char * val = Tcl_GetString(objv[3]);
-        if ( !dbcapi.set_clientinfo(conn_state_ptr->conn, var, val) ) {
-            SetErrorResult(interp, conn_state_ptr->conn, "Cannot set session variable ", var, NULL);
-            return TCL_ERROR;
-        }
-        Tcl_SetObjResult(interp, objv[3]);
+    if ( Tcl_DeleteCommandFromToken(interp, merge_ptr->merge_cmd) != TCL_OK ) {
+        Tcl_SetResult(interp, "Cannot delete merge handle", TCL_STATIC);
+        return TCL_ERROR;
+    }
+    return TCL_OK;
+}
 
-    } else if ( objc == 3 ) {
+/**
+ * Destroys and deletes the merge state.
+ */
+static void
+Merge_DeleteState (Merge_State * merge_ptr)
+{
+    for ( int i = 0; i < merge_ptr->num_inputs; i++ ) {
+        Merge_Input * input_ptr = &merge_ptr->inputs[i];
+        Tcl_DecrRefCount(input_ptr->stmt_name);
+        if ( input_ptr->info != NULL ) ckfree(input_ptr->info);
+        if ( input_ptr->keys != NULL ) ckfree(input_ptr->keys);
+    }
+    Tcl_DecrRefCount(merge_ptr->key_list);
+    if ( merge_ptr->error != NULL ) {
+        Tcl_DecrRefCount(merge_ptr->error);
+    }
+    ckfree(merge_ptr->inputs);
+    ckfree(merge_ptr->key_cols);
+    ckfree(merge_ptr->heap);
+    ckfree(merge_ptr);
+}
 
-        char * var = Tcl_GetString(objv[2]);
-        const char * val = dbcapi.get_clientinfo(conn_state_ptr->conn, var);
-        if ( val == NULL ) {
-            Tcl_AppendResult(interp, "Session variable ", var, " does not exist.", NULL);
-            return TCL_ERROR;
-        }
-        Tcl_SetObjResult(interp, Tcl_NewStringObj(val, -1));
+/**
+ * Merge cursor subcommands multiplexor.
+ */
+static int
+Merge_Cmd (Merge_State * merge_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    if ( objc < 2 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "method ?option...?");
+        return TCL_ERROR;
+    }
 
-    } else {
+    static const char * const methods[] = {
+        "close", "fetch", "fetchmany", NULL
+    };
+    enum {
+        CLOSE, FETCH, FETCH_MANY
+    } method;
 
-        Tcl_WrongNumArgs(interp, objc, objv, "set session_variable ?value?");
+    if ( Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, (int *) &method) != TCL_OK ) {
         return TCL_ERROR;
     }
+    switch ( method ) {
+        case CLOSE:
+            return Merge_Close      (merge_ptr, interp, objc - 2, objv + 2);
+        case FETCH:
+            return Merge_Fetch      (merge_ptr, interp, objc - 2, objv + 2);
+        case FETCH_MANY:
+            return Merge_FetchMany  (merge_ptr, interp, objc - 2, objv + 2);
+    }
     return TCL_OK;
 }
 
 /**
- * Calls DBCAPI to prepare SQL and then creates and returns the statement command to miltiplex the statement subcommands.
+ * Creates a cursor that merges result sets of several statements, each of them already ordered by the
+ * same key, into one result set that is ordered by that key. Returns the merge command that fetches
+ * merged rows.
+ *
+ * Key columns are specified by their names or by their positions in the result set. Key values are
+ * compared according to their column types. NULLs are less than any other value. With `-order desc`
+ * the statements must be ordered by the key in the descending order.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set s1 [$conn1 query "SELECT region, order_id, amount FROM orders ORDER BY region, order_id"]
+ * set s2 [$conn2 query "SELECT region, order_id, amount FROM orders ORDER BY region, order_id"]
+ * set merge [hdb merge -key {REGION ORDER_ID} $s1 $s2]
+ * while { [$merge fetch row] } {
+ *     # ...
+ * }
+ * $merge close
+ * \endcode
+ *
+ * \note The merge holds only the current row of each statement. Rows must not be fetched from the merged
+ * statements directly while they are being merged.
  */
 static int
-PrepareStmt (Conn_State * conn_state_ptr, Tcl_Interp * interp, const char * sql, Stmt_State * * stmt_state_ptr_ptr)
+Hdb_Merge (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    Stmt_State * stmt_state_ptr = ckalloc(sizeof(Stmt_State));
-    if ( stmt_state_ptr == NULL ) {
-        Tcl_SetResult(interp, "cannot allocate memory for the statement internal state", TCL_STATIC);
+    static const char * const options[] = {
+        "-key", "-order", NULL
+    };
+    enum {
+        KEY, ORDER
+    } option;
+
+    Tcl_Obj * key_list = NULL;
+    int direction = 1;
+    int i = 0;
+    for ( ; i + 1 < objc && Tcl_GetString(objv[i])[0] == '-'; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case KEY:
+                key_list = objv[i + 1];
+                break;
+            case ORDER: {
+                static const char * const orders[] = { "asc", "desc", NULL };
+                int order;
+                if ( Tcl_GetIndexFromObj(interp, objv[i + 1], orders, "order", 0, &order) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                direction = ( order == 0 ? 1 : -1 );
+                break;
+            }
+        }
+    }
+    if ( key_list == NULL || i >= objc ) {
+        Tcl_WrongNumArgs(interp, 0, objv, "merge -key {column...} ?-order asc|desc? stmt ?stmt...?");
         return TCL_ERROR;
     }
-    memset(stmt_state_ptr, 0, sizeof(Stmt_State));
-    stmt_state_ptr->conn_state_ptr = conn_state_ptr;
-
-    stmt_state_ptr->stmt = dbcapi.prepare(conn_state_ptr->conn, sql);
-    if ( stmt_state_ptr->stmt == NULL ) {
-        SetErrorResult(interp, conn_state_ptr->conn, "Cannot prepare statement for execution", NULL);
-        goto Error_Exit;
+    int num_keys;
+    if ( Tcl_ListObjLength(interp, key_list, &num_keys) != TCL_OK ) {
+        return TCL_ERROR;
     }
-
-    char name[24];
-    int name_len = sprintf(name, "hdbstmt%" PRIxPTR, (uintptr_t) stmt_state_ptr->stmt);
-
-    stmt_state_ptr->stmt_cmd = Tcl_CreateObjCommand(interp, name, (Tcl_ObjCmdProc *) Stmt_Cmd, (ClientData) stmt_state_ptr, (Tcl_CmdDeleteProc *) Stmt_DeleteState);
-    if ( stmt_state_ptr->stmt_cmd == NULL ) {
-        Tcl_SetResult(interp, "cannot create statement command handler", TCL_STATIC);
-        goto Error_Exit;
+    if ( num_keys == 0 ) {
+        Tcl_SetResult(interp, "merge key must have at least one column", TCL_STATIC);
+        return TCL_ERROR;
     }
-    int is_new;
-    Tcl_HashEntry * entry = Tcl_CreateHashEntry(conn_state_ptr->open_statements, stmt_state_ptr->stmt_cmd, &is_new);
-    Tcl_SetHashValue(entry, stmt_state_ptr->stmt_cmd);
 
-    if ( stmt_state_ptr_ptr != NULL ) {
-        *stmt_state_ptr_ptr = stmt_state_ptr;
+    Merge_State * merge_ptr = ckalloc(sizeof(Merge_State));
+    memset(merge_ptr, 0, sizeof(Merge_State));
+    merge_ptr->key_list = Tcl_DuplicateObj(key_list);
+    Tcl_IncrRefCount(merge_ptr->key_list);
+    merge_ptr->num_keys = num_keys;
+    merge_ptr->key_cols = (int *) ckalloc(sizeof(int) * num_keys);
+    merge_ptr->direction = direction;
+    merge_ptr->num_inputs = objc - i;
+    merge_ptr->inputs = (Merge_Input *) ckalloc(sizeof(Merge_Input) * merge_ptr->num_inputs);
+    memset(merge_ptr->inputs, 0, sizeof(Merge_Input) * merge_ptr->num_inputs);
+    merge_ptr->heap = (int *) ckalloc(sizeof(int) * merge_ptr->num_inputs);
+    for ( int n = 0; n < merge_ptr->num_inputs; n++ ) {
+        merge_ptr->inputs[n].stmt_name = objv[i + n];
+        Tcl_IncrRefCount(objv[i + n]);
+    }
+    if ( Merge_ResolveInputs(merge_ptr, interp) != TCL_OK ) {
+        Merge_DeleteState(merge_ptr);
+        return TCL_ERROR;
+    }
+    for ( int a = 0; a < merge_ptr->num_inputs; a++ ) {
+        for ( int b = 0; b < a; b++ ) {
+            if ( merge_ptr->inputs[a].stmt_state_ptr == merge_ptr->inputs[b].stmt_state_ptr ) {
+                Tcl_AppendResult(interp, Tcl_GetString(merge_ptr->inputs[a].stmt_name), " is listed more than once", NULL);
+                Merge_DeleteState(merge_ptr);
+                return TCL_ERROR;
+            }
+        }
     }
 
+    char name[32];
+    int name_len = sprintf(name, "hdbmerge%" PRIxPTR, (uintptr_t) merge_ptr);
+
+    merge_ptr->merge_cmd = Tcl_CreateObjCommand(interp, name, (Tcl_ObjCmdProc *) Merge_Cmd, (ClientData) merge_ptr, (Tcl_CmdDeleteProc *) Merge_DeleteState);
+    if ( merge_ptr->merge_cmd == NULL ) {
+        Tcl_SetResult(interp, "cannot create merge command handler", TCL_STATIC);
+        Merge_DeleteState(merge_ptr);
+        return TCL_ERROR;
+    }
     Tcl_SetObjResult(interp, Tcl_NewStringObj(name, name_len));
     return TCL_OK;
+}
 
-Error_Exit:
-    Stmt_DeleteState(stmt_state_ptr, interp);
-    return TCL_ERROR;
+/**
+ * Returns performance counters of all connections of the interpreter as a dictionary. With `-reset`
+ * the counters are reset after they are returned. Counters of connections and statements are not
+ * affected.
+ *
+ * # Example
+ *
+ * \code{.tcl}
+ * set stats [hdb stats]
+ * \endcode
+ */
+static int
+Hdb_Stats (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+{
+    return Stats_Report(&hdbtcl_state_ptr->stats, interp, objc, objv, "stats ?-reset?");
 }
 
 /**
- * Prepares the SQL statement for execution. Returns the prepared statement, so it could be executed
- * later.
+ * Returns memory all statements of the interpreter hold as a dictionary:
+ * - `memory` - current sizes (bytes) of `rows`, `lobs`, `params`, `metadata` and their `total`.
+ * - `peak` - the largest sizes statements have held.
+ * - `memorylimit` - the module memory limit.
+ * - `connections` - open connections. Each is a dictionary that `$conn resources` returns.
+ *
+ * With `-memorylimit` sets the number of bytes all statements may hold at once - the data of the
+ * fetches and executions in progress (asynchronous ones included), bound parameters and metadata.
+ * Calls that would exceed it fail. Data returned to the script are not accounted, so the limit
+ * bounds the calls rather than the data the script keeps. 0 (the default) disables the limit.
  *
  * # Example
  *
  * \code{.tcl}
- * set stmt [$conn prepare "INSERT INTO employees (employee_id, first_name, last_name) VALUES (?, ?, ?)"]
+ * hdb resources -memorylimit 1000000000
+ * puts "fetched data take [dict get [hdb resources] memory total] bytes"
  * \endcode
  */
 static int
-Conn_Prepare (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Hdb_Resources (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    if ( objc != 3 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "prepare sql_string");
+    if ( objc != 0 && objc != 2 ) {
+        Tcl_WrongNumArgs(interp, 0, objv, "resources ?-memorylimit bytes?");
         return TCL_ERROR;
     }
-    char * sql = Tcl_GetString(objv[2]);
-    return PrepareStmt(conn_state_ptr, interp, sql, NULL);
+    if ( objc == 2 ) {
+        static const char * const options[] = { "-memorylimit", NULL };
+        int option;
+        if ( Tcl_GetIndexFromObj(interp, objv[0], options, "option", 0, &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        return GetMemoryLimitFromObj(interp, objv[1], &hdbtcl_state_ptr->memory_limit);
+    }
+    Tcl_Obj * result = Tcl_NewDictObj();
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("memory", -1), Memory_NewDictObj(&hdbtcl_state_ptr->memory));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("peak", -1), Memory_NewDictObj(&hdbtcl_state_ptr->memory_peak));
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("memorylimit", -1), Tcl_NewWideIntObj(hdbtcl_state_ptr->memory_limit));
+    Tcl_Obj * conns = Tcl_NewDictObj();
+    Tcl_HashSearch iter;
+    for (
+        Tcl_HashEntry * entry = Tcl_FirstHashEntry(hdbtcl_state_ptr->open_connections, &iter);
+        entry != NULL;
+        entry = Tcl_NextHashEntry(&iter)
+    ) {
+        Tcl_Command conn_cmd = Tcl_GetHashValue(entry);
+        Tcl_CmdInfo info;
+        if ( Tcl_GetCommandInfoFromToken(conn_cmd, &info) ) {
+            Conn_State * conn_state_ptr = (Conn_State *) info.objClientData;
+            Tcl_DictObjPut(NULL, conns, Tcl_NewStringObj(Tcl_GetCommandName(interp, conn_cmd), -1), Conn_NewResourcesObj(conn_state_ptr, interp));
+        }
+    }
+    Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("connections", -1), conns);
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
 }
 
 /**
- * Prepares and executes the SQL statement. Returns the prepared statement, so it could be executed
- * again with different arguments.
+ * Configures the module. Without options returns the current configuration as a dictionary.
+ * Supported options are:
+ *  -conversionthreads
+ *      Sets the number of threads, the calling one included, that convert large rowsets into Tcl
+ *      values or render them as text. Rows of a rowset are split into ranges that are converted at
+ *      the same time. 1 disables parallel conversion. By default up to 4 threads are used, but no
+ *      more than there are processors. The setting is shared by all interpreters of the process.
  *
  * # Example
  *
  * \code{.tcl}
- * set stmt [$conn execute "INSERT INTO employees (employee_id, first_name, last_name) VALUES (?, ?, ?)" 2 "Hasso" "Plattner"]
+ * hdb configure -conversionthreads 8
  * \endcode
  */
 static int
-Conn_Execute (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Hdb_Configure (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    if ( objc < 3 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "execute sql_string ?arg...?");
+    if ( objc % 2 != 0 ) {
+        Tcl_WrongNumArgs(interp, objc, objv, "configure ?-conversionthreads n?");
         return TCL_ERROR;
     }
-    char * sql = Tcl_GetString(objv[2]);
-    Stmt_State * stmt_state_ptr;
-    if ( PrepareStmt(conn_state_ptr, interp, sql, &stmt_state_ptr) != TCL_OK ) {
-        return TCL_ERROR;
+    static const char * const options[] = { "-conversionthreads", NULL };
+    enum { CONVERSIONTHREADS } option;
+    for ( int i = 0; i < objc; i += 2 ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case CONVERSIONTHREADS: {
+                int num_threads;
+                if ( Tcl_GetIntFromObj(interp, objv[i + 1], &num_threads) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                if ( num_threads < 1 || num_threads > CONVERT_MAX_THREADS ) {
+                    Tcl_SetObjResult(interp, Tcl_ObjPrintf("the number of conversion threads must be between 1 and %d", CONVERT_MAX_THREADS));
+                    return TCL_ERROR;
+                }
+                Tcl_MutexLock(&convert_lock);
+                convert_pool.max_threads = num_threads;
+                Tcl_MutexUnlock(&convert_lock);
+                break;
+            }
+        }
     }
-    // Note that PrepareStmt has set the name of the statement command as result.
-    // So, unless Stmt_Execute below resets it on error, that's what [$conn execute ...] will return
-
-    if ( Stmt_Execute(stmt_state_ptr, interp, objc - 3, objv + 3) != TCL_OK ) {
-        goto Error_Exit;
+    if ( objc == 0 ) {
+        Tcl_Obj * result = Tcl_NewDictObj();
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("conversionthreads", -1), Tcl_NewIntObj(Convert_GetMaxThreads()));
+        Tcl_SetObjResult(interp, result);
     }
-
     return TCL_OK;
-
-Error_Exit:
-    if ( Tcl_DeleteCommandFromToken(interp, stmt_state_ptr->stmt_cmd) != TCL_OK ) {
-        Stmt_DeleteState(stmt_state_ptr, interp);
-    }
-    return TCL_ERROR;
 }
 
 /**
- * Commits the current transaction.
+ * Returns the list of slow statements that were traced most recently, the oldest first. Each
+ * entry is a dictionary:
+ * - `connection` - connection that executed the statement.
+ * - `sql` - SQL text of the statement. Long statements are truncated.
+ * - `params` - number of statement arguments.
+ * - `time` - when the execution was completed (ms since the epoch, as `clock milliseconds`).
+ * - `elapsed`, `execute`, `fetch` - time (ms) the statement spent executing and fetching rows.
+ * - `rows` - number of fetched rows.
+ * - `affected` - number of affected rows for statements that do not return a result set.
+ * - `error` - error message if the execution failed.
+ *
+ * With `-clear` the log is cleared after the entries are returned.
  *
  * # Example
  *
  * \code{.tcl}
- * $conn commit
+ * foreach entry [hdb slowlog -clear] {
+ *     puts "[dict get $entry elapsed] ms: [dict get $entry sql]"
+ * }
  * \endcode
  */
 static int
-Conn_Commit (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Hdb_SlowLog (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    if ( !dbcapi.commit(conn_state_ptr->conn) ) {
-        SetErrorResult(interp, conn_state_ptr->conn, "Cannot commit transaction", NULL);
+    static const char * const options[] = { "-clear", NULL };
+    int option;
+    if ( objc > 1 ) {
+        Tcl_WrongNumArgs(interp, 0, objv, "slowlog ?-clear?");
         return TCL_ERROR;
     }
+    if ( objc == 1 && Tcl_GetIndexFromObj(interp, objv[0], options, "option", 0, &option) != TCL_OK ) {
+        return TCL_ERROR;
+    }
+    Tcl_Obj * result = Tcl_NewListObj(0, NULL);
+    int first = ( hdbtcl_state_ptr->slowlog_next - hdbtcl_state_ptr->slowlog_count + SLOWLOG_SIZE ) % SLOWLOG_SIZE;
+    for ( int i = 0; i < hdbtcl_state_ptr->slowlog_count; i++ ) {
+        Tcl_ListObjAppendElement(NULL, result, hdbtcl_state_ptr->slowlog[( first + i ) % SLOWLOG_SIZE]);
+    }
+    if ( objc == 1 ) {
+        for ( int i = 0; i < SLOWLOG_SIZE; i++ ) {
+            if ( hdbtcl_state_ptr->slowlog[i] != NULL ) {
+                Tcl_DecrRefCount(hdbtcl_state_ptr->slowlog[i]);
+                hdbtcl_state_ptr->slowlog[i] = NULL;
+            }
+        }
+        hdbtcl_state_ptr->slowlog_next = 0;
+        hdbtcl_state_ptr->slowlog_count = 0;
+    }
+    Tcl_SetObjResult(interp, result);
     return TCL_OK;
 }
 
 /**
- * Rolls back the current transaction.
+ * Returns latency percentiles of connects, prepares, executions, row fetches and commits. With
+ * `-format dict` (default) the result is a dictionary with an entry for each operation, and with
+ * `labels` entry that has latencies of labelled statements:
+ * - `count` - number of operations.
+ * - `sum` - total time (us) of all operations.
+ * - `p50`, `p90`, `p99`, `p999` - percentiles (us).
+ * - `max` - the longest operation (us).
+ *
+ * `-format prometheus` returns the same data in the Prometheus text exposition format as
+ * summaries with latencies in seconds. With `-reset` latencies are cleared after they are returned.
  *
  * # Example
  *
  * \code{.tcl}
- * $conn rollback
+ * set p99 [dict get [hdb metrics] fetch p99]
+ * puts [hdb metrics -format prometheus]
  * \endcode
  */
 static int
-Conn_Rollback (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Hdb_Metrics (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
-    if ( !dbcapi.rollback(conn_state_ptr->conn) ) {
-        SetErrorResult(interp, conn_state_ptr->conn, "Cannot roll back transaction", NULL);
-        return TCL_ERROR;
+    static const char * const options[] = { "-format", "-reset", NULL };
+    enum { FORMAT, RESET } option;
+    static const char * const formats[] = { "dict", "prometheus", NULL };
+    enum { DICT, PROMETHEUS } format = DICT;
+    bool reset = false;
+
+    for ( int i = 0; i < objc; i++ ) {
+        if ( Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0, (int *) &option) != TCL_OK ) {
+            return TCL_ERROR;
+        }
+        switch ( option ) {
+            case FORMAT: {
+                if ( ++i == objc ) {
+                    Tcl_WrongNumArgs(interp, 0, NULL, "metrics ?-format dict|prometheus? ?-reset?");
+                    return TCL_ERROR;
+                }
+                if ( Tcl_GetIndexFromObj(interp, objv[i], formats, "format", 0, (int *) &format) != TCL_OK ) {
+                    return TCL_ERROR;
+                }
+                break;
+            }
+            case RESET: {
+                reset = true;
+                break;
+            }
+        }
+    }
+
+    Tcl_HashTable * labels = hdbtcl_state_ptr->labels;
+    Tcl_HashSearch iter;
+    Tcl_Obj * result;
+    if ( format == PROMETHEUS ) {
+        result = Tcl_NewObj();
+        for ( int h = 0; h < NUM_LATENCY_HISTOGRAMS; h++ ) {
+            const char * metric = latency_metric_names[h];
+            Tcl_AppendPrintfToObj(result, "# HELP %s %s\n# TYPE %s summary\n", metric, latency_metric_help[h], metric);
+            Histogram_AppendPrometheus(result, metric, NULL, &hdbtcl_state_ptr->metrics.histograms[h]);
+            for ( Tcl_HashEntry * entry = Tcl_FirstHashEntry(labels, &iter); entry != NULL; entry = Tcl_NextHashEntry(&iter) ) {
+                Latency_Metrics * metrics_ptr = (Latency_Metrics *) Tcl_GetHashValue(entry);
+                if ( metrics_ptr->histograms[h].count > 0 ) {
+                    Histogram_AppendPrometheus(result, metric, Tcl_GetHashKey(labels, entry), &metrics_ptr->histograms[h]);
+                }
+            }
+        }
+    } else {
+        result = Tcl_NewDictObj();
+        for ( int h = 0; h < NUM_LATENCY_HISTOGRAMS; h++ ) {
+            Tcl_DictObjPut(NULL, result, Tcl_NewStringObj(latency_names[h], -1), Histogram_NewDictObj(&hdbtcl_state_ptr->metrics.histograms[h]));
+        }
+        Tcl_Obj * labelled = Tcl_NewDictObj();
+        for ( Tcl_HashEntry * entry = Tcl_FirstHashEntry(labels, &iter); entry != NULL; entry = Tcl_NextHashEntry(&iter) ) {
+            Latency_Metrics * metrics_ptr = (Latency_Metrics *) Tcl_GetHashValue(entry);
+            Tcl_Obj * label_metrics = Tcl_NewDictObj();
+            for ( int h = 0; h < NUM_LATENCY_HISTOGRAMS; h++ ) {
+                if ( metrics_ptr->histograms[h].count > 0 ) {
+                    Tcl_DictObjPut(NULL, label_metrics, Tcl_NewStringObj(latency_names[h], -1), Histogram_NewDictObj(&metrics_ptr->histograms[h]));
+                }
+            }
+            Tcl_DictObjPut(NULL, labelled, Tcl_NewStringObj(Tcl_GetHashKey(labels, entry), -1), label_metrics);
+        }
+        Tcl_DictObjPut(NULL, result, Tcl_NewStringObj("labels", -1), labelled);
     }
+
+    if ( reset ) {
+        // labelled histograms are kept, as statements refer to them, and only cleared
+        memset(&hdbtcl_state_ptr->metrics, 0, sizeof(Latency_Metrics));
+        for ( Tcl_HashEntry * entry = Tcl_FirstHashEntry(labels, &iter); entry != NULL; entry = Tcl_NextHashEntry(&iter) ) {
+            memset(Tcl_GetHashValue(entry), 0, sizeof(Latency_Metrics));
+        }
+    }
+    Tcl_SetObjResult(interp, result);
     return TCL_OK;
 }
 
 /**
- * Connection subcommands multiplexor.
+ * Implements the "hdb" command.
+ *
+ * "hdb" is a subcommand multiplexor.
  */
 static int
-Conn_Cmd (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+Hdb_Cmd (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
 {
     if ( objc < 2 ) {
         Tcl_WrongNumArgs(interp, objc, objv, "method ?option...?");
@@ -2063,10 +10237,10 @@ Conn_Cmd (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj *
     }
 
     static const char * const methods[] = {
-        "cget", "close", "commit", "configure", "execute", "prepare", "rollback", "set", NULL
+        "configure", "connect", "export", "merge", "metrics", "parallel", "pool", "resources", "slowlog", "stats", NULL
     };
     enum {
-        CGET, CLOSE, COMMIT, CONFIGURE, EXECUTE, PREPARE, ROLLBACK, SET
+        CONFIGURE, CONNECT, EXPORT, MERGE, METRICS, PARALLEL, POOL, RESOURCES, SLOWLOG, STATS
     } method;
 
     if ( Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, (int *) &method) != TCL_OK ) {
@@ -2074,173 +10248,729 @@ Conn_Cmd (Conn_State * conn_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj *
     }
     switch ( method ) {
         case CONFIGURE:
-            return Conn_Configure(conn_state_ptr, interp, objc, objv);
-        case CGET:
-            return Conn_Cget(conn_state_ptr, interp, objc, objv);
-        case SET:
-            return Conn_Set(conn_state_ptr, interp, objc, objv);
-        case EXECUTE:
-            return Conn_Execute(conn_state_ptr, interp, objc, objv);
-        case PREPARE:
-            return Conn_Prepare(conn_state_ptr, interp, objc, objv);
-        case COMMIT:
-            return Conn_Commit(conn_state_ptr, interp, objc, objv);
-        case ROLLBACK:
-            return Conn_Rollback(conn_state_ptr, interp, objc, objv);
-        case CLOSE:
-            return Conn_Close(conn_state_ptr, interp, objc, objv);
+            return Hdb_Configure(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case CONNECT:
+            return Hdb_Connect(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case EXPORT:
+            return Hdb_Export(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case MERGE:
+            return Hdb_Merge(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case METRICS:
+            return Hdb_Metrics(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case PARALLEL:
+            return Hdb_Parallel(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case POOL:
+            return Hdb_Pool(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case RESOURCES:
+            return Hdb_Resources(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case SLOWLOG:
+            return Hdb_SlowLog(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+        case STATS:
+            return Hdb_Stats(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
     }
     return TCL_OK;
 }
 
 /**
- * Establishes a database connection and returns the command that is used to manipulate the current connection.
- *
- * # Example
+ * DBCAPI call recording.
  *
- * \code{.tcl}
- * set conn [hdb connect -serverNode localhost:39041 -uid username -pwd password]
- * \endcode
- *
- * \see https://help.sap.com/viewer/0eec0d68141541d1b07893a39944924e/2.0.04/en-US/4fe9978ebac44f35b9369ef5a4a26f4c.html
- *      for a list of acceptable connection options/properties
+ * When `HDBCAPIRECORD` names a file, every DBCAPI call is recorded into it with its arguments, the
+ * data DBCAPI returned and the time the call took. The recording can be served back without a server
+ * by the replay library (see stub/dbcapi_replay.c).
  *
- * \note The `charset` option, if provided, will be overwritten and set to `UTF-8`
+ * The file starts with the 8 byte signature that is followed by records. Each record has a fixed
+ * header (in the native byte order):
+ *  - u8  - function, the index of the function in the `dbcapi` table
+ *  - u8  - reserved
+ *  - u16 - thread, a sequential number of the thread that made the call
+ *  - u32 - length of the payload that follows the header
+ *  - u64 - handle, the connection or the statement the call used
+ *  - u64 - time (ns) since the recording started when the call was made
+ *  - u64 - time (ns) the call took
+ *  - i64 - value the function returned (handles are returned as their addresses)
+ * The payload holds function arguments and returned data as u8, u32, u64 and byte strings. Byte
+ * strings are u32 length and the data. NULL strings have 0xFFFFFFFF length. Passwords are not recorded.
  */
-static int
-Hdb_Connect (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+#define RECORDER_SIGNATURE      "HDBREC\x01\n"
+#define RECORDER_NULL_LENGTH    0xFFFFFFFFu
+
+enum {
+    REC_INIT, REC_FINI, REC_NEW_CONNECTION, REC_FREE_CONNECTION, REC_CONNECT2, REC_DISCONNECT,
+    REC_SET_CONNECT_PROPERTY, REC_SET_CLIENTINFO, REC_GET_CLIENTINFO, REC_SET_TRANSACTION_ISOLATION,
+    REC_SET_AUTOCOMMIT, REC_GET_AUTOCOMMIT, REC_COMMIT, REC_ROLLBACK, REC_ERROR_LENGTH, REC_ERROR,
+    REC_PREPARE, REC_RESET, REC_FREE_STMT, REC_NUM_PARAMS, REC_DESCRIBE_BIND_PARAM, REC_BIND_PARAM,
+    REC_GET_BIND_PARAM_INFO, REC_SEND_PARAM_DATA, REC_GET_PARAM_DATA, REC_FINISH_PARAM_DATA, REC_EXECUTE,
+    REC_FETCH_NEXT, REC_GET_NEXT_RESULT, REC_AFFECTED_ROWS, REC_NUM_COLS, REC_NUM_ROWS, REC_GET_COLUMN,
+    REC_GET_COLUMN_INFO, REC_GET_DATA, REC_GET_PRINT_LINE, REC_EXECUTE_DIRECT, REC_EXECUTE_IMMEDIATE, REC_CANCEL
+};
+
+static struct dbcapi recorded_dbcapi;   /// functions of the loaded DBCAPI library
+static FILE * recorder_file;
+static Tcl_WideInt recorder_started;
+static int recorder_threads;
+static Tcl_ThreadDataKey recorder_thread_key;
+TCL_DECLARE_MUTEX(recorder_lock)
+
+/**
+ * Record payload that is being assembled.
+ */
+typedef struct recorder_buffer {
+    char *              data;
+    size_t              length;
+    size_t              capacity;
+    char                space[256];
+} Recorder_Buffer;
+
+static void
+Recorder_Init (Recorder_Buffer * buf_ptr)
 {
-    if ( objc < 2 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "connect -option value ?-option value...?");
-        return TCL_ERROR;
+    buf_ptr->data = buf_ptr->space;
+    buf_ptr->length = 0;
+    buf_ptr->capacity = sizeof(buf_ptr->space);
+}
+
+static void
+Recorder_Put (Recorder_Buffer * buf_ptr, const void * data, size_t length)
+{
+    if ( buf_ptr->length + length > buf_ptr->capacity ) {
+        size_t capacity = ( buf_ptr->length + length ) * 2;
+        char * new_data = ckalloc(capacity);
+        memcpy(new_data, buf_ptr->data, buf_ptr->length);
+        if ( buf_ptr->data != buf_ptr->space ) {
+            ckfree(buf_ptr->data);
+        }
+        buf_ptr->data = new_data;
+        buf_ptr->capacity = capacity;
     }
+    memcpy(buf_ptr->data + buf_ptr->length, data, length);
+    buf_ptr->length += length;
+}
 
-    Conn_State * conn_state_ptr = ckalloc(sizeof(Conn_State));
-    if ( conn_state_ptr == NULL ) {
-        Tcl_SetResult(interp, "cannot allocate memory for the connection internal state", TCL_STATIC);
-        return TCL_ERROR;
+static void
+Recorder_PutU8 (Recorder_Buffer * buf_ptr, uint8_t value)
+{
+    Recorder_Put(buf_ptr, &value, sizeof(value));
+}
+
+static void
+Recorder_PutU32 (Recorder_Buffer * buf_ptr, uint32_t value)
+{
+    Recorder_Put(buf_ptr, &value, sizeof(value));
+}
+
+static void
+Recorder_PutU64 (Recorder_Buffer * buf_ptr, uint64_t value)
+{
+    Recorder_Put(buf_ptr, &value, sizeof(value));
+}
+
+static void
+Recorder_PutBytes (Recorder_Buffer * buf_ptr, const void * data, size_t length)
+{
+    if ( data == NULL ) {
+        Recorder_PutU32(buf_ptr, RECORDER_NULL_LENGTH);
+        return;
     }
-    memset(conn_state_ptr, 0, sizeof(Conn_State));
-    conn_state_ptr->hdbtcl_state_ptr = hdbtcl_state_ptr;
+    Recorder_PutU32(buf_ptr, (uint32_t) length);
+    Recorder_Put(buf_ptr, data, length);
+}
 
-    conn_state_ptr->conn = dbcapi.new_connection();
-    for ( int i = 0; i < objc; ) {
-        char * opt_name  = Tcl_GetString(objv[i++]);
-        char * opt_value = Tcl_GetString(objv[i++]);
-        if ( opt_name == NULL || opt_value == NULL ) {
-            Tcl_SetResult(interp, "malformed argument list", TCL_STATIC);
-            goto Error_Exit;
-        }
-        if ( *opt_name == '-' ) {
-            ++opt_name;
-        }
-        if ( !dbcapi.set_connect_property(conn_state_ptr->conn, opt_name, opt_value) ) {
-            SetErrorResult(interp, conn_state_ptr->conn, "Cannot set connection property ", opt_name, NULL);
-            goto Error_Exit;
+static void
+Recorder_PutString (Recorder_Buffer * buf_ptr, const char * str)
+{
+    Recorder_PutBytes(buf_ptr, str, str != NULL ? strlen(str) : 0);
+}
+
+/**
+ * Records the data value. Only the data of the values that are not NULL are recorded.
+ */
+static void
+Recorder_PutValue (Recorder_Buffer * buf_ptr, const dbcapi_data_value * value)
+{
+    bool is_null = value->is_null != NULL && *value->is_null;
+    Recorder_PutU32(buf_ptr, value->type);
+    Recorder_PutU64(buf_ptr, value->buffer_size);
+    Recorder_PutU8(buf_ptr, is_null);
+    size_t length = 0;
+    size_t data_length = 0;
+    bool has_length = ( value->type != A_STRING && value->type != A_BINARY ) || value->length != NULL;
+    if ( !is_null && value->buffer != NULL && has_length ) {
+        length = GetValueSize((dbcapi_data_value *) value);
+        data_length = length;
+        if ( ( value->type == A_STRING || value->type == A_BINARY ) && length > value->buffer_size ) {
+            // LOB, which buffer only has the beginning of the value
+            data_length = value->buffer_size;
         }
     }
-    if ( !dbcapi.set_connect_property(conn_state_ptr->conn, "charset", "UTF-8") ) {
-        SetErrorResult(interp, conn_state_ptr->conn, "Cannot configure character set for the connection", NULL);
-        goto Error_Exit;
+    Recorder_PutU64(buf_ptr, length);
+    Recorder_PutBytes(buf_ptr, value->buffer != NULL && has_length ? value->buffer : NULL, data_length);
+}
+
+/**
+ * Writes the record into the recording file.
+ */
+static void
+Recorder_Write (int func, const void * handle, Tcl_WideInt started, Tcl_WideInt elapsed, int64_t result, Recorder_Buffer * buf_ptr)
+{
+    int * thread_ptr = (int *) Tcl_GetThreadData(&recorder_thread_key, sizeof(int));
+    Tcl_MutexLock(&recorder_lock);
+    if ( *thread_ptr == 0 ) {
+        *thread_ptr = ++recorder_threads;
     }
-    conn_state_ptr->connected = dbcapi.connect2(conn_state_ptr->conn);
-    if ( !conn_state_ptr->connected ) {
-        SetErrorResult(interp, conn_state_ptr->conn, "Cannot connect to the database", NULL);
-        goto Error_Exit;
+    uint8_t header[40];
+    uint32_t payload_length = buf_ptr != NULL ? (uint32_t) buf_ptr->length : 0;
+    uint16_t thread = (uint16_t) *thread_ptr;
+    uint64_t handle_id = (uint64_t) (uintptr_t) handle;
+    uint64_t start_time = (uint64_t) ( started - recorder_started );
+    uint64_t call_time = (uint64_t) elapsed;
+    header[0] = (uint8_t) func;
+    header[1] = 0;
+    memcpy(header + 2, &thread, 2);
+    memcpy(header + 4, &payload_length, 4);
+    memcpy(header + 8, &handle_id, 8);
+    memcpy(header + 16, &start_time, 8);
+    memcpy(header + 24, &call_time, 8);
+    memcpy(header + 32, &result, 8);
+    fwrite(header, sizeof(header), 1, recorder_file);
+    if ( payload_length > 0 ) {
+        fwrite(buf_ptr->data, payload_length, 1, recorder_file);
     }
+    Tcl_MutexUnlock(&recorder_lock);
+    if ( buf_ptr != NULL && buf_ptr->data != buf_ptr->space ) {
+        ckfree(buf_ptr->data);
+    }
+}
 
-    conn_state_ptr->open_statements = ckalloc(sizeof(Tcl_HashTable));
-    Tcl_InitHashTable(conn_state_ptr->open_statements, TCL_ONE_WORD_KEYS);
+/**
+ * Defines a recording wrapper of a function that takes a handle and returns a number.
+ */
+#define RECORDED_HANDLE_FN( ret_type, sym, handle_type, rec_func ) \
+static ret_type                                                     \
+Rec_##sym ( handle_type * handle )                                  \
+{                                                                   \
+    Tcl_WideInt started = GetMonotonicTime();                       \
+    ret_type rc = recorded_dbcapi.sym( handle );                    \
+    Recorder_Write( rec_func, handle, started, GetMonotonicTime() - started, (int64_t) rc, NULL ); \
+    return rc;                                                      \
+}
 
-    char name[24];
-    int name_len = sprintf(name, "hdbconn%" PRIxPTR, (uintptr_t) conn_state_ptr);
+RECORDED_HANDLE_FN( dbcapi_bool, connect2,          dbcapi_connection, REC_CONNECT2 )
+RECORDED_HANDLE_FN( dbcapi_bool, disconnect,        dbcapi_connection, REC_DISCONNECT )
+RECORDED_HANDLE_FN( dbcapi_bool, commit,            dbcapi_connection, REC_COMMIT )
+RECORDED_HANDLE_FN( dbcapi_bool, rollback,          dbcapi_connection, REC_ROLLBACK )
+RECORDED_HANDLE_FN( size_t,      error_length,      dbcapi_connection, REC_ERROR_LENGTH )
+RECORDED_HANDLE_FN( dbcapi_bool, cancel,            dbcapi_connection, REC_CANCEL )
+RECORDED_HANDLE_FN( dbcapi_bool, reset,             dbcapi_stmt,       REC_RESET )
+RECORDED_HANDLE_FN( dbcapi_i32,  num_params,        dbcapi_stmt,       REC_NUM_PARAMS )
+RECORDED_HANDLE_FN( dbcapi_bool, execute,           dbcapi_stmt,       REC_EXECUTE )
+RECORDED_HANDLE_FN( dbcapi_bool, fetch_next,        dbcapi_stmt,       REC_FETCH_NEXT )
+RECORDED_HANDLE_FN( dbcapi_bool, get_next_result,   dbcapi_stmt,       REC_GET_NEXT_RESULT )
+RECORDED_HANDLE_FN( dbcapi_i32,  affected_rows,     dbcapi_stmt,       REC_AFFECTED_ROWS )
+RECORDED_HANDLE_FN( dbcapi_i32,  num_cols,          dbcapi_stmt,       REC_NUM_COLS )
+RECORDED_HANDLE_FN( dbcapi_i32,  num_rows,          dbcapi_stmt,       REC_NUM_ROWS )
+
+static dbcapi_bool
+Rec_init (const char * app_name, dbcapi_u32 api_version, dbcapi_u32 * version_available)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.init(app_name, api_version, version_available);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutString(&buf, app_name);
+    Recorder_PutU32(&buf, api_version);
+    Recorder_Write(REC_INIT, NULL, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
 
-    conn_state_ptr->conn_cmd = Tcl_CreateObjCommand(interp, name, (Tcl_ObjCmdProc *) Conn_Cmd, (ClientData) conn_state_ptr, (Tcl_CmdDeleteProc *) Conn_DeleteState);
-    if ( conn_state_ptr->conn_cmd == NULL ) {
-        Tcl_SetResult(interp, "cannot create connection command handler", TCL_STATIC);
-        goto Error_Exit;
+static void
+Rec_fini ()
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    recorded_dbcapi.fini();
+    Recorder_Write(REC_FINI, NULL, started, GetMonotonicTime() - started, 0, NULL);
+    Tcl_MutexLock(&recorder_lock);
+    fflush(recorder_file);
+    Tcl_MutexUnlock(&recorder_lock);
+}
+
+static dbcapi_connection *
+Rec_new_connection ()
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_connection * conn = recorded_dbcapi.new_connection();
+    Recorder_Write(REC_NEW_CONNECTION, NULL, started, GetMonotonicTime() - started, (int64_t) (uintptr_t) conn, NULL);
+    return conn;
+}
+
+static void
+Rec_free_connection (dbcapi_connection * conn)
+{
+    // recorded before the call, so the record would precede records of a connection that reuses the address
+    Recorder_Write(REC_FREE_CONNECTION, conn, GetMonotonicTime(), 0, 0, NULL);
+    recorded_dbcapi.free_connection(conn);
+}
+
+static dbcapi_bool
+Rec_set_connect_property (dbcapi_connection * conn, const char * property, const char * value)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.set_connect_property(conn, property, value);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutString(&buf, property);
+    bool is_password = Tcl_StringCaseMatch(property, "pwd", 1) || Tcl_StringCaseMatch(property, "password", 1);
+    Recorder_PutString(&buf, is_password ? "" : value);
+    Recorder_Write(REC_SET_CONNECT_PROPERTY, conn, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_bool
+Rec_set_clientinfo (dbcapi_connection * conn, const char * property, const char * value)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.set_clientinfo(conn, property, value);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutString(&buf, property);
+    Recorder_PutString(&buf, value);
+    Recorder_Write(REC_SET_CLIENTINFO, conn, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static const char *
+Rec_get_clientinfo (dbcapi_connection * conn, const char * property)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    const char * value = recorded_dbcapi.get_clientinfo(conn, property);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutString(&buf, property);
+    Recorder_PutString(&buf, value);
+    Recorder_Write(REC_GET_CLIENTINFO, conn, started, GetMonotonicTime() - started, value != NULL, &buf);
+    return value;
+}
+
+static dbcapi_bool
+Rec_set_transaction_isolation (dbcapi_connection * conn, dbcapi_u32 isolation_level)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.set_transaction_isolation(conn, isolation_level);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, isolation_level);
+    Recorder_Write(REC_SET_TRANSACTION_ISOLATION, conn, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_bool
+Rec_set_autocommit (dbcapi_connection * conn, dbcapi_bool mode)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.set_autocommit(conn, mode);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, mode);
+    Recorder_Write(REC_SET_AUTOCOMMIT, conn, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_bool
+Rec_get_autocommit (dbcapi_connection * conn, dbcapi_bool * mode)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.get_autocommit(conn, mode);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, *mode);
+    Recorder_Write(REC_GET_AUTOCOMMIT, conn, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_i32
+Rec_error (dbcapi_connection * conn, char * buffer, size_t size)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_i32 rc = recorded_dbcapi.error(conn, buffer, size);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU64(&buf, size);
+    Recorder_PutString(&buf, size > 0 ? buffer : NULL);
+    Recorder_Write(REC_ERROR, conn, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_stmt *
+Rec_prepare (dbcapi_connection * conn, const char * sql)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_stmt * stmt = recorded_dbcapi.prepare(conn, sql);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutString(&buf, sql);
+    Recorder_Write(REC_PREPARE, conn, started, GetMonotonicTime() - started, (int64_t) (uintptr_t) stmt, &buf);
+    return stmt;
+}
+
+static dbcapi_stmt *
+Rec_execute_direct (dbcapi_connection * conn, const char * sql)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_stmt * stmt = recorded_dbcapi.execute_direct(conn, sql);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutString(&buf, sql);
+    Recorder_Write(REC_EXECUTE_DIRECT, conn, started, GetMonotonicTime() - started, (int64_t) (uintptr_t) stmt, &buf);
+    return stmt;
+}
+
+static dbcapi_bool
+Rec_execute_immediate (dbcapi_connection * conn, const char * sql)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.execute_immediate(conn, sql);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutString(&buf, sql);
+    Recorder_Write(REC_EXECUTE_IMMEDIATE, conn, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static void
+Rec_free_stmt (dbcapi_stmt * stmt)
+{
+    Recorder_Write(REC_FREE_STMT, stmt, GetMonotonicTime(), 0, 0, NULL);
+    recorded_dbcapi.free_stmt(stmt);
+}
+
+static dbcapi_bool
+Rec_describe_bind_param (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_data * param)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.describe_bind_param(stmt, index, param);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, index);
+    if ( rc ) {
+        Recorder_PutU32(&buf, param->direction);
+        Recorder_PutU32(&buf, param->value.type);
+        Recorder_PutU64(&buf, param->value.buffer_size);
+        Recorder_PutString(&buf, param->name);
     }
-    int is_new;
-    Tcl_HashEntry * entry = Tcl_CreateHashEntry(hdbtcl_state_ptr->open_connections, conn_state_ptr->conn_cmd, &is_new);
-    Tcl_SetHashValue(entry, conn_state_ptr->conn_cmd);
+    Recorder_Write(REC_DESCRIBE_BIND_PARAM, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
 
-    Tcl_SetObjResult(interp, Tcl_NewStringObj(name, name_len));
-    return TCL_OK;
+static dbcapi_bool
+Rec_bind_param (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_data * param)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.bind_param(stmt, index, param);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, index);
+    Recorder_PutU32(&buf, param->direction);
+    if ( param->direction == DD_OUTPUT ) {
+        // output buffers have no data yet
+        dbcapi_data_value value = param->value;
+        value.buffer = NULL;
+        Recorder_PutValue(&buf, &value);
+    } else {
+        Recorder_PutValue(&buf, &param->value);
+    }
+    Recorder_Write(REC_BIND_PARAM, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
 
-Error_Exit:
-    Conn_DeleteState(conn_state_ptr, interp);
-    return TCL_ERROR;
+static dbcapi_bool
+Rec_get_bind_param_info (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_param_info * info)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.get_bind_param_info(stmt, index, info);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, index);
+    if ( rc ) {
+        Recorder_PutString(&buf, info->name);
+        Recorder_PutU32(&buf, info->direction);
+        Recorder_PutU32(&buf, info->native_type);
+        Recorder_PutU32(&buf, info->precision);
+        Recorder_PutU32(&buf, info->scale);
+        Recorder_PutU64(&buf, info->max_size);
+        Recorder_PutU32(&buf, info->input_value.type);
+        Recorder_PutU64(&buf, info->input_value.buffer_size);
+        if ( info->direction == DD_INPUT || info->output_value.length == NULL ) {
+            dbcapi_data_value value = info->output_value;
+            value.buffer = NULL;
+            Recorder_PutValue(&buf, &value);
+        } else {
+            Recorder_PutValue(&buf, &info->output_value);
+        }
+    }
+    Recorder_Write(REC_GET_BIND_PARAM_INFO, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
 }
 
-/**
- * Implements the "hdb" command.
- *
- * "hdb" is a subcommand multiplexor. However, at the moment the only available subcommand is "connect".
- */
-static int
-Hdb_Cmd (Hdbtcl_State * hdbtcl_state_ptr, Tcl_Interp * interp, int objc, Tcl_Obj * const objv[])
+static dbcapi_bool
+Rec_send_param_data (dbcapi_stmt * stmt, dbcapi_u32 index, char * buffer, size_t size)
 {
-    if ( objc < 2 ) {
-        Tcl_WrongNumArgs(interp, objc, objv, "method ?option...?");
-        return TCL_ERROR;
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.send_param_data(stmt, index, buffer, size);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, index);
+    Recorder_PutU64(&buf, size);
+    Recorder_Write(REC_SEND_PARAM_DATA, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_i32
+Rec_get_param_data (dbcapi_stmt * stmt, dbcapi_u32 index, size_t offset, void * buffer, size_t size)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_i32 rc = recorded_dbcapi.get_param_data(stmt, index, offset, buffer, size);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, index);
+    Recorder_PutU64(&buf, offset);
+    Recorder_PutU64(&buf, size);
+    Recorder_PutBytes(&buf, rc > 0 ? buffer : NULL, rc > 0 ? rc : 0);
+    Recorder_Write(REC_GET_PARAM_DATA, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_bool
+Rec_finish_param_data (dbcapi_stmt * stmt, dbcapi_u32 index)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.finish_param_data(stmt, index);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, index);
+    Recorder_Write(REC_FINISH_PARAM_DATA, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_bool
+Rec_get_column (dbcapi_stmt * stmt, dbcapi_u32 col_index, dbcapi_data_value * value)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.get_column(stmt, col_index, value);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, col_index);
+    if ( rc ) {
+        Recorder_PutValue(&buf, value);
     }
+    Recorder_Write(REC_GET_COLUMN, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
 
-    static const char * const methods[] = {
-        "connect", NULL
-    };
-    enum {
-        CONNECT
-    } method;
+static dbcapi_bool
+Rec_get_column_info (dbcapi_stmt * stmt, dbcapi_u32 col_index, dbcapi_column_info * info)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_bool rc = recorded_dbcapi.get_column_info(stmt, col_index, info);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, col_index);
+    if ( rc ) {
+        Recorder_PutString(&buf, info->name);
+        Recorder_PutU32(&buf, info->type);
+        Recorder_PutU32(&buf, info->native_type);
+        Recorder_PutU32(&buf, info->precision);
+        Recorder_PutU32(&buf, info->scale);
+        Recorder_PutU64(&buf, info->max_size);
+        Recorder_PutU8(&buf, info->nullable);
+        Recorder_PutString(&buf, info->table_name);
+        Recorder_PutString(&buf, info->owner_name);
+        Recorder_PutU8(&buf, info->is_case_sensitive);
+        Recorder_PutString(&buf, info->column_name);
+        Recorder_PutU8(&buf, info->is_signed);
+        Recorder_PutU8(&buf, info->is_autoincrement);
+    }
+    Recorder_Write(REC_GET_COLUMN_INFO, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
 
-    if ( Tcl_GetIndexFromObj(interp, objv[1], methods, "method", 0, (int *) &method) != TCL_OK ) {
-        return TCL_ERROR;
+static dbcapi_i32
+Rec_get_data (dbcapi_stmt * stmt, dbcapi_u32 col_index, size_t offset, void * buffer, size_t size)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_i32 rc = recorded_dbcapi.get_data(stmt, col_index, offset, buffer, size);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, col_index);
+    Recorder_PutU64(&buf, offset);
+    Recorder_PutU64(&buf, size);
+    Recorder_PutBytes(&buf, rc > 0 ? buffer : NULL, rc > 0 ? rc : 0);
+    Recorder_Write(REC_GET_DATA, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+static dbcapi_retcode
+Rec_get_print_line (dbcapi_stmt * stmt, const dbcapi_i32 host_type, void * buffer, size_t * length_indicator, size_t buffer_size, const dbcapi_bool terminate)
+{
+    Tcl_WideInt started = GetMonotonicTime();
+    dbcapi_retcode rc = recorded_dbcapi.get_print_line(stmt, host_type, buffer, length_indicator, buffer_size, terminate);
+    Recorder_Buffer buf;
+    Recorder_Init(&buf);
+    Recorder_PutU32(&buf, host_type);
+    Recorder_PutU64(&buf, buffer_size);
+    Recorder_PutU8(&buf, terminate);
+    bool has_data = rc == DBCAPI_OK || rc == DBCAPI_DATA_TRUNC;
+    size_t length = has_data && length_indicator != NULL ? *length_indicator : 0;
+    Recorder_PutU64(&buf, length);
+    Recorder_PutBytes(&buf, has_data ? buffer : NULL, length < buffer_size ? length : buffer_size);
+    Recorder_Write(REC_GET_PRINT_LINE, stmt, started, GetMonotonicTime() - started, rc, &buf);
+    return rc;
+}
+
+/**
+ * Routes DBCAPI calls through the recording wrappers if the recording is requested.
+ */
+static bool
+Recorder_Install (const char * file_name)
+{
+    if ( file_name == NULL || file_name[0] == '\0' ) {
+        return true;
     }
-    switch ( method ) {
-        case CONNECT:
-            return Hdb_Connect(hdbtcl_state_ptr, interp, objc - 2, objv + 2);
+    recorder_file = fopen(file_name, "wb");
+    if ( recorder_file == NULL ) {
+        return false;
     }
-    return TCL_OK;
+    setvbuf(recorder_file, NULL, _IOFBF, 1 << 20);
+    fwrite(RECORDER_SIGNATURE, 8, 1, recorder_file);
+    recorder_started = GetMonotonicTime();
+    recorded_dbcapi = dbcapi;
+
+#define RECORD_FN( sym ) dbcapi.sym = Rec_##sym
+    RECORD_FN( init );
+    RECORD_FN( fini );
+    RECORD_FN( new_connection );
+    RECORD_FN( free_connection );
+    RECORD_FN( connect2 );
+    RECORD_FN( disconnect );
+    RECORD_FN( set_connect_property );
+    RECORD_FN( set_clientinfo );
+    RECORD_FN( get_clientinfo );
+    RECORD_FN( set_transaction_isolation );
+    RECORD_FN( set_autocommit );
+    RECORD_FN( get_autocommit );
+    RECORD_FN( commit );
+    RECORD_FN( rollback );
+    RECORD_FN( error_length );
+    RECORD_FN( error );
+    RECORD_FN( prepare );
+    RECORD_FN( reset );
+    RECORD_FN( free_stmt );
+    RECORD_FN( num_params );
+    RECORD_FN( describe_bind_param );
+    RECORD_FN( bind_param );
+    RECORD_FN( get_bind_param_info );
+    RECORD_FN( send_param_data );
+    RECORD_FN( get_param_data );
+    RECORD_FN( finish_param_data );
+    RECORD_FN( execute );
+    RECORD_FN( fetch_next );
+    RECORD_FN( get_next_result );
+    RECORD_FN( affected_rows );
+    RECORD_FN( num_cols );
+    RECORD_FN( num_rows );
+    RECORD_FN( get_column );
+    RECORD_FN( get_column_info );
+    RECORD_FN( get_data );
+    RECORD_FN( get_print_line );
+    RECORD_FN( execute_direct );
+    RECORD_FN( execute_immediate );
+    RECORD_FN( cancel );
+#undef RECORD_FN
+    // array binding is not recorded, so executemany executes argument lists one by one while recording
+    dbcapi.set_batch_size = NULL;
+    dbcapi.set_param_bind_type = NULL;
+    return true;
 }
 
 /**
- * Module state when loaded into the main interpreter.
- *
- * This one is needed to create a single DBCAPI cleanup point.
+ * DBCAPI is initialized when the first interpreter - in any thread - loads the module and it is
+ * finalized when the last interpreter that uses the module is deleted.
  */
-typedef struct hdbtcl_main_state {
-    Hdbtcl_State *  hdbtcl_state_ptr;
-    Tcl_Interp *    main_interp;
-} Hdbtcl_MainState;
+TCL_DECLARE_MUTEX(dbcapi_lock)
+static int dbcapi_refs = 0;
 
 /**
- * Possible types of exit handlers.
+ * Loads and initializes DBCAPI if this is the first reference to it.
  */
-static enum ExitHandlerState {
-    NONE,       /// exit handler has not been set up yet
-    INTERP,     /// module was loaded into the slave interpreter and the cleanup will happen when the latter terminates
-    MAIN        /// module was loaded into the main interpreter and cleanup will run when main interpreter exits
-} exit_handler_state = NONE;
+static int
+Hdbtcl_AcquireDbcapi (Tcl_Interp * interp)
+{
+    int res = TCL_OK;
+    Tcl_MutexLock(&dbcapi_lock);
+    if ( dbcapi.init == NULL && !init_dbcapi( getenv("HDBCAPILIB") ) ) {
+        Tcl_SetResult(interp, "Cannot load DBCAPI library", TCL_STATIC);
+        res = TCL_ERROR;
+    } else if ( recorder_file == NULL && !Recorder_Install( getenv("HDBCAPIRECORD") ) ) {
+        Tcl_SetResult(interp, "Cannot create DBCAPI recording file", TCL_STATIC);
+        res = TCL_ERROR;
+    } else if ( dbcapi_refs == 0 && !dbcapi.init("TCL", _DBCAPI_VERSION, NULL) ) {
+        Tcl_SetResult(interp, "DBCAPI initialization failed", TCL_STATIC);
+        res = TCL_ERROR;
+    } else {
+        ++dbcapi_refs;
+    }
+    Tcl_MutexUnlock(&dbcapi_lock);
+    return res;
+}
 
 /**
- * Module cleanup.
- *
- * Disposes of the module state and releases DBCAPI resources.
+ * Releases the reference to DBCAPI. Finalizes DBCAPI when the last reference is released.
  */
 static void
-Hdbtcl_Finalize (Hdbtcl_MainState * main_state_ptr)
+Hdbtcl_ReleaseDbcapi ()
 {
-    if ( main_state_ptr != NULL ) {
-        Hdbtcl_DeleteState(main_state_ptr->hdbtcl_state_ptr, main_state_ptr->main_interp);
-        ckfree(main_state_ptr);
+    Tcl_MutexLock(&dbcapi_lock);
+    if ( --dbcapi_refs == 0 ) {
+        Watchdog_Shutdown();
+        dbcapi.fini();
     }
-    dbcapi.fini();
+    Tcl_MutexUnlock(&dbcapi_lock);
+}
+
+static void Hdbtcl_ThreadExit (ClientData client_data);
+
+/**
+ * Module cleanup when the interpreter that loaded the module is deleted.
+ */
+static void
+Hdbtcl_InterpDeleted (ClientData client_data, Tcl_Interp * interp)
+{
+    Tcl_DeleteThreadExitHandler(Hdbtcl_ThreadExit, client_data);
+    Hdbtcl_DeleteState((Hdbtcl_State *) client_data, interp);
+    Hdbtcl_ReleaseDbcapi();
+}
+
+/**
+ * Module cleanup when the thread exits before the interpreter that loaded the module is deleted.
+ * This is what usually happens to the main interpreter when the application exits.
+ */
+static void
+Hdbtcl_ThreadExit (ClientData client_data)
+{
+    Hdbtcl_State * hdbtcl_state_ptr = (Hdbtcl_State *) client_data;
+    Tcl_Interp * interp = hdbtcl_state_ptr->interp;
+    Tcl_DontCallWhenDeleted(interp, Hdbtcl_InterpDeleted, client_data);
+    Hdbtcl_DeleteState(hdbtcl_state_ptr, interp);
+    Hdbtcl_ReleaseDbcapi();
 }
 
 /**
  * Extension initialization entry.
  *
  * Initializes DBCAPI and the module state (mainly to track open connections).
- * Sets up state cleanup to run upon - main or slave - interpreter exit.
+ * Sets up state cleanup to run when the interpreter is deleted or when its thread exits,
+ * whichever happens first.
+ *
+ * \note The module state belongs to the interpreter and thus to the thread that loaded the module.
+ * Connections, statements and pools can only be used by the interpreter that created them.
  */
 int DLLEXPORT
 Hdbtcl_Init (Tcl_Interp * interp)
@@ -2250,40 +10980,17 @@ Hdbtcl_Init (Tcl_Interp * interp)
         return TCL_ERROR;
     }
 #endif
-    if ( dbcapi.init == NULL ) {
-        if ( !init_dbcapi( getenv("HDBCAPILIB") ) ) {
-            Tcl_SetResult(interp, "Cannot load DBCAPI library", TCL_STATIC);
-            return TCL_ERROR;
-        }
-    }
-
-    if ( !dbcapi.init("TCL", _DBCAPI_VERSION, NULL) ) {
-        Tcl_SetResult(interp, "DBCAPI initialization failed", TCL_STATIC);
+    if ( Hdbtcl_AcquireDbcapi(interp) != TCL_OK ) {
         return TCL_ERROR;
     }
 
     Hdbtcl_State * hdbtcl_state_ptr = Hdbtcl_InitState(interp);
     if ( hdbtcl_state_ptr == NULL ) {
+        Hdbtcl_ReleaseDbcapi();
         return TCL_ERROR;
     }
+    Tcl_CallWhenDeleted(interp, Hdbtcl_InterpDeleted, (ClientData) hdbtcl_state_ptr);
+    Tcl_CreateThreadExitHandler(Hdbtcl_ThreadExit, (ClientData) hdbtcl_state_ptr);
 
-    Tcl_Obj * argc = Tcl_GetVar2Ex(interp, "argc", NULL, TCL_GLOBAL_ONLY);
-    if ( argc == NULL ) {
-        Tcl_CallWhenDeleted(interp, (Tcl_InterpDeleteProc *) Hdbtcl_DeleteState, (ClientData) hdbtcl_state_ptr);
-        if ( exit_handler_state == NONE ) {
-            Tcl_CreateExitHandler((Tcl_ExitProc *) Hdbtcl_Finalize, NULL);
-            exit_handler_state = INTERP;
-        }
-    } else {
-        Tcl_DecrRefCount(argc);
-        if ( exit_handler_state == INTERP ) {
-            Tcl_DeleteExitHandler((Tcl_ExitProc *) Hdbtcl_Finalize, NULL);
-        }
-        exit_handler_state = MAIN;
-        Hdbtcl_MainState * main_state_ptr = ckalloc(sizeof(Hdbtcl_MainState));
-        main_state_ptr->hdbtcl_state_ptr = hdbtcl_state_ptr;
-        main_state_ptr->main_interp = interp;
-        Tcl_CreateExitHandler((Tcl_ExitProc *) Hdbtcl_Finalize, (ClientData) main_state_ptr);
-    }
     return Tcl_PkgProvide(interp, "hdbtcl", "1.0");
 }
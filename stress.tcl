@@ -0,0 +1,126 @@
+##
+# Multi-thread stress test.
+#
+# Runs hdbtcl in several Tcl threads at the same time. It is meant to be run against the stub
+# DBCAPI library (see stub/dbcapi_stub.c), which aborts the process when a connection is used by
+# two threads at the same time or when DBCAPI is used while it is not initialized:
+#
+#   HDBCAPILIB=/path/to/libdbcapistub.so DBCAPI_STUB_CHECK_FINI=1 tclsh stress.tcl ?num_threads? ?num_rounds?
+##
+lassign $::argv num_threads num_rounds
+if { $num_threads == "" } {
+    set num_threads 8
+}
+if { $num_rounds == "" } {
+    set num_rounds 4
+}
+
+package require Thread
+
+lappend ::auto_path [pwd]
+
+# Work that each thread does. Returns the number of fetched rows.
+set worker_script {
+    proc async_done { status result } {
+        set ::async_result [list $status $result]
+    }
+
+    proc run { auto_path num_iterations } {
+        set ::auto_path $auto_path
+        package require hdbtcl
+
+        set num_rows 0
+        set pool [hdb pool create -serverNode stub -minsize 1 -maxsize 2 -healthcheck 0]
+        for { set i 0 } { $i < $num_iterations } { incr i } {
+            set conn [hdb connect -serverNode stub]
+            set stmt [$conn prepare "SELECT rows=100 cols=int,bigint,double,varchar,nvarchar,varbinary,timestamp,clob nulls=7"]
+            $stmt execute
+            while { [$stmt fetch row] } {
+                incr num_rows
+            }
+            $stmt execute -async -command async_done
+            vwait ::async_result
+            if { [lindex $::async_result 0] != "ok" } {
+                error "async execute failed: $::async_result"
+            }
+            $stmt fetchmany -async 1000 -command async_done
+            vwait ::async_result
+            incr num_rows [llength [lindex $::async_result 1]]
+
+            set ins [$conn prepare "INSERT INTO t VALUES (?, ?) params=int,nvarchar"]
+            $ins execute $i "row $i"
+            $conn commit
+            $conn close
+
+            set pconn [$pool checkout]
+            set pstmt [$pconn query "SELECT rows=10 cols=int,varchar"]
+            incr num_rows [llength [$pstmt fetchmany 100]]
+            $pconn close
+        }
+        $pool close
+        return $num_rows
+    }
+}
+
+set failures 0
+
+proc report { msg ok } {
+    puts [format "  %-62s%s" $msg [expr { $ok ? "OK" : "FAIL" }]]
+    if { !$ok } {
+        incr ::failures
+    }
+}
+
+puts "Multi-thread stress test: $num_threads threads, $num_rounds rounds"
+
+# The main interpreter keeps a reference to DBCAPI while worker threads come and go
+package require hdbtcl
+set main_conn [hdb connect -serverNode stub]
+
+for { set round 1 } { $round <= $num_rounds } { incr round } {
+    set threads {}
+    for { set t 0 } { $t < $num_threads } { incr t } {
+        set tid [thread::create -joinable]
+        thread::send $tid $worker_script
+        thread::send -async $tid [list run $::auto_path 20] results($tid)
+        lappend threads $tid
+    }
+    set ok 1
+    foreach tid $threads {
+        if { ![info exists results($tid)] } {
+            vwait results($tid)
+        }
+        if { $results($tid) != 20 * (100 + 100 + 10) } {
+            puts "    thread $tid: $results($tid)"
+            set ok 0
+        }
+        thread::release $tid
+        thread::join $tid
+    }
+    array unset results
+    report "round $round: threads can use their own connections" $ok
+}
+
+# Threads that load the module and exit without deleting their interpreters explicitly
+set threads {}
+for { set t 0 } { $t < $num_threads } { incr t } {
+    set tid [thread::create -joinable]
+    thread::send $tid [list set ::auto_path $::auto_path]
+    thread::send $tid {
+        package require hdbtcl
+        set conn [hdb connect -serverNode stub]
+        set stmt [$conn execute "SELECT rows=10 sleep=10"]
+    }
+    lappend threads $tid
+}
+foreach tid $threads {
+    thread::release $tid
+    thread::join $tid
+}
+set stmt [$main_conn query "SELECT rows=3"]
+report "main connection is usable after threads exit" [expr { [llength [$stmt fetchmany 10]] == 3 }]
+
+$main_conn close
+if { $failures > 0 } {
+    exit 1
+}
@@ -0,0 +1,935 @@
+/**
+ * DBCAPI replay library.
+ *
+ * Serves DBCAPI calls from a recording that `hdbtcl` made when `HDBCAPIRECORD` named the recording
+ * file. The recording is read from the file named by `DBCAPI_REPLAY` when DBCAPI is initialized.
+ * When `DBCAPI_REPLAY_TIMING` is set, every replayed call takes as long as the recorded one did.
+ *
+ * Recorded connections are handed out in the order they were created. Statements are matched by
+ * their SQL text among the statements the connection prepared. Calls made with a connection or a
+ * statement are matched to its recorded calls in order:
+ *  - calls that change the state of a statement (execute, fetch_next, get_next_result and reset)
+ *    are matched by the next recorded call only. When the next recorded state change is a
+ *    different call, the call fails (fetch_next returns "no more rows").
+ *  - other calls are matched by the next recorded call of the same function with the same key
+ *    arguments (column or parameter index, LOB offset, property name or SQL text) that is not
+ *    past the next recorded state change, or, if there is none, by the most recent matching call.
+ * Calls that cannot be matched fail with the "call was not recorded" error. `dbcapi_cancel` is
+ * always successful and does nothing.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <DBCAPI.h>
+
+#define REPLAY_SIGNATURE    "HDBREC\x01\n"
+#define REPLAY_NULL_LENGTH  0xFFFFFFFFu
+#define REPLAY_HEADER_SIZE  40
+
+/* Recorded functions. The order matches the order of functions in the hdbtcl `dbcapi` table. */
+enum {
+    REC_INIT, REC_FINI, REC_NEW_CONNECTION, REC_FREE_CONNECTION, REC_CONNECT2, REC_DISCONNECT,
+    REC_SET_CONNECT_PROPERTY, REC_SET_CLIENTINFO, REC_GET_CLIENTINFO, REC_SET_TRANSACTION_ISOLATION,
+    REC_SET_AUTOCOMMIT, REC_GET_AUTOCOMMIT, REC_COMMIT, REC_ROLLBACK, REC_ERROR_LENGTH, REC_ERROR,
+    REC_PREPARE, REC_RESET, REC_FREE_STMT, REC_NUM_PARAMS, REC_DESCRIBE_BIND_PARAM, REC_BIND_PARAM,
+    REC_GET_BIND_PARAM_INFO, REC_SEND_PARAM_DATA, REC_GET_PARAM_DATA, REC_FINISH_PARAM_DATA, REC_EXECUTE,
+    REC_FETCH_NEXT, REC_GET_NEXT_RESULT, REC_AFFECTED_ROWS, REC_NUM_COLS, REC_NUM_ROWS, REC_GET_COLUMN,
+    REC_GET_COLUMN_INFO, REC_GET_DATA, REC_GET_PRINT_LINE, REC_EXECUTE_DIRECT, REC_EXECUTE_IMMEDIATE, REC_CANCEL,
+    REC_NUM_FUNCTIONS
+};
+
+typedef struct replay_record {
+    int                 func;
+    uint64_t            handle;
+    uint64_t            elapsed;
+    int64_t             result;
+    const uint8_t *     payload;
+    uint32_t            payload_length;
+    int                 child;          /// object that prepare and execute_direct created
+} Replay_Record;
+
+/* Recorded connection or statement */
+typedef struct replay_object {
+    int                 is_stmt;
+    int *               records;
+    int                 num_records;
+    int                 max_records;
+} Replay_Object;
+
+/* Payload reader */
+typedef struct replay_reader {
+    const uint8_t *     data;
+    const uint8_t *     end;
+} Replay_Reader;
+
+typedef struct replay_column {
+    char *              name;
+    char *              table_name;
+    char *              owner_name;
+    char *              column_name;
+    size_t              length;
+    dbcapi_bool         is_null;
+} Replay_Column;
+
+typedef struct replay_param {
+    char *              name;
+    dbcapi_bind_data    bind;
+} Replay_Param;
+
+/* Replayed handle */
+typedef struct replay_handle {
+    dbcapi_connection * conn;
+    int                 obj;
+    int                 pos;            /// index of the next recorded call of the object
+} Replay_Handle;
+
+struct dbcapi_connection {
+    Replay_Handle       handle;
+    int                 error_code;
+    char                error_msg[256];
+    char *              clientinfo;
+};
+
+struct dbcapi_stmt {
+    Replay_Handle       handle;
+    Replay_Column *     cols;
+    int                 num_cols;
+    Replay_Param *      params;
+    int                 num_params;
+};
+
+static pthread_mutex_t replay_lock = PTHREAD_MUTEX_INITIALIZER;
+static int init_count;
+static uint8_t * trace_data;
+static Replay_Record * records;
+static int num_records;
+static Replay_Object * objects;
+static int num_objects;
+static int * connections;       /// recorded connections in the order they were created
+static int num_connections;
+static int next_connection;
+static int replay_timing;
+
+static uint32_t
+read_u32 (Replay_Reader * r)
+{
+    uint32_t v = 0;
+    if ( r->end - r->data >= 4 ) {
+        memcpy(&v, r->data, 4);
+        r->data += 4;
+    }
+    return v;
+}
+
+static uint64_t
+read_u64 (Replay_Reader * r)
+{
+    uint64_t v = 0;
+    if ( r->end - r->data >= 8 ) {
+        memcpy(&v, r->data, 8);
+        r->data += 8;
+    }
+    return v;
+}
+
+static uint8_t
+read_u8 (Replay_Reader * r)
+{
+    uint8_t v = 0;
+    if ( r->data < r->end ) {
+        v = *r->data++;
+    }
+    return v;
+}
+
+/**
+ * Reads the byte string. Returns NULL if the recorded string was NULL.
+ */
+static const uint8_t *
+read_bytes (Replay_Reader * r, uint32_t * length)
+{
+    *length = read_u32(r);
+    if ( *length == REPLAY_NULL_LENGTH || (size_t) ( r->end - r->data ) < *length ) {
+        *length = 0;
+        return NULL;
+    }
+    const uint8_t * data = r->data;
+    r->data += *length;
+    return data;
+}
+
+/**
+ * Reads the string into the allocated buffer, which replaces the previous one.
+ */
+static char *
+read_string (Replay_Reader * r, char ** str_ptr)
+{
+    uint32_t length;
+    const uint8_t * data = read_bytes(r, &length);
+    free(*str_ptr);
+    *str_ptr = NULL;
+    if ( data != NULL ) {
+        *str_ptr = malloc(length + 1);
+        memcpy(*str_ptr, data, length);
+        (*str_ptr)[length] = '\0';
+    }
+    return *str_ptr;
+}
+
+static void
+set_error (dbcapi_connection * conn, int code, const char * msg)
+{
+    conn->error_code = code;
+    snprintf(conn->error_msg, sizeof(conn->error_msg), "%s", msg);
+}
+
+static int
+new_object (int is_stmt)
+{
+    if ( ( num_objects & 255 ) == 0 ) {
+        objects = realloc(objects, sizeof(Replay_Object) * ( num_objects + 256 ));
+    }
+    memset(&objects[num_objects], 0, sizeof(Replay_Object));
+    objects[num_objects].is_stmt = is_stmt;
+    return num_objects++;
+}
+
+static void
+add_record (int obj, int rec)
+{
+    Replay_Object * o = &objects[obj];
+    if ( o->num_records == o->max_records ) {
+        o->max_records = o->max_records ? o->max_records * 2 : 64;
+        o->records = realloc(o->records, sizeof(int) * o->max_records);
+    }
+    o->records[o->num_records++] = rec;
+}
+
+/* Recorded handles that are in use while the recording is loaded */
+typedef struct live_handle {
+    uint64_t            handle;
+    int                 obj;
+} Live_Handle;
+
+static int
+find_live (Live_Handle * live, int num_live, uint64_t handle)
+{
+    for ( int i = num_live - 1; i >= 0; i-- ) {
+        if ( live[i].handle == handle ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Loads the recording and sorts recorded calls by the objects they used.
+ */
+static int
+load_trace (const char * file_name)
+{
+    FILE * f = file_name != NULL ? fopen(file_name, "rb") : NULL;
+    if ( f == NULL ) {
+        fprintf(stderr, "dbcapi replay: cannot open recording %s\n", file_name != NULL ? file_name : "(DBCAPI_REPLAY is not set)");
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    trace_data = malloc(size > 0 ? size : 1);
+    if ( size < 8 || fread(trace_data, 1, size, f) != (size_t) size || memcmp(trace_data, REPLAY_SIGNATURE, 8) != 0 ) {
+        fprintf(stderr, "dbcapi replay: %s is not a DBCAPI recording\n", file_name);
+        fclose(f);
+        return 0;
+    }
+    fclose(f);
+
+    Live_Handle * live = NULL;
+    int num_live = 0;
+    int max_records = 0;
+    for ( long pos = 8; pos + REPLAY_HEADER_SIZE <= size; ) {
+        const uint8_t * header = trace_data + pos;
+        uint32_t payload_length;
+        memcpy(&payload_length, header + 4, 4);
+        if ( pos + REPLAY_HEADER_SIZE + payload_length > (unsigned long) size ) {
+            break;  // incomplete record at the end of the recording
+        }
+        if ( num_records == max_records ) {
+            max_records = max_records ? max_records * 2 : 1024;
+            records = realloc(records, sizeof(Replay_Record) * max_records);
+        }
+        Replay_Record * rec = &records[num_records];
+        rec->func = header[0];
+        memcpy(&rec->handle, header + 8, 8);
+        memcpy(&rec->elapsed, header + 24, 8);
+        memcpy(&rec->result, header + 32, 8);
+        rec->payload = header + REPLAY_HEADER_SIZE;
+        rec->payload_length = payload_length;
+        rec->child = -1;
+        pos += REPLAY_HEADER_SIZE + payload_length;
+
+        int obj = -1;
+        int idx = find_live(live, num_live, rec->handle);
+        if ( idx >= 0 ) {
+            obj = live[idx].obj;
+        }
+        int new_handle = 0;
+        switch ( rec->func ) {
+            case REC_INIT:
+            case REC_FINI:
+                break;
+            case REC_NEW_CONNECTION:
+                if ( rec->result != 0 ) {
+                    rec->child = new_object(0);
+                    connections = realloc(connections, sizeof(int) * ( num_connections + 1 ));
+                    connections[num_connections++] = rec->child;
+                    new_handle = 1;
+                }
+                break;
+            case REC_PREPARE:
+            case REC_EXECUTE_DIRECT:
+                if ( rec->result != 0 ) {
+                    rec->child = new_object(1);
+                    new_handle = 1;
+                }
+                break;
+        }
+        if ( obj >= 0 && rec->func != REC_NEW_CONNECTION ) {
+            add_record(obj, num_records);
+        }
+        if ( rec->func == REC_FREE_CONNECTION || rec->func == REC_FREE_STMT ) {
+            if ( idx >= 0 ) {
+                live[idx] = live[--num_live];
+            }
+        }
+        if ( new_handle ) {
+            int old = find_live(live, num_live, (uint64_t) rec->result);
+            if ( old >= 0 ) {
+                live[old] = live[--num_live];   // the freed handle was not recorded
+            }
+            live = realloc(live, sizeof(Live_Handle) * ( num_live + 1 ));
+            live[num_live].handle = (uint64_t) rec->result;
+            live[num_live].obj = rec->child;
+            num_live++;
+        }
+        num_records++;
+    }
+    free(live);
+    return 1;
+}
+
+static void
+free_trace ()
+{
+    for ( int i = 0; i < num_objects; i++ ) {
+        free(objects[i].records);
+    }
+    free(objects);
+    free(connections);
+    free(records);
+    free(trace_data);
+    objects = NULL;
+    connections = NULL;
+    records = NULL;
+    trace_data = NULL;
+    num_objects = num_connections = num_records = next_connection = 0;
+}
+
+static int
+is_state_change (int func)
+{
+    return func == REC_EXECUTE || func == REC_FETCH_NEXT || func == REC_GET_NEXT_RESULT || func == REC_RESET;
+}
+
+/**
+ * Finds the recorded call that matches the call that is being replayed. The key is the encoded
+ * beginning of the payload that identifies the call.
+ */
+static Replay_Record *
+find_record (Replay_Handle * h, int func, const void * key, size_t key_length)
+{
+    if ( h->obj < 0 ) {
+        return NULL;
+    }
+    Replay_Object * o = &objects[h->obj];
+    for ( int i = h->pos; i < o->num_records; i++ ) {
+        Replay_Record * rec = &records[o->records[i]];
+        if ( rec->func == func && rec->payload_length >= key_length && memcmp(rec->payload, key, key_length) == 0 ) {
+            h->pos = i + 1;
+            return rec;
+        }
+        if ( is_state_change(rec->func) || is_state_change(func) ) {
+            break;
+        }
+    }
+    if ( is_state_change(func) ) {
+        return NULL;
+    }
+    for ( int i = h->pos - 1; i >= 0; i-- ) {
+        Replay_Record * rec = &records[o->records[i]];
+        if ( rec->func == func && rec->payload_length >= key_length && memcmp(rec->payload, key, key_length) == 0 ) {
+            return rec;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Encodes the string the same way it is recorded.
+ */
+static size_t
+string_key (char * key, size_t key_size, const char * str)
+{
+    uint32_t length = (uint32_t) strlen(str);
+    if ( 4 + length > key_size ) {
+        return 0;
+    }
+    memcpy(key, &length, 4);
+    memcpy(key + 4, str, length);
+    return 4 + length;
+}
+
+static Replay_Record *
+replay_call (Replay_Handle * h, int func, const void * key, size_t key_length, Replay_Reader * r)
+{
+    pthread_mutex_lock(&replay_lock);
+    Replay_Record * rec = find_record(h, func, key, key_length);
+    pthread_mutex_unlock(&replay_lock);
+    if ( rec == NULL ) {
+        if ( h->conn != NULL && func != REC_FETCH_NEXT ) {
+            set_error(h->conn, -20000, "call was not recorded");
+        }
+        return NULL;
+    }
+    if ( replay_timing && rec->elapsed > 0 ) {
+        struct timespec ts = { (time_t) ( rec->elapsed / 1000000000 ), (long) ( rec->elapsed % 1000000000 ) };
+        while ( nanosleep(&ts, &ts) != 0 && errno == EINTR ) {}
+    }
+    if ( r != NULL ) {
+        r->data = rec->payload + key_length;
+        r->end = rec->payload + rec->payload_length;
+    }
+    return rec;
+}
+
+static int64_t
+replay_handle_call (Replay_Handle * h, int func, int64_t failed)
+{
+    Replay_Record * rec = replay_call(h, func, NULL, 0, NULL);
+    return rec != NULL ? rec->result : failed;
+}
+
+dbcapi_bool
+dbcapi_init (const char * app_name, dbcapi_u32 api_version, dbcapi_u32 * version_available)
+{
+    if ( version_available != NULL ) *version_available = _DBCAPI_VERSION;
+    pthread_mutex_lock(&replay_lock);
+    int ok = 1;
+    if ( init_count == 0 ) {
+        replay_timing = getenv("DBCAPI_REPLAY_TIMING") != NULL;
+        ok = load_trace(getenv("DBCAPI_REPLAY"));
+        if ( !ok ) {
+            free_trace();
+        }
+    }
+    if ( ok ) {
+        init_count++;
+    }
+    pthread_mutex_unlock(&replay_lock);
+    return ok;
+}
+
+void
+dbcapi_fini ()
+{
+    pthread_mutex_lock(&replay_lock);
+    if ( init_count > 0 && --init_count == 0 ) {
+        free_trace();
+    }
+    pthread_mutex_unlock(&replay_lock);
+}
+
+dbcapi_connection *
+dbcapi_new_connection ()
+{
+    dbcapi_connection * conn = calloc(1, sizeof(dbcapi_connection));
+    conn->handle.conn = conn;
+    pthread_mutex_lock(&replay_lock);
+    conn->handle.obj = next_connection < num_connections ? connections[next_connection++] : -1;
+    pthread_mutex_unlock(&replay_lock);
+    return conn;
+}
+
+void
+dbcapi_free_connection (dbcapi_connection * conn)
+{
+    free(conn->clientinfo);
+    free(conn);
+}
+
+dbcapi_bool
+dbcapi_connect2 (dbcapi_connection * conn)
+{
+    if ( conn->handle.obj < 0 ) {
+        set_error(conn, -10709, "Connection was not recorded");
+        return 0;
+    }
+    return (dbcapi_bool) replay_handle_call(&conn->handle, REC_CONNECT2, 0);
+}
+
+dbcapi_bool
+dbcapi_disconnect (dbcapi_connection * conn)
+{
+    return (dbcapi_bool) replay_handle_call(&conn->handle, REC_DISCONNECT, 0);
+}
+
+static dbcapi_bool
+replay_property (dbcapi_connection * conn, int func, const char * property)
+{
+    char key[256];
+    size_t key_length = string_key(key, sizeof(key), property);
+    Replay_Record * rec = replay_call(&conn->handle, func, key, key_length, NULL);
+    return rec != NULL ? (dbcapi_bool) rec->result : 0;
+}
+
+dbcapi_bool
+dbcapi_set_connect_property (dbcapi_connection * conn, const char * property, const char * value)
+{
+    return replay_property(conn, REC_SET_CONNECT_PROPERTY, property);
+}
+
+dbcapi_bool
+dbcapi_set_clientinfo (dbcapi_connection * conn, const char * property, const char * value)
+{
+    return replay_property(conn, REC_SET_CLIENTINFO, property);
+}
+
+const char *
+dbcapi_get_clientinfo (dbcapi_connection * conn, const char * property)
+{
+    char key[256];
+    size_t key_length = string_key(key, sizeof(key), property);
+    Replay_Reader r;
+    if ( replay_call(&conn->handle, REC_GET_CLIENTINFO, key, key_length, &r) == NULL ) {
+        return NULL;
+    }
+    return read_string(&r, &conn->clientinfo);
+}
+
+dbcapi_bool
+dbcapi_set_transaction_isolation (dbcapi_connection * conn, dbcapi_u32 isolation_level)
+{
+    return (dbcapi_bool) replay_handle_call(&conn->handle, REC_SET_TRANSACTION_ISOLATION, 0);
+}
+
+dbcapi_bool
+dbcapi_set_autocommit (dbcapi_connection * conn, dbcapi_bool mode)
+{
+    return (dbcapi_bool) replay_handle_call(&conn->handle, REC_SET_AUTOCOMMIT, 0);
+}
+
+dbcapi_bool
+dbcapi_get_autocommit (dbcapi_connection * conn, dbcapi_bool * mode)
+{
+    Replay_Reader r;
+    Replay_Record * rec = replay_call(&conn->handle, REC_GET_AUTOCOMMIT, NULL, 0, &r);
+    if ( rec == NULL ) {
+        return 0;
+    }
+    *mode = (dbcapi_bool) read_u32(&r);
+    return (dbcapi_bool) rec->result;
+}
+
+dbcapi_bool
+dbcapi_commit (dbcapi_connection * conn)
+{
+    return (dbcapi_bool) replay_handle_call(&conn->handle, REC_COMMIT, 0);
+}
+
+dbcapi_bool
+dbcapi_rollback (dbcapi_connection * conn)
+{
+    return (dbcapi_bool) replay_handle_call(&conn->handle, REC_ROLLBACK, 0);
+}
+
+/*
+ * Errors of the calls that were not recorded are reported by the library. Other errors are
+ * replayed.
+ */
+dbcapi_u32
+dbcapi_error_length (dbcapi_connection * conn)
+{
+    if ( conn->error_code != 0 ) {
+        return (dbcapi_u32) strlen(conn->error_msg) + 1;
+    }
+    return (dbcapi_u32) replay_handle_call(&conn->handle, REC_ERROR_LENGTH, 1);
+}
+
+dbcapi_i32
+dbcapi_error (dbcapi_connection * conn, char * buffer, size_t size)
+{
+    if ( conn->error_code != 0 ) {
+        int code = conn->error_code;
+        if ( buffer != NULL && size > 0 ) {
+            snprintf(buffer, size, "%s", conn->error_msg);
+        }
+        conn->error_code = 0;
+        return code;
+    }
+    Replay_Reader r;
+    Replay_Record * rec = replay_call(&conn->handle, REC_ERROR, NULL, 0, &r);
+    if ( buffer != NULL && size > 0 ) {
+        buffer[0] = '\0';
+        if ( rec != NULL ) {
+            uint32_t length;
+            read_u64(&r);
+            const uint8_t * msg = read_bytes(&r, &length);
+            if ( msg != NULL ) {
+                if ( length >= size ) length = (uint32_t) size - 1;
+                memcpy(buffer, msg, length);
+                buffer[length] = '\0';
+            }
+        }
+    }
+    return rec != NULL ? (dbcapi_i32) rec->result : 0;
+}
+
+static dbcapi_stmt *
+replay_prepare (dbcapi_connection * conn, int func, const char * sql)
+{
+    size_t key_size = strlen(sql) + 4;
+    char * key = malloc(key_size);
+    size_t key_length = string_key(key, key_size, sql);
+    Replay_Record * rec = replay_call(&conn->handle, func, key, key_length, NULL);
+    free(key);
+    if ( rec == NULL || rec->result == 0 ) {
+        return NULL;
+    }
+    dbcapi_stmt * stmt = calloc(1, sizeof(dbcapi_stmt));
+    stmt->handle.conn = conn;
+    stmt->handle.obj = rec->child;
+    return stmt;
+}
+
+dbcapi_stmt *
+dbcapi_prepare (dbcapi_connection * conn, const char * sql)
+{
+    return replay_prepare(conn, REC_PREPARE, sql);
+}
+
+dbcapi_stmt *
+dbcapi_execute_direct (dbcapi_connection * conn, const char * sql)
+{
+    return replay_prepare(conn, REC_EXECUTE_DIRECT, sql);
+}
+
+dbcapi_bool
+dbcapi_execute_immediate (dbcapi_connection * conn, const char * sql)
+{
+    size_t key_size = strlen(sql) + 4;
+    char * key = malloc(key_size);
+    size_t key_length = string_key(key, key_size, sql);
+    Replay_Record * rec = replay_call(&conn->handle, REC_EXECUTE_IMMEDIATE, key, key_length, NULL);
+    free(key);
+    return rec != NULL ? (dbcapi_bool) rec->result : 0;
+}
+
+dbcapi_bool
+dbcapi_reset (dbcapi_stmt * stmt)
+{
+    return (dbcapi_bool) replay_handle_call(&stmt->handle, REC_RESET, 0);
+}
+
+void
+dbcapi_free_stmt (dbcapi_stmt * stmt)
+{
+    for ( int i = 0; i < stmt->num_cols; i++ ) {
+        free(stmt->cols[i].name);
+        free(stmt->cols[i].table_name);
+        free(stmt->cols[i].owner_name);
+        free(stmt->cols[i].column_name);
+    }
+    for ( int i = 0; i < stmt->num_params; i++ ) {
+        free(stmt->params[i].name);
+    }
+    free(stmt->cols);
+    free(stmt->params);
+    free(stmt);
+}
+
+dbcapi_i32
+dbcapi_num_params (dbcapi_stmt * stmt)
+{
+    return (dbcapi_i32) replay_handle_call(&stmt->handle, REC_NUM_PARAMS, -1);
+}
+
+static Replay_Param *
+get_param (dbcapi_stmt * stmt, dbcapi_u32 index)
+{
+    if ( index >= (dbcapi_u32) stmt->num_params ) {
+        stmt->params = realloc(stmt->params, sizeof(Replay_Param) * ( index + 1 ));
+        memset(stmt->params + stmt->num_params, 0, sizeof(Replay_Param) * ( index + 1 - stmt->num_params ));
+        stmt->num_params = index + 1;
+    }
+    return &stmt->params[index];
+}
+
+static Replay_Column *
+get_col (dbcapi_stmt * stmt, dbcapi_u32 index)
+{
+    if ( index >= (dbcapi_u32) stmt->num_cols ) {
+        stmt->cols = realloc(stmt->cols, sizeof(Replay_Column) * ( index + 1 ));
+        memset(stmt->cols + stmt->num_cols, 0, sizeof(Replay_Column) * ( index + 1 - stmt->num_cols ));
+        stmt->num_cols = index + 1;
+    }
+    return &stmt->cols[index];
+}
+
+dbcapi_bool
+dbcapi_describe_bind_param (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_data * param)
+{
+    Replay_Reader r;
+    Replay_Record * rec = replay_call(&stmt->handle, REC_DESCRIBE_BIND_PARAM, &index, sizeof(index), &r);
+    if ( rec == NULL || !rec->result ) {
+        return 0;
+    }
+    Replay_Param * p = get_param(stmt, index);
+    memset(param, 0, sizeof(dbcapi_bind_data));
+    param->direction = (dbcapi_data_direction) read_u32(&r);
+    param->value.type = (dbcapi_data_type) read_u32(&r);
+    param->value.buffer_size = (size_t) read_u64(&r);
+    param->name = read_string(&r, &p->name);
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_bind_param (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_data * param)
+{
+    Replay_Record * rec = replay_call(&stmt->handle, REC_BIND_PARAM, &index, sizeof(index), NULL);
+    if ( rec == NULL || !rec->result ) {
+        return 0;
+    }
+    get_param(stmt, index)->bind = *param;
+    return 1;
+}
+
+/**
+ * Reads the recorded value into the value buffers.
+ */
+static void
+read_value (Replay_Reader * r, dbcapi_data_value * value)
+{
+    read_u32(r);    // type
+    read_u64(r);    // buffer size
+    dbcapi_bool is_null = read_u8(r);
+    size_t length = (size_t) read_u64(r);
+    uint32_t data_length;
+    const uint8_t * data = read_bytes(r, &data_length);
+    if ( value->is_null != NULL ) {
+        *value->is_null = is_null;
+    }
+    if ( value->length != NULL ) {
+        *value->length = length;
+    }
+    if ( data != NULL && value->buffer != NULL ) {
+        memcpy(value->buffer, data, data_length < value->buffer_size || value->buffer_size == 0 ? data_length : value->buffer_size);
+    }
+}
+
+dbcapi_bool
+dbcapi_get_bind_param_info (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_param_info * info)
+{
+    Replay_Reader r;
+    Replay_Record * rec = replay_call(&stmt->handle, REC_GET_BIND_PARAM_INFO, &index, sizeof(index), &r);
+    if ( rec == NULL || !rec->result ) {
+        return 0;
+    }
+    Replay_Param * p = get_param(stmt, index);
+    memset(info, 0, sizeof(dbcapi_bind_param_info));
+    info->name = read_string(&r, &p->name);
+    info->direction = (dbcapi_data_direction) read_u32(&r);
+    info->native_type = (dbcapi_native_type) read_u32(&r);
+    info->precision = read_u32(&r);
+    info->scale = read_u32(&r);
+    info->max_size = (size_t) read_u64(&r);
+    info->input_value = p->bind.value;
+    info->input_value.type = (dbcapi_data_type) read_u32(&r);
+    info->input_value.buffer_size = (size_t) read_u64(&r);
+    info->output_value = p->bind.value;
+    if ( info->direction != DD_INPUT ) {
+        // OUT values are written into the buffers the caller bound
+        read_value(&r, &info->output_value);
+    }
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_send_param_data (dbcapi_stmt * stmt, dbcapi_u32 index, char * buffer, size_t size)
+{
+    Replay_Record * rec = replay_call(&stmt->handle, REC_SEND_PARAM_DATA, &index, sizeof(index), NULL);
+    return rec != NULL ? (dbcapi_bool) rec->result : 0;
+}
+
+/**
+ * Replays a LOB read. Returns the number of bytes copied into the buffer.
+ */
+static dbcapi_i32
+replay_read (dbcapi_stmt * stmt, int func, dbcapi_u32 index, size_t offset, void * buffer, size_t size)
+{
+    uint8_t key[12];
+    uint64_t key_offset = offset;
+    memcpy(key, &index, 4);
+    memcpy(key + 4, &key_offset, 8);
+    Replay_Reader r;
+    Replay_Record * rec = replay_call(&stmt->handle, func, key, sizeof(key), &r);
+    if ( rec == NULL ) {
+        return -1;
+    }
+    read_u64(&r);
+    uint32_t length;
+    const uint8_t * data = read_bytes(&r, &length);
+    if ( data != NULL ) {
+        memcpy(buffer, data, length < size ? length : size);
+    }
+    return (dbcapi_i32) rec->result;
+}
+
+dbcapi_i32
+dbcapi_get_param_data (dbcapi_stmt * stmt, dbcapi_u32 param_index, size_t offset, void * buffer, size_t size)
+{
+    return replay_read(stmt, REC_GET_PARAM_DATA, param_index, offset, buffer, size);
+}
+
+dbcapi_bool
+dbcapi_finish_param_data (dbcapi_stmt * stmt, dbcapi_u32 index)
+{
+    Replay_Record * rec = replay_call(&stmt->handle, REC_FINISH_PARAM_DATA, &index, sizeof(index), NULL);
+    return rec != NULL ? (dbcapi_bool) rec->result : 0;
+}
+
+dbcapi_bool
+dbcapi_execute (dbcapi_stmt * stmt)
+{
+    return (dbcapi_bool) replay_handle_call(&stmt->handle, REC_EXECUTE, 0);
+}
+
+dbcapi_bool
+dbcapi_fetch_next (dbcapi_stmt * stmt)
+{
+    return (dbcapi_bool) replay_handle_call(&stmt->handle, REC_FETCH_NEXT, 0);
+}
+
+dbcapi_bool
+dbcapi_get_next_result (dbcapi_stmt * stmt)
+{
+    return (dbcapi_bool) replay_handle_call(&stmt->handle, REC_GET_NEXT_RESULT, 0);
+}
+
+dbcapi_i32
+dbcapi_affected_rows (dbcapi_stmt * stmt)
+{
+    return (dbcapi_i32) replay_handle_call(&stmt->handle, REC_AFFECTED_ROWS, -1);
+}
+
+dbcapi_i32
+dbcapi_num_cols (dbcapi_stmt * stmt)
+{
+    return (dbcapi_i32) replay_handle_call(&stmt->handle, REC_NUM_COLS, -1);
+}
+
+dbcapi_i32
+dbcapi_num_rows (dbcapi_stmt * stmt)
+{
+    return (dbcapi_i32) replay_handle_call(&stmt->handle, REC_NUM_ROWS, -1);
+}
+
+dbcapi_bool
+dbcapi_get_column (dbcapi_stmt * stmt, dbcapi_u32 col_index, dbcapi_data_value * buffer)
+{
+    Replay_Reader r;
+    Replay_Record * rec = replay_call(&stmt->handle, REC_GET_COLUMN, &col_index, sizeof(col_index), &r);
+    if ( rec == NULL || !rec->result ) {
+        return 0;
+    }
+    Replay_Column * c = get_col(stmt, col_index);
+    buffer->type = (dbcapi_data_type) read_u32(&r);
+    buffer->buffer_size = (size_t) read_u64(&r);
+    c->is_null = read_u8(&r);
+    c->length = (size_t) read_u64(&r);
+    uint32_t data_length;
+    // values point into the loaded recording, which is kept until DBCAPI is finalized
+    buffer->buffer = (char *) read_bytes(&r, &data_length);
+    buffer->length = &c->length;
+    buffer->is_null = &c->is_null;
+    buffer->is_address = 0;
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_get_column_info (dbcapi_stmt * stmt, dbcapi_u32 col_index, dbcapi_column_info * buffer)
+{
+    Replay_Reader r;
+    Replay_Record * rec = replay_call(&stmt->handle, REC_GET_COLUMN_INFO, &col_index, sizeof(col_index), &r);
+    if ( rec == NULL || !rec->result ) {
+        return 0;
+    }
+    Replay_Column * c = get_col(stmt, col_index);
+    memset(buffer, 0, sizeof(dbcapi_column_info));
+    buffer->name = read_string(&r, &c->name);
+    buffer->type = (dbcapi_data_type) read_u32(&r);
+    buffer->native_type = (dbcapi_native_type) read_u32(&r);
+    buffer->precision = (unsigned short) read_u32(&r);
+    buffer->scale = (unsigned short) read_u32(&r);
+    buffer->max_size = (size_t) read_u64(&r);
+    buffer->nullable = read_u8(&r);
+    buffer->table_name = read_string(&r, &c->table_name);
+    buffer->owner_name = read_string(&r, &c->owner_name);
+    buffer->is_case_sensitive = read_u8(&r);
+    buffer->column_name = read_string(&r, &c->column_name);
+    buffer->is_signed = read_u8(&r);
+    buffer->is_autoincrement = read_u8(&r);
+    return 1;
+}
+
+dbcapi_i32
+dbcapi_get_data (dbcapi_stmt * stmt, dbcapi_u32 col_index, size_t offset, void * buffer, size_t size)
+{
+    return replay_read(stmt, REC_GET_DATA, col_index, offset, buffer, size);
+}
+
+dbcapi_retcode
+dbcapi_get_print_line (dbcapi_stmt * stmt, const dbcapi_i32 host_type, void * buffer, size_t * length_indicator, size_t buffer_size, const dbcapi_bool terminate)
+{
+    Replay_Reader r;
+    Replay_Record * rec = replay_call(&stmt->handle, REC_GET_PRINT_LINE, NULL, 0, &r);
+    if ( rec == NULL ) {
+        return DBCAPI_NO_DATA_FOUND;
+    }
+    read_u32(&r);
+    read_u64(&r);
+    read_u8(&r);
+    size_t length = (size_t) read_u64(&r);
+    uint32_t data_length;
+    const uint8_t * data = read_bytes(&r, &data_length);
+    if ( length_indicator != NULL ) {
+        *length_indicator = length;
+    }
+    if ( data != NULL && buffer_size > 0 ) {
+        size_t n = data_length < buffer_size ? data_length : buffer_size;
+        memcpy(buffer, data, n);
+        if ( terminate ) {
+            ( (char *) buffer )[n < buffer_size ? n : buffer_size - 1] = '\0';
+        }
+    }
+    return (dbcapi_retcode) rec->result;
+}
+
+dbcapi_bool
+dbcapi_cancel (dbcapi_connection * conn)
+{
+    return 1;
+}
@@ -0,0 +1,1032 @@
+/**
+ * Stub DBCAPI library.
+ *
+ * Implements the DBCAPI functions `hdbtcl` resolves during initialization and serves synthetic
+ * result sets without a server. The shape of the result set is described by `key=value` tokens
+ * embedded into the SQL text:
+ *  - `rows=N`       - number of rows a SELECT returns (default 1)
+ *  - `cols=T,T,...` - column types: tinyint, smallint, int, bigint, real, double, decimal, boolean,
+ *                     varchar, nvarchar, varbinary, date, timestamp, clob, nclob, blob, real_vector
+ *                     (default int)
+ *  - `width=N`      - length of generated string and binary values, dimension of generated vectors
+ *  - `lob=N`        - size of generated LOB values (default 1024)
+ *  - `nulls=N`      - every Nth row has NULLs in all columns but the first one
+ *  - `failrow=N`    - fetching row N fails as if the connection was lost
+ *  - `params=T,...` - types of the `?` parameters (default varchar)
+ *  - `sleep=MS`     - execution takes MS milliseconds unless it is cancelled
+ *  - `latency=US`   - every execute, fetch, LOB read and LOB write call takes US more microseconds,
+ *                     which simulates the network round trip
+ *  - `echo`         - the result set has a row with the values of the bound parameters for each
+ *                     argument list (vector parameters are echoed as vector columns, all others
+ *                     as varchar)
+ * Statements that do not start with SELECT report 1 affected row per argument list. Statements
+ * that mention `no_such_table` fail to prepare. Connecting with `-serverNode fail` fails.
+ *
+ * Parameters can be bound to arrays of argument lists - `dbcapi_set_batch_size` sets the number of
+ * lists, `dbcapi_set_param_bind_type` selects column-wise (0) or row-wise binding (the row size).
+ *
+ * Queries that `hdb export` wraps around the exported query are understood as well: the key range
+ * query returns 1 and the number of rows, and partition queries return rows whose first column
+ * (the row number) is within the bound key range.
+ *
+ * The stub also checks how the library is used and aborts the process when:
+ *  - a connection is created before `dbcapi_init` or after the matching `dbcapi_fini`
+ *  - a connection is used by two threads at the same time (`dbcapi_cancel` is the only exception)
+ * When `DBCAPI_STUB_CHECK_FINI` is set the process exits with status 3 if `dbcapi_init` and
+ * `dbcapi_fini` calls were not balanced.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <DBCAPI.h>
+
+#define MAX_COLS   256
+#define MAX_PARAMS 256
+
+struct dbcapi_connection {
+    pthread_mutex_t     guard;          /// protects owner and depth
+    pthread_t           owner;          /// thread that is currently using the connection
+    int                 depth;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cancel_cond;
+    int                 cancelled;
+    int                 connected;
+    dbcapi_bool         autocommit;
+    int                 error_code;
+    char                error_msg[256];
+    char                app_name[64];
+};
+
+typedef struct stub_echo_value {
+    char *              data;
+    size_t              length;
+    dbcapi_bool         is_null;
+} Stub_Echo_Value;
+
+typedef struct stub_column {
+    dbcapi_column_info  info;
+    const char *        type_name;
+    char *              buffer;
+    size_t              buffer_size;
+    size_t              length;
+    dbcapi_bool         is_null;
+} Stub_Column;
+
+struct dbcapi_stmt {
+    dbcapi_connection * conn;
+    char *              sql;
+    int                 is_select;
+    int                 echo;
+    long                num_rows;
+    long                width;
+    long                lob_size;
+    long                nulls;
+    long                fail_row;
+    long                sleep_ms;
+    long                latency_us;
+    int                 key_range;      /// the query is the export key range query
+    long                first_row;
+    long                last_row;
+    int                 num_cols;
+    Stub_Column         cols[MAX_COLS];
+    int                 num_params;
+    dbcapi_data_type    param_types[MAX_PARAMS];
+    dbcapi_native_type  param_native_types[MAX_PARAMS];
+    dbcapi_bind_data    binds[MAX_PARAMS];
+    dbcapi_u32          batch_size;     /// number of argument lists the parameters are bound to
+    size_t              param_row_size; /// 0 - parameters are bound column-wise
+    Stub_Echo_Value *   echo_values;    /// values of the echoed argument lists, batch_size rows
+    int                 executed;
+    long                cur_row;
+    long                affected_rows;
+};
+
+static int init_count;
+
+/**
+ * Aborts the process if DBCAPI has not been initialized.
+ */
+static void
+check_init ()
+{
+    if ( __atomic_load_n(&init_count, __ATOMIC_SEQ_CST) <= 0 ) {
+        fprintf(stderr, "dbcapi stub: DBCAPI is used while it is not initialized\n");
+        abort();
+    }
+}
+
+/**
+ * Marks the beginning of a connection use by the current thread. Aborts the process if another
+ * thread is using the connection.
+ */
+static void
+enter (dbcapi_connection * conn)
+{
+    check_init();
+    pthread_mutex_lock(&conn->guard);
+    if ( conn->depth > 0 && !pthread_equal(conn->owner, pthread_self()) ) {
+        fprintf(stderr, "dbcapi stub: connection %p is used by two threads at the same time\n", (void *) conn);
+        abort();
+    }
+    conn->owner = pthread_self();
+    conn->depth++;
+    pthread_mutex_unlock(&conn->guard);
+}
+
+static void
+leave (dbcapi_connection * conn)
+{
+    pthread_mutex_lock(&conn->guard);
+    conn->depth--;
+    pthread_mutex_unlock(&conn->guard);
+}
+
+__attribute__((destructor))
+static void
+check_fini ()
+{
+    int count = __atomic_load_n(&init_count, __ATOMIC_SEQ_CST);
+    if ( count != 0 && getenv("DBCAPI_STUB_CHECK_FINI") != NULL ) {
+        fprintf(stderr, "dbcapi stub: %d dbcapi_init calls were not matched by dbcapi_fini\n", count);
+        _Exit(3);
+    }
+}
+
+static void
+set_error (dbcapi_connection * conn, int code, const char * msg)
+{
+    conn->error_code = code;
+    snprintf(conn->error_msg, sizeof(conn->error_msg), "%s", msg);
+}
+
+static void
+clear_error (dbcapi_connection * conn)
+{
+    conn->error_code = 0;
+    conn->error_msg[0] = '\0';
+}
+
+dbcapi_bool
+dbcapi_init (const char * app_name, dbcapi_u32 api_version, dbcapi_u32 * version_available)
+{
+    if ( version_available != NULL ) *version_available = _DBCAPI_VERSION;
+    __atomic_add_fetch(&init_count, 1, __ATOMIC_SEQ_CST);
+    return 1;
+}
+
+void
+dbcapi_fini ()
+{
+    __atomic_sub_fetch(&init_count, 1, __ATOMIC_SEQ_CST);
+}
+
+dbcapi_connection *
+dbcapi_new_connection ()
+{
+    check_init();
+    dbcapi_connection * conn = calloc(1, sizeof(dbcapi_connection));
+    pthread_mutex_init(&conn->guard, NULL);
+    pthread_mutex_init(&conn->lock, NULL);
+    pthread_cond_init(&conn->cancel_cond, NULL);
+    return conn;
+}
+
+void
+dbcapi_free_connection (dbcapi_connection * conn)
+{
+    pthread_cond_destroy(&conn->cancel_cond);
+    pthread_mutex_destroy(&conn->lock);
+    pthread_mutex_destroy(&conn->guard);
+    free(conn);
+}
+
+dbcapi_bool
+dbcapi_connect2 (dbcapi_connection * conn)
+{
+    clear_error(conn);
+    conn->connected = 1;
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_disconnect (dbcapi_connection * conn)
+{
+    conn->connected = 0;
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_set_connect_property (dbcapi_connection * conn, const char * property, const char * value)
+{
+    if ( strcasecmp(property, "serverNode") == 0 && strcmp(value, "fail") == 0 ) {
+        set_error(conn, -10709, "Connection failed");
+        return 0;
+    }
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_set_clientinfo (dbcapi_connection * conn, const char * property, const char * value)
+{
+    if ( strcmp(property, "APPLICATION") == 0 ) {
+        snprintf(conn->app_name, sizeof(conn->app_name), "%s", value);
+    }
+    return 1;
+}
+
+const char *
+dbcapi_get_clientinfo (dbcapi_connection * conn, const char * property)
+{
+    if ( strcmp(property, "APPLICATION") == 0 ) {
+        return conn->app_name;
+    }
+    return NULL;
+}
+
+dbcapi_bool
+dbcapi_set_transaction_isolation (dbcapi_connection * conn, dbcapi_u32 isolation_level)
+{
+    return 1 <= isolation_level && isolation_level <= 3;
+}
+
+dbcapi_bool
+dbcapi_set_autocommit (dbcapi_connection * conn, dbcapi_bool mode)
+{
+    conn->autocommit = mode;
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_get_autocommit (dbcapi_connection * conn, dbcapi_bool * mode)
+{
+    *mode = conn->autocommit;
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_commit (dbcapi_connection * conn)
+{
+    enter(conn);
+    leave(conn);
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_rollback (dbcapi_connection * conn)
+{
+    enter(conn);
+    leave(conn);
+    return 1;
+}
+
+size_t
+dbcapi_error_length (dbcapi_connection * conn)
+{
+    return strlen(conn->error_msg) + 1;
+}
+
+dbcapi_i32
+dbcapi_error (dbcapi_connection * conn, char * buffer, size_t size)
+{
+    if ( size > 0 ) {
+        snprintf(buffer, size, "%s", conn->error_msg);
+    }
+    return conn->error_code;
+}
+
+// REAL_VECTOR is newer than the DBCAPI.h the stub is built with
+#define STUB_DT_REAL_VECTOR ((dbcapi_native_type) 96)
+
+static const struct {
+    const char *        name;
+    dbcapi_data_type    type;
+    dbcapi_native_type  native_type;
+    size_t              max_size;
+} stub_types[] = {
+    { "tinyint",   A_UVAL8,  DT_TINYINT,   1 },
+    { "smallint",  A_VAL16,  DT_SMALLINT,  2 },
+    { "int",       A_VAL32,  DT_INT,       4 },
+    { "bigint",    A_VAL64,  DT_BIGINT,    8 },
+    { "real",      A_FLOAT,  DT_REAL,      4 },
+    { "double",    A_DOUBLE, DT_DOUBLE,    8 },
+    { "decimal",   A_STRING, DT_DECIMAL,   34 },
+    { "boolean",   A_UVAL8,  DT_BOOLEAN,   1 },
+    { "varchar",   A_STRING, DT_VARCHAR1,  5000 },
+    { "nvarchar",  A_STRING, DT_NVARCHAR,  5000 },
+    { "varbinary", A_BINARY, DT_VARBINARY, 5000 },
+    { "date",      A_STRING, DT_DATE,      10 },
+    { "timestamp", A_STRING, DT_TIMESTAMP, 29 },
+    { "clob",      A_STRING, DT_CLOB,      INT32_MAX },
+    { "nclob",     A_STRING, DT_NCLOB,     INT32_MAX },
+    { "blob",      A_BINARY, DT_BLOB,      INT32_MAX },
+    { "real_vector", A_BINARY, STUB_DT_REAL_VECTOR, 65000 },
+    { NULL }
+};
+
+static int
+find_type (const char * name, size_t len)
+{
+    for ( int i = 0; stub_types[i].name != NULL; i++ ) {
+        if ( strlen(stub_types[i].name) == len && strncasecmp(stub_types[i].name, name, len) == 0 ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static const char *
+find_option (const char * sql, const char * key)
+{
+    size_t key_len = strlen(key);
+    for ( const char * p = sql; (p = strstr(p, key)) != NULL; p += key_len ) {
+        if ( (p == sql || p[-1] == ' ' || p[-1] == '\n' || p[-1] == '\t' || p[-1] == '(') ) {
+            return p + key_len;
+        }
+    }
+    return NULL;
+}
+
+static long
+long_option (const char * sql, const char * key, long default_value)
+{
+    const char * val = find_option(sql, key);
+    return val != NULL ? strtol(val, NULL, 10) : default_value;
+}
+
+static int
+parse_types (const char * spec, int * type_idx, int max_types)
+{
+    int n = 0;
+    while ( *spec != '\0' && *spec != ' ' && *spec != '\n' && *spec != ')' && n < max_types ) {
+        const char * end = spec;
+        while ( *end != '\0' && *end != ',' && *end != ' ' && *end != '\n' && *end != ')' ) ++end;
+        int t = find_type(spec, end - spec);
+        type_idx[n++] = t < 0 ? 2 : t;
+        spec = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static void
+fill_column (dbcapi_stmt * stmt, int col, int type_idx, const char * name)
+{
+    Stub_Column * c = &stmt->cols[col];
+    c->type_name = stub_types[type_idx].name;
+    c->info.name = strdup(name);
+    c->info.column_name = c->info.name;
+    c->info.table_name = "STUB_TABLE";
+    c->info.owner_name = "STUB";
+    c->info.type = stub_types[type_idx].type;
+    c->info.native_type = stub_types[type_idx].native_type;
+    c->info.max_size = stub_types[type_idx].max_size;
+    c->info.nullable = col > 0;
+    c->info.precision = c->info.native_type == DT_DECIMAL ? 18 : 0;
+    c->info.scale = c->info.native_type == DT_DECIMAL ? 3 : 0;
+    size_t size = 64;
+    if ( c->info.max_size == INT32_MAX ) {
+        size = stmt->lob_size + 1;
+    } else if ( c->info.native_type == STUB_DT_REAL_VECTOR ) {
+        size = stmt->width * sizeof(float) + 64;
+    } else if ( c->info.type == A_STRING || c->info.type == A_BINARY ) {
+        size = stmt->width * 2 + 64;
+    }
+    c->buffer_size = size;
+    c->buffer = malloc(size);
+}
+
+static dbcapi_stmt *
+stub_prepare (dbcapi_connection * conn, const char * sql)
+{
+    clear_error(conn);
+    if ( strstr(sql, "no_such_table") != NULL ) {
+        set_error(conn, 259, "invalid table name: Could not find table/view NO_SUCH_TABLE");
+        return NULL;
+    }
+    dbcapi_stmt * stmt = calloc(1, sizeof(dbcapi_stmt));
+    stmt->conn = conn;
+    stmt->sql = strdup(sql);
+    stmt->batch_size = 1;
+    while ( *sql == ' ' || *sql == '\n' || *sql == '\t' ) ++sql;
+    stmt->is_select = strncasecmp(sql, "SELECT", 6) == 0;
+    stmt->echo = find_option(sql, "echo") != NULL;
+    stmt->num_rows = long_option(sql, "rows=", 1);
+    stmt->width = long_option(sql, "width=", 16);
+    stmt->lob_size = long_option(sql, "lob=", 1024);
+    stmt->nulls = long_option(sql, "nulls=", 0);
+    stmt->fail_row = long_option(sql, "failrow=", 0);
+    stmt->sleep_ms = long_option(sql, "sleep=", 0);
+    stmt->latency_us = long_option(sql, "latency=", 0);
+    stmt->key_range = strncasecmp(sql, "SELECT TO_BIGINT(MIN(", 21) == 0;
+
+    for ( const char * p = sql; *p; p++ ) {
+        if ( *p == '?' && stmt->num_params < MAX_PARAMS ) {
+            stmt->num_params++;
+        }
+    }
+    int param_types[MAX_PARAMS];
+    const char * spec = find_option(sql, "params=");
+    int num_typed = spec != NULL ? parse_types(spec, param_types, MAX_PARAMS) : 0;
+    for ( int i = 0; i < stmt->num_params; i++ ) {
+        int t = i < num_typed ? param_types[i] : 8;
+        stmt->param_types[i] = stub_types[t].type;
+        stmt->param_native_types[i] = stub_types[t].native_type;
+    }
+
+    if ( stmt->is_select ) {
+        int col_types[MAX_COLS];
+        if ( stmt->echo ) {
+            stmt->num_rows = 1;
+            stmt->num_cols = stmt->num_params;
+            for ( int i = 0; i < stmt->num_cols; i++ ) {
+                int t = i < num_typed ? param_types[i] : 8;
+                col_types[i] = stub_types[t].native_type == STUB_DT_REAL_VECTOR ? t : 8;
+            }
+        } else if ( stmt->key_range ) {
+            stmt->num_cols = 2;
+            col_types[0] = col_types[1] = 3;
+        } else {
+            spec = find_option(sql, "cols=");
+            stmt->num_cols = spec != NULL ? parse_types(spec, col_types, MAX_COLS) : 0;
+            if ( stmt->num_cols == 0 ) {
+                col_types[0] = 2;
+                stmt->num_cols = 1;
+            }
+        }
+        for ( int i = 0; i < stmt->num_cols; i++ ) {
+            char name[16];
+            sprintf(name, "C%d", i);
+            fill_column(stmt, i, col_types[i], name);
+        }
+    }
+    return stmt;
+}
+
+dbcapi_bool
+dbcapi_reset (dbcapi_stmt * stmt)
+{
+    stmt->executed = 0;
+    stmt->cur_row = 0;
+    return 1;
+}
+
+static void
+free_echo_values (dbcapi_stmt * stmt)
+{
+    if ( stmt->echo_values == NULL ) {
+        return;
+    }
+    for ( long i = 0; i < stmt->num_rows * stmt->num_cols; i++ ) {
+        free(stmt->echo_values[i].data);
+    }
+    free(stmt->echo_values);
+    stmt->echo_values = NULL;
+}
+
+void
+dbcapi_free_stmt (dbcapi_stmt * stmt)
+{
+    for ( int i = 0; i < stmt->num_cols; i++ ) {
+        free(stmt->cols[i].info.name);
+        free(stmt->cols[i].buffer);
+    }
+    free_echo_values(stmt);
+    free(stmt->sql);
+    free(stmt);
+}
+
+dbcapi_i32
+dbcapi_num_params (dbcapi_stmt * stmt)
+{
+    return stmt->num_params;
+}
+
+dbcapi_bool
+dbcapi_describe_bind_param (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_data * param)
+{
+    if ( index >= (dbcapi_u32) stmt->num_params ) {
+        set_error(stmt->conn, -10, "parameter index out of range");
+        return 0;
+    }
+    memset(param, 0, sizeof(dbcapi_bind_data));
+    param->direction = DD_INPUT;
+    param->name = "";
+    param->value.type = stmt->param_types[index];
+    switch ( stmt->param_native_types[index] ) {
+        case DT_CLOB: case DT_NCLOB: case DT_BLOB:
+            param->value.buffer_size = INT32_MAX;
+            break;
+        default:
+            param->value.buffer_size = 5000;
+    }
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_bind_param (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_data * param)
+{
+    if ( index >= (dbcapi_u32) stmt->num_params ) {
+        set_error(stmt->conn, -10, "parameter index out of range");
+        return 0;
+    }
+    stmt->binds[index] = *param;
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_set_batch_size (dbcapi_stmt * stmt, dbcapi_u32 num_rows)
+{
+    if ( num_rows == 0 ) {
+        set_error(stmt->conn, -10, "batch size must be positive");
+        return 0;
+    }
+    stmt->batch_size = num_rows;
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_set_param_bind_type (dbcapi_stmt * stmt, size_t row_size)
+{
+    stmt->param_row_size = row_size;
+    return 1;
+}
+
+/**
+ * Returns the value the parameter is bound to for the argument list of the batch. Column-wise bound
+ * values are `buffer_size` bytes apart (lengths and NULL indicators are arrays), row-wise bound ones
+ * are all `param_row_size` bytes apart.
+ */
+static dbcapi_data_value
+bound_value (dbcapi_stmt * stmt, int index, dbcapi_u32 row)
+{
+    dbcapi_data_value value = stmt->binds[index].value;
+    size_t row_size = stmt->param_row_size;
+    value.buffer += row * ( row_size != 0 ? row_size : value.buffer_size );
+    if ( value.length != NULL ) {
+        value.length = (size_t *) ( (char *) value.length + row * ( row_size != 0 ? row_size : sizeof(size_t) ) );
+    }
+    if ( value.is_null != NULL ) {
+        value.is_null = (dbcapi_bool *) ( (char *) value.is_null + row * ( row_size != 0 ? row_size : sizeof(dbcapi_bool) ) );
+    }
+    return value;
+}
+
+dbcapi_bool
+dbcapi_get_bind_param_info (dbcapi_stmt * stmt, dbcapi_u32 index, dbcapi_bind_param_info * info)
+{
+    if ( index >= (dbcapi_u32) stmt->num_params ) {
+        set_error(stmt->conn, -10, "parameter index out of range");
+        return 0;
+    }
+    memset(info, 0, sizeof(dbcapi_bind_param_info));
+    info->name = "";
+    info->direction = DD_INPUT;
+    info->native_type = stmt->param_native_types[index];
+    info->input_value = stmt->binds[index].value;
+    if ( info->input_value.type == A_INVALID_TYPE ) {
+        info->input_value.type = stmt->param_types[index];
+    }
+    info->max_size = 5000;
+    return 1;
+}
+
+/**
+ * Simulates the round trip to the server.
+ */
+static void
+stub_delay (dbcapi_stmt * stmt)
+{
+    if ( stmt->latency_us > 0 ) {
+        struct timespec delay = { stmt->latency_us / 1000000, ( stmt->latency_us % 1000000 ) * 1000 };
+        while ( nanosleep(&delay, &delay) != 0 && errno == EINTR );
+    }
+}
+
+dbcapi_bool
+dbcapi_send_param_data (dbcapi_stmt * stmt, dbcapi_u32 index, char * buffer, size_t size)
+{
+    stub_delay(stmt);
+    return index < (dbcapi_u32) stmt->num_params;
+}
+
+dbcapi_i32
+dbcapi_get_param_data (dbcapi_stmt * stmt, dbcapi_u32 param_index, size_t offset, void * buffer, size_t size)
+{
+    return 0;
+}
+
+dbcapi_bool
+dbcapi_finish_param_data (dbcapi_stmt * stmt, dbcapi_u32 index)
+{
+    return index < (dbcapi_u32) stmt->num_params;
+}
+
+static int
+stub_sleep (dbcapi_connection * conn, long ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += (ms % 1000) * 1000000L;
+    if ( deadline.tv_nsec >= 1000000000L ) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&conn->lock);
+    int rc = 0;
+    while ( !conn->cancelled && rc != ETIMEDOUT ) {
+        rc = pthread_cond_timedwait(&conn->cancel_cond, &conn->lock, &deadline);
+    }
+    int cancelled = conn->cancelled;
+    conn->cancelled = 0;
+    pthread_mutex_unlock(&conn->lock);
+    return !cancelled;
+}
+
+static void echo_value (dbcapi_stmt * stmt, int index, dbcapi_u32 row, Stub_Echo_Value * echo);
+
+static long
+param_long (dbcapi_stmt * stmt, int index)
+{
+    dbcapi_data_value value = bound_value(stmt, index, 0);
+    switch ( value.type ) {
+        case A_VAL32: return *(int32_t *) value.buffer;
+        case A_VAL64: return (long) *(int64_t *) value.buffer;
+        default: {
+            char num[32];
+            size_t len = value.length != NULL && *value.length < sizeof(num) ? *value.length : 0;
+            memcpy(num, value.buffer, len);
+            num[len] = '\0';
+            return strtol(num, NULL, 10);
+        }
+    }
+}
+
+/**
+ * Limits rows of the export partition query to the bound key range.
+ */
+static void
+set_row_range (dbcapi_stmt * stmt)
+{
+    stmt->first_row = 1;
+    stmt->last_row = stmt->key_range ? 1 : stmt->num_rows;
+    const char * where = strstr(stmt->sql, "hdbtcl_export WHERE ");
+    if ( where == NULL || stmt->num_params == 0 ) {
+        return;
+    }
+    long bound = param_long(stmt, stmt->num_params - 1);
+    if ( strstr(where, " IS NULL") != NULL ) {
+        if ( bound - 1 < stmt->last_row ) stmt->last_row = bound - 1;
+    } else if ( strstr(where, ">= ? AND") != NULL ) {
+        long lower = param_long(stmt, stmt->num_params - 2);
+        if ( lower > stmt->first_row ) stmt->first_row = lower;
+        if ( bound - 1 < stmt->last_row ) stmt->last_row = bound - 1;
+    } else if ( bound > stmt->first_row ) {
+        stmt->first_row = bound;
+    }
+}
+
+static dbcapi_bool
+stub_execute (dbcapi_stmt * stmt)
+{
+    clear_error(stmt->conn);
+    pthread_mutex_lock(&stmt->conn->lock);
+    stmt->conn->cancelled = 0;
+    pthread_mutex_unlock(&stmt->conn->lock);
+    stub_delay(stmt);
+    if ( stmt->sleep_ms > 0 && !stub_sleep(stmt->conn, stmt->sleep_ms) ) {
+        set_error(stmt->conn, 139, "current operation cancelled by request and transaction rolled back");
+        return 0;
+    }
+    for ( int i = 0; i < stmt->num_params; i++ ) {
+        if ( stmt->binds[i].value.type == A_INVALID_TYPE ) {
+            set_error(stmt->conn, -10, "parameter is not bound");
+            return 0;
+        }
+    }
+    if ( stmt->echo ) {
+        // bound buffers are only valid during execution
+        free_echo_values(stmt);
+        stmt->num_rows = stmt->batch_size;
+        stmt->echo_values = calloc(stmt->num_rows * stmt->num_cols, sizeof(Stub_Echo_Value));
+        for ( dbcapi_u32 row = 0; row < stmt->batch_size; row++ ) {
+            for ( int col = 0; col < stmt->num_cols; col++ ) {
+                echo_value(stmt, col, row, &stmt->echo_values[row * stmt->num_cols + col]);
+            }
+        }
+    }
+    set_row_range(stmt);
+    stmt->executed = 1;
+    stmt->cur_row = stmt->first_row - 1;
+    stmt->affected_rows = stmt->is_select ? 0 : stmt->batch_size;
+    return 1;
+}
+
+/**
+ * Renders the value the parameter is bound to for the argument list of the batch.
+ */
+static void
+echo_value (dbcapi_stmt * stmt, int index, dbcapi_u32 row, Stub_Echo_Value * echo)
+{
+    dbcapi_data_value value = bound_value(stmt, index, row);
+    if ( value.is_null != NULL && *value.is_null ) {
+        echo->is_null = 1;
+        return;
+    }
+    switch ( value.type ) {
+        case A_VAL32:
+            echo->data = malloc(16);
+            echo->length = sprintf(echo->data, "%d", *(int32_t *) value.buffer);
+            break;
+        case A_VAL64:
+            echo->data = malloc(24);
+            echo->length = sprintf(echo->data, "%lld", (long long) *(int64_t *) value.buffer);
+            break;
+        case A_DOUBLE:
+            echo->data = malloc(32);
+            echo->length = sprintf(echo->data, "%.17g", *(double *) value.buffer);
+            break;
+        default: {
+            echo->length = value.length != NULL ? *value.length : 0;
+            echo->data = malloc(echo->length + 1);
+            memcpy(echo->data, value.buffer, echo->length);
+        }
+    }
+}
+
+static void
+generate_value (dbcapi_stmt * stmt, int col, long row)
+{
+    Stub_Column * c = &stmt->cols[col];
+    if ( stmt->key_range ) {
+        *(int64_t *) c->buffer = col == 0 ? 1 : stmt->num_rows;
+        c->length = 8;
+        c->is_null = 0;
+        return;
+    }
+    c->is_null = stmt->nulls > 0 && col > 0 && row % stmt->nulls == 0;
+    if ( c->is_null ) {
+        c->length = 0;
+        return;
+    }
+    if ( stmt->echo ) {
+        Stub_Echo_Value * echo = &stmt->echo_values[(row - 1) * stmt->num_cols + col];
+        if ( echo->is_null ) {
+            c->is_null = 1;
+            c->length = 0;
+            return;
+        }
+        if ( echo->length > c->buffer_size ) {
+            c->buffer = realloc(c->buffer, echo->length);
+            c->buffer_size = echo->length;
+        }
+        memcpy(c->buffer, echo->data, echo->length);
+        c->length = echo->length;
+        return;
+    }
+    switch ( (int) c->info.native_type ) {
+        case DT_TINYINT: case DT_BOOLEAN:
+            *(uint8_t *) c->buffer = c->info.native_type == DT_BOOLEAN ? row & 1 : row & 0xff;
+            c->length = 1;
+            break;
+        case DT_SMALLINT:
+            *(int16_t *) c->buffer = (int16_t) row;
+            c->length = 2;
+            break;
+        case DT_INT:
+            *(int32_t *) c->buffer = (int32_t) row;
+            c->length = 4;
+            break;
+        case DT_BIGINT:
+            *(int64_t *) c->buffer = (int64_t) row * 1000003;
+            c->length = 8;
+            break;
+        case DT_REAL:
+            *(float *) c->buffer = (float) row / 4;
+            c->length = 4;
+            break;
+        case DT_DOUBLE:
+            *(double *) c->buffer = row + 0.25;
+            c->length = 8;
+            break;
+        case DT_DECIMAL:
+            c->length = sprintf(c->buffer, "%ld.125", row);
+            break;
+        case DT_DATE:
+            c->length = sprintf(c->buffer, "2020-01-%02ld", row % 28 + 1);
+            break;
+        case DT_TIMESTAMP:
+            c->length = sprintf(c->buffer, "2020-01-01 00:00:%02ld.000000000", row % 60);
+            break;
+        case DT_VARCHAR1: case DT_NVARCHAR: {
+            int len = sprintf(c->buffer, c->info.native_type == DT_NVARCHAR ? "\xd0\xb7\xd0\xbd\xd0\xb0\xd1\x87-%ld-" : "value-%ld-", row);
+            while ( len < stmt->width ) c->buffer[len++] = 'x';
+            c->length = len;
+            break;
+        }
+        case DT_VARBINARY:
+            for ( long i = 0; i < stmt->width; i++ ) c->buffer[i] = (char) (row + i);
+            c->length = stmt->width;
+            break;
+        case DT_CLOB: case DT_NCLOB:
+            for ( long i = 0; i < stmt->lob_size; i++ ) c->buffer[i] = 'a' + (row + i) % 26;
+            c->length = stmt->lob_size;
+            break;
+        case DT_BLOB:
+            for ( long i = 0; i < stmt->lob_size; i++ ) c->buffer[i] = (char) (row + i);
+            c->length = stmt->lob_size;
+            break;
+        case STUB_DT_REAL_VECTOR: {
+            // fvecs layout - the dimension followed by the (little-endian) elements
+            uint32_t dim = (uint32_t) stmt->width;
+            memcpy(c->buffer, &dim, sizeof(dim));
+            for ( uint32_t i = 0; i < dim; i++ ) {
+                float elem = (float) row + (float) i / 4;
+                memcpy(c->buffer + sizeof(dim) + i * sizeof(float), &elem, sizeof(float));
+            }
+            c->length = sizeof(dim) + dim * sizeof(float);
+            break;
+        }
+        default:
+            c->length = 0;
+    }
+}
+
+static dbcapi_bool
+stub_fetch_next (dbcapi_stmt * stmt)
+{
+    clear_error(stmt->conn);
+    if ( !stmt->executed || !stmt->is_select || stmt->cur_row >= stmt->last_row ) {
+        set_error(stmt->conn, 100, "no data");
+        return 0;
+    }
+    stub_delay(stmt);
+    if ( stmt->cur_row + 1 == stmt->fail_row ) {
+        set_error(stmt->conn, -10807, "Connection down: socket closed");
+        return 0;
+    }
+    stmt->cur_row++;
+    for ( int col = 0; col < stmt->num_cols; col++ ) {
+        generate_value(stmt, col, stmt->cur_row);
+    }
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_get_next_result (dbcapi_stmt * stmt)
+{
+    return 0;
+}
+
+dbcapi_i32
+dbcapi_affected_rows (dbcapi_stmt * stmt)
+{
+    return stmt->affected_rows;
+}
+
+dbcapi_i32
+dbcapi_num_cols (dbcapi_stmt * stmt)
+{
+    return stmt->num_cols;
+}
+
+dbcapi_i32
+dbcapi_num_rows (dbcapi_stmt * stmt)
+{
+    return stmt->is_select ? stmt->num_rows : 0;
+}
+
+static dbcapi_bool
+stub_get_column (dbcapi_stmt * stmt, dbcapi_u32 col_index, dbcapi_data_value * buffer)
+{
+    if ( col_index >= (dbcapi_u32) stmt->num_cols || stmt->cur_row == 0 ) {
+        set_error(stmt->conn, -10, "column index out of range or no current row");
+        return 0;
+    }
+    Stub_Column * c = &stmt->cols[col_index];
+    buffer->buffer = c->buffer;
+    buffer->buffer_size = c->buffer_size;
+    buffer->length = &c->length;
+    buffer->type = c->info.type;
+    buffer->is_null = &c->is_null;
+    buffer->is_address = 0;
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_get_column_info (dbcapi_stmt * stmt, dbcapi_u32 col_index, dbcapi_column_info * buffer)
+{
+    if ( col_index >= (dbcapi_u32) stmt->num_cols ) {
+        set_error(stmt->conn, -10, "column index out of range");
+        return 0;
+    }
+    *buffer = stmt->cols[col_index].info;
+    return 1;
+}
+
+static dbcapi_i32
+stub_get_data (dbcapi_stmt * stmt, dbcapi_u32 col_index, size_t offset, void * buffer, size_t size)
+{
+    if ( col_index >= (dbcapi_u32) stmt->num_cols || stmt->cur_row == 0 ) {
+        set_error(stmt->conn, -10, "column index out of range or no current row");
+        return -1;
+    }
+    Stub_Column * c = &stmt->cols[col_index];
+    if ( offset >= c->length ) {
+        return 0;
+    }
+    stub_delay(stmt);
+    size_t len = c->length - offset < size ? c->length - offset : size;
+    memcpy(buffer, c->buffer + offset, len);
+    return (dbcapi_i32) len;
+}
+
+dbcapi_retcode
+dbcapi_get_print_line (dbcapi_stmt * stmt, const dbcapi_i32 host_type, void * buffer, size_t * length_indicator, size_t buffer_size, const dbcapi_bool terminate)
+{
+    return DBCAPI_NO_DATA_FOUND;
+}
+
+dbcapi_stmt *
+dbcapi_prepare (dbcapi_connection * conn, const char * sql)
+{
+    enter(conn);
+    dbcapi_stmt * rc = stub_prepare(conn, sql);
+    leave(conn);
+    return rc;
+}
+
+dbcapi_bool
+dbcapi_execute (dbcapi_stmt * stmt)
+{
+    enter(stmt->conn);
+    dbcapi_bool rc = stub_execute(stmt);
+    leave(stmt->conn);
+    return rc;
+}
+
+dbcapi_bool
+dbcapi_fetch_next (dbcapi_stmt * stmt)
+{
+    enter(stmt->conn);
+    dbcapi_bool rc = stub_fetch_next(stmt);
+    leave(stmt->conn);
+    return rc;
+}
+
+dbcapi_bool
+dbcapi_get_column (dbcapi_stmt * stmt, dbcapi_u32 col_index, dbcapi_data_value * buffer)
+{
+    enter(stmt->conn);
+    dbcapi_bool rc = stub_get_column(stmt, col_index, buffer);
+    leave(stmt->conn);
+    return rc;
+}
+
+dbcapi_i32
+dbcapi_get_data (dbcapi_stmt * stmt, dbcapi_u32 col_index, size_t offset, void * buffer, size_t size)
+{
+    enter(stmt->conn);
+    dbcapi_i32 rc = stub_get_data(stmt, col_index, offset, buffer, size);
+    leave(stmt->conn);
+    return rc;
+}
+
+dbcapi_stmt *
+dbcapi_execute_direct (dbcapi_connection * conn, const char * sql)
+{
+    dbcapi_stmt * stmt = dbcapi_prepare(conn, sql);
+    if ( stmt == NULL ) {
+        return NULL;
+    }
+    if ( !dbcapi_execute(stmt) ) {
+        dbcapi_free_stmt(stmt);
+        return NULL;
+    }
+    return stmt;
+}
+
+dbcapi_bool
+dbcapi_execute_immediate (dbcapi_connection * conn, const char * sql)
+{
+    dbcapi_stmt * stmt = dbcapi_execute_direct(conn, sql);
+    if ( stmt == NULL ) {
+        return 0;
+    }
+    dbcapi_free_stmt(stmt);
+    return 1;
+}
+
+dbcapi_bool
+dbcapi_cancel (dbcapi_connection * conn)
+{
+    pthread_mutex_lock(&conn->lock);
+    conn->cancelled = 1;
+    pthread_cond_broadcast(&conn->cancel_cond);
+    pthread_mutex_unlock(&conn->lock);
+    return 1;
+}
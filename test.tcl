@@ -492,6 +492,107 @@ describe "Non-LOB data manipulation statements" {
             expr { $num_rows_checked == 2 }
         }
     }
+    -it "can fetch binaries as hex and base64" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_varbinary) VALUES (?,?)"]
+        set bin [binary format c* {0 1 2 -1 -2 -3 64 65 66 67 68 69 70 71 72 73 74 75 76 77}]
+        $stmt execute [incr last_id] $bin
+        set stmt [$::conn prepare "SELECT id, a_varbinary FROM hdbtcl_test_data WHERE id = ?"]
+        $stmt execute $last_id
+        $stmt fetch row -binaryas hex
+        expect "binary is fetched as hex" {
+            expr { [lindex $row 1] eq [binary encode hex $bin] }
+        }
+        $stmt execute $last_id
+        set rows [$stmt fetchmany 10 -binaryas {bytes base64}]
+        expect "binary is fetched as base64" {
+            expr { [lindex $rows 0 1] eq [binary encode base64 $bin] }
+        }
+        expect "non-binary columns are not affected" {
+            expr { [lindex $rows 0 0] == $last_id }
+        }
+    }
+    -it "can fetch rows as JSON" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_bigint, a_double, a_boolean, a_nvarchar) VALUES (?,?,?,?,?)"]
+        $stmt execute [incr last_id] 42 0.5 true "say \"hi\"\n"
+        set stmt [$::conn prepare "SELECT id, a_bigint, a_double, a_boolean, a_nvarchar, a_date FROM hdbtcl_test_data WHERE id = ?"]
+        $stmt execute $last_id
+        expect "row is rendered as a JSON array of objects" {
+            expr { [$stmt fetchjson] eq "\[{\"ID\":$last_id,\"A_BIGINT\":42,\"A_DOUBLE\":0.5,\"A_BOOLEAN\":true,\"A_NVARCHAR\":\"say \\\"hi\\\"\\n\",\"A_DATE\":null}\]" }
+        }
+        $stmt execute $last_id
+        expect "row is rendered as NDJSON" {
+            expr { [llength [split [string trimright [$stmt fetchjson -format ndjson] "\n"] "\n"]] == 1 }
+        }
+        expect "no rows are left" {
+            expr { [$stmt fetchjson] eq "\[\]" }
+        }
+    }
+    -it "can fetch numeric columns into packed arrays" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_bigint, a_double) VALUES (?,?,?)"]
+        set first_id [expr { $last_id + 1 }]
+        $stmt executemany [list [list [incr last_id] 5000000000 0.5] [list [incr last_id] {} -2.25] [list [incr last_id] -7 {}]]
+        set stmt [$::conn prepare "SELECT id, a_bigint, a_double FROM hdbtcl_test_data WHERE id >= ? ORDER BY id"]
+        $stmt execute $first_id
+        binary scan [$stmt fetchcolumn A_BIGINT -nulls nulls] w* bigints
+        binary scan $nulls b3 null_flags
+        expect "integers are fetched as int64 and NULLs as 0" {
+            expr { $bigints eq {5000000000 0 -7} && $null_flags eq "010" }
+        }
+        $stmt execute $first_id
+        binary scan [$stmt fetchcolumn 2 -as double -maxrows 2] q* doubles
+        expect "doubles are fetched up to the maximum number of rows" {
+            expr { $doubles eq {0.5 -2.25} }
+        }
+        $stmt execute $first_id
+        expect "values that do not fit int32 are reported" {
+            expr { [catch { $stmt fetchcolumn 1 -as int32 }] == 1 }
+        }
+    }
+    -it "can execute argument lists in batches" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_bigint, a_nvarchar) VALUES (?,?,?)"]
+        set first_id [expr { $last_id + 1 }]
+        set args {}
+        for { set i 0 } { $i < 2500 } { incr i } {
+            lappend args [list [incr last_id] [expr { $i % 7 == 0 ? {} : $i }] [string repeat x [expr { $i % 50 }]]]
+        }
+        expect "all argument lists have been executed" {
+            expr { [$stmt executemany $args] == 2500 }
+        }
+        set stmt [$::conn prepare "SELECT id, a_bigint, a_nvarchar FROM hdbtcl_test_data WHERE id >= ? ORDER BY id"]
+        $stmt execute $first_id
+        set rows [$stmt fetchmany 3000]
+        expect "values of all batches have been stored" {
+            expr { [llength $rows] == 2500 && [lindex $rows 1000] eq [list [expr { $first_id + 1000 }] 1000 [string repeat x 0]] && [lindex $rows 2498] eq [list [expr { $last_id - 1 }] 2498 [string repeat x 48]] }
+        }
+        expect "NULLs are stored in batches" {
+            expr { [lindex $rows 7 1] eq {} }
+        }
+    }
+    -it "can read rows through a channel" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_bigint, a_nvarchar) VALUES (?,?,?)"]
+        $stmt execute [incr last_id] 7 "a,\"b\""
+        set stmt [$::conn prepare "SELECT id, a_bigint, a_nvarchar FROM hdbtcl_test_data WHERE id = ?"]
+        $stmt execute $last_id
+        set chan [$stmt channel -format csv -header true]
+        expect "rows are rendered as CSV" {
+            expr { [read $chan] eq "ID,A_BIGINT,A_NVARCHAR\n$last_id,7,\"a,\"\"b\"\"\"\n" }
+        }
+        close $chan
+        $stmt execute $last_id
+        set chan [$stmt channel -format ndjson]
+        set out [file tempfile out_name]
+        fcopy $chan $out -command [list set ::copied]
+        vwait ::copied
+        close $chan
+        close $out
+        set out [open $out_name]
+        set text [read $out]
+        close $out
+        file delete $out_name
+        expect "fcopy streams rows in the background" {
+            expr { $text eq "{\"ID\":$last_id,\"A_BIGINT\":7,\"A_NVARCHAR\":\"a,\\\"b\\\"\"}\n" }
+        }
+    }
     -it "can manipulate strings" {
         set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_nvarchar) VALUES (?,?)"]
         set text "Ask not what your country can do for you — ask what you can do for your country."
@@ -525,6 +626,21 @@ describe "Non-LOB data manipulation statements" {
             expr { $num_rows_checked == 2 }
         }
     }
+    -it "can manipulate strings with characters outside of the BMP" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_nvarchar) VALUES (?,?)"]
+        set text "smile \U1F600 and \u0000 nul"
+        $stmt execute [incr last_id] $text
+        set stmt [$::conn execute "SELECT a_nvarchar FROM hdbtcl_test_data WHERE id = ?" $last_id]
+        expect "the row has been retrieved" {
+            $stmt fetch row
+        }
+        expect "retrieved value is the same as the inserted one" {
+            expr { [lindex $row 0] eq $text }
+        }
+        expect "supplementary character is a single character" {
+            expr { [string length [lindex $row 0]] == [string length $text] }
+        }
+    }
     -it "can manipulate dates" {
         set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_date) VALUES (?,To_Date(?,?))"]
         set orig_id $last_id
@@ -638,6 +754,575 @@ describe "Non-LOB data manipulation statements" {
     }
 }
 
+describe "Connection pool" {
+    -prologue {
+        if { [info commands hdb] == {} } {
+            break
+        }
+        set ::pool [hdb pool create -serverNode $::node -uid $::uid -pwd $::pwd -minsize 1 -maxsize 2 -clientinfo {APPLICATION hdbtcl_test}]
+    }
+    -it "opens minimum number of connections" {
+        expect "one idle connection" {
+            expr { [dict get [$::pool info] idle] == 1 }
+        }
+    }
+    -it "reuses returned connections" {
+        set conn [$::pool checkout]
+        expect "client info is set" {
+            expr { [$conn set APPLICATION] == "hdbtcl_test" }
+        }
+        $conn configure -autocommit on
+        set stmt [$conn prepare "SELECT * FROM dummy"]
+        $conn close
+        expect "statement is closed" {
+            expr { [info commands $stmt] == {} }
+        }
+        set conn2 [$::pool checkout]
+        expect "same connection" {
+            expr { $conn2 == $conn }
+        }
+        expect "autocommit is reset" {
+            expr { ![$conn2 cget -autocommit] }
+        }
+        $::pool checkin $conn2
+    }
+    -it "does not open more than maximum number of connections" {
+        set conn1 [$::pool checkout]
+        set conn2 [$::pool checkout]
+        expect "pool is exhausted" {
+            expr { [catch { $::pool checkout }] == 1 }
+        }
+        $conn1 close
+        $conn2 close
+        expect "both connections are idle" {
+            expr { [dict get [$::pool info] idle] == 2 }
+        }
+    }
+    -epilogue {
+        $::pool close
+    }
+}
+
+describe "Parallel queries" {
+    -prologue {
+        if { [info commands hdb] == {} } {
+            break
+        }
+        set ::pool [hdb pool create -serverNode $::node -uid $::uid -pwd $::pwd -maxsize 2]
+    }
+    -it "returns results in the order of jobs" {
+        set results [hdb parallel -pool $::pool {
+            {"SELECT 1 FROM dummy"}
+            {"SELECT ? FROM dummy" 2}
+            {"SELECT 3 FROM dummy"}
+        }]
+        expect "result of each job" {
+            expr { [llength $results] == 3 }
+        }
+        expect "rows in job order" {
+            set rows {}
+            foreach res $results {
+                lappend rows [dict get $res rows]
+            }
+            expr { $rows == {1 2 3} }
+        }
+        expect "connections are returned to the pool" {
+            expr { [dict get [$::pool info] busy] == 0 }
+        }
+    }
+    -it "reports errors of individual jobs" {
+        set results [hdb parallel -pool $::pool {
+            {"SELECT * FROM hdbtcl_no_such_table"}
+            {"SELECT 1 FROM dummy"}
+        }]
+        expect "failed job" {
+            expr { [dict get [lindex $results 0] status] == "error" }
+        }
+        expect "completed job" {
+            expr { [dict get [lindex $results 1] status] == "ok" && [dict get [lindex $results 1] rows] == 1 }
+        }
+    }
+    -it "uses listed connections" {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        set results [hdb parallel -connections [list $::conn] -maxrows 2 {
+            {"SELECT schema_name FROM schemas"}
+        }]
+        expect "maxrows limits the number of rows" {
+            expr { [llength [dict get [lindex $results 0] rows]] <= 2 }
+        }
+    }
+    -epilogue {
+        $::pool close
+    }
+}
+
+describe "Partitioned export" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        $::conn exec "CREATE TABLE hdbtcl_test_data (id INTEGER NOT NULL PRIMARY KEY, a_nvarchar NVARCHAR(100))"
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_nvarchar) VALUES (?, ?)"]
+        for { set id 1 } { $id <= 100 } { incr id } {
+            $stmt execute $id "row, $id"
+        }
+        $::conn commit
+        set ::pool [hdb pool create -serverNode $::node -uid $::uid -pwd $::pwd -maxsize 3]
+        set ::export_dir [file join [pwd] hdbtcl_export_test]
+        file mkdir $::export_dir
+    }
+    -it "writes each partition into its own file" {
+        set counts [hdb export -pool $::pool -partitions 3 -key id -batchsize 7 -file [file join $::export_dir part_%d.csv] \
+            "SELECT id, a_nvarchar FROM hdbtcl_test_data WHERE id > ?" 10]
+        expect "all rows are exported" {
+            expr { [tcl::mathop::+ {*}$counts] == 90 && [llength $counts] == 3 }
+        }
+        expect "values are quoted" {
+            set f [open [file join $::export_dir part_0.csv]]
+            set lines [split [read $f] "\n"]
+            close $f
+            expr { [lsearch -exact $lines {11,"row, 11"}] >= 0 }
+        }
+    }
+    -it "writes partitions into the channel in the key order" {
+        set file_name [file join $::export_dir all.tsv]
+        set f [open $file_name w]
+        hdb export -pool $::pool -partitions 3 -key id -batchsize 7 -channel $f -format tsv "SELECT id FROM hdbtcl_test_data"
+        close $f
+        set f [open $file_name]
+        set ids [split [string trim [read $f]] "\n"]
+        close $f
+        expect "rows are ordered" {
+            expr { [llength $ids] == 100 && $ids == [lsort -integer $ids] }
+        }
+    }
+    -epilogue {
+        file delete -force $::export_dir
+        $::pool close
+        $::conn exec "DROP TABLE hdbtcl_test_data"
+    }
+}
+
+describe "Merging ordered result sets" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        $::conn exec "CREATE TABLE hdbtcl_test_data (id INTEGER NOT NULL PRIMARY KEY, a_decimal DECIMAL(10,2))"
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_decimal) VALUES (?, ?)"]
+        for { set id 1 } { $id <= 20 } { incr id } {
+            $stmt execute $id [expr { $id * 1.5 }]
+        }
+        $::conn commit
+    }
+    -it "returns rows of all statements in the key order" {
+        set s1 [$::conn query "SELECT id, a_decimal FROM hdbtcl_test_data WHERE MOD(id, 3) = 0 ORDER BY id"]
+        set s2 [$::conn query "SELECT id, a_decimal FROM hdbtcl_test_data WHERE MOD(id, 3) <> 0 ORDER BY id"]
+        set merge [hdb merge -key ID $s1 $s2]
+        set ids {}
+        while { [$merge fetch row] } {
+            lappend ids [lindex $row 0]
+        }
+        $merge close
+        $s1 close
+        $s2 close
+        expect "all rows are merged" {
+            expr { [llength $ids] == 20 && $ids == [lsort -integer $ids] }
+        }
+    }
+    -it "compares decimal keys numerically in the descending order" {
+        set s1 [$::conn query "SELECT a_decimal, id FROM hdbtcl_test_data WHERE id < 10 ORDER BY a_decimal DESC"]
+        set s2 [$::conn query "SELECT a_decimal, id FROM hdbtcl_test_data WHERE id >= 10 ORDER BY a_decimal DESC"]
+        set merge [hdb merge -key 0 -order desc $s1 $s2]
+        set rows [$merge fetchmany 100]
+        $merge close
+        $s1 close
+        $s2 close
+        expect "rows are ordered" {
+            set ids {}
+            foreach row $rows {
+                lappend ids [lindex $row 1]
+            }
+            expr { [llength $ids] == 20 && $ids == [lsort -integer -decreasing $ids] }
+        }
+    }
+    -epilogue {
+        $::conn exec "DROP TABLE hdbtcl_test_data"
+    }
+}
+
+describe "Parallel conversion" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        set conversion_threads [dict get [hdb configure] conversionthreads]
+        set query "SELECT generated_period_start, TO_NVARCHAR(generated_period_start) FROM SERIES_GENERATE_INTEGER(1, 0, 20000) ORDER BY 1"
+    }
+    -it "converts large rowsets into the same rows with any number of threads" {
+        set results {}
+        foreach threads { 1 4 } {
+            hdb configure -conversionthreads $threads
+            set stmt [$::conn execute $query]
+            lappend results [$stmt fetchmany 20000]
+            $stmt close
+        }
+        expect "rows are converted in order" {
+            expr { [llength [lindex $results 0]] == 20000 && [lindex $results 0] eq [lindex $results 1] }
+        }
+    }
+    -epilogue {
+        hdb configure -conversionthreads $conversion_threads
+    }
+}
+
+describe "Vectors" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        # REAL_VECTOR is only available in HANA Cloud
+        if { [catch { $::conn execute "CREATE TABLE hdbtcl_test_vectors (id INTEGER PRIMARY KEY, embedding REAL_VECTOR(3))" }] } {
+            break
+        }
+    }
+    -it "can load vectors from lists and packed floats" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_vectors (id, embedding) VALUES (?,?)"]
+        expect "all argument lists have been executed" {
+            expr { [$stmt executemany [list {1 {0.5 1.25 -2}} [list 2 [binary format f* {3 4 5}]] {3 {}}]] == 3 }
+        }
+    }
+    -it "can fetch vectors as packed floats and as lists" {
+        set stmt [$::conn execute "SELECT id, embedding FROM hdbtcl_test_vectors ORDER BY id"]
+        set rows [$stmt fetchmany 10 -binaryas {bytes list}]
+        expect "vectors are fetched as lists of doubles" {
+            expr { [lindex $rows 0 1] eq {0.5 1.25 -2.0} && [lindex $rows 1 1] eq {3.0 4.0 5.0} }
+        }
+        expect "NULL vectors are fetched as empty values" {
+            expr { [lindex $rows 2 1] eq {} }
+        }
+        set stmt [$::conn execute "SELECT embedding FROM hdbtcl_test_vectors WHERE id = 2"]
+        $stmt fetch row
+        expect "vectors are fetched as packed floats by default" {
+            expr { [lindex $row 0] eq [binary format f* {3 4 5}] }
+        }
+        set stmt [$::conn execute "SELECT id, embedding FROM hdbtcl_test_vectors WHERE id = 1"]
+        expect "vectors are rendered as JSON arrays" {
+            expr { [$stmt fetchjson] eq {[{"ID":1,"EMBEDDING":[0.5,1.25,-2.0]}]} }
+        }
+    }
+    -it "sends packed floats as bare elements" {
+        # the first element has the bits of a dimension that matches the rest of the bytes
+        set embedding [binary format iu1f2 2 {7 8}]
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_vectors (id, embedding) VALUES (?,?)"]
+        $stmt execute 4 $embedding
+        set stmt [$::conn execute "SELECT embedding FROM hdbtcl_test_vectors WHERE id = 4"]
+        $stmt fetch row
+        expect "all bytes are vector elements" {
+            expr { [lindex $row 0] eq $embedding }
+        }
+    }
+    -epilogue {
+        $::conn execute "DROP TABLE hdbtcl_test_vectors"
+    }
+}
+
+describe "Performance counters" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        $::conn stats -reset
+    }
+    -it "counts statement work" {
+        set stmt [$::conn prepare "SELECT schema_name FROM schemas"]
+        $stmt execute
+        set rows [$stmt fetchmany 1000]
+        set stats [$stmt stats]
+        $stmt close
+        expect "prepare and execute" {
+            expr { [dict get $stats prepares] == 1 && [dict get $stats executes] == 1 }
+        }
+        expect "fetched rows" {
+            expr { [dict get $stats rows] == [llength $rows] && [dict get $stats fetches] == 1 }
+        }
+    }
+    -it "rolls statement counters up to the connection" {
+        set stats [$::conn stats -reset]
+        expect "connection counters" {
+            expr { [dict get $stats prepares] >= 1 && [dict get $stats rows] >= 1 }
+        }
+        expect "counters are reset" {
+            expr { [dict get [$::conn stats] prepares] == 0 }
+        }
+        expect "module counters" {
+            expr { [dict get [hdb stats] prepares] >= 1 }
+        }
+    }
+}
+
+describe "Memory accounting" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+    }
+    -it "reports memory of open statements" {
+        set stmt [$::conn prepare "SELECT schema_name FROM schemas"]
+        $stmt execute
+        set rows [$stmt fetchmany 1000]
+        set resources [$::conn resources]
+        $stmt close
+        expect "statement entry" {
+            dict exists $resources statements $stmt
+        }
+        expect "fetch is accounted while it builds the rows" {
+            expr { [dict get $resources statements $stmt peak rows] > 0 }
+        }
+        expect "connection entry" {
+            dict exists [hdb resources] connections $::conn
+        }
+    }
+    -it "accounts OUT value buffers" {
+        set stmt [$::conn prepare "
+            DO (OUT p_name NVARCHAR(256) => ?)
+            BEGIN
+                p_name = 'hdbtcl';
+            END
+        "]
+        $stmt execute name
+        set resources [$::conn resources]
+        $stmt close
+        expect "OUT value" {
+            expr { $name == "hdbtcl" }
+        }
+        expect "OUT buffer is accounted while the statement executes" {
+            expr { [dict get $resources statements $stmt peak params] > 0 && [dict get $resources statements $stmt memory params] == 0 }
+        }
+    }
+    -it "fails fetches that exceed the limit" {
+        $::conn configure -memorylimit 100
+        set stmt [$::conn prepare "SELECT schema_name FROM schemas"]
+        $stmt execute
+        set res [catch { $stmt fetchmany 1000 } err]
+        $stmt close
+        $::conn configure -memorylimit 0
+        expect "fetch error" {
+            expr { $res == 1 && [string match "*exceed*memory limit*" $err] }
+        }
+    }
+}
+
+describe "Latency metrics" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        hdb metrics -reset
+    }
+    -it "records latencies of labelled statements" {
+        set stmt [$::conn prepare "SELECT schema_name FROM schemas"]
+        $stmt configure -label schemas
+        $stmt execute
+        set rows [$stmt fetchmany 1000]
+        $stmt close
+        set metrics [hdb metrics]
+        expect "execute latency" {
+            expr { [dict get $metrics execute count] == 1 && [dict get $metrics labels schemas execute count] == 1 }
+        }
+        expect "row fetch latency" {
+            expr { [dict get $metrics labels schemas fetch count] == [llength $rows] }
+        }
+        expect "ordered percentiles" {
+            expr { [dict get $metrics execute p50] <= [dict get $metrics execute p99] }
+        }
+    }
+    -it "exports metrics in Prometheus format" {
+        set text [hdb metrics -format prometheus -reset]
+        expect "execute summary" {
+            expr { [string first "hdbtcl_execute_seconds_count 1" $text] >= 0 }
+        }
+        expect "labelled summary" {
+            expr { [string first {hdbtcl_execute_seconds_count{label="schemas"} 1} $text] >= 0 }
+        }
+    }
+}
+
+describe "Slow statement tracing" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        hdb slowlog -clear
+    }
+    -epilogue {
+        $::conn trace -threshold -1 -command ""
+    }
+    -it "records statements that take longer than the threshold" {
+        proc ::trace_callback { entry } {
+            lappend ::traced $entry
+        }
+        set ::traced {}
+        $::conn trace -threshold 0 -command ::trace_callback
+        set stmt [$::conn query "SELECT schema_name FROM schemas"]
+        set rows [$stmt fetchmany 1000]
+        $stmt close
+        update
+        set log [hdb slowlog]
+        expect "statement in the log" {
+            expr { [llength $log] == 1 && [dict get [lindex $log 0] sql] == "SELECT schema_name FROM schemas" }
+        }
+        expect "fetched rows" {
+            expr { [dict get [lindex $log 0] rows] == [llength $rows] }
+        }
+        expect "callback has been called" {
+            expr { $::traced == $log }
+        }
+    }
+    -it "does not record statements when tracing is off" {
+        $::conn trace -threshold -1
+        hdb slowlog -clear
+        set stmt [$::conn query "SELECT * FROM dummy"]
+        $stmt fetchmany 10
+        $stmt close
+        expect "empty log" {
+            expr { [llength [hdb slowlog]] == 0 }
+        }
+    }
+}
+
+describe "Unprepared statements" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+    }
+    -it "can execute statements without preparing them" {
+        $::conn exec "CREATE TABLE hdbtcl_test_data (id INTEGER NOT NULL PRIMARY KEY, a_nvarchar NVARCHAR(100))"
+        $::conn exec "INSERT INTO hdbtcl_test_data (id, a_nvarchar) VALUES (1, 'one')"
+        $::conn exec "INSERT INTO hdbtcl_test_data (id, a_nvarchar) VALUES (2, 'two')"
+
+        set stmt [$::conn query "SELECT id, a_nvarchar FROM hdbtcl_test_data ORDER BY id"]
+        expect "first row" {
+            expr { [$stmt fetch row] && $row == {1 one} }
+        }
+        expect "second row" {
+            expr { [$stmt fetch row] && $row == {2 two} }
+        }
+        expect "no more rows" {
+            expr { ![$stmt fetch row] }
+        }
+    }
+    -it "binds thousands of arguments" {
+        set num_args 5000
+        set args {}
+        for { set i 1 } { $i <= $num_args } { incr i } {
+            lappend args $i
+        }
+        set stmt [$::conn prepare "SELECT COUNT(*) FROM hdbtcl_test_data WHERE id IN ([join [lrepeat $num_args ?] ,])"]
+        $stmt execute {*}$args
+        expect "matching rows" {
+            expr { [$stmt fetch row] && $row == 2 }
+        }
+        $stmt close
+    }
+    -it "reports errors from unprepared statements" {
+        expect "exec fails" {
+            expr { [catch { $::conn exec "SELECT * FROM hdbtcl_no_such_table" }] == 1 }
+        }
+        expect "query fails" {
+            expr { [catch { $::conn query "SELECT * FROM hdbtcl_no_such_table" }] == 1 }
+        }
+    }
+    -epilogue {
+        $::conn exec "DROP TABLE hdbtcl_test_data"
+    }
+}
+
+describe "Asynchronous execution" {
+    -prologue {
+        if { ![info exists ::conn] || [info commands $::conn] == {} } {
+            break
+        }
+        $::conn exec "CREATE TABLE hdbtcl_test_data (id INTEGER NOT NULL PRIMARY KEY, a_nvarchar NVARCHAR(100))"
+        proc ::async_done { status result } {
+            set ::async_result [list $status $result]
+        }
+    }
+    -it "can execute statements asynchronously" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_nvarchar) VALUES (?, ?)"]
+        foreach {id str} {1 one 2 two 3 three} {
+            $stmt execute -async -command ::async_done $id $str
+            expect "connection is busy" {
+                expr { [catch { $::conn commit }] == 1 }
+            }
+            vwait ::async_result
+            expect "row $id is inserted" {
+                expr { $::async_result == {ok {}} }
+            }
+        }
+        $stmt close
+    }
+    -it "can fetch rows asynchronously" {
+        set stmt [$::conn prepare "SELECT id, a_nvarchar FROM hdbtcl_test_data ORDER BY id"]
+        $stmt execute -async -command ::async_done
+        vwait ::async_result
+        $stmt fetchmany -async 2 -command ::async_done
+        vwait ::async_result
+        expect "first 2 rows" {
+            expr { $::async_result == {ok {{1 one} {2 two}}} }
+        }
+        expect "remaining rows" {
+            expr { [$stmt fetchmany 2] == {{3 three}} }
+        }
+        expect "no more rows" {
+            expr { [$stmt fetchmany 2] == {} }
+        }
+        $stmt close
+    }
+    -it "can cancel asynchronous execution" {
+        set stmt [$::conn prepare "SELECT COUNT(*) FROM objects a, objects b, objects c"]
+        $stmt execute -async -command ::async_done
+        expect "request is cancelled" {
+            $stmt cancel
+        }
+        vwait ::async_result
+        expect "execution fails" {
+            expr { [lindex $::async_result 0] == "error" }
+        }
+        expect "nothing to cancel" {
+            expr { ![$stmt cancel] }
+        }
+        $stmt close
+    }
+    -it "cancels statements that run longer than the timeout" {
+        set stmt [$::conn prepare "SELECT COUNT(*) FROM objects a, objects b, objects c"]
+        $stmt configure -timeout 100
+        expect "statement timeout" {
+            expr { [$stmt cget -timeout] == 100 }
+        }
+        expect "execution times out" {
+            expr { [catch { $stmt execute } err] == 1 && [string match "Statement execution timed out*" $err] }
+        }
+        $stmt close
+    }
+    -it "reports asynchronous execution errors" {
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_nvarchar) VALUES (?, ?)"]
+        $stmt execute -async -command ::async_done 1 "duplicate"
+        vwait ::async_result
+        expect "execution fails" {
+            expr { [lindex $::async_result 0] == "error" }
+        }
+        $stmt close
+    }
+    -epilogue {
+        $::conn exec "DROP TABLE hdbtcl_test_data"
+        rename ::async_done {}
+    }
+}
+
 describe "LOB data manipulation statements" {
     -prologue {
         if { ![info exists ::conn] || [info commands $::conn] == {} } {
@@ -739,6 +1424,27 @@ describe "LOB data manipulation statements" {
             expr { $text == $quote }
         }
     }
+    -it "reads LOBs in pieces of the configured size" {
+        set text [string repeat "0123456789" 100]
+        set stmt [$::conn prepare "INSERT INTO hdbtcl_test_data (id, a_nclob) VALUES (?,?)"]
+        $stmt execute [incr last_id] $text
+
+        proc keep_lob_chunks { read_state lob_chunk col_num col_name table_name table_owner } {
+            lappend read_state $lob_chunk
+            return $read_state
+        }
+
+        $::conn configure -lobchunksize 300
+        set stmt [$::conn execute "SELECT a_nclob FROM hdbtcl_test_data WHERE id = ?" $last_id]
+        $stmt fetch row -lobreadcommand keep_lob_chunks
+        $::conn configure -lobchunksize 32768
+        expect "chunk size" {
+            expr { [$::conn cget -lobchunksize] == 32768 && [string length [lindex $row 0 0]] == 300 }
+        }
+        expect "kept chunks are intact" {
+            expr { [join [lindex $row 0] ""] == $text }
+        }
+    }
     -it "can save OUT LOBs into variables or streams" {
         set quote "Imagination was given to man to compensate him for what he is not, and a sense of humor was provided to console him for what he is."
 